@@ -112,7 +112,9 @@ int JitterBuffer::put(int index, void* src)
  *
  * @date       2015-03-24
  *
- * @revision   none
+ * @revision   2026-10-18 - returns 0 without waiting if the buffer was
+ *   emptied by {JitterBuffer::reset} while waiting for an element.
+ *             2026-10-18 - calls the overload that returns the index.
  *
  * @designer   Eric Tsang
  *
@@ -129,9 +131,59 @@ int JitterBuffer::put(int index, void* src)
  */
 int JitterBuffer::get(void* dest)
 {
-    // acquire synchronization objects
-    WaitForSingleObject(notEmpty,INFINITE);
+    int index;
+    return get(dest,&index);
+}
+
+/**
+ * copies the next element from th {JitterBuffer} to the {dest} pointer, and
+ *   its index to {index}. elements that were never inserted are padded over
+ *   with the next one, so the indexes of the elements removed always go up by
+ *   one.
+ *
+ * @function   JitterBuffer::get
+ *
+ * @date       2026-10-18
+ *
+ * @revision   2026-10-18 - returns 0 right away if the buffer is empty,
+ *   instead of waiting for an element.
+ *
+ * @designer   Eric Tsang
+ *
+ * @programmer Eric Tsang
+ *
+ * @note       used by consumers that need to know where they are in the
+ *   stream. consumers wait for {canGet} before calling it; a delayed set of
+ *   {canGet} from before a {JitterBuffer::reset} can still wake them once
+ *   the buffer is empty, so it is cleared again instead of blocking the
+ *   consumer.
+ *
+ * @signature  int JitterBuffer::get(void* dest, int* index)
+ *
+ * @param      dest pointer to copy element data into
+ * @param      index set to the index of the element removed
+ *
+ * @return     1 if there was an inserted to remove from the JitterBuffer; 0
+ *   otherwise.
+ */
+int JitterBuffer::get(void* dest, int* index)
+{
+    // acquire synchronization objects; there's nothing to wait for if the
+    // buffer is empty
+    bool hasElement = WaitForSingleObject(notEmpty,0) == WAIT_OBJECT_0;
     WaitForSingleObject(access,INFINITE);
+
+    // the buffer may have been reset since {canGet} was set
+    if(!hasElement || Heap::size() == 0)
+    {
+        if(Heap::size() == 0)
+        {
+            ResetEvent(canGet);
+        }
+        ReleaseMutex(access);
+        return 0;
+    }
+
     WaitForSingleObject(canGet,INFINITE);
 
     // copy data from root to destination
@@ -140,7 +192,8 @@ int JitterBuffer::get(void* dest)
     Heap::setRelativeZero(lastIndex);
 
     // remove data from buffer if consumed, don't remove otherwise, because we're padding the data.
-    if(++lastIndex == tempIndex)
+    *index = ++lastIndex;
+    if(lastIndex == tempIndex)
     {
         Heap::remove();
         ReleaseSemaphore(notFull,1,NULL);
@@ -163,6 +216,76 @@ int JitterBuffer::get(void* dest)
     return 1;
 }
 
+/**
+ * throws away every element in the {JitterBuffer}, and makes {index} + 1 the
+ *   index of the next element to be removed. used when the source starts over
+ *   with a new range of indexes, so the elements still in the buffer, and the
+ *   ones still on their way, are never played.
+ *
+ * @function   JitterBuffer::reset
+ *
+ * @date       2026-10-18
+ *
+ * @revision   none
+ *
+ * @designer   Eric Tsang
+ *
+ * @programmer Eric Tsang
+ *
+ * @note       as after construction, the next element put into the buffer
+ *   can only be removed after {delay} milliseconds.
+ *
+ * @signature  void JitterBuffer::reset(int index)
+ *
+ * @param      index index before the first index to accept.
+ */
+void JitterBuffer::reset(int index)
+{
+    WaitForSingleObject(access,INFINITE);
+
+    while(Heap::size() > 0)
+    {
+        Heap::remove();
+        WaitForSingleObject(notEmpty,0);
+        ReleaseSemaphore(notFull,1,NULL);
+    }
+
+    lastIndex = index;
+    strikes   = 0;
+    ResetEvent(canGet);
+
+    ReleaseMutex(access);
+}
+
+/**
+ * sets the milliseconds to wait after the first element is put into the empty
+ *   {JitterBuffer} before it can be removed; the latency the buffer adds to
+ *   absorb jitter.
+ *
+ * @function   JitterBuffer::setDelay
+ *
+ * @date       2026-10-18
+ *
+ * @revision   none
+ *
+ * @designer   Eric Tsang
+ *
+ * @programmer Eric Tsang
+ *
+ * @note       takes effect the next time the buffer goes from empty to not
+ *   empty.
+ *
+ * @signature  void JitterBuffer::setDelay(int delay)
+ *
+ * @param      delay milliseconds to hold on to the first element.
+ */
+void JitterBuffer::setDelay(int delay)
+{
+    WaitForSingleObject(access,INFINITE);
+    this->delay = delay;
+    ReleaseMutex(access);
+}
+
 /**
  * returns the number of elements in the {JitterBuffer}.
  *
@@ -14,6 +14,9 @@ public:
     JitterBuffer(int capacity, int himark, int elementSize, int delay, int interval);
     virtual int put(int index, void* src);
     virtual int get(void* dest);
+    virtual int get(void* dest, int* index);
+    virtual void reset(int index);
+    virtual void setDelay(int delay);
     virtual int size();
     virtual int getElementSize();
     /**
@@ -34,6 +34,24 @@ int main(void)
         jb.get(&payload);
         printf("payload: %d\n",payload);
     }
+
+    // start over with a new range of indexes; late packets from before the
+    // reset are rejected
+    payload = 30;
+    jb.put(30,&payload);
+    jb.reset(100);
+
+    payload = 21;
+    jb.put(21,&payload);
+
+    payload = 101;
+    jb.put(101,&payload);
+
+    while(jb.size() > 0)
+    {
+        jb.get(&payload);
+        printf("payload after reset: %d\n",payload);
+    }
     getchar();
 }
 
@@ -0,0 +1,536 @@
+#include "AudioBackend.h"
+#include <stdlib.h>
+#include <string.h>
+
+// static function forward declarations
+
+static std::chrono::steady_clock::duration bytesToTime(unsigned long long bytes,
+    unsigned long bytesPerSecond);
+static void writeWavHeader(FILE* file, int sampleRate, int bitsPerSample,
+    int channels, unsigned long dataSize);
+static int readWavHeader(FILE* file, int* sampleRate, int* bitsPerSample,
+    int* channels, unsigned long* dataSize);
+static void putLittleEndian(unsigned char* dest, unsigned long value, int bytes);
+static unsigned long getLittleEndian(const unsigned char* src, int bytes);
+
+// null output implementation
+
+/**
+ * makes an output that plays nothing.
+ *
+ * @date     2026-10-18
+ *
+ * @param    realTime   true if periods take as long to play as they would on
+ *   a sound card; false if they finish as soon as they are written.
+ */
+NullOutput::NullOutput(bool realTime)
+{
+    this->realTime          = realTime;
+    this->bytesPerSecond    = 0;
+    this->periods           = 0;
+    this->period            = NULL;
+    this->bytesSinceStarted = 0;
+    this->bytesPlayed       = 0;
+}
+
+NullOutput::~NullOutput()
+{
+    close();
+}
+
+int NullOutput::open(int sampleRate, int bitsPerSample, int channels,
+    int periodBytes, int periods)
+{
+    free(period);
+    this->bytesPerSecond    = sampleRate*channels*bitsPerSample/8;
+    this->periods           = periods;
+    this->period            = (char*) malloc(periodBytes);
+    this->bytesSinceStarted = 0;
+    finishes.clear();
+    return period != NULL ? 0 : AUDIO_BACKEND_ERROR;
+}
+
+int NullOutput::close()
+{
+    free(period);
+    period = NULL;
+    finishes.clear();
+    return 0;
+}
+
+char* NullOutput::getPeriod()
+{
+    return queued() < periods ? period : NULL;
+}
+
+/**
+ * plays a period. in real time, it finishes playing once the periods before
+ *   it have, and its length has passed; if there are none, the device has
+ *   run dry, and starts playing again from now.
+ *
+ * @date     2026-10-18
+ *
+ * @param    len   bytes of the period.
+ *
+ * @return   0.
+ */
+int NullOutput::writePeriod(int len)
+{
+    play(period,len);
+    bytesPlayed += len;
+
+    if(realTime)
+    {
+        if(queued() == 0)
+        {
+            started           = Clock::now();
+            bytesSinceStarted = 0;
+        }
+        bytesSinceStarted += len;
+        finishes.push_back(started+bytesToTime(bytesSinceStarted,bytesPerSecond));
+    }
+    return 0;
+}
+
+int NullOutput::queued()
+{
+    Clock::time_point now = Clock::now();
+    while(!finishes.empty() && finishes.front() <= now)
+    {
+        finishes.pop_front();
+    }
+    return (int) finishes.size();
+}
+
+void NullOutput::wait(int timeoutMs)
+{
+    if(!realTime)
+    {
+        return;
+    }
+
+    Clock::time_point until = Clock::now()+std::chrono::milliseconds(timeoutMs);
+    if(queued() > 0 && finishes.front() < until)
+    {
+        until = finishes.front();
+    }
+    std::this_thread::sleep_until(until);
+}
+
+/**
+ * @return   the number of bytes written to the output since it was made.
+ */
+unsigned long long NullOutput::getBytesPlayed()
+{
+    return bytesPlayed;
+}
+
+// wav file output implementation
+
+/**
+ * makes an output that writes what is played to a WAV file. nothing is
+ *   written until it is opened.
+ *
+ * @date     2026-10-18
+ *
+ * @param    path   path of the file to write.
+ * @param    realTime   see {NullOutput::NullOutput}.
+ */
+WavFileOutput::WavFileOutput(const char* path, bool realTime)
+    : NullOutput(realTime)
+{
+    strncpy(this->path,path,sizeof(this->path)-1);
+    this->path[sizeof(this->path)-1] = 0;
+    this->file     = NULL;
+    this->dataSize = 0;
+}
+
+WavFileOutput::~WavFileOutput()
+{
+    close();
+}
+
+int WavFileOutput::open(int sampleRate, int bitsPerSample, int channels,
+    int periodBytes, int periods)
+{
+    close();
+    this->sampleRate    = sampleRate;
+    this->bitsPerSample = bitsPerSample;
+    this->channels      = channels;
+    this->dataSize      = 0;
+    this->file          = fopen(path,"wb");
+    if(file == NULL)
+    {
+        return AUDIO_BACKEND_ERROR;
+    }
+
+    writeWavHeader(file,sampleRate,bitsPerSample,channels,dataSize);
+    return NullOutput::open(sampleRate,bitsPerSample,channels,periodBytes,periods);
+}
+
+/**
+ * fills in the sizes in the header of the file, and closes it.
+ *
+ * @date     2026-10-18
+ *
+ * @return   0.
+ */
+int WavFileOutput::close()
+{
+    if(file != NULL)
+    {
+        fseek(file,0,SEEK_SET);
+        writeWavHeader(file,sampleRate,bitsPerSample,channels,dataSize);
+        fclose(file);
+        file = NULL;
+    }
+    return NullOutput::close();
+}
+
+void WavFileOutput::play(const char* data, int len)
+{
+    dataSize += fwrite(data,1,len,file);
+}
+
+// null input implementation
+
+/**
+ * makes an input that captures silence.
+ *
+ * @date     2026-10-18
+ *
+ * @param    realTime   true if buffers take as long to capture as they would
+ *   on a sound card; false if they are handed over as fast as they are added.
+ */
+NullInput::NullInput(bool realTime)
+{
+    this->realTime       = realTime;
+    this->bitsPerSample  = 8;
+    this->bytesPerSecond = 0;
+    this->handler        = NULL;
+    this->overruns       = 0;
+    this->stopping       = true;
+}
+
+NullInput::~NullInput()
+{
+    close();
+}
+
+/**
+ * starts the thread that captures into the buffers, and hands them over.
+ *
+ * @date     2026-10-18
+ *
+ * @return   0.
+ */
+int NullInput::open(int sampleRate, int bitsPerSample, int channels,
+    AudioInputHandler* handler)
+{
+    NullInput::close();
+    this->bitsPerSample  = bitsPerSample;
+    this->bytesPerSecond = sampleRate*channels*bitsPerSample/8;
+    this->handler        = handler;
+    this->stopping       = false;
+    this->thread         = std::thread(&NullInput::_threadRoutine,this);
+    return 0;
+}
+
+int NullInput::addBuffer(char* data, int len)
+{
+    std::lock_guard<std::mutex> lock(access);
+    if(stopping)
+    {
+        return AUDIO_BACKEND_ERROR;
+    }
+
+    Buffer buffer = {data,len};
+    buffers.push_back(buffer);
+    changed.notify_all();
+    return 0;
+}
+
+void NullInput::close()
+{
+    if(thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(access);
+            stopping = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+}
+
+/**
+ * @return   the number of times there was no buffer to capture into.
+ */
+unsigned long NullInput::getOverruns()
+{
+    std::lock_guard<std::mutex> lock(access);
+    return overruns;
+}
+
+int NullInput::capture(char* dest, int len)
+{
+    memset(dest,bitsPerSample == 8 ? 0x80 : 0,len);
+    return len;
+}
+
+/**
+ * captures into the buffers, and hands them to the handler, until the input
+ *   is closed or has nothing left to capture; then hands back the buffers it
+ *   still has, unfilled.
+ *
+ * in real time, each buffer is held until the time it would have taken to
+ *   record has passed since capturing started. if there was no buffer when
+ *   the last one was filled, capturing starts over when the next one is
+ *   added.
+ *
+ * @date     2026-10-18
+ */
+void NullInput::_threadRoutine()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point started;
+    unsigned long long bytes = 0;
+    bool overran = true;
+
+    std::unique_lock<std::mutex> lock(access);
+    while(true)
+    {
+        changed.wait(lock,[this]{ return stopping || !buffers.empty(); });
+        if(stopping)
+        {
+            break;
+        }
+
+        Buffer buffer = buffers.front();
+        buffers.pop_front();
+        if(overran)
+        {
+            started = Clock::now();
+            bytes   = 0;
+        }
+
+        lock.unlock();
+        int len = capture(buffer.data,buffer.len);
+        lock.lock();
+        if(len == 0)
+        {
+            buffers.push_front(buffer);
+            break;
+        }
+
+        bytes += len;
+        if(realTime && changed.wait_until(lock,started+bytesToTime(bytes,bytesPerSecond),
+            [this]{ return stopping; }))
+        {
+            buffers.push_front(buffer);
+            break;
+        }
+
+        // in real time, the device overruns if it has nothing to capture into
+        //   next; otherwise it only ever waits for buffers
+        overran = !realTime || buffers.empty();
+        if(realTime && overran)
+        {
+            ++overruns;
+        }
+
+        lock.unlock();
+        handler->captured(buffer.data,len);
+        lock.lock();
+    }
+
+    // no more buffers may be added; hand back the ones left
+    stopping = true;
+    std::deque<Buffer> left;
+    left.swap(buffers);
+    lock.unlock();
+
+    for(size_t i = 0; i < left.size(); ++i)
+    {
+        handler->captured(left[i].data,0);
+    }
+    handler->stopped();
+}
+
+// wav file input implementation
+
+/**
+ * makes an input that captures the samples of a WAV file. the file isn't
+ *   read until the input is opened.
+ *
+ * @date     2026-10-18
+ *
+ * @param    path   path of the file to read.
+ * @param    realTime   see {NullInput::NullInput}.
+ */
+WavFileInput::WavFileInput(const char* path, bool realTime)
+    : NullInput(realTime)
+{
+    strncpy(this->path,path,sizeof(this->path)-1);
+    this->path[sizeof(this->path)-1] = 0;
+    this->file     = NULL;
+    this->dataLeft = 0;
+}
+
+WavFileInput::~WavFileInput()
+{
+    close();
+}
+
+/**
+ * opens the file, and starts capturing from the start of its samples.
+ *
+ * @date     2026-10-18
+ *
+ * @return   0 on success; AUDIO_BACKEND_ERROR if the file can't be read, or
+ *   its samples aren't in the passed format.
+ */
+int WavFileInput::open(int sampleRate, int bitsPerSample, int channels,
+    AudioInputHandler* handler)
+{
+    close();
+    file = fopen(path,"rb");
+    if(file == NULL)
+    {
+        return AUDIO_BACKEND_ERROR;
+    }
+
+    int fileRate;
+    int fileBits;
+    int fileChannels;
+    if(readWavHeader(file,&fileRate,&fileBits,&fileChannels,&dataLeft) != 0
+        || fileRate != sampleRate
+        || fileBits != bitsPerSample
+        || fileChannels != channels)
+    {
+        fclose(file);
+        file = NULL;
+        return AUDIO_BACKEND_ERROR;
+    }
+
+    return NullInput::open(sampleRate,bitsPerSample,channels,handler);
+}
+
+void WavFileInput::close()
+{
+    NullInput::close();
+    if(file != NULL)
+    {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+int WavFileInput::capture(char* dest, int len)
+{
+    if((unsigned long) len > dataLeft)
+    {
+        len = (int) dataLeft;
+    }
+    int read = (int) fread(dest,1,len,file);
+    dataLeft -= read;
+    return read;
+}
+
+// static function implementations
+
+/**
+ * works out how long it takes to play {bytes} bytes, exactly to the tick of
+ *   the clock.
+ */
+std::chrono::steady_clock::duration bytesToTime(unsigned long long bytes,
+    unsigned long bytesPerSecond)
+{
+    const unsigned long long NANOS_PER_SEC = 1000000000ULL;
+    std::chrono::nanoseconds time(
+        bytes/bytesPerSecond*NANOS_PER_SEC+bytes%bytesPerSecond*NANOS_PER_SEC/bytesPerSecond);
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(time);
+}
+
+void writeWavHeader(FILE* file, int sampleRate, int bitsPerSample,
+    int channels, unsigned long dataSize)
+{
+    unsigned char header[44];
+    memcpy(header,"RIFF",4);
+    putLittleEndian(header+4,36+dataSize,4);
+    memcpy(header+8,"WAVEfmt ",8);
+    putLittleEndian(header+16,16,4);
+    putLittleEndian(header+20,1,2);
+    putLittleEndian(header+22,channels,2);
+    putLittleEndian(header+24,sampleRate,4);
+    putLittleEndian(header+28,sampleRate*channels*bitsPerSample/8,4);
+    putLittleEndian(header+32,channels*bitsPerSample/8,2);
+    putLittleEndian(header+34,bitsPerSample,2);
+    memcpy(header+36,"data",4);
+    putLittleEndian(header+40,dataSize,4);
+    fwrite(header,1,sizeof(header),file);
+}
+
+/**
+ * reads the chunks of a WAV file up to the start of its samples.
+ *
+ * @return   0 if the file is PCM, and its format and the size of its samples
+ *   were read; AUDIO_BACKEND_ERROR otherwise.
+ */
+int readWavHeader(FILE* file, int* sampleRate, int* bitsPerSample,
+    int* channels, unsigned long* dataSize)
+{
+    unsigned char chunk[16];
+    if(fread(chunk,1,12,file) != 12
+        || memcmp(chunk,"RIFF",4) != 0
+        || memcmp(chunk+8,"WAVE",4) != 0)
+    {
+        return AUDIO_BACKEND_ERROR;
+    }
+
+    bool haveFormat = false;
+    while(fread(chunk,1,8,file) == 8)
+    {
+        unsigned long size = getLittleEndian(chunk+4,4);
+        if(memcmp(chunk,"fmt ",4) == 0 && size >= 16)
+        {
+            if(fread(chunk,1,16,file) != 16 || getLittleEndian(chunk,2) != 1)
+            {
+                return AUDIO_BACKEND_ERROR;
+            }
+            *channels      = (int) getLittleEndian(chunk+2,2);
+            *sampleRate    = (int) getLittleEndian(chunk+4,4);
+            *bitsPerSample = (int) getLittleEndian(chunk+14,2);
+            haveFormat     = true;
+            size -= 16;
+        }
+        else if(memcmp(chunk,"data",4) == 0)
+        {
+            *dataSize = size;
+            return haveFormat ? 0 : AUDIO_BACKEND_ERROR;
+        }
+
+        // chunks are padded to an even size
+        fseek(file,size+(size&1),SEEK_CUR);
+    }
+    return AUDIO_BACKEND_ERROR;
+}
+
+void putLittleEndian(unsigned char* dest, unsigned long value, int bytes)
+{
+    for(int i = 0; i < bytes; ++i)
+    {
+        dest[i] = (unsigned char) (value >> (i*8));
+    }
+}
+
+unsigned long getLittleEndian(const unsigned char* src, int bytes)
+{
+    unsigned long value = 0;
+    for(int i = 0; i < bytes; ++i)
+    {
+        value |= (unsigned long) src[i] << (i*8);
+    }
+    return value;
+}
@@ -0,0 +1,319 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: AudioBackend.h
+--
+-- NOTES:
+-- The devices the client plays and captures audio on. The
+-- {PlayWave} writes periods of audio to an {AudioOutput}, and
+-- the {MicReader} gives an {AudioInput} buffers to capture
+-- into, and is handed each one back as it is filled; neither
+-- knows what kind of device it is.
+--
+-- The winmm devices are in WinmmBackend.h. The devices here
+-- depend on nothing but the standard library:
+--
+-- {NullOutput} throws away what is written to it, and
+-- {NullInput} captures silence; both at exactly the rate of
+-- real time, so whatever drives them is paced as though by a
+-- sound card.
+--
+-- {WavFileOutput} writes what is played to a WAV file, and
+-- {WavFileInput} captures from one; as fast as they are driven
+-- by default, or at the rate of real time.
+--------------------------------------------------------------*/
+#ifndef AUDIOBACKEND_H
+#define AUDIOBACKEND_H
+
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/**
+ * returned by the devices here when they fail; the winmm devices return
+ *   their MMRESULT instead. 0 is success either way.
+ */
+#define AUDIO_BACKEND_ERROR -1
+
+/**
+ * a device audio is played on. it has room for a few periods at a time,
+ *   which are played in the order they were written.
+ *
+ * an output is only used by one thread at a time.
+ */
+class AudioOutput
+{
+public:
+    virtual ~AudioOutput() {}
+
+    /**
+     * opens the device in the passed format, with room for {periods} periods
+     *   of at most {periodBytes} bytes.
+     *
+     * @return   0 on success.
+     */
+    virtual int open(int sampleRate, int bitsPerSample, int channels,
+        int periodBytes, int periods) = 0;
+
+    /**
+     * throws away whatever hasn't been played yet, and closes the device.
+     *   does nothing if it isn't open.
+     *
+     * @return   0 on success.
+     */
+    virtual int close() = 0;
+
+    /**
+     * @return   the buffer the next period is copied into before it is
+     *   written; NULL if every period is still being played.
+     */
+    virtual char* getPeriod() = 0;
+
+    /**
+     * writes the first {len} bytes of the buffer from {getPeriod} to the
+     *   device.
+     *
+     * @return   0 on success.
+     */
+    virtual int writePeriod(int len) = 0;
+
+    /**
+     * @return   the number of periods written that haven't finished playing.
+     */
+    virtual int queued() = 0;
+
+    /**
+     * blocks until the device finishes playing a period, or {timeoutMs}
+     *   milliseconds have passed.
+     */
+    virtual void wait(int timeoutMs) = 0;
+
+    /**
+     * sets the volume of the device; the low word is the left channel, the
+     *   high word the right. devices without a volume ignore it.
+     */
+    virtual void setVolume(unsigned long /*volume*/) {}
+};
+
+/**
+ * told about the buffers an {AudioInput} captures into, from the thread that
+ *   captures them.
+ */
+class AudioInputHandler
+{
+public:
+    virtual ~AudioInputHandler() {}
+
+    /**
+     * a buffer was filled, or was given back unfilled because the input was
+     *   closed. the buffer is the handler's again; it is only captured into
+     *   again if it is added again.
+     *
+     * @param    data   the buffer, as it was passed to {AudioInput::addBuffer}.
+     * @param    len   the number of bytes captured into it.
+     */
+    virtual void captured(char* data, int len) = 0;
+
+    /**
+     * the input has stopped capturing; because it was closed, or has nothing
+     *   left to capture.
+     */
+    virtual void stopped() {}
+};
+
+/**
+ * a device audio is captured from, into buffers that belong to whoever uses
+ *   it. the buffers are filled in the order they are added.
+ */
+class AudioInput
+{
+public:
+    virtual ~AudioInput() {}
+
+    /**
+     * opens the device in the passed format, and starts capturing into the
+     *   buffers added to it, handing each one to {handler} as it is filled.
+     *
+     * @return   0 on success.
+     */
+    virtual int open(int sampleRate, int bitsPerSample, int channels,
+        AudioInputHandler* handler) = 0;
+
+    /**
+     * gives the device a buffer to capture into. the buffer must stay valid
+     *   until it is handed back to the handler. some devices, like winmm's,
+     *   don't allow it to be called from the handler.
+     *
+     * @return   0 on success.
+     */
+    virtual int addBuffer(char* data, int len) = 0;
+
+    /**
+     * stops capturing, hands back every buffer it still had, and closes the
+     *   device. does nothing if it isn't open.
+     */
+    virtual void close() = 0;
+};
+
+/**
+ * an output that plays nothing. in real time, a period finishes playing
+ *   when the periods before it, and then its own length, have passed, like a
+ *   sound card that never drifts; otherwise it finishes as it is written.
+ */
+class NullOutput : public AudioOutput
+{
+public:
+    NullOutput(bool realTime = true);
+    ~NullOutput();
+    virtual int open(int sampleRate, int bitsPerSample, int channels,
+        int periodBytes, int periods);
+    virtual int close();
+    virtual char* getPeriod();
+    virtual int writePeriod(int len);
+    virtual int queued();
+    virtual void wait(int timeoutMs);
+    unsigned long long getBytesPlayed();
+
+protected:
+    /**
+     * does whatever the output does with a period as it is written.
+     */
+    virtual void play(const char* /*data*/, int /*len*/) {}
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    bool realTime;
+
+    /**
+     * bytes played a second, the most periods that may be queued, and the
+     *   buffer each is copied into; the data is gone once it is written.
+     */
+    unsigned long bytesPerSecond;
+    int periods;
+    char* period;
+
+    /**
+     * when the device last started playing after running dry, and the bytes
+     *   written since; the end of every period is worked out from them, so
+     *   rounding never adds up.
+     */
+    Clock::time_point started;
+    unsigned long long bytesSinceStarted;
+
+    /**
+     * when each period written finishes playing, and the bytes played so far.
+     */
+    std::deque<Clock::time_point> finishes;
+    unsigned long long bytesPlayed;
+};
+
+/**
+ * an output that writes what is played to a WAV file. the file is made over
+ *   each time the output is opened, and its header is filled in when it is
+ *   closed.
+ */
+class WavFileOutput : public NullOutput
+{
+public:
+    WavFileOutput(const char* path, bool realTime = false);
+    ~WavFileOutput();
+    virtual int open(int sampleRate, int bitsPerSample, int channels,
+        int periodBytes, int periods);
+    virtual int close();
+
+protected:
+    virtual void play(const char* data, int len);
+
+private:
+    char path[260];
+    FILE* file;
+    int sampleRate;
+    int bitsPerSample;
+    int channels;
+    unsigned long dataSize;
+};
+
+/**
+ * an input that captures silence. in real time, a buffer is handed over
+ *   once it has taken as long as it would to record; if there is no buffer
+ *   when one would be, what would have been captured is lost, as it is when
+ *   a sound card overruns. otherwise one is handed over after the other as
+ *   fast as they are added.
+ */
+class NullInput : public AudioInput
+{
+public:
+    NullInput(bool realTime = true);
+    ~NullInput();
+    virtual int open(int sampleRate, int bitsPerSample, int channels,
+        AudioInputHandler* handler);
+    virtual int addBuffer(char* data, int len);
+    virtual void close();
+    unsigned long getOverruns();
+
+protected:
+    /**
+     * fills the next buffer to hand over.
+     *
+     * @return   the number of bytes filled; 0 once there is nothing left to
+     *   capture.
+     */
+    virtual int capture(char* dest, int len);
+
+    int bitsPerSample;
+
+private:
+    struct Buffer
+    {
+        char* data;
+        int len;
+    };
+
+    void _threadRoutine();
+
+    bool realTime;
+    unsigned long bytesPerSecond;
+    AudioInputHandler* handler;
+
+    /**
+     * buffers added that haven't been filled yet, oldest first, and the
+     *   number of times there were none to capture into.
+     */
+    std::deque<Buffer> buffers;
+    unsigned long overruns;
+
+    /**
+     * thread that hands over the buffers, what protects the buffers and tells
+     *   it to stop, and what wakes it up when either changes.
+     */
+    std::thread thread;
+    std::mutex access;
+    std::condition_variable changed;
+    bool stopping;
+};
+
+/**
+ * an input that captures the samples of a WAV file, which has to be in the
+ *   format the input is opened in, until the end of the file.
+ */
+class WavFileInput : public NullInput
+{
+public:
+    WavFileInput(const char* path, bool realTime = false);
+    ~WavFileInput();
+    virtual int open(int sampleRate, int bitsPerSample, int channels,
+        AudioInputHandler* handler);
+    virtual void close();
+
+protected:
+    virtual int capture(char* dest, int len);
+
+private:
+    char path[260];
+    FILE* file;
+    unsigned long dataLeft;
+};
+
+#endif
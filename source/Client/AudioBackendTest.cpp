@@ -0,0 +1,271 @@
+#include "AudioBackend.h"
+#include "AudioMixer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef TEST_AUDIO_BACKEND
+
+/**
+ * test of the devices that run without a sound card; like them, it uses
+ *   nothing that depends on the platform, so it runs anywhere.
+ *
+ * a null output is driven as fast as it will take periods of 44100 Hz 16 bit
+ *   stereo, and a null input captures 22050 Hz 8 bit mono, the format of
+ *   voice; both are timed against the clock, to check they keep to the rate
+ *   of real time. then a WAV file is written with a file output, and read
+ *   back with a file input, to check the samples come back as they went in.
+ *
+ * last, the client's mix of many voices is played on a null output in real
+ *   time, the way the client plays it on a sound card, and the share of the
+ *   time spent mixing is reported.
+ */
+
+#define SECONDS 2
+#define PERIOD_MS 20
+#define PERIODS 4
+#define VOICES 16
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * keeps what is captured into a few buffers of its own, and gives each back
+ *   to the input as soon as it is handed over, the way the client does.
+ */
+class Recorder : public AudioInputHandler
+{
+public:
+    Recorder(AudioInput* input) : input(input), done(false) {}
+    void start()
+    {
+        for(int i = 0; i < PERIODS; ++i)
+        {
+            input->addBuffer(pool[i],sizeof(pool[i]));
+        }
+    }
+    virtual void captured(char* data, int len)
+    {
+        {
+            std::lock_guard<std::mutex> lock(access);
+            bytes.insert(bytes.end(),data,data+len);
+        }
+        if(len > 0)
+        {
+            input->addBuffer(data,sizeof(pool[0]));
+        }
+    }
+    virtual void stopped()
+    {
+        std::lock_guard<std::mutex> lock(access);
+        done = true;
+    }
+    AudioInput* input;
+    char pool[PERIODS][256];
+    std::mutex access;
+    std::vector<char> bytes;
+    bool done;
+};
+
+/**
+ * a voice of 8 bit 22050 Hz mono, that never runs dry.
+ */
+class VoiceSource : public PcmSource
+{
+public:
+    VoiceSource(int pitch) : PcmSource(22050,8,1), phase(0)
+    {
+        for(int i = 0; i < (int) sizeof(voice); ++i)
+        {
+            voice[i] = (char) (128+sin(i*pitch*0.01)*40);
+        }
+    }
+protected:
+    virtual int fill(char* dest, int len)
+    {
+        for(int i = 0; i < len; ++i)
+        {
+            dest[i] = voice[phase++%sizeof(voice)];
+        }
+        return len;
+    }
+    char voice[22050];
+    unsigned long phase;
+};
+
+double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now()-start).count();
+}
+
+/**
+ * plays {SECONDS} seconds through a null output, and returns how long it
+ *   took; it should be {SECONDS} exactly.
+ */
+double timeOutput(unsigned long* wakeups)
+{
+    int periodBytes = 44100*2*2*PERIOD_MS/1000;
+    NullOutput output;
+    output.open(44100,16,2,periodBytes,PERIODS);
+
+    *wakeups = 0;
+    Clock::time_point start = Clock::now();
+    for(int p = 0; p < SECONDS*1000/PERIOD_MS; ++p)
+    {
+        while(output.getPeriod() == NULL)
+        {
+            output.wait(PERIOD_MS);
+            ++*wakeups;
+        }
+        output.writePeriod(periodBytes);
+    }
+    while(output.queued() > 0)
+    {
+        output.wait(PERIOD_MS);
+        ++*wakeups;
+    }
+    double taken = secondsSince(start);
+    output.close();
+    return taken;
+}
+
+/**
+ * captures from a null input for {SECONDS} seconds, and returns the rate
+ *   it captured at; it should be 22050 bytes a second.
+ */
+double rateOfInput(unsigned long* overruns)
+{
+    NullInput input;
+    Recorder recorder(&input);
+    Clock::time_point start = Clock::now();
+    input.open(22050,8,1,&recorder);
+    recorder.start();
+    std::this_thread::sleep_for(std::chrono::seconds(SECONDS));
+
+    double rate;
+    {
+        std::lock_guard<std::mutex> lock(recorder.access);
+        rate = recorder.bytes.size()/secondsSince(start);
+    }
+    input.close();
+    *overruns = input.getOverruns();
+    return rate;
+}
+
+/**
+ * writes a ramp to a WAV file, and reads it back.
+ *
+ * @return   the number of bytes that came back wrong, or didn't come back.
+ */
+int roundTrip()
+{
+    const int PERIOD_BYTES = 1000;
+    const int RAMP_PERIODS = 50;
+
+    WavFileOutput output("AudioBackendTest.wav");
+    output.open(22050,8,1,PERIOD_BYTES,PERIODS);
+    for(int p = 0; p < RAMP_PERIODS; ++p)
+    {
+        char* period = output.getPeriod();
+        for(int i = 0; i < PERIOD_BYTES; ++i)
+        {
+            period[i] = (char) (p*PERIOD_BYTES+i);
+        }
+        output.writePeriod(PERIOD_BYTES);
+    }
+    output.close();
+
+    WavFileInput input("AudioBackendTest.wav");
+    Recorder recorder(&input);
+    if(input.open(22050,8,1,&recorder) != 0)
+    {
+        return PERIOD_BYTES*RAMP_PERIODS;
+    }
+    recorder.start();
+    for(bool done = false; !done; )
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::lock_guard<std::mutex> lock(recorder.access);
+        done = recorder.done;
+    }
+    input.close();
+
+    int wrong = abs((int) recorder.bytes.size()-PERIOD_BYTES*RAMP_PERIODS);
+    for(int i = 0; i < (int) recorder.bytes.size() && i < PERIOD_BYTES*RAMP_PERIODS; ++i)
+    {
+        wrong += recorder.bytes[i] != (char) i;
+    }
+    return wrong;
+}
+
+/**
+ * mixes {VOICES} voices into 44100 Hz 16 bit stereo, and plays the mix on a
+ *   null output for {SECONDS} seconds.
+ *
+ * @return   the share of the time spent mixing.
+ */
+double mixInRealTime()
+{
+    AudioMixer mixer(44100,2);
+    VoiceSource* voices[VOICES];
+    for(int v = 0; v < VOICES; ++v)
+    {
+        voices[v] = new VoiceSource(v+1);
+        mixer.addSource(voices[v],0.5f);
+    }
+
+    int periodBytes = MIXER_PERIOD_FRAMES*2*sizeof(short);
+    NullOutput output;
+    output.open(44100,16,2,periodBytes,PERIODS);
+
+    Clock::duration mixing = Clock::duration::zero();
+    Clock::time_point start = Clock::now();
+    for(int p = 0; p < SECONDS*44100/MIXER_PERIOD_FRAMES; ++p)
+    {
+        while(output.getPeriod() == NULL)
+        {
+            output.wait(PERIOD_MS);
+        }
+        Clock::time_point mixStart = Clock::now();
+        memcpy(output.getPeriod(),mixer.mix(),periodBytes);
+        mixing += Clock::now()-mixStart;
+        output.writePeriod(periodBytes);
+    }
+    double taken = secondsSince(start);
+    output.close();
+
+    for(int v = 0; v < VOICES; ++v)
+    {
+        delete voices[v];
+    }
+    return std::chrono::duration<double>(mixing).count()/taken;
+}
+
+int main(void)
+{
+    unsigned long wakeups;
+    double taken = timeOutput(&wakeups);
+    double outputError = (taken-SECONDS)/SECONDS;
+    printf("null output: %d s played in %.4f s, %+.0f ppm, %lu waits for %d periods\n",
+        SECONDS,taken,outputError*1e6,wakeups,SECONDS*1000/PERIOD_MS);
+
+    unsigned long overruns;
+    double rate = rateOfInput(&overruns);
+    double inputError = (rate-22050)/22050;
+    printf("null input: %.1f bytes a second captured, %+.0f ppm, %lu overruns; a period behind is %+.0f ppm\n",
+        rate,inputError*1e6,overruns,-256.0/(22050*SECONDS)*1e6);
+
+    int wrong = roundTrip();
+    printf("wav file: %d bytes wrong\n",wrong);
+
+    double busy = mixInRealTime();
+    printf("%d voices mixed in real time: %.3f%% of the time spent mixing\n",VOICES,busy*100);
+
+    // the output may only be late by the time it takes to wake up; the input
+    //   may be a period behind when it is stopped
+    bool paced = outputError >= 0 && outputError < 0.01
+        && inputError > -0.02 && inputError < 0.01 && overruns == 0;
+    return !paced || wrong != 0;
+}
+
+#endif
@@ -0,0 +1,453 @@
+#include "AudioMixer.h"
+#include <string.h>
+
+// static function forward declarations
+
+static void putLittleEndian(unsigned char* dest, unsigned long value, int bytes);
+static int decodeSample(const char* src, int bitsPerSample);
+
+// wav file sink implementation
+
+/**
+ * opens the WAV file the mix is written to. the sizes in its header are
+ *   filled in when the sink is destroyed.
+ *
+ * @date     2026-10-18
+ *
+ * @param    path   path of the file to write.
+ * @param    sampleRate   sample rate of the mix.
+ * @param    channels   number of channels of the mix.
+ */
+WavFileSink::WavFileSink(const char* path, int sampleRate, int channels)
+{
+    this->sampleRate = sampleRate;
+    this->channels   = channels;
+    this->dataSize   = 0;
+    this->file       = fopen(path,"wb");
+
+    if(file != NULL)
+    {
+        _writeHeader();
+    }
+}
+
+WavFileSink::~WavFileSink()
+{
+    if(file != NULL)
+    {
+        fseek(file,0,SEEK_SET);
+        _writeHeader();
+        fclose(file);
+    }
+}
+
+void WavFileSink::write(const short* samples, int frames, int channels)
+{
+    if(file != NULL)
+    {
+        dataSize += fwrite(samples,sizeof(short),frames*channels,file)*sizeof(short);
+    }
+}
+
+void WavFileSink::_writeHeader()
+{
+    unsigned char header[44];
+    memcpy(header,"RIFF",4);
+    putLittleEndian(header+4,36+dataSize,4);
+    memcpy(header+8,"WAVEfmt ",8);
+    putLittleEndian(header+16,16,4);
+    putLittleEndian(header+20,1,2);
+    putLittleEndian(header+22,channels,2);
+    putLittleEndian(header+24,sampleRate,4);
+    putLittleEndian(header+28,sampleRate*channels*sizeof(short),4);
+    putLittleEndian(header+32,channels*sizeof(short),2);
+    putLittleEndian(header+34,16,2);
+    memcpy(header+36,"data",4);
+    putLittleEndian(header+40,dataSize,4);
+    fwrite(header,1,sizeof(header),file);
+}
+
+// pcm source implementation
+
+PcmSource::PcmSource(int sampleRate, int bitsPerSample, int channels)
+{
+    this->drift = 0;
+    setFormat(sampleRate,bitsPerSample,channels);
+}
+
+/**
+ * sets the format of the data handed over by {fill} from now on; anything
+ *   decoded in the old format is thrown away.
+ *
+ * @date     2026-10-18
+ *
+ * @param    sampleRate   samples per second of the data.
+ * @param    bitsPerSample   bits of each sample; 8 bit samples are unsigned,
+ *   the rest are signed, and only their top 16 bits are used.
+ * @param    channels   number of interleaved channels of the data.
+ */
+void PcmSource::setFormat(int sampleRate, int bitsPerSample, int channels)
+{
+    this->sampleRate    = sampleRate;
+    this->bitsPerSample = bitsPerSample;
+    this->channels      = channels;
+    reset();
+}
+
+/**
+ * makes the data be read a little faster or slower than its sample rate;
+ *   used to follow a source whose clock drifts from that of the mix. the
+ *   frames are interpolated as they are when the rates are different.
+ *
+ * @date     2026-10-18
+ *
+ * @param    ppm   parts per million to read the data faster by; negative to
+ *   read it slower, 0 to read it at its sample rate.
+ */
+void PcmSource::setDrift(double ppm)
+{
+    drift = ppm;
+}
+
+/**
+ * throws away everything that has been handed over but not read yet.
+ *
+ * @date     2026-10-18
+ */
+void PcmSource::reset()
+{
+    partialLen    = 0;
+    frameCount    = 0;
+    frameChannels = 0;
+    position      = 0;
+}
+
+/**
+ * reads frames converted to the format of the mix. if the rates are the same,
+ *   the decoded frames are copied as they are; otherwise every frame of the
+ *   mix is interpolated between the two decoded frames around it.
+ *
+ * @date     2026-10-18
+ *
+ * @revision 2026-10-18 the step between frames includes the drift.
+ *
+ * @param    dest   where to put the frames.
+ * @param    count   most frames to read.
+ * @param    outRate   sample rate of the mix.
+ * @param    outChannels   number of channels of the mix.
+ *
+ * @return   the number of frames read.
+ */
+int PcmSource::read(short* dest, int count, int outRate, int outChannels)
+{
+    // frames decoded for another number of channels are of no use any more
+    if(frameChannels != outChannels)
+    {
+        frameCount    = 0;
+        frameChannels = outChannels;
+        position      = 0;
+    }
+
+    unsigned long long step = ((unsigned long long) sampleRate << 32)/outRate;
+    if(drift != 0)
+    {
+        step = (unsigned long long) (step*(1+drift/1000000));
+    }
+
+    int done = 0;
+    while(done < count)
+    {
+        int index = (int) (position >> 32);
+        int fraction = (int) (position >> 17) & 0x7FFF;
+
+        // a frame between two decoded ones needs the one after it as well
+        if(index+(fraction ? 2 : 1) > frameCount)
+        {
+            if(!_decode(outChannels))
+            {
+                break;
+            }
+            continue;
+        }
+
+        const short* frame = frames+index*outChannels;
+        for(int c = 0; c < outChannels; ++c)
+        {
+            int sample = frame[c];
+            if(fraction)
+            {
+                sample += ((frame[c+outChannels]-sample)*fraction) >> 15;
+            }
+            dest[c] = (short) sample;
+        }
+        dest     += outChannels;
+        position += step;
+        ++done;
+    }
+    return done;
+}
+
+/**
+ * throws away the frames that have been read, and decodes as much more as
+ *   {fill} hands over, mixing the channels down or repeating them up to the
+ *   channels of the mix.
+ *
+ * @date     2026-10-18
+ *
+ * @param    outChannels   number of channels of the mix.
+ *
+ * @return   true if any frames were decoded; false otherwise.
+ */
+bool PcmSource::_decode(int outChannels)
+{
+    int used = (int) (position >> 32);
+    if(used > frameCount)
+    {
+        used = frameCount;
+    }
+    memmove(frames,frames+used*outChannels,(frameCount-used)*outChannels*sizeof(short));
+    frameCount -= used;
+    position   -= (unsigned long long) used << 32;
+
+    int sampleSize = bitsPerSample/8;
+    int frameSize  = sampleSize*channels;
+    if(frameSize <= 0 || frameSize > (int) sizeof(partial))
+    {
+        return false;
+    }
+
+    // get the rest of the frame that was partly handed over last time, and
+    // as many whole frames as there is room for
+    char data[PCM_SOURCE_FRAMES*sizeof(partial)];
+    int room = PCM_SOURCE_FRAMES-frameCount;
+    memcpy(data,partial,partialLen);
+    int len = partialLen+fill(data+partialLen,room*frameSize-partialLen);
+
+    int whole  = len/frameSize;
+    partialLen = len-whole*frameSize;
+    memcpy(partial,data+whole*frameSize,partialLen);
+
+    short* dest = frames+frameCount*outChannels;
+    if((bitsPerSample == 8 || bitsPerSample == 16) && channels <= 2 && outChannels <= 2)
+    {
+        _normalize(dest,data,whole,outChannels);
+    }
+    else
+    {
+        for(int i = 0; i < whole; ++i)
+        {
+            const char* frame = data+i*frameSize;
+            if(outChannels == 1 && channels > 1)
+            {
+                int sum = 0;
+                for(int c = 0; c < channels; ++c)
+                {
+                    sum += decodeSample(frame+c*sampleSize,bitsPerSample);
+                }
+                dest[0] = (short) (sum/channels);
+            }
+            else
+            {
+                for(int c = 0; c < outChannels; ++c)
+                {
+                    dest[c] = (short) decodeSample(frame+(c%channels)*sampleSize,bitsPerSample);
+                }
+            }
+            dest += outChannels;
+        }
+    }
+    frameCount += whole;
+
+    return whole > 0;
+}
+
+/**
+ * converts whole frames of 8 or 16 bit, mono or stereo data to the channels
+ *   of the mix, a block at a time. the samples are widened to 16 bits first,
+ *   unless they are already, and the channels are then mixed down, repeated
+ *   up, or copied as they are.
+ *
+ * @date     2026-10-18
+ *
+ * @param    dest   where to put the frames.
+ * @param    data   the frames handed over by {fill}.
+ * @param    count   number of frames.
+ * @param    outChannels   number of channels of the mix.
+ */
+void PcmSource::_normalize(short* dest, const char* data, int count, int outChannels)
+{
+    // samples already in the channels of the mix need no other step
+    short samples[PCM_SOURCE_FRAMES*MIXER_MAX_CHANNELS];
+    short* widened = channels == outChannels ? dest : samples;
+    int sampleCount = count*channels;
+    if(bitsPerSample == 8)
+    {
+        PcmKernels::u8ToS16(widened,(const unsigned char*) data,sampleCount);
+    }
+    else
+    {
+        memcpy(widened,data,sampleCount*sizeof(short));
+    }
+
+    if(channels == outChannels)
+    {
+        return;
+    }
+    else if(channels == 2)
+    {
+        PcmKernels::stereoToMono(dest,samples,count);
+    }
+    else
+    {
+        PcmKernels::monoToStereo(dest,samples,count);
+    }
+}
+
+// audio mixer implementation
+
+AudioMixer::AudioMixer(int sampleRate, int channels)
+{
+    setFormat(sampleRate,channels);
+}
+
+/**
+ * sets the format the sources are read in, and the mix is made in.
+ *
+ * @date     2026-10-18
+ *
+ * @param    sampleRate   samples per second of the mix.
+ * @param    channels   number of channels of the mix, up to
+ *   {MIXER_MAX_CHANNELS}.
+ */
+void AudioMixer::setFormat(int sampleRate, int channels)
+{
+    this->sampleRate = sampleRate;
+    this->channels   = channels < 1 ? 1
+        : channels > MIXER_MAX_CHANNELS ? MIXER_MAX_CHANNELS : channels;
+}
+
+int AudioMixer::getSampleRate()
+{
+    return sampleRate;
+}
+
+int AudioMixer::getChannels()
+{
+    return channels;
+}
+
+/**
+ * adds a source to the mix. the mixer doesn't take ownership of it.
+ *
+ * @date     2026-10-18
+ *
+ * @param    source   source to mix.
+ * @param    gain   what the samples of the source are multiplied by; 1 to
+ *   leave them as they are.
+ */
+void AudioMixer::addSource(MixSource* source, float gain)
+{
+    Source s;
+    s.source = source;
+    s.gain   = PcmKernels::toGain(gain);
+    sources.push_back(s);
+    samples.resize(sources.size()*MIXER_PERIOD_FRAMES*MIXER_MAX_CHANNELS);
+}
+
+void AudioMixer::setGain(MixSource* source, float gain)
+{
+    for(int i = 0; i < (int) sources.size(); ++i)
+    {
+        if(sources[i].source == source)
+        {
+            sources[i].gain = PcmKernels::toGain(gain);
+        }
+    }
+}
+
+void AudioMixer::removeSource(MixSource* source)
+{
+    for(int i = 0; i < (int) sources.size(); ++i)
+    {
+        if(sources[i].source == source)
+        {
+            sources.erase(sources.begin()+i);
+            return;
+        }
+    }
+}
+
+/**
+ * mixes a period of {MIXER_PERIOD_FRAMES} frames of every source. each source
+ *   is read into a period of its own, and they are all added up at once;
+ *   past {PCM_MAX_SOURCES} sources, they are added to a 32 bit total one at a
+ *   time instead.
+ *
+ * @date     2026-10-18
+ *
+ * @return   the mixed period; it stays valid until the next call.
+ */
+const short* AudioMixer::mix()
+{
+    int count = MIXER_PERIOD_FRAMES*channels;
+    int sourceCount = (int) sources.size();
+
+    if(sourceCount > PCM_MAX_SOURCES)
+    {
+        memset(total,0,count*sizeof(*total));
+        for(int i = 0; i < sourceCount; ++i)
+        {
+            short* period = &samples[0];
+            int frames = sources[i].source->read(period,MIXER_PERIOD_FRAMES,sampleRate,channels);
+            PcmKernels::accumulate(total,period,sources[i].gain,frames*channels);
+        }
+        PcmKernels::saturate(output,total,count);
+        return output;
+    }
+
+    const short* periods[PCM_MAX_SOURCES];
+    short gains[PCM_MAX_SOURCES];
+    for(int i = 0; i < sourceCount; ++i)
+    {
+        // whatever a source that has run dry didn't read is mixed as silence
+        short* period = &samples[i*MIXER_PERIOD_FRAMES*MIXER_MAX_CHANNELS];
+        int frames = sources[i].source->read(period,MIXER_PERIOD_FRAMES,sampleRate,channels);
+        memset(period+frames*channels,0,(count-frames*channels)*sizeof(short));
+
+        periods[i] = period;
+        gains[i]   = sources[i].gain;
+    }
+
+    PcmKernels::mix(output,periods,gains,sourceCount,count);
+    return output;
+}
+
+void AudioMixer::mix(MixSink* sink)
+{
+    sink->write(mix(),MIXER_PERIOD_FRAMES,channels);
+}
+
+// static function implementations
+
+void putLittleEndian(unsigned char* dest, unsigned long value, int bytes)
+{
+    for(int i = 0; i < bytes; ++i)
+    {
+        dest[i] = (unsigned char) (value >> (i*8));
+    }
+}
+
+/**
+ * decodes a sample to 16 bits; 8 bit samples are unsigned, and only the top
+ *   16 bits of longer ones are used.
+ */
+int decodeSample(const char* src, int bitsPerSample)
+{
+    if(bitsPerSample == 8)
+    {
+        return ((unsigned char) *src-128) << 8;
+    }
+    short sample;
+    memcpy(&sample,src+bitsPerSample/8-2,sizeof(sample));
+    return sample;
+}
@@ -0,0 +1,223 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: AudioMixer.h
+--
+-- NOTES:
+-- The {AudioMixer} adds up every sound the client plays; the
+-- music, and the voice of each peer, into one period of 16 bit
+-- samples at a time, so the client only needs one output
+-- device however many people are talking.
+--
+-- Once every period, each {MixSource} is asked for a period of
+-- samples in the format of the mix. Every source is then scaled
+-- by its gain and added up in one pass, in 32 bits, which are
+-- saturated back to 16 bits, and handed to a {MixSink}; see
+-- PcmKernels.h.
+--
+-- Nothing here depends on the platform; the sinks that write
+-- the mix to a WAV file or throw it away let the mixer be run,
+-- and benchmarked, without an audio device.
+--------------------------------------------------------------*/
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include "PcmKernels.h"
+#include <stdio.h>
+#include <vector>
+
+/**
+ * number of frames mixed at a time.
+ */
+#define MIXER_PERIOD_FRAMES 256
+
+/**
+ * most channels the mix may have.
+ */
+#define MIXER_MAX_CHANNELS 2
+
+/**
+ * gains are applied as fixed point numbers with this many fraction bits, and
+ *   are kept below {MIXER_MAX_GAIN}, so the 32 bit total of
+ *   {PCM_MAX_SOURCES} sources at full scale can't overflow.
+ */
+#define MIXER_GAIN_BITS PCM_GAIN_BITS
+#define MIXER_MAX_GAIN PCM_MAX_GAIN
+
+/**
+ * frames a {PcmSource} decodes ahead of what it has been asked for.
+ */
+#define PCM_SOURCE_FRAMES 1024
+
+/**
+ * something that can be mixed.
+ */
+class MixSource
+{
+public:
+    virtual ~MixSource() {}
+
+    /**
+     * reads up to {frames} frames of 16 bit samples at {sampleRate} with
+     *   {channels} interleaved channels into {dest}, without blocking.
+     *
+     * @return   the number of frames read; fewer than {frames} if the source
+     *   has run dry, which are mixed as though the rest were silent.
+     */
+    virtual int read(short* dest, int frames, int sampleRate, int channels) = 0;
+};
+
+/**
+ * somewhere the mix goes.
+ */
+class MixSink
+{
+public:
+    virtual ~MixSink() {}
+
+    /**
+     * takes {frames} frames of the mix, of the channels of the mix.
+     */
+    virtual void write(const short* samples, int frames, int channels) = 0;
+};
+
+/**
+ * a sink that throws the mix away.
+ */
+class NullSink : public MixSink
+{
+public:
+    virtual void write(const short* /*samples*/, int /*frames*/, int /*channels*/) {}
+};
+
+/**
+ * a sink that writes the mix to a 16 bit WAV file.
+ */
+class WavFileSink : public MixSink
+{
+public:
+    WavFileSink(const char* path, int sampleRate, int channels);
+    ~WavFileSink();
+    virtual void write(const short* samples, int frames, int channels);
+
+private:
+    void _writeHeader();
+
+    FILE* file;
+    int sampleRate;
+    int channels;
+    unsigned long dataSize;
+};
+
+/**
+ * a source of PCM data in some format, converted to the format of the mix.
+ *   the channels are mixed down or repeated up to those of the mix, and the
+ *   samples are interpolated to the rate of the mix if it is different, or
+ *   if the source is made to drift from its rate.
+ *
+ * subclasses hand over the data, as it arrives, with {fill}.
+ */
+class PcmSource : public MixSource
+{
+public:
+    PcmSource(int sampleRate, int bitsPerSample, int channels);
+    void setFormat(int sampleRate, int bitsPerSample, int channels);
+    void setDrift(double ppm);
+    void reset();
+    virtual int read(short* dest, int frames, int sampleRate, int channels);
+
+protected:
+    /**
+     * copies up to {len} bytes of PCM data into {dest} without blocking.
+     *
+     * @return   the number of bytes copied; 0 if there is none yet.
+     */
+    virtual int fill(char* dest, int len) = 0;
+
+private:
+    bool _decode(int channels);
+    void _normalize(short* dest, const char* data, int count, int outChannels);
+
+    /**
+     * format of the data handed over by {fill}.
+     */
+    int sampleRate;
+    int bitsPerSample;
+    int channels;
+
+    /**
+     * bytes of a frame that has only been partly handed over.
+     */
+    char partial[16];
+    int partialLen;
+
+    /**
+     * decoded frames, with the channels of the mix, and the number of them.
+     */
+    short frames[PCM_SOURCE_FRAMES*MIXER_MAX_CHANNELS];
+    int frameCount;
+    int frameChannels;
+
+    /**
+     * parts per million the data is read faster than its sample rate.
+     */
+    double drift;
+
+    /**
+     * position of the next frame to read in {frames}, with 32 fraction bits;
+     *   fine enough to follow a drift of a fraction of a part per million.
+     */
+    unsigned long long position;
+};
+
+/**
+ * mixes its sources into one period at a time. the mixer doesn't synchronize
+ *   anything itself; whoever drives it has to make sure the sources and the
+ *   format aren't changed while a period is being mixed.
+ */
+class AudioMixer
+{
+public:
+    AudioMixer(int sampleRate, int channels);
+
+    void setFormat(int sampleRate, int channels);
+    int getSampleRate();
+    int getChannels();
+
+    void addSource(MixSource* source, float gain);
+    void setGain(MixSource* source, float gain);
+    void removeSource(MixSource* source);
+
+    const short* mix();
+    void mix(MixSink* sink);
+
+private:
+    struct Source
+    {
+        MixSource* source;
+        short gain;
+    };
+
+    /**
+     * format of the mix.
+     */
+    int sampleRate;
+    int channels;
+
+    /**
+     * sources that are mixed, with their gains.
+     */
+    std::vector<Source> sources;
+
+    /**
+     * a period of samples read from each source, in the order of {sources}.
+     */
+    std::vector<short> samples;
+
+    /**
+     * 32 bit total of the period being mixed, used when there are more than
+     *   {PCM_MAX_SOURCES} sources, and the finished period.
+     */
+    int total[MIXER_PERIOD_FRAMES*MIXER_MAX_CHANNELS];
+    short output[MIXER_PERIOD_FRAMES*MIXER_MAX_CHANNELS];
+};
+
+#endif
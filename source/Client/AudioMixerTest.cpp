@@ -0,0 +1,142 @@
+#include "AudioMixer.h"
+#include <math.h>
+#include <string.h>
+#include <chrono>
+
+#ifdef TEST_AUDIO_MIXER
+
+/**
+ * benchmark of the AudioMixer. it uses nothing but the mixer, so it runs
+ *   without an audio device, on any platform. for more and more sources, many
+ *   periods of 44100 Hz stereo are mixed into a null sink; once with sources
+ *   already in the format of the mix, to time the gain and the sum alone, and
+ *   once with sources of 8 bit 22050 Hz mono, the format of voice, which have
+ *   to be converted as well. reports the time taken per period, and how much
+ *   faster than real time that is.
+ *
+ * also checks that a lone source at unity gain comes out as it went in, and
+ *   writes a few seconds of a mix to a WAV file.
+ */
+
+#define PERIODS 20000
+#define MAX_SOURCES 64
+#define MIX_RATE 44100
+#define MIX_CHANNELS 2
+
+/**
+ * a source that is already in the format of the mix.
+ */
+class ToneSource : public MixSource
+{
+public:
+    ToneSource(int pitch)
+    {
+        for(int i = 0; i < MIXER_PERIOD_FRAMES*MIX_CHANNELS; ++i)
+        {
+            period[i] = (short) (sin(i*pitch*0.01)*8000);
+        }
+    }
+    virtual int read(short* dest, int frames, int /*sampleRate*/, int channels)
+    {
+        memcpy(dest,period,frames*channels*sizeof(short));
+        return frames;
+    }
+    short period[MIXER_PERIOD_FRAMES*MIX_CHANNELS];
+};
+
+/**
+ * a source of 8 bit 22050 Hz mono, that never runs dry.
+ */
+class VoiceSource : public PcmSource
+{
+public:
+    VoiceSource(int pitch) : PcmSource(22050,8,1), phase(0)
+    {
+        for(int i = 0; i < (int) sizeof(voice); ++i)
+        {
+            voice[i] = (char) (128+sin(i*pitch*0.01)*40);
+        }
+    }
+protected:
+    virtual int fill(char* dest, int len)
+    {
+        for(int i = 0; i < len; ++i)
+        {
+            dest[i] = voice[phase++%sizeof(voice)];
+        }
+        return len;
+    }
+    char voice[22050];
+    unsigned long phase;
+};
+
+double benchmark(AudioMixer* mixer, MixSink* sink)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for(int p = 0; p < PERIODS; ++p)
+    {
+        mixer->mix(sink);
+    }
+    std::chrono::duration<double,std::micro> taken = std::chrono::high_resolution_clock::now()-start;
+    return taken.count()/PERIODS;
+}
+
+int main(void)
+{
+    static ToneSource* tones[MAX_SOURCES];
+    static VoiceSource* voices[MAX_SOURCES];
+    for(int i = 0; i < MAX_SOURCES; ++i)
+    {
+        tones[i]  = new ToneSource(i+1);
+        voices[i] = new VoiceSource(i+1);
+    }
+
+    // a lone source at unity gain passes through
+    AudioMixer lone(MIX_RATE,MIX_CHANNELS);
+    lone.addSource(tones[3],1);
+    const short* mixed = lone.mix();
+    int wrong = 0;
+    for(int i = 0; i < MIXER_PERIOD_FRAMES*MIX_CHANNELS; ++i)
+    {
+        wrong += mixed[i] != tones[3]->period[i];
+    }
+    printf("lone source: %d of %d samples wrong\n",wrong,MIXER_PERIOD_FRAMES*MIX_CHANNELS);
+
+    // a few seconds of music with two voices over it, to listen to
+    {
+        WavFileSink wav("AudioMixerTest.wav",MIX_RATE,MIX_CHANNELS);
+        AudioMixer mixer(MIX_RATE,MIX_CHANNELS);
+        mixer.addSource(tones[0],0.5f);
+        mixer.addSource(voices[4],1);
+        mixer.addSource(voices[9],1);
+        for(int p = 0; p < MIX_RATE*5/MIXER_PERIOD_FRAMES; ++p)
+        {
+            mixer.mix(&wav);
+        }
+    }
+
+    NullSink sink;
+    double periodUs = (double) MIXER_PERIOD_FRAMES*1000000/MIX_RATE;
+    printf("%d periods of %d frames, %.0f us each\n",PERIODS,MIXER_PERIOD_FRAMES,periodUs);
+
+    int counts[] = {1,2,4,8,16,32,64};
+    for(int c = 0; c < (int) (sizeof(counts)/sizeof(counts[0])); ++c)
+    {
+        int sources = counts[c];
+        AudioMixer direct(MIX_RATE,MIX_CHANNELS);
+        AudioMixer converted(MIX_RATE,MIX_CHANNELS);
+        for(int s = 0; s < sources; ++s)
+        {
+            direct.addSource(tones[s],0.75f);
+            converted.addSource(voices[s],0.75f);
+        }
+        double directUs    = benchmark(&direct,&sink);
+        double convertedUs = benchmark(&converted,&sink);
+        printf("%3d sources %8.3f us %8.0fx real time, converted %8.3f us %8.0fx real time\n",
+            sources,directUs,periodUs/directUs,convertedUs,periodUs/convertedUs);
+    }
+
+    return wrong != 0;
+}
+
+#endif
@@ -0,0 +1,389 @@
+/*-----------------------------------------------------------------------------
+-- SOURCE FILE: CarouselReceiver.cpp - This file provides functionality for
+-- collecting a song from the server's download carousel.
+--
+-- PUBLIC FUNCTIONS:
+-- bool isOpen();
+-- unsigned long receive(volatile bool *cancelled);
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- NOTES:
+-- The carousel sends the blocks of a song round and round on a multicast
+-- group, with a parity block after every CAROUSEL_FEC_GROUP blocks. A block
+-- lost on the way is rebuilt from the parity block of its group when it is
+-- the only one of the group that is missing; otherwise it is picked up the
+-- next time the carousel comes round. Once only a few blocks are left, the
+-- receiver gives up on the carousel, and the rest is fetched over TCP.
+-----------------------------------------------------------------------------*/
+
+#include "CarouselReceiver.h"
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: CarouselReceiver
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Remember which blocks were already on disk.
+--
+-- INTERFACE: CarouselReceiver(CarouselOfferPacket *offer, DownloadSink *sink)
+--		CarouselOfferPacket *offer : the offer the server sent.
+--		DownloadSink *sink         : the sink of the song being downloaded.
+--
+-- NOTES: Joins the multicast group of the carousel. Blocks the sink already has, from an earlier
+-- attempt, are not waited for.
+-------------------------------------------------------------------------------------------------*/
+CarouselReceiver::CarouselReceiver(CarouselOfferPacket *offer, DownloadSink *sink)
+	: offer(*offer)
+	, sink(sink)
+{
+	struct sockaddr_in local;
+	char reuseAddr = 1;
+	int receiveBuffer = 1024 * 1024;
+	DWORD timeout = CAROUSEL_TIMEOUT_MS;
+
+	blockCount = (offer->size + CAROUSEL_BLOCK_SIZE - 1) / CAROUSEL_BLOCK_SIZE;
+	groupCount = (blockCount + CAROUSEL_FEC_GROUP - 1) / CAROUSEL_FEC_GROUP;
+
+	// Find out which blocks are still missing
+	have.resize(blockCount);
+	missing = 0;
+	for (unsigned long block = 0; block < blockCount; ++block)
+	{
+		unsigned long offset = block * CAROUSEL_BLOCK_SIZE;
+		have[block] = sink->contains(offset, offset + blockLength(block));
+		if (!have[block])
+			++missing;
+	}
+	onDisk = have;
+
+	// Join the group
+	sd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sd == INVALID_SOCKET)
+		return;
+
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_port = htons(offer->port);
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &reuseAddr, sizeof(reuseAddr));
+	setsockopt(sd, SOL_SOCKET, SO_RCVBUF, (char*) &receiveBuffer, sizeof(receiveBuffer));
+	setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, (char*) &timeout, sizeof(timeout));
+
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.imr_multiaddr.s_addr = inet_addr(offer->group);
+	mreq.imr_interface.s_addr = INADDR_ANY;
+
+	if (bind(sd, (struct sockaddr*) &local, sizeof(local)) == SOCKET_ERROR
+		|| setsockopt(sd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char*) &mreq, sizeof(mreq)) == SOCKET_ERROR)
+	{
+		#ifdef DEBUG
+		MessageBox(NULL, L"Can't join the download carousel", L"ERROR", MB_ICONERROR);
+		#endif
+		closesocket(sd);
+		sd = INVALID_SOCKET;
+	}
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: ~CarouselReceiver
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: ~CarouselReceiver()
+--
+-- NOTES: Leaves the multicast group.
+-------------------------------------------------------------------------------------------------*/
+CarouselReceiver::~CarouselReceiver()
+{
+	if (sd != INVALID_SOCKET)
+	{
+		setsockopt(sd, IPPROTO_IP, IP_DROP_MEMBERSHIP, (char*) &mreq, sizeof(mreq));
+		closesocket(sd);
+	}
+
+	for (std::map<unsigned long, Group*>::iterator it = groups.begin(); it != groups.end(); ++it)
+	{
+		delete it->second;
+	}
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: isOpen
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: isOpen()
+--
+-- NOTES: Returns false if the multicast group could not be joined.
+-------------------------------------------------------------------------------------------------*/
+bool CarouselReceiver::isOpen()
+{
+	return sd != INVALID_SOCKET;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: receive
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: receive(volatile bool *cancelled)
+--		volatile bool *cancelled : stops receiving when this becomes true.
+--
+-- NOTES: Collects blocks from the carousel until the song is complete; until a full turn of the
+-- carousel has gone by and at most CAROUSEL_REPAIR_BLOCKS blocks are missing; until
+-- CAROUSEL_MAX_TURNS turns have gone by; or until the carousel stops. Returns the number of
+-- blocks that are still missing.
+-------------------------------------------------------------------------------------------------*/
+unsigned long CarouselReceiver::receive(volatile bool *cancelled)
+{
+	char datagram[1 + sizeof(CarouselPacket)];
+	CarouselPacket packet;
+	unsigned long packetsPerTurn = blockCount + groupCount;
+	unsigned long heard = 0;
+
+	while (sd != INVALID_SOCKET && missing > 0 && !*cancelled)
+	{
+		// Times out once the carousel has stopped
+		int len = recv(sd, datagram, sizeof(datagram), 0);
+		if (len == SOCKET_ERROR)
+			break;
+
+		if (len != sizeof(datagram) || datagram[0] != CAROUSEL_BLOCK)
+			continue;
+
+		// Other songs may be on the same group
+		memcpy(&packet, datagram + 1, sizeof(packet));
+		if (packet.songId != offer.songId || packet.size != offer.size)
+			continue;
+
+		if (packet.parity)
+		{
+			if (packet.block < groupCount)
+				storeParity(packet.block, packet.data);
+		}
+		else if (packet.block < blockCount && !have[packet.block])
+		{
+			storeBlock(packet.block, packet.data);
+		}
+
+		// Leave the last few blocks to TCP rather than waiting for another turn
+		++heard;
+		if (heard >= packetsPerTurn && (missing <= CAROUSEL_REPAIR_BLOCKS || heard >= CAROUSEL_MAX_TURNS * packetsPerTurn))
+			break;
+	}
+
+	return missing;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: storeBlock
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: storeBlock(unsigned long block, const char *data)
+--		unsigned long block : number of a block that is missing.
+--		const char *data    : the block, padded to CAROUSEL_BLOCK_SIZE.
+--
+-- NOTES: Writes a block to the sink, and adds it to the sum of its group.
+-------------------------------------------------------------------------------------------------*/
+void CarouselReceiver::storeBlock(unsigned long block, const char *data)
+{
+	unsigned long group = block / CAROUSEL_FEC_GROUP;
+
+	sink->write(block * CAROUSEL_BLOCK_SIZE, data, blockLength(block));
+	have[block] = true;
+	--missing;
+
+	if (isComplete(group))
+	{
+		delete groups[group];
+		groups.erase(group);
+		return;
+	}
+
+	Group *state = getGroup(group);
+	for (int i = 0; i < CAROUSEL_BLOCK_SIZE; ++i)
+	{
+		state->sum[i] ^= data[i];
+	}
+	++state->received;
+
+	rebuild(group, state);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: storeParity
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: storeParity(unsigned long group, const char *data)
+--		unsigned long group : number of the group the parity block belongs to.
+--		const char *data    : the parity block.
+--
+-- NOTES: Adds the parity block to the sum of its group, and rebuilds the one block the group is
+-- missing, if that is all it is missing.
+-------------------------------------------------------------------------------------------------*/
+void CarouselReceiver::storeParity(unsigned long group, const char *data)
+{
+	if (isComplete(group))
+		return;
+
+	Group *state = getGroup(group);
+	if (state->hasParity)
+		return;
+
+	for (int i = 0; i < CAROUSEL_BLOCK_SIZE; ++i)
+	{
+		state->sum[i] ^= data[i];
+	}
+	state->hasParity = true;
+
+	rebuild(group, state);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: rebuild
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: rebuild(unsigned long group, Group *state)
+--		unsigned long group : number of a group that is missing blocks.
+--		Group *state        : the state of the group.
+--
+-- NOTES: Once the parity block and all but one of the blocks of a group have been added to its
+-- sum, the sum is the missing block. The state is deleted once the block has been stored.
+-------------------------------------------------------------------------------------------------*/
+void CarouselReceiver::rebuild(unsigned long group, Group *state)
+{
+	if (!state->hasParity || state->received != groupLength(group) - 1)
+		return;
+
+	char rebuilt[CAROUSEL_BLOCK_SIZE];
+	memcpy(rebuilt, state->sum, CAROUSEL_BLOCK_SIZE);
+
+	unsigned long first = group * CAROUSEL_FEC_GROUP;
+	for (unsigned long lost = first; lost < first + groupLength(group); ++lost)
+	{
+		if (!have[lost])
+		{
+			storeBlock(lost, rebuilt);
+			break;
+		}
+	}
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: getGroup
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Add the blocks that were already on disk to the sum.
+--
+-- INTERFACE: getGroup(unsigned long group)
+--		unsigned long group : number of a group that is missing blocks.
+--
+-- NOTES: Returns the state of the group, creating it the first time the group is heard from. The
+-- blocks of the group that an earlier attempt left on disk are read back and added to the sum of
+-- a new group, so a group that was partly downloaded before can still be rebuilt from its parity.
+-------------------------------------------------------------------------------------------------*/
+CarouselReceiver::Group *CarouselReceiver::getGroup(unsigned long group)
+{
+	Group *&state = groups[group];
+	if (!state)
+	{
+		state = new Group;
+		state->received = 0;
+		state->hasParity = false;
+		memset(state->sum, 0, CAROUSEL_BLOCK_SIZE);
+
+		char data[CAROUSEL_BLOCK_SIZE];
+		unsigned long first = group * CAROUSEL_FEC_GROUP;
+		for (unsigned long block = first; block < first + groupLength(group); ++block)
+		{
+			// The last block is padded with zeros, the way the carousel sends it
+			memset(data, 0, CAROUSEL_BLOCK_SIZE);
+			if (!onDisk[block] || !sink->read(block * CAROUSEL_BLOCK_SIZE, data, blockLength(block)))
+				continue;
+
+			for (int i = 0; i < CAROUSEL_BLOCK_SIZE; ++i)
+			{
+				state->sum[i] ^= data[i];
+			}
+			++state->received;
+		}
+	}
+	return state;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: isComplete
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: isComplete(unsigned long group)
+--		unsigned long group : number of a group.
+--
+-- NOTES: Returns true if no block of the group is missing.
+-------------------------------------------------------------------------------------------------*/
+bool CarouselReceiver::isComplete(unsigned long group)
+{
+	unsigned long first = group * CAROUSEL_FEC_GROUP;
+	for (unsigned long block = first; block < first + groupLength(group); ++block)
+	{
+		if (!have[block])
+			return false;
+	}
+	return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: groupLength
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: groupLength(unsigned long group)
+--		unsigned long group : number of a group.
+--
+-- NOTES: Returns the number of blocks in the group; only the last group may be short.
+-------------------------------------------------------------------------------------------------*/
+unsigned long CarouselReceiver::groupLength(unsigned long group)
+{
+	return min(blockCount - group * CAROUSEL_FEC_GROUP, (unsigned long) CAROUSEL_FEC_GROUP);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: blockLength
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: blockLength(unsigned long block)
+--		unsigned long block : number of a block.
+--
+-- NOTES: Returns the number of bytes of the song in the block; only the last block may be short.
+-------------------------------------------------------------------------------------------------*/
+unsigned long CarouselReceiver::blockLength(unsigned long block)
+{
+	return min(offer.size - block * CAROUSEL_BLOCK_SIZE, (unsigned long) CAROUSEL_BLOCK_SIZE);
+}
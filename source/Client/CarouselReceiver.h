@@ -0,0 +1,103 @@
+/*-----------------------------------------------------------------------------
+-- SOURCE FILE: CarouselReceiver.h - This file provides functionality for
+-- collecting a song from the server's download carousel.
+--
+-- PUBLIC FUNCTIONS:
+-- bool isOpen();
+-- unsigned long receive(volatile bool *cancelled);
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- NOTES:
+-- The carousel sends the blocks of a song round and round on a multicast
+-- group, with a parity block after every CAROUSEL_FEC_GROUP blocks. A block
+-- lost on the way is rebuilt from the parity block of its group when it is
+-- the only one of the group that is missing; otherwise it is picked up the
+-- next time the carousel comes round. Once only a few blocks are left, the
+-- receiver gives up on the carousel, and the rest is fetched over TCP.
+-----------------------------------------------------------------------------*/
+
+#ifndef _CAROUSEL_RECEIVER_H_
+#define _CAROUSEL_RECEIVER_H_
+
+#include "../common.h"
+#include "../protocol.h"
+#include "DownloadSink.h"
+#include <map>
+#include <vector>
+
+/*
+	Number of missing blocks left after a full turn of the carousel at which
+	the rest is fetched over TCP instead of waiting for another turn.
+*/
+#define CAROUSEL_REPAIR_BLOCKS 64
+
+/*
+	Most turns of the carousel to listen to before fetching whatever is
+	still missing over TCP.
+*/
+#define CAROUSEL_MAX_TURNS 3
+
+/*
+	Milliseconds without a block after which the carousel is taken to have
+	stopped.
+*/
+#define CAROUSEL_TIMEOUT_MS 2000
+
+/*-----------------------------------------------------------------------------
+-- CLASS: CarouselReceiver
+--
+-- DESCRIPTION: Joins the carousel a CAROUSEL_OFFER points at, and writes the
+-- blocks of the song into a DownloadSink as they arrive.
+-----------------------------------------------------------------------------*/
+class CarouselReceiver
+{
+	public:
+		/* CONSTRUCTORS/DESTRUCTORS */
+		CarouselReceiver(CarouselOfferPacket *offer, DownloadSink *sink);
+		~CarouselReceiver();
+
+		/* PUBLIC MEMBER METHODS */
+		bool isOpen();
+		unsigned long receive(volatile bool *cancelled);
+
+	private:
+		/*
+			A group that is still missing blocks. {received} counts the
+			blocks of the group XORed into {sum}, both the ones that were
+			already on disk and the ones received since joining; {sum} also
+			holds the parity block once it has arrived.
+		*/
+		struct Group
+		{
+			int received;
+			bool hasParity;
+			char sum[CAROUSEL_BLOCK_SIZE];
+		};
+
+		/* PRIVATE MEMBER METHODS */
+		void storeBlock(unsigned long block, const char *data);
+		void storeParity(unsigned long group, const char *data);
+		void rebuild(unsigned long group, Group *state);
+		Group *getGroup(unsigned long group);
+		bool isComplete(unsigned long group);
+		unsigned long groupLength(unsigned long group);
+		unsigned long blockLength(unsigned long block);
+
+		/* PRIVATE MEMBER DATA */
+		SOCKET sd;
+		ip_mreq mreq;
+		CarouselOfferPacket offer;
+		DownloadSink *sink;
+
+		unsigned long blockCount;
+		unsigned long groupCount;
+		unsigned long missing;
+		std::vector<bool> have;
+		std::vector<bool> onDisk;
+		std::map<unsigned long, Group*> groups;
+};
+
+#endif
@@ -0,0 +1,629 @@
+/*-----------------------------------------------------------------------------
+-- SOURCE FILE: ChunkedDownloader.cpp - This file provides functionality for
+-- downloading a song over several data connections at once.
+--
+-- PUBLIC FUNCTIONS:
+-- void setServer(char *host, unsigned short port);
+-- void setConcurrency(int connections);
+-- void setChunkSize(unsigned long size);
+-- bool download(SongName *song);
+-- void cancel(int songId);
+-- bool waitFor(int songId, DWORD timeout);
+-- bool isDownloading();
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- NOTES:
+-- The song is cut into fixed-size chunks that are requested from the
+-- server's data port over several connections, so a download is not limited
+-- to the window of a single TCP stream. Each chunk is written in place with
+-- positional writes by a DownloadSink, which records completed ranges in the
+-- same sidecar file the FileTransferer uses, so chunked downloads can be
+-- resumed too. A song other clients are downloading at the same time is
+-- collected from the server's carousel first, with a CarouselReceiver.
+-----------------------------------------------------------------------------*/
+
+#include "ChunkedDownloader.h"
+#include "CarouselReceiver.h"
+
+#include <limits.h>
+
+#include "../protocol.h"
+
+/*
+	Size of the message header that precedes every message on a TCP connection;
+	the message type followed by the payload length.
+*/
+#define MESSAGE_HEADER_SIZE (sizeof(char)+sizeof(int))
+
+/*
+	State of a single download, shared by all the threads fetching its chunks.
+*/
+struct ChunkedDownload
+{
+	ChunkedDownloader *pThis;
+	SongName song;
+	sockaddr_in server;
+	int concurrency;
+	unsigned long chunkSize;
+
+	DownloadSink *sink;
+	unsigned long size;
+	HANDLE access;
+
+	volatile LONG nextChunk;
+	LONG chunkCount;
+	volatile bool cancelled;
+	volatile bool failed;
+	HANDLE thread;
+};
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: ChunkedDownloader
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: ChunkedDownloader(OnDownloadComplete downloadComplete)
+--		OnDownloadComplete downloadComplete : the callback to call when a download stops.
+--
+-- NOTES: Create a new ChunkedDownloader using the default concurrency and chunk size.
+-------------------------------------------------------------------------------------------------*/
+ChunkedDownloader::ChunkedDownloader(OnDownloadComplete downloadComplete)
+	: access(CreateMutex(NULL, FALSE, NULL))
+	, concurrency(DEFAULT_DOWNLOAD_CONNECTIONS)
+	, chunkSize(DEFAULT_DOWNLOAD_CHUNK_SIZE)
+	, onDownloadComplete(downloadComplete)
+{
+	memset(&server, 0, sizeof(server));
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: ~ChunkedDownloader
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: ~ChunkedDownloader()
+--
+-- NOTES: Cancel every download, and wait for their threads to finish.
+-------------------------------------------------------------------------------------------------*/
+ChunkedDownloader::~ChunkedDownloader()
+{
+	for (std::map<int, ChunkedDownload*>::iterator it = downloads.begin(); it != downloads.end(); ++it)
+	{
+		it->second->cancelled = true;
+		WaitForSingleObject(it->second->thread, INFINITE);
+		CloseHandle(it->second->thread);
+		CloseHandle(it->second->access);
+		delete it->second;
+	}
+	CloseHandle(access);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: setServer
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: setServer(char *host, unsigned short port)
+--		char *host          : IP address of the server
+--		unsigned short port : data port of the server
+--
+-- NOTES: Set the server that songs are downloaded from.
+-------------------------------------------------------------------------------------------------*/
+void ChunkedDownloader::setServer(char *host, unsigned short port)
+{
+	WaitForSingleObject(access, INFINITE);
+	server.sin_family = AF_INET;
+	server.sin_addr.s_addr = inet_addr(host);
+	server.sin_port = htons(port);
+	ReleaseMutex(access);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: setConcurrency
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: setConcurrency(int connections)
+--		int connections : number of data connections each download is fetched over.
+--
+-- NOTES: Applies to downloads started after the call. Clamped to [1, MAX_DOWNLOAD_CONNECTIONS].
+-------------------------------------------------------------------------------------------------*/
+void ChunkedDownloader::setConcurrency(int connections)
+{
+	concurrency = max(1, min(connections, MAX_DOWNLOAD_CONNECTIONS));
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: setChunkSize
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: setChunkSize(unsigned long size)
+--		unsigned long size : number of bytes requested at a time over a data connection.
+--
+-- NOTES: Applies to downloads started after the call. Chunks smaller than FILE_CHUNK_SIZE are
+-- rounded up to it.
+-------------------------------------------------------------------------------------------------*/
+void ChunkedDownloader::setChunkSize(unsigned long size)
+{
+	chunkSize = max(size, (unsigned long) FILE_CHUNK_SIZE);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: download
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: download(SongName *song)
+--		SongName *song : the song to download; saved under its cFilename.
+--
+-- NOTES: Start downloading a song in the background. Returns false if the song is already
+-- being downloaded.
+-------------------------------------------------------------------------------------------------*/
+bool ChunkedDownloader::download(SongName *song)
+{
+	WaitForSingleObject(access, INFINITE);
+
+	// Forget about the previous download of the song once it has finished
+	ChunkedDownload *previous = downloads[song->id];
+	if (previous)
+	{
+		if (WaitForSingleObject(previous->thread, 0) == WAIT_TIMEOUT)
+		{
+			ReleaseMutex(access);
+			return false;
+		}
+		CloseHandle(previous->thread);
+		CloseHandle(previous->access);
+		delete previous;
+	}
+
+	ChunkedDownload *download = new ChunkedDownload;
+	download->pThis = this;
+	download->song = *song;
+	download->server = server;
+	download->concurrency = concurrency;
+	download->chunkSize = chunkSize;
+	download->sink = NULL;
+	download->size = 0;
+	download->access = CreateMutex(NULL, FALSE, NULL);
+	download->nextChunk = 0;
+	download->chunkCount = 0;
+	download->cancelled = false;
+	download->failed = false;
+	download->thread = CreateThread(NULL, 0, DownloadThread, download, 0, NULL);
+	downloads[song->id] = download;
+
+	ReleaseMutex(access);
+	return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: cancel
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: cancel(int songId)
+--		int songId : the id of the song to stop downloading.
+--
+-- NOTES: Stop downloading a song. The chunks received so far are kept, so the download can be
+-- resumed later.
+-------------------------------------------------------------------------------------------------*/
+void ChunkedDownloader::cancel(int songId)
+{
+	WaitForSingleObject(access, INFINITE);
+	if (downloads[songId])
+	{
+		downloads[songId]->cancelled = true;
+	}
+	ReleaseMutex(access);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: waitFor
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: waitFor(int songId, DWORD timeout)
+--		int songId    : the id of the song being downloaded.
+--		DWORD timeout : milliseconds to wait for, or INFINITE.
+--
+-- NOTES: Wait for the download of a song to stop. Returns true if the whole song was received.
+-------------------------------------------------------------------------------------------------*/
+bool ChunkedDownloader::waitFor(int songId, DWORD timeout)
+{
+	WaitForSingleObject(access, INFINITE);
+	ChunkedDownload *download = downloads[songId];
+	ReleaseMutex(access);
+
+	if (!download || WaitForSingleObject(download->thread, timeout) != WAIT_OBJECT_0)
+		return false;
+
+	return !download->failed && !download->cancelled;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: isDownloading
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: isDownloading()
+--
+-- NOTES: Returns true if any download is still running.
+-------------------------------------------------------------------------------------------------*/
+bool ChunkedDownloader::isDownloading()
+{
+	bool downloading = false;
+
+	WaitForSingleObject(access, INFINITE);
+	for (std::map<int, ChunkedDownload*>::iterator it = downloads.begin(); it != downloads.end() && !downloading; ++it)
+	{
+		downloading = it->second && WaitForSingleObject(it->second->thread, 0) == WAIT_TIMEOUT;
+	}
+	ReleaseMutex(access);
+
+	return downloading;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: DownloadThread
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Write the song through a DownloadSink.
+--		October 18, 2026 - Collect the song from the carousel when the server offers it.
+--
+-- INTERFACE: DownloadThread(LPVOID chunkedDownload)
+--		LPVOID chunkedDownload : the download to run.
+--
+-- NOTES: Opens the first data connection and asks it for an empty range at the end of the
+-- song, which is answered with just the size of the song. Once the number of chunks is known,
+-- the other connections are opened in worker threads and every connection fetches chunks until
+-- there are none left. The DownloadSink of the song is only created once the size of the song is
+-- known, so it can preallocate the file.
+--
+-- If other clients are downloading the same song, the server offers the carousel it is sending
+-- the song on along with the size. The song is then collected from the carousel first, and the
+-- data connections only fetch the few blocks that were still missing.
+-------------------------------------------------------------------------------------------------*/
+DWORD WINAPI ChunkedDownloader::DownloadThread(LPVOID chunkedDownload)
+{
+	ChunkedDownload *download = (ChunkedDownload*) chunkedDownload;
+	HANDLE workers[MAX_DOWNLOAD_CONNECTIONS];
+	int numWorkers = 0;
+	FileTransferHeader header;
+	CarouselOfferPacket offer;
+	SOCKET sd;
+	bool success = false;
+
+	// Find out how big the song is, and whether it is on the carousel
+	offer.songId = -1;
+	sd = connectToServer(&download->server);
+	if (sd != INVALID_SOCKET && fetchRange(download, sd, ULONG_MAX, 1, &header, &offer) && header.size > 0)
+	{
+		download->size = header.size;
+		download->chunkCount = (LONG) ((header.size + download->chunkSize - 1) / download->chunkSize);
+
+		// Keeps whatever a previous download left on disk
+		download->sink = new DownloadSink(download->song.cFilename, download->size);
+		if (download->sink->isOpen())
+		{
+			// Collect what the carousel has first, so the data connections only fetch what it missed
+			if (offer.songId == download->song.id && offer.size == header.size)
+			{
+				CarouselReceiver carousel(&offer, download->sink);
+				carousel.receive(&download->cancelled);
+				download->sink->sync();
+			}
+
+			// Fetch the chunks over all the connections
+			unsigned long gapStart, gapEnd;
+			if (download->sink->gapIn(0, download->size, &gapStart, &gapEnd))
+			{
+				for (int i = 1; i < download->concurrency && i < download->chunkCount; ++i)
+				{
+					workers[numWorkers++] = CreateThread(NULL, 0, WorkerThread, download, 0, NULL);
+				}
+			}
+			fetchChunks(download, sd);
+
+			WaitForMultipleObjects(numWorkers, workers, TRUE, INFINITE);
+			for (int i = 0; i < numWorkers; ++i)
+			{
+				CloseHandle(workers[i]);
+			}
+		}
+
+		// The sink drops the sidecar only once every byte is on disk
+		success = download->sink->finish() && !download->failed;
+		delete download->sink;
+		download->sink = NULL;
+	}
+
+	if (sd != INVALID_SOCKET)
+	{
+		closesocket(sd);
+	}
+
+	download->failed = !success;
+	if (download->pThis->onDownloadComplete)
+	{
+		download->pThis->onDownloadComplete(download->song.cFilename, success);
+	}
+	return success ? 0 : 1;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: WorkerThread
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: WorkerThread(LPVOID chunkedDownload)
+--		LPVOID chunkedDownload : the download to fetch chunks for.
+--
+-- NOTES: Opens a data connection of its own, and fetches chunks over it until there are none
+-- left.
+-------------------------------------------------------------------------------------------------*/
+DWORD WINAPI ChunkedDownloader::WorkerThread(LPVOID chunkedDownload)
+{
+	ChunkedDownload *download = (ChunkedDownload*) chunkedDownload;
+	SOCKET sd = connectToServer(&download->server);
+
+	if (sd == INVALID_SOCKET)
+	{
+		// The other connections pick up the chunks this one would have fetched
+		return 1;
+	}
+
+	fetchChunks(download, sd);
+	closesocket(sd);
+	return 0;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: fetchChunks
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: fetchChunks(ChunkedDownload *download, SOCKET sd)
+--		ChunkedDownload *download : the download to fetch chunks for.
+--		SOCKET sd                 : a data connection to the server.
+--
+-- NOTES: Takes the next chunk nobody has taken yet, and fetches it, until every chunk has been
+-- taken, the download is cancelled, or the connection fails. Only the parts of a chunk that are
+-- not on disk yet, from an earlier attempt or from the carousel, are fetched.
+-------------------------------------------------------------------------------------------------*/
+void ChunkedDownloader::fetchChunks(ChunkedDownload *download, SOCKET sd)
+{
+	FileTransferHeader header;
+	LONG chunk;
+
+	while (!download->cancelled && (chunk = InterlockedIncrement(&download->nextChunk) - 1) < download->chunkCount)
+	{
+		unsigned long offset = chunk * download->chunkSize;
+		unsigned long end = min(offset + download->chunkSize, download->size);
+		unsigned long gapStart, gapEnd;
+
+		// Only fetch the parts of the chunk that are not on disk yet
+		while (!download->cancelled && download->sink->gapIn(offset, end, &gapStart, &gapEnd))
+		{
+			if (!fetchRange(download, sd, gapStart, gapEnd - gapStart, &header))
+			{
+				download->failed = true;
+				return;
+			}
+			offset = gapEnd;
+		}
+	}
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: fetchRange
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Receive the data straight into the buffers of the DownloadSink.
+--		October 18, 2026 - Accept a CAROUSEL_OFFER ahead of the reply.
+--
+-- INTERFACE: fetchRange(ChunkedDownload *download, SOCKET sd, unsigned long offset,
+--		unsigned long length, FileTransferHeader *header, CarouselOfferPacket *offer)
+--		ChunkedDownload *download  : the download the range belongs to.
+--		SOCKET sd                  : a data connection to the server.
+--		unsigned long offset       : offset of the first byte to fetch.
+--		unsigned long length       : number of bytes to fetch.
+--		FileTransferHeader *header : set to the header of the server's reply.
+--		CarouselOfferPacket *offer : set to the offer sent ahead of the reply, if there is one;
+--		                             may be NULL.
+--
+-- NOTES: Sends a REQUEST_DOWNLOAD for the range and receives the reply. The data of the
+-- DOWNLOAD_CHUNKs is received straight into buffers taken from the download's sink, which are
+-- handed back to be written whenever they fill up. Returns false if the connection failed, or
+-- the download was cancelled part way through; whatever was received is still written.
+-------------------------------------------------------------------------------------------------*/
+bool ChunkedDownloader::fetchRange(ChunkedDownload *download, SOCKET sd, unsigned long offset,
+	unsigned long length, FileTransferHeader *header, CarouselOfferPacket *offer)
+{
+	char message[MESSAGE_HEADER_SIZE + sizeof(DownloadRequestPacket)];
+	DownloadRequestPacket *request = (DownloadRequestPacket*) (message + MESSAGE_HEADER_SIZE);
+	char messageHeader[MESSAGE_HEADER_SIZE];
+	int messageLen = sizeof(DownloadRequestPacket);
+	FileChunkHeader chunk;
+
+	// Ask for the range
+	message[0] = REQUEST_DOWNLOAD;
+	memcpy(&message[1], &messageLen, sizeof(messageLen));
+	request->index = download->song.id;
+	request->offset = offset;
+	request->length = length;
+	request->flags = DOWNLOAD_FLAG_BULK;
+	if (send(sd, message, sizeof(message), 0) != sizeof(message))
+		return false;
+
+	if (!recvAll(sd, messageHeader, sizeof(messageHeader)))
+		return false;
+
+	// The server may offer the carousel of the song first
+	if (messageHeader[0] == CAROUSEL_OFFER)
+	{
+		CarouselOfferPacket received;
+
+		if (*(int*)&messageHeader[1] != sizeof(CarouselOfferPacket)
+			|| !recvAll(sd, (char*) &received, sizeof(received))
+			|| !recvAll(sd, messageHeader, sizeof(messageHeader)))
+		{
+			return false;
+		}
+		if (offer)
+		{
+			*offer = received;
+		}
+	}
+
+	// The reply starts with the header...
+	if (messageHeader[0] != DOWNLOAD_HEADER
+		|| *(int*)&messageHeader[1] != sizeof(FileTransferHeader)
+		|| !recvAll(sd, (char*) header, sizeof(FileTransferHeader)))
+	{
+		return false;
+	}
+
+	// ...followed by the chunks, and an empty chunk
+	char *buffer = NULL;
+	unsigned long bufferOffset = 0;
+	unsigned long bufferLen = 0;
+	bool ok = true;
+
+	while (ok)
+	{
+		if (!recvAll(sd, messageHeader, sizeof(messageHeader))
+			|| messageHeader[0] != DOWNLOAD_CHUNK
+			|| !recvAll(sd, (char*) &chunk, sizeof(chunk)))
+		{
+			ok = false;
+			break;
+		}
+
+		if (chunk.dataLen == 0)
+			break;
+
+		if (!download->sink || chunk.dataLen > FILE_CHUNK_SIZE)
+		{
+			ok = false;
+			break;
+		}
+
+		// Start a new buffer if this chunk doesn't fit, or doesn't follow on from the buffer
+		if (buffer && (bufferLen + chunk.dataLen > DOWNLOAD_SINK_BUFFER_SIZE || chunk.offset != bufferOffset + bufferLen))
+		{
+			download->sink->submit(buffer, bufferOffset, bufferLen);
+			buffer = NULL;
+		}
+		if (!buffer)
+		{
+			buffer = download->sink->getBuffer();
+			bufferOffset = chunk.offset;
+			bufferLen = 0;
+		}
+
+		if (!recvAll(sd, buffer + bufferLen, chunk.dataLen))
+		{
+			ok = false;
+			break;
+		}
+		bufferLen += chunk.dataLen;
+
+		if (download->cancelled)
+			ok = false;
+	}
+
+	if (buffer)
+	{
+		download->sink->submit(buffer, bufferOffset, bufferLen);
+	}
+	return ok;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: connectToServer
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: connectToServer(sockaddr_in *server)
+--		sockaddr_in *server : address of the server's data port.
+--
+-- NOTES: Open a blocking data connection to the server. Returns INVALID_SOCKET on failure.
+-------------------------------------------------------------------------------------------------*/
+SOCKET ChunkedDownloader::connectToServer(sockaddr_in *server)
+{
+	SOCKET sd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (sd == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	if (connect(sd, (sockaddr*) server, sizeof(*server)) == SOCKET_ERROR)
+	{
+		#ifdef DEBUG
+		MessageBox(NULL, L"Can't connect to the data port", L"ERROR", MB_ICONERROR);
+		#endif
+		closesocket(sd);
+		return INVALID_SOCKET;
+	}
+
+	return sd;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: recvAll
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: recvAll(SOCKET sd, char *buffer, int length)
+--		SOCKET sd    : the socket to receive from.
+--		char *buffer : buffer to receive into.
+--		int length   : number of bytes to receive.
+--
+-- NOTES: Keep receiving until the whole length has arrived. Returns false if the connection
+-- failed or was closed.
+-------------------------------------------------------------------------------------------------*/
+bool ChunkedDownloader::recvAll(SOCKET sd, char *buffer, int length)
+{
+	while (length > 0)
+	{
+		int received = recv(sd, buffer, length, 0);
+		if (received <= 0)
+			return false;
+
+		buffer += received;
+		length -= received;
+	}
+	return true;
+}
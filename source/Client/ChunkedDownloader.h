@@ -0,0 +1,95 @@
+/*-----------------------------------------------------------------------------
+-- SOURCE FILE: ChunkedDownloader.h - This file provides functionality for
+-- downloading a song over several data connections at once.
+--
+-- PUBLIC FUNCTIONS:
+-- void setServer(char *host, unsigned short port);
+-- void setConcurrency(int connections);
+-- void setChunkSize(unsigned long size);
+-- bool download(SongName *song);
+-- void cancel(int songId);
+-- bool waitFor(int songId, DWORD timeout);
+-- bool isDownloading();
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- NOTES:
+-- The song is cut into fixed-size chunks that are requested from the
+-- server's data port over several connections, so a download is not limited
+-- to the window of a single TCP stream. Each chunk is written in place with
+-- positional writes by a DownloadSink, which records completed ranges in the
+-- same sidecar file the FileTransferer uses, so chunked downloads can be
+-- resumed too. A song other clients are downloading at the same time is
+-- collected from the server's carousel first, with a CarouselReceiver.
+-----------------------------------------------------------------------------*/
+
+#ifndef _CHUNKED_DOWNLOADER_H_
+#define _CHUNKED_DOWNLOADER_H_
+
+#include "../common.h"
+#include "../protocol.h"
+#include "FileTransferer.h"
+#include <map>
+
+/*
+	Number of data connections a download is fetched over by default.
+*/
+#define DEFAULT_DOWNLOAD_CONNECTIONS 4
+
+/*
+	Largest number of data connections a single download may use.
+*/
+#define MAX_DOWNLOAD_CONNECTIONS 16
+
+/*
+	Size of the chunks a download is cut into by default.
+*/
+#define DEFAULT_DOWNLOAD_CHUNK_SIZE (1024*1024)
+
+struct ChunkedDownload;
+
+/*-----------------------------------------------------------------------------
+-- CLASS: ChunkedDownloader
+--
+-- DESCRIPTION: Downloads songs from the server's data port. Every download runs
+-- in threads of its own; the OnDownloadComplete callback is called when a
+-- download stops, indicating whether the whole song was received.
+-----------------------------------------------------------------------------*/
+class ChunkedDownloader
+{
+	public:
+		/* CONSTRUCTORS/DESTRUCTORS */
+		ChunkedDownloader(OnDownloadComplete downloadComplete);
+		~ChunkedDownloader();
+
+		/* PUBLIC MEMBER METHODS */
+		void setServer(char *host, unsigned short port);
+		void setConcurrency(int connections);
+		void setChunkSize(unsigned long size);
+		bool download(SongName *song);
+		void cancel(int songId);
+		bool waitFor(int songId, DWORD timeout);
+		bool isDownloading();
+
+	private:
+		/* PRIVATE STATIC MEMBER METHODS */
+		static DWORD WINAPI DownloadThread(LPVOID chunkedDownload);
+		static DWORD WINAPI WorkerThread(LPVOID chunkedDownload);
+		static void fetchChunks(ChunkedDownload *download, SOCKET sd);
+		static bool fetchRange(ChunkedDownload *download, SOCKET sd, unsigned long offset,
+			unsigned long length, FileTransferHeader *header, CarouselOfferPacket *offer = NULL);
+		static SOCKET connectToServer(sockaddr_in *server);
+		static bool recvAll(SOCKET sd, char *buffer, int length);
+
+		/* PRIVATE MEMBER DATA */
+		std::map<int, ChunkedDownload*> downloads;
+		HANDLE access;
+		sockaddr_in server;
+		int concurrency;
+		unsigned long chunkSize;
+		OnDownloadComplete onDownloadComplete;
+};
+
+#endif
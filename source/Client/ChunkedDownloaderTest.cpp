@@ -0,0 +1,277 @@
+#include "ChunkedDownloader.h"
+#include "../Server/ServerControlThread.h"
+#include "../Buffer/MessageQueue.h"
+#include <deque>
+
+#ifdef TEST_CHUNKED_DOWNLOADER
+
+/**
+ * loopback benchmark of chunked downloads. the data port is served by a real
+ *   FileTransferer, and reached through a local proxy that delays everything
+ *   it forwards, and only keeps a window's worth of bytes in flight per
+ *   connection, like a long fat link would. reports MB/s for every
+ *   combination of connections and chunk size.
+ */
+
+#define DATA_PORT 7791
+#define PROXY_PORT 7792
+#define PROXY_DELAY_MS 20
+#define PROXY_WINDOW (256*1024)
+#define TEST_SONG_SIZE (32*1024*1024)
+#define TEST_DIR L"ChunkedDownloaderTest"
+#define TEST_SONG L"ChunkedDownloaderTest\\song.wav"
+
+/**
+ * a block of bytes read by the proxy, and when it may be forwarded.
+ */
+struct ProxyBlock
+{
+    LARGE_INTEGER due;
+    int len;
+    char data[FILE_CHUNK_SIZE];
+};
+
+/**
+ * one direction of a proxied connection.
+ */
+struct ProxyPipe
+{
+    SOCKET from;
+    SOCKET to;
+    std::deque<ProxyBlock*> blocks;
+    int inFlight;
+    bool closed;
+    CRITICAL_SECTION lock;
+    HANDLE readable;
+    HANDLE writable;
+};
+
+static LARGE_INTEGER freq;
+
+DWORD WINAPI proxyReader(void* params)
+{
+    ProxyPipe* pipe = (ProxyPipe*) params;
+
+    while(true)
+    {
+        // wait until there's room in the window
+        WaitForSingleObject(pipe->writable,INFINITE);
+
+        ProxyBlock* block = new ProxyBlock;
+        block->len = recv(pipe->from,block->data,sizeof(block->data),0);
+        QueryPerformanceCounter(&block->due);
+        block->due.QuadPart += freq.QuadPart*PROXY_DELAY_MS/1000;
+
+        EnterCriticalSection(&pipe->lock);
+        if(block->len <= 0)
+        {
+            delete block;
+            pipe->closed = true;
+        }
+        else
+        {
+            pipe->blocks.push_back(block);
+            pipe->inFlight += block->len;
+            if(pipe->inFlight >= PROXY_WINDOW)
+            {
+                ResetEvent(pipe->writable);
+            }
+        }
+        SetEvent(pipe->readable);
+        LeaveCriticalSection(&pipe->lock);
+
+        if(pipe->closed)
+        {
+            return 0;
+        }
+    }
+}
+
+DWORD WINAPI proxyWriter(void* params)
+{
+    ProxyPipe* pipe = (ProxyPipe*) params;
+
+    while(true)
+    {
+        WaitForSingleObject(pipe->readable,INFINITE);
+
+        EnterCriticalSection(&pipe->lock);
+        if(pipe->blocks.empty())
+        {
+            bool closed = pipe->closed;
+            ResetEvent(pipe->readable);
+            LeaveCriticalSection(&pipe->lock);
+            if(closed)
+            {
+                shutdown(pipe->to,SD_SEND);
+                return 0;
+            }
+            continue;
+        }
+        ProxyBlock* block = pipe->blocks.front();
+        pipe->blocks.pop_front();
+        LeaveCriticalSection(&pipe->lock);
+
+        // hold the block back until it is due
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        if(now.QuadPart < block->due.QuadPart)
+        {
+            Sleep((DWORD) ((block->due.QuadPart-now.QuadPart)*1000/freq.QuadPart));
+        }
+        send(pipe->to,block->data,block->len,0);
+
+        EnterCriticalSection(&pipe->lock);
+        pipe->inFlight -= block->len;
+        if(pipe->inFlight < PROXY_WINDOW)
+        {
+            SetEvent(pipe->writable);
+        }
+        LeaveCriticalSection(&pipe->lock);
+        delete block;
+    }
+}
+
+void startPipe(SOCKET from, SOCKET to)
+{
+    ProxyPipe* pipe = new ProxyPipe;
+    pipe->from = from;
+    pipe->to = to;
+    pipe->inFlight = 0;
+    pipe->closed = false;
+    InitializeCriticalSection(&pipe->lock);
+    pipe->readable = CreateEvent(NULL,TRUE,FALSE,NULL);
+    pipe->writable = CreateEvent(NULL,TRUE,TRUE,NULL);
+    CreateThread(NULL,0,proxyReader,pipe,0,NULL);
+    CreateThread(NULL,0,proxyWriter,pipe,0,NULL);
+}
+
+SOCKET listenOn(unsigned short port)
+{
+    SOCKET sd = socket(AF_INET,SOCK_STREAM,0);
+    sockaddr_in addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(sd,(sockaddr*) &addr,sizeof(addr));
+    listen(sd,SOMAXCONN);
+    return sd;
+}
+
+DWORD WINAPI dataPort(void* params)
+{
+    SOCKET listener = (SOCKET) params;
+    FileTransferer transferer(NULL);
+    SOCKET sd;
+
+    while((sd = accept(listener,NULL,NULL)) != INVALID_SOCKET)
+    {
+        MessageQueue* msgq = new MessageQueue(100,sizeof(TCPPacket));
+        transferer.serveDataConnection(new TCPSocket(sd,msgq,true));
+    }
+    return 0;
+}
+
+DWORD WINAPI proxy(void* params)
+{
+    SOCKET listener = (SOCKET) params;
+    SOCKET client;
+
+    while((client = accept(listener,NULL,NULL)) != INVALID_SOCKET)
+    {
+        sockaddr_in addr;
+        memset(&addr,0,sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(DATA_PORT);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        SOCKET server = socket(AF_INET,SOCK_STREAM,0);
+        connect(server,(sockaddr*) &addr,sizeof(addr));
+        startPipe(client,server);
+        startPipe(server,client);
+    }
+    return 0;
+}
+
+void writeSong()
+{
+    struct
+    {
+        char riff[4];
+        unsigned long riffSize;
+        char wave[4];
+        char fmt[4];
+        unsigned long fmtSize;
+        short format, channels;
+        unsigned long sampleRate, byteRate;
+        short blockAlign, bitsPerSample;
+        char data[4];
+        unsigned long dataSize;
+    } header = {{'R','I','F','F'},TEST_SONG_SIZE-8,{'W','A','V','E'},
+        {'f','m','t',' '},16,1,1,AUDIO_SAMPLE_RATE,AUDIO_SAMPLE_RATE,1,8,
+        {'d','a','t','a'},TEST_SONG_SIZE-44};
+
+    CreateDirectory(TEST_DIR,NULL);
+    FILE* fp = _wfopen(TEST_SONG,L"wb");
+    fwrite(&header,sizeof(header),1,fp);
+    for(unsigned long i = sizeof(header); i < TEST_SONG_SIZE; ++i)
+    {
+        fputc((char) i,fp);
+    }
+    fclose(fp);
+}
+
+int main(void)
+{
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2),&wsaData);
+    QueryPerformanceFrequency(&freq);
+
+    // serve a playlist holding the test song
+    writeSong();
+    Playlist* playlist = new Playlist(TEST_DIR L"\\*.wav");
+    ServerControlThread::getInstance()->setPlaylist(playlist);
+    SongName song = playlist->playlist[0];
+    sprintf_s(song.cFilename,"ChunkedDownloaderTest.out");
+
+    CreateThread(NULL,0,dataPort,(void*) listenOn(DATA_PORT),0,NULL);
+    CreateThread(NULL,0,proxy,(void*) listenOn(PROXY_PORT),0,NULL);
+
+    int connections[] = {1,2,4,8};
+    unsigned long chunkSizes[] = {256*1024,1024*1024,4*1024*1024};
+
+    printf("delay %d ms, window %d KB\n",PROXY_DELAY_MS,PROXY_WINDOW/1024);
+    for(int c = 0; c < sizeof(connections)/sizeof(connections[0]); ++c)
+    {
+        for(int s = 0; s < sizeof(chunkSizes)/sizeof(chunkSizes[0]); ++s)
+        {
+            ChunkedDownloader downloader(NULL);
+            downloader.setServer("127.0.0.1",PROXY_PORT);
+            downloader.setConcurrency(connections[c]);
+            downloader.setChunkSize(chunkSizes[s]);
+
+            DeleteFileA("ChunkedDownloaderTest.out");
+            DeleteFileA("ChunkedDownloaderTest.out" PART_FILE_EXTENSION);
+
+            LARGE_INTEGER start, stop;
+            QueryPerformanceCounter(&start);
+            downloader.download(&song);
+            bool success = downloader.waitFor(song.id,INFINITE);
+            QueryPerformanceCounter(&stop);
+
+            double seconds = (double) (stop.QuadPart-start.QuadPart)/freq.QuadPart;
+            printf("%2d connections %5lu KB chunks %8.1f MB/s %s\n",connections[c],
+                chunkSizes[s]/1024,(double) TEST_SONG_SIZE/(1024*1024)/seconds,
+                success ? "" : "FAILED");
+        }
+    }
+
+    DeleteFileA("ChunkedDownloaderTest.out");
+    DeleteFile(TEST_SONG);
+    RemoveDirectory(TEST_DIR);
+    WSACleanup();
+    return 0;
+}
+
+#endif
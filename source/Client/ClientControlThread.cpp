@@ -18,8 +18,15 @@
 #include "../handlerHelper.h"
 #include "../protocol.h"
 #include "MusicBuffer.h"
+#include "ClientMixer.h"
 #include "PlayWave.h"
+#include "MicReader.h"
 #include "../Client/FileTransferer.h"
+#include "ChunkedDownloader.h"
+#include "ReceiveThread.h"
+#include "MusicBufferer.h"
+#include "../Buffer/JitterBuffer.h"
+#include "../Server/FormatConverter.h"
 
 /*
  * message queue constructor parameters
@@ -39,6 +46,9 @@
 union MsgqElement
 {
     int songId;
+    int station;
+    double percentage;
+    FormatPacket format;
 };
 
 /**
@@ -47,6 +57,7 @@ union MsgqElement
 union SockMsgqElement
 {
     char data[DATA_BUFSIZE];
+    char chunk[sizeof(FileChunkHeader)+FILE_CHUNK_SIZE];
 };
 
 /////////////////////
@@ -95,6 +106,17 @@ ClientControlThread::ClientControlThread()
     _threadStopEv = CreateEvent(NULL,TRUE,FALSE,NULL);
     _thread       = INVALID_HANDLE_VALUE;
 	fileTransferer = new FileTransferer(NULL);
+    fileTransferer->setBulkMode(true);
+    chunkedDownloader = new ChunkedDownloader(NULL);
+    downloadConnections = DEFAULT_DOWNLOAD_CONNECTIONS;
+    _changeRequested.QuadPart = 0;
+    memset(_changeLatency,0,sizeof(_changeLatency));
+    _songId       = -1;
+    _radioSongId  = -1;
+    _onDemand     = false;
+    _onDemandBase = 0;
+    _station      = -1;
+    memset(&_streamFormat,0,sizeof(_streamFormat));
 }
 
 /**
@@ -145,11 +167,115 @@ void ClientControlThread::requestChangeStream(int id)
     _msgq.enqueue(CHANGE_STREAM,&element);
 }
 
+/**
+ * posts a message to an internal message queue, informing the control thread
+ *   that the server should stream the current song to this client alone,
+ *   starting at the passed position. used to seek to positions that haven't
+ *   been received yet; the other clients keep listening to the multicast
+ *   stream.
+ *
+ * @date     2026-10-18
+ *
+ * @param    percentage   position in the current song to stream from, from 0
+ *   to 1.
+ */
+void ClientControlThread::requestSeek(double percentage)
+{
+    // prepare the element for insertion into the message queue
+    MsgqElement element;
+    element.percentage = percentage;
+
+    // insert the element into the message queue
+    _msgq.enqueue(SEEK_STREAM,&element);
+}
+
+/**
+ * posts a message to an internal message queue, informing the control thread
+ *   that the server should tune this client to another station.
+ *
+ * @date     2026-10-18
+ *
+ * @param    station   number of the station, counted from 0.
+ */
+void ClientControlThread::requestStation(int station)
+{
+    // prepare the element for insertion into the message queue
+    MsgqElement element;
+    element.station = station;
+
+    // insert the element into the message queue
+    _msgq.enqueue(TUNE_STATION,&element);
+}
+
+/**
+ * posts a message to an internal message queue, informing the control thread
+ *   that the multicast stream has gone on to its next song by itself. called
+ *   by the {MusicBuffer} once the current song has been played out, and the
+ *   next one is being read.
+ *
+ * @date     2026-10-18
+ *
+ * @param    format   the song the stream went on to.
+ */
+void ClientControlThread::nextSongStarted(FormatPacket* format)
+{
+    // prepare the element for insertion into the message queue
+    MsgqElement element;
+    element.format = *format;
+
+    // insert the element into the message queue
+    _msgq.enqueue(STREAM_FORMAT,&element);
+}
+
+/**
+ * sets how songs are downloaded. downloads are cut into chunks that are
+ *   fetched over several connections to the server's data port at once, or
+ *   sent in one piece over the control connection.
+ *
+ * @date     2026-10-18
+ *
+ * @param    connections   number of data connections each download is
+ *   fetched over; 0 to download over the control connection, where control
+ *   messages queue up behind the file data. that mode is only kept to compare
+ *   stream change latency against.
+ */
+void ClientControlThread::setDownloadConnections(int connections)
+{
+    downloadConnections = connections;
+    if(connections > 0)
+    {
+        chunkedDownloader->setConcurrency(connections);
+    }
+}
+
+/**
+ * copies the stream change latencies measured so far. downloading over the
+ *   control connection delays stream changes behind the queued file data;
+ *   comparing {downloading} with {idle} for both download modes shows by how
+ *   much.
+ *
+ * @date     2026-10-18
+ *
+ * @param    idle   set to the latencies of stream changes requested while
+ *   no download was running.
+ * @param    downloading   set to the latencies of stream changes requested
+ *   while a download was running.
+ */
+void ClientControlThread::getStreamChangeLatency(StreamChangeLatency* idle,
+    StreamChangeLatency* downloading)
+{
+    WaitForSingleObject(access,INFINITE);
+    *idle        = _changeLatency[0];
+    *downloading = _changeLatency[1];
+    ReleaseMutex(access);
+}
+
 void ClientControlThread::connect(char* ipAddress, unsigned short port)
 {
     // copy connection parameters into the object
     memcpy(this->ipAddress,ipAddress,IP_ADDR_LEN);
     this->port = port;
+    chunkedDownloader->setServer(ipAddress,port+DATA_PORT_OFFSET);
 
     // start the threaded routine
     _startRoutine(&_thread,_threadStopEv,_threadRoutine,this);
@@ -174,14 +300,41 @@ void ClientControlThread::onDownloadPacket( FileTransferData packet )
 
 void ClientControlThread::onChangeStream( RequestPacket packet )
 {
-    // get the song
-    SongName song = _songs[packet.index];
+    // get the song, as the server streams it
+    SongName song = _streamed(packet.index);
+    _songId = packet.index;
 
-    // set the speaker settings and stuff according to the song parameters 
-    _window->musicPlayer->stopPlaying();
-	_window->musicfile->newSong(song.size, song.bps);
+    // a song announced by the old stream doesn't follow this one
+    _window->musicBufferer->clearBuffer();
+
+    // set the speaker settings and stuff according to the song parameters;
+    // the device stays open if the format is the same
+	_window->musicfile->newSong(song.size, song.bps, song.dataOffset);
 	_window->setTitle(song.filepath);
-    _window->musicPlayer->startPlaying(song.sample_rate,song.bps,song.channels);
+    _window->mixer->playFormat(song.sample_rate,song.bps,song.channels);
+}
+
+/**
+ * invoked when the multicast stream has gone on to its next song by itself.
+ *   the music buffer has already started the song; the player is only
+ *   restarted if the format changed, so songs of the same format play back
+ *   to back without a gap.
+ *
+ * @date     2026-10-18
+ *
+ * @param    format   the song the stream went on to.
+ */
+void ClientControlThread::onNextSong(FormatPacket format)
+{
+    _radioSongId = format.songId;
+    if(_onDemand)
+    {
+        return;
+    }
+
+    _songId = format.songId;
+    _window->setTitle(_songs[format.songId].filepath);
+    _window->mixer->playFormat(format.sample_rate,format.bps,format.channels);
 }
 
 void ClientControlThread::onNewSong( SongName song )
@@ -190,6 +343,85 @@ void ClientControlThread::onNewSong( SongName song )
     _songs[song.id] = song;
 }
 
+/**
+ * invoked when the stream the server was sending to this client alone has
+ *   reached the end of the song. the client goes back to the song everybody
+ *   else is listening to, unless it has seeked again since; the end of an
+ *   older stream is ignored.
+ *
+ * @date     2026-10-18
+ *
+ * @param    packet   the server's SEEK_STREAM, with the first index of the
+ *   stream that ended.
+ */
+void ClientControlThread::onStreamEnded(SeekPacket* packet)
+{
+    if(!_onDemand || packet->firstIndex != _onDemandBase)
+    {
+        return;
+    }
+
+    _leaveOnDemand();
+    if(_radioSongId != -1)
+    {
+        RequestPacket packet;
+        packet.index = _radioSongId;
+        onChangeStream(packet);
+    }
+}
+
+/**
+ * invoked when the server sends recent packets of the multicast stream, after
+ *   this client has joined it or the song has changed. the packets go straight
+ *   into the jitter buffer, so the song starts playing without waiting for the
+ *   stream to fill it at real time.
+ *
+ * @date     2026-10-18
+ *
+ * @param    packet   the packets; the jitter buffer starts over before the
+ *   first of them if this is the first part of the prefill.
+ */
+void ClientControlThread::onPrefill(PrefillPacket* packet)
+{
+    // the stream sent to this client alone is playing instead
+    if(_onDemand || packet->songId != _songId || packet->count <= 0)
+    {
+        return;
+    }
+
+    if(packet->first)
+    {
+        // the oldest packet may start with the end of the song before
+        _window->musicBufferer->skipLead(packet->packets[0].index,packet->lead);
+        _window->musicJitBuf->reset(packet->packets[0].index-1);
+    }
+    for(int i = 0; i < packet->count; ++i)
+    {
+        _window->musicJitBuf->put(packet->packets[i].index,packet->packets[i].data);
+    }
+}
+
+/**
+ * invoked when the server tunes this client to a station; leaves the
+ *   multicast group of the station it was tuned to, and joins the group of
+ *   the new one. the server follows up with the song of the station and the
+ *   start of its stream.
+ *
+ * @date     2026-10-18
+ *
+ * @param    packet   the station this client is tuned to.
+ */
+void ClientControlThread::onTuned(StationPacket* packet)
+{
+    _window->udpSock->switchGroup(packet->group);
+    _station = packet->station;
+    _streamFormat = packet->format;
+
+    wchar_t out[64];
+    swprintf_s(out,64,L"tuned to station %d of %d\n",packet->station,packet->count);
+    OutputDebugString(out);
+}
+
 int ClientControlThread::_startRoutine(HANDLE* thread, HANDLE stopEvent,
     LPTHREAD_START_ROUTINE routine, void* params)
 {
@@ -285,13 +517,20 @@ void ClientControlThread::_handleMsgqMsg(ClientControlThread* dis)
     {
     case REQUEST_DOWNLOAD:
     {
-        RequestPacket packet;
-        packet.index = element.songId;
-        dis->tcpSock->Send(REQUEST_DOWNLOAD,&packet,sizeof(packet));
+        if(dis->downloadConnections > 0)
+        {
+            dis->chunkedDownloader->download(&dis->_songs[element.songId]);
+            break;
+        }
+
+        // resumes from whatever is already on disk
+        dis->fileTransferer->requestFile(&dis->_songs[element.songId],dis->tcpSock);
         break;
     }
     case CANCEL_DOWNLOAD:
     {
+        dis->chunkedDownloader->cancel(element.songId);
+
         RequestPacket packet;
         packet.index = element.songId;
         dis->tcpSock->Send(CANCEL_DOWNLOAD,&packet,sizeof(packet));
@@ -299,11 +538,65 @@ void ClientControlThread::_handleMsgqMsg(ClientControlThread* dis)
     }
     case CHANGE_STREAM:
     {
+        // changing the song everybody listens to puts this client back on it
+        if(dis->_onDemand)
+        {
+            dis->_leaveOnDemand();
+        }
+
+        // start timing the stream change
+        QueryPerformanceCounter(&dis->_changeRequested);
+        dis->_changeSongId = element.songId;
+        dis->_changeDuringDownload = dis->_isDownloading();
+
         RequestPacket packet;
         packet.index = element.songId;
         dis->tcpSock->Send(CHANGE_STREAM,&packet,sizeof(packet));
         break;
     }
+    case SEEK_STREAM:
+    {
+        if(dis->_songId == -1)
+        {
+            break;
+        }
+
+        // find the sample frame to start from, and where it is in the song
+        SongName streamed = dis->_streamed(dis->_songId);
+        SongName* song = &streamed;
+        unsigned long frameSize = max(song->channels*song->bps/8,1);
+        SeekPacket packet;
+        packet.index = song->id;
+        packet.sample = (unsigned long) (element.percentage*song->size)/frameSize;
+        dis->_onDemandBase = (int) ((unsigned int) dis->_onDemandBase+ONDEMAND_INDEX_STRIDE);
+        packet.firstIndex = dis->_onDemandBase;
+
+        // only play what the server streams from the new position
+        dis->_onDemand = true;
+        dis->_window->musicBufferer->clearBuffer();
+        dis->_window->recvThread->setOnDemand(true);
+        dis->_window->musicJitBuf->reset(packet.firstIndex);
+        dis->_window->musicfile->restartAt(song->dataOffset+packet.sample*frameSize);
+
+        dis->tcpSock->Send(SEEK_STREAM,&packet,sizeof(packet));
+        break;
+    }
+    case STREAM_FORMAT:
+        dis->onNextSong(element.format);
+        break;
+    case TUNE_STATION:
+    {
+        // the new station plays instead of the stream sent to this client
+        if(dis->_onDemand)
+        {
+            dis->_leaveOnDemand();
+        }
+
+        RequestPacket packet;
+        packet.index = element.station;
+        dis->tcpSock->Send(TUNE_STATION,&packet,sizeof(packet));
+        break;
+    }
     default:
         fprintf(stderr,"WARNING: received unknown message type: %d\n",msgType);
         break;
@@ -326,9 +619,34 @@ void ClientControlThread::_handleSockMsgqMsg(ClientControlThread* dis)
         OutputDebugString(L"DOWNLOAD\n");
         dis->onDownloadPacket( *((FileTransferData *)element) );
         break;
+    case DOWNLOAD_HEADER:
+        OutputDebugString(L"DOWNLOAD_HEADER\n");
+        dis->fileTransferer->recvHeader( (char *)element );
+        break;
+    case DOWNLOAD_CHUNK:
+        dis->fileTransferer->recvChunk( (char *)element );
+        break;
     case CHANGE_STREAM:
         OutputDebugString(L"CHANGE_STREAM\n");
-        dis->onChangeStream( *((RequestPacket *)element) );
+        dis->_radioSongId = ((RequestPacket *)element)->index;
+        dis->_recordStreamChange( ((RequestPacket *)element)->index );
+
+        // keep playing the stream sent to this client alone
+        if(!dis->_onDemand)
+        {
+            dis->onChangeStream( *((RequestPacket *)element) );
+        }
+        break;
+    case SEEK_STREAM:
+        OutputDebugString(L"SEEK_STREAM\n");
+        dis->onStreamEnded( (SeekPacket *)element );
+        break;
+    case STREAM_PREFILL:
+        dis->onPrefill( (PrefillPacket *)element );
+        break;
+    case TUNE_STATION:
+        OutputDebugString(L"TUNE_STATION\n");
+        dis->onTuned( (StationPacket *)element );
         break;
     case NEW_SONG:
         OutputDebugString(L"NEW_SONG\n");
@@ -342,6 +660,85 @@ void ClientControlThread::_handleSockMsgqMsg(ClientControlThread* dis)
 	free(element);
 }
 
+/**
+ * returns true if a song is being downloaded, over either the data
+ *   connections or the control connection.
+ *
+ * @date     2026-10-18
+ *
+ * @return   true if a download is running.
+ */
+bool ClientControlThread::_isDownloading()
+{
+    return chunkedDownloader->isDownloading() || fileTransferer->isReceiving();
+}
+
+/**
+ * stops playing the stream the server sends to this client alone, and goes
+ *   back to the one multicast to everybody. the server stops sending it as
+ *   soon as the client changes the stream, or the song has ended.
+ *
+ * @date     2026-10-18
+ */
+void ClientControlThread::_leaveOnDemand()
+{
+    _onDemand = false;
+    _window->recvThread->setOnDemand(false);
+    _window->musicJitBuf->reset(0);
+}
+
+/**
+ * returns a song the way the server streams it; in the server's stream
+ *   format, if it has one.
+ *
+ * @date     2026-10-18
+ *
+ * @param    songId   id of the song.
+ *
+ * @return   the song, with the format and size it is streamed in.
+ */
+SongName ClientControlThread::_streamed(int songId)
+{
+    SongName song = _songs[songId];
+    FormatConverter::convert(&song,&_streamFormat);
+    return song;
+}
+
+/**
+ * finishes timing the pending stream change, if the server's CHANGE_STREAM is
+ *   the answer to it.
+ *
+ * @date     2026-10-18
+ *
+ * @param    songId   id of the song in the server's CHANGE_STREAM.
+ */
+void ClientControlThread::_recordStreamChange(int songId)
+{
+    if(_changeRequested.QuadPart == 0 || songId != _changeSongId)
+    {
+        return;
+    }
+
+    LARGE_INTEGER now, freq;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+    double ms = (double) (now.QuadPart-_changeRequested.QuadPart)*1000/freq.QuadPart;
+    _changeRequested.QuadPart = 0;
+
+    WaitForSingleObject(access,INFINITE);
+    StreamChangeLatency* latency = &_changeLatency[_changeDuringDownload ? 1 : 0];
+    ++latency->count;
+    latency->totalMs += ms;
+    latency->maxMs = max(latency->maxMs,ms);
+    ReleaseMutex(access);
+
+    wchar_t s[256];
+    swprintf(s,256,L"stream change took %.1f ms (%s, downloads over %s)\n",ms,
+        _changeDuringDownload ? L"during download" : L"idle",
+        downloadConnections > 0 ? L"data connections" : L"control connection");
+    OutputDebugString(s);
+}
+
 bool ClientControlThread::onClose(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval)
 {
 	//if connected
@@ -350,6 +747,79 @@ bool ClientControlThread::onClose(GuiComponent *_pThis, UINT command, UINT id, W
     cct->tcpSock->Send( DISCONNECT, blah, 0 );
 	free( blah );
 
+	// report the stream change latencies measured during the session
+	StreamChangeLatency idle, downloading;
+	wchar_t s[256];
+	cct->getStreamChangeLatency( &idle, &downloading );
+	swprintf( s, 256, L"stream changes: idle %d avg %.1f ms max %.1f ms, "
+		L"during download %d avg %.1f ms max %.1f ms\n",
+		idle.count, idle.count ? idle.totalMs / idle.count : 0.0, idle.maxMs,
+		downloading.count, downloading.count ? downloading.totalMs / downloading.count : 0.0,
+		downloading.maxMs );
+	OutputDebugString( s );
+
+	// report the seek latencies, within what was buffered and streamed by the server
+	PlaybackLatency local, remote, start;
+	cct->_window->musicfile->getSeekLatency( &local, &remote );
+	swprintf( s, 256, L"seeks: buffered %d avg %.1f ms max %.1f ms, "
+		L"streamed by the server %d avg %.1f ms max %.1f ms\n",
+		local.count, local.count ? local.totalMs / local.count : 0.0, local.maxMs,
+		remote.count, remote.count ? remote.totalMs / remote.count : 0.0, remote.maxMs );
+	OutputDebugString( s );
+
+	// report the time to first audio of the songs joined and switched to
+	cct->_window->musicfile->getStartLatency( &start );
+	swprintf( s, 256, L"time to first audio: %d songs avg %.1f ms max %.1f ms\n",
+		start.count, start.count ? start.totalMs / start.count : 0.0, start.maxMs );
+	OutputDebugString( s );
+
+	// report the voice sessions, and the memory they hold
+	VoiceSessionStats voice;
+	cct->_window->recvThread->getVoiceStats( &voice );
+	swprintf( s, 256, L"voice sessions: %d of %d active, %lu evicted, %lu packets dropped, %lu KB held\n",
+		voice.active, voice.pooled, voice.evicted, voice.dropped, voice.bytes / 1024 );
+	OutputDebugString( s );
+
+	// report the latency of the audio device, and how often it ran dry
+	PlayWaveStats device;
+	cct->_window->mixer->getDeviceStats( &device );
+	swprintf( s, 256, L"audio device: %d periods of %.1f ms, %.1f ms latency, %lu writes, %lu underruns\n",
+		device.periods, device.periodMs, device.latencyMs, device.writes, device.underruns );
+	OutputDebugString( s );
+
+	// report the drift between the server's clock and the sound card's
+	DriftStats drift;
+	cct->_window->mixer->getDriftStats( &drift );
+	swprintf( s, 256, L"music clock drift: %+.1f ppm, corrected by %+.1f ppm; %.1f ms buffered of %.1f ms "
+		L"target, at most %.1f ms off over %.0f s, %lu resets\n",
+		drift.driftPpm, drift.correctionPpm, drift.depthMs, drift.targetMs, drift.maxErrorMs,
+		drift.playedMs / 1000, drift.resets );
+	OutputDebugString( s );
+
+	// report how long captured voice waited before it was sent
+	CaptureLatency capture;
+	cct->_window->micReader->getCaptureLatency( &capture );
+	swprintf( s, 256, L"voice capture to send: %d buffers avg %.1f ms max %.1f ms\n",
+		capture.count, capture.count ? capture.totalMs / capture.count : 0.0, capture.maxMs );
+	OutputDebugString( s );
+
+	// report how long received voice waited to be mixed, and the mouth to ear
+	// latency it adds up to; the time on the network can't be measured
+	// without the peers' clocks, so it isn't counted
+	VoiceLatency jitter;
+	cct->_window->mixer->getVoiceLatency( &jitter );
+	swprintf( s, 256, L"voice arrival to mix: %d frames avg %.1f ms max %.1f ms\n",
+		jitter.count, jitter.count ? jitter.totalMs / jitter.count : 0.0, jitter.maxMs );
+	OutputDebugString( s );
+
+	double frameMs = cct->_window->micReader->getFrameLength() * 1000;
+	double sendMs = capture.count ? capture.totalMs / capture.count : 0.0;
+	double mixMs = jitter.count ? jitter.totalMs / jitter.count : 0.0;
+	swprintf( s, 256, L"voice mouth to ear: %.1f ms frame + %.1f ms to send + %.1f ms to mix "
+		L"+ %.1f ms device = %.1f ms, plus the network\n",
+		frameMs, sendMs, mixMs, device.latencyMs, frameMs + sendMs + mixMs + device.latencyMs );
+	OutputDebugString( s );
+
 	PostQuitMessage(0);
 
 	return true;
@@ -7,9 +7,37 @@
 
 class TCPSocket;
 class FileTransferer;
+class ChunkedDownloader;
 
 #define IP_ADDR_LEN 16
 
+/**
+ * the packets of each stream the server sends to this client alone are
+ *   numbered this far on from the ones of the stream before it, so packets of
+ *   an old stream still on their way are never mistaken for new ones. the
+ *   numbers wrap around, and are only ever compared the way the jitter buffer
+ *   does, so they can go on forever.
+ */
+#define ONDEMAND_INDEX_STRIDE (1<<24)
+
+/**
+ * latency of the stream changes requested by this client; the time from
+ *   sending CHANGE_STREAM to the server, until the server's CHANGE_STREAM for
+ *   the same song is handled.
+ *
+ * {count}; number of stream changes measured
+ *
+ * {totalMs}; sum of their latencies in milliseconds
+ *
+ * {maxMs}; largest of their latencies in milliseconds
+ */
+struct StreamChangeLatency
+{
+    int count;
+    double totalMs;
+    double maxMs;
+};
+
 class ClientControlThread
 {
 public:
@@ -17,6 +45,12 @@ public:
     void requestDownload(int id);
     void cancelDownload(int id);
     void requestChangeStream(int id);
+    void requestSeek(double percentage);
+    void requestStation(int station);
+    void nextSongStarted(FormatPacket* format);
+    void setDownloadConnections(int connections);
+    void getStreamChangeLatency(StreamChangeLatency* idle,
+        StreamChangeLatency* downloading);
     void connect(char* ipAddress, unsigned short port);
     void disconnect();
     void setClientWindow( ClientWindow * );
@@ -26,6 +60,10 @@ protected:
     void onDownloadPacket( FileTransferData packet );
     void onChangeStream(RequestPacket packet);
     void onNewSong(SongName song);
+    void onStreamEnded(SeekPacket* packet);
+    void onPrefill(PrefillPacket* packet);
+    void onTuned(StationPacket* packet);
+    void onNextSong(FormatPacket format);
 private:
 	static bool onClose(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
 
@@ -36,12 +74,72 @@ private:
     static DWORD WINAPI _threadRoutine(void* params);
     static void _handleMsgqMsg(ClientControlThread* dis);
     static void _handleSockMsgqMsg(ClientControlThread* dis);
+    bool _isDownloading();
+    void _recordStreamChange(int songId);
+    void _leaveOnDemand();
+    SongName _streamed(int songId);
     /**
      * reference to the one and only {ClientControlThread} instance.
      */
     static ClientControlThread* _instance;
 
 	FileTransferer* fileTransferer;
+    /**
+     * downloads songs over the server's data port.
+     */
+    ChunkedDownloader* chunkedDownloader;
+    /**
+     * number of data connections each download is fetched over; 0 to
+     *   download over the control connection instead.
+     */
+    int downloadConnections;
+    /**
+     * time that the pending stream change was requested at; 0 if there is
+     *   none.
+     */
+    LARGE_INTEGER _changeRequested;
+    /**
+     * id of the song that the pending stream change is to.
+     */
+    int _changeSongId;
+    /**
+     * true if a download was running when the pending stream change was
+     *   requested.
+     */
+    bool _changeDuringDownload;
+    /**
+     * stream change latencies; [0] while no download was running, [1] while
+     *   one was.
+     */
+    StreamChangeLatency _changeLatency[2];
+    /**
+     * id of the song being played; -1 if there is none.
+     */
+    int _songId;
+    /**
+     * id of the song last multicast to all clients; -1 if there is none.
+     */
+    int _radioSongId;
+    /**
+     * true while the server is streaming to this client alone, after it
+     *   seeked past what it had received.
+     */
+    bool _onDemand;
+    /**
+     * index before the first packet of the last stream requested from the
+     *   server.
+     */
+    int _onDemandBase;
+    /**
+     * number of the station this client is tuned to; -1 until the server
+     *   tunes it to one.
+     */
+    int _station;
+    /**
+     * format the server converts songs to before streaming them; a sample
+     *   rate of 0 if it streams them in their own format.
+     */
+    StreamFormat _streamFormat;
     /**
      * reference to the one and only {ClientControlThread} instance.
      */
@@ -0,0 +1,500 @@
+#include "ClientMixer.h"
+#include "PlayWave.h"
+#include "../Buffer/MessageQueue.h"
+#include "../Buffer/JitterBuffer.h"
+#include "../protocol.h"
+
+// static function forward declarations
+
+static int startRoutine(HANDLE* thread, HANDLE stopEvent,
+    LPTHREAD_START_ROUTINE routine, void* params);
+static int stopRoutine(HANDLE* thread, HANDLE stopEvent);
+
+/**
+ * PCM data that arrives an element at a time; the music from a message queue,
+ *   or a voice from its jitter buffer, as {VoiceFrame}s. only the mixing
+ *   thread takes elements out, and only when there is one, so reading never
+ *   blocks.
+ */
+class ClientMixer::Source : public PcmSource
+{
+public:
+    Source(MessageQueue* queue, JitterBuffer* jitterBuffer, int elementSize)
+        : PcmSource(AUDIO_SAMPLE_RATE,AUDIO_BITS_PER_SAMPLE,NUM_AUDIO_CHANNELS)
+    {
+        this->queue        = queue;
+        this->jitterBuffer = jitterBuffer;
+        this->element      = (char*) malloc(elementSize);
+        this->elementSize  = elementSize;
+        this->offset       = 0;
+        this->left         = 0;
+        memset(&latency,0,sizeof(latency));
+        QueryPerformanceFrequency(&freq);
+    }
+
+    ~Source()
+    {
+        free(element);
+    }
+
+    /**
+     * throws away everything the source holds, and everything queued for it.
+     */
+    void flush()
+    {
+        if(queue != NULL)
+        {
+            queue->clear();
+        }
+        left = 0;
+        reset();
+    }
+
+    /**
+     * @return   bytes of the music queued, and left of the element being read,
+     *   that haven't been decoded yet.
+     */
+    int buffered()
+    {
+        return (queue != NULL ? queue->size()*queue->elementSize : 0)+left;
+    }
+
+    /**
+     * adds how long the frames of the voice waited to be mixed to {latency}.
+     */
+    void addLatency(VoiceLatency* latency)
+    {
+        latency->count   += this->latency.count;
+        latency->totalMs += this->latency.totalMs;
+        latency->maxMs    = max(latency->maxMs,this->latency.maxMs);
+    }
+
+protected:
+    virtual int fill(char* dest, int len)
+    {
+        int copied = 0;
+        while(copied < len)
+        {
+            if(left == 0)
+            {
+                int type;
+                if(queue != NULL && queue->size() > 0)
+                {
+                    queue->dequeue(&type,element,&left);
+                    offset = 0;
+                }
+                else if(jitterBuffer != NULL
+                    && WaitForSingleObject(jitterBuffer->canGet,0) == WAIT_OBJECT_0
+                    && jitterBuffer->get(element))
+                {
+                    VoiceFrame* frame = (VoiceFrame*) element;
+                    left   = frame->len;
+                    offset = offsetof(VoiceFrame,data);
+                    record(frame);
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            int n = min(left,len-copied);
+            memcpy(dest+copied,element+offset,n);
+            copied += n;
+            offset += n;
+            left   -= n;
+        }
+        return copied;
+    }
+
+private:
+    void record(VoiceFrame* frame)
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        double ms = (double) (now.QuadPart-frame->arrived.QuadPart)*1000/freq.QuadPart;
+        ++latency.count;
+        latency.totalMs += ms;
+        latency.maxMs    = max(latency.maxMs,ms);
+    }
+
+    MessageQueue* queue;
+    JitterBuffer* jitterBuffer;
+    char* element;
+    int elementSize;
+    int offset;
+    int left;
+    VoiceLatency latency;
+    LARGE_INTEGER freq;
+};
+
+// client mixer implementation
+
+/**
+ * makes the mixer, with the music as its only source, and the device it
+ *   plays on. nothing is played until {start} is called.
+ *
+ * @date     2026-10-18
+ *
+ * @param    musicQueue   queue the {MusicReader} enqueues the music into.
+ * @param    output   device the mix is played on; the system's speakers if
+ *   NULL.
+ */
+ClientMixer::ClientMixer(MessageQueue* musicQueue, AudioOutput* output)
+{
+    this->sampleRate    = AUDIO_SAMPLE_RATE;
+    this->bitsPerSample = AUDIO_BITS_PER_SAMPLE;
+    this->channels      = NUM_AUDIO_CHANNELS;
+    this->musicBacklog  = 0;
+    this->musicPaused   = false;
+    this->mixer         = new AudioMixer(sampleRate,channels);
+    this->music         = new Source(musicQueue,NULL,musicQueue->elementSize);
+    this->deviceQueue   = new MessageQueue(1,MIXER_PERIOD_FRAMES*MIXER_MAX_CHANNELS*sizeof(short));
+    this->device        = new PlayWave(CLIENT_MIXER_DEVICE_PERIODS,deviceQueue,output);
+    this->thread        = INVALID_HANDLE_VALUE;
+    this->threadStopEv  = CreateEvent(NULL,TRUE,FALSE,NULL);
+    this->access        = CreateMutex(NULL,FALSE,NULL);
+
+    device->setPeriod(CLIENT_MIXER_PERIOD_MS);
+    mixer->addSource(music,1);
+}
+
+ClientMixer::~ClientMixer()
+{
+    stop();
+    delete device;
+    delete deviceQueue;
+    for(std::map<JitterBuffer*,Source*>::iterator i = voices.begin(); i != voices.end(); ++i)
+    {
+        delete i->second;
+    }
+    delete music;
+    delete mixer;
+    CloseHandle(threadStopEv);
+    CloseHandle(access);
+}
+
+/**
+ * opens the device, and starts mixing.
+ *
+ * @date     2026-10-18
+ */
+void ClientMixer::start()
+{
+    device->startPlaying(sampleRate,bitsPerSample,mixer->getChannels());
+    startRoutine(&thread,threadStopEv,_threadRoutine,this);
+}
+
+/**
+ * stops mixing. the mixing thread may be waiting for room on the device, so
+ *   the periods on their way to it are thrown away to let it stop.
+ *
+ * @date     2026-10-18
+ */
+void ClientMixer::stop()
+{
+    SetEvent(threadStopEv);
+    deviceQueue->clear();
+    stopRoutine(&thread,threadStopEv);
+    device->stopPlaying();
+}
+
+/**
+ * makes sure the music is played in the passed format; the mix is made, and
+ *   the device plays, in the format of the song, so the music is never
+ *   converted, only the voices are. nothing changes if the format is the same
+ *   as the last song's.
+ *
+ * @date     2026-10-18
+ *
+ * @revision 2026-10-18 the drift compensator starts over when the format
+ *   changes.
+ *
+ * @param    samplesPerSecond   sample rate of the song.
+ * @param    bitsPerSample   bits per sample of the song; 8 or 16.
+ * @param    numChannels   number of channels of the song.
+ *
+ * @return   see PlayWave::playFormat.
+ */
+int ClientMixer::playFormat(int samplesPerSecond, int bitsPerSample, int numChannels)
+{
+    WaitForSingleObject(access,INFINITE);
+
+    if(samplesPerSecond != sampleRate
+        || bitsPerSample != this->bitsPerSample
+        || numChannels != channels)
+    {
+        sampleRate          = samplesPerSecond;
+        this->bitsPerSample = bitsPerSample;
+        channels            = numChannels;
+        mixer->setFormat(sampleRate,channels);
+        music->setFormat(sampleRate,bitsPerSample,channels);
+        drift.reset();
+    }
+    int ret = device->playFormat(sampleRate,bitsPerSample,mixer->getChannels());
+
+    ReleaseMutex(access);
+    return ret;
+}
+
+/**
+ * throws away the music that hasn't been played yet, when the music is
+ *   stopped or seeked; the voices go on playing.
+ *
+ * @date     2026-10-18
+ *
+ * @revision 2026-10-18 the drift compensator starts over.
+ */
+void ClientMixer::flushMusic()
+{
+    WaitForSingleObject(access,INFINITE);
+    music->flush();
+    drift.reset();
+    ReleaseMutex(access);
+}
+
+/**
+ * adds the voice of a peer to the mix.
+ *
+ * @date     2026-10-18
+ *
+ * @revision 2026-10-18 the source of a jitter buffer that was in the mix
+ *   before is used again.
+ *
+ * @param    voiceJitterBuffer   jitter buffer the voice of the peer is put
+ *   into as it is received.
+ */
+void ClientMixer::addVoice(JitterBuffer* voiceJitterBuffer)
+{
+    WaitForSingleObject(access,INFINITE);
+
+    Source* voice = voices[voiceJitterBuffer];
+    if(voice == NULL)
+    {
+        voice = new Source(NULL,voiceJitterBuffer,voiceJitterBuffer->getElementSize());
+        voices[voiceJitterBuffer] = voice;
+    }
+    mixer->addSource(voice,1);
+
+    ReleaseMutex(access);
+}
+
+/**
+ * takes the voice of a peer out of the mix, throwing away what its source
+ *   still held.
+ *
+ * @date     2026-10-18
+ *
+ * @param    voiceJitterBuffer   jitter buffer that was passed to {addVoice}.
+ */
+void ClientMixer::removeVoice(JitterBuffer* voiceJitterBuffer)
+{
+    WaitForSingleObject(access,INFINITE);
+
+    Source* voice = voices[voiceJitterBuffer];
+    if(voice != NULL)
+    {
+        mixer->removeSource(voice);
+        voice->flush();
+    }
+
+    ReleaseMutex(access);
+}
+
+void ClientMixer::setVolume(char volume)
+{
+    device->setVolume(volume);
+}
+
+/**
+ * gets the latency of the device, and how often it ran out of audio.
+ *
+ * @date     2026-10-18
+ *
+ * @param    stats   filled with the statistics of the device.
+ */
+void ClientMixer::getDeviceStats(PlayWaveStats* stats)
+{
+    device->getStats(stats);
+}
+
+/**
+ * gets how long the frames of every voice waited in their jitter buffers,
+ *   from when they were received until they were mixed; with the latency of
+ *   the device, the time from a peer's packet arriving until it is heard.
+ *
+ * @date     2026-10-18
+ *
+ * @param    latency   filled with the statistics of all the voices.
+ */
+void ClientMixer::getVoiceLatency(VoiceLatency* latency)
+{
+    memset(latency,0,sizeof(*latency));
+
+    WaitForSingleObject(access,INFINITE);
+    for(std::map<JitterBuffer*,Source*>::iterator i = voices.begin(); i != voices.end(); ++i)
+    {
+        if(i->second != NULL)
+        {
+            i->second->addLatency(latency);
+        }
+    }
+    ReleaseMutex(access);
+}
+
+/**
+ * tells the mixer how much music the {MusicBuffer} holds that hasn't been
+ *   enqueued yet; it is counted towards the music buffered. doesn't block, so
+ *   it can be called with the buffer locked.
+ *
+ * @date     2026-10-18
+ *
+ * @param    bytes   bytes received that haven't been read from the buffer.
+ */
+void ClientMixer::setMusicBacklog(unsigned long bytes)
+{
+    InterlockedExchange(&musicBacklog,(LONG) bytes);
+}
+
+/**
+ * tells the mixer the music was paused or resumed. the music buffered stops
+ *   being measured while it is paused, since it only grows; the drift
+ *   compensator starts over once it resumes.
+ *
+ * @date     2026-10-18
+ *
+ * @param    paused   true if the music was paused; false if it was resumed.
+ */
+void ClientMixer::setMusicPaused(bool paused)
+{
+    WaitForSingleObject(access,INFINITE);
+    if(musicPaused && !paused)
+    {
+        drift.reset();
+    }
+    musicPaused = paused;
+    ReleaseMutex(access);
+}
+
+/**
+ * gets the drift between the clock the music is sent by and the sound card's,
+ *   and how much music is buffered to make up for it.
+ *
+ * @date     2026-10-18
+ *
+ * @param    stats   filled with the state of the drift compensator.
+ */
+void ClientMixer::getDriftStats(DriftStats* stats)
+{
+    WaitForSingleObject(access,INFINITE);
+    drift.getStats(stats);
+    ReleaseMutex(access);
+}
+
+/**
+ * mixes periods, and hands them to the device, until stopped. handing a
+ *   period over blocks while the device has enough queued, which keeps the
+ *   mix just ahead of what is being heard.
+ *
+ * @date     2026-10-18
+ *
+ * @param    params   the {ClientMixer}.
+ *
+ * @return   0.
+ */
+DWORD WINAPI ClientMixer::_threadRoutine(void* params)
+{
+    ClientMixer* dis = (ClientMixer*) params;
+    char* element = (char*) malloc(dis->deviceQueue->elementSize);
+
+    while(WaitForSingleObject(dis->threadStopEv,0) == WAIT_TIMEOUT)
+    {
+        int len = dis->_mixPeriod(element);
+        dis->deviceQueue->enqueue(0,element,len);
+    }
+
+    free(element);
+    return 0;
+}
+
+/**
+ * mixes a period, in the format the device is playing. before it is mixed,
+ *   the music buffered is measured, and the music is made to drift to keep it
+ *   where it is; the periods are paced by the device, so they are what time
+ *   is measured in.
+ *
+ * @date     2026-10-18
+ *
+ * @revision 2026-10-18 compensates for the drift of the music.
+ *           2026-10-18 leaves the drift alone while the music is paused.
+ *
+ * @param    element   where to put the period.
+ *
+ * @return   the size of the period in bytes.
+ */
+int ClientMixer::_mixPeriod(char* element)
+{
+    WaitForSingleObject(access,INFINITE);
+
+    double bytesPerMs = (double) sampleRate*channels*(bitsPerSample/8)/1000;
+    double depthMs = (musicBacklog+music->buffered())/bytesPerMs;
+    double periodMs = (double) MIXER_PERIOD_FRAMES*1000/sampleRate;
+    if(!musicPaused)
+    {
+        music->setDrift(drift.update(periodMs,depthMs));
+    }
+
+    const short* mixed = mixer->mix();
+    int count = MIXER_PERIOD_FRAMES*mixer->getChannels();
+    int len;
+    if(bitsPerSample == 8)
+    {
+        PcmKernels::s16ToU8((unsigned char*) element,mixed,count);
+        len = count;
+    }
+    else
+    {
+        len = count*sizeof(short);
+        memcpy(element,mixed,len);
+    }
+
+    ReleaseMutex(access);
+    return len;
+}
+
+// static function implementations
+
+int startRoutine(HANDLE* thread, HANDLE stopEvent,
+    LPTHREAD_START_ROUTINE routine, void* params)
+{
+    // return immediately if the routine is already running
+    if(*thread != INVALID_HANDLE_VALUE)
+    {
+        return 1;
+    }
+
+    // reset the stop event
+    ResetEvent(stopEvent);
+
+    // start the thread & return
+    DWORD useless;
+    *thread = CreateThread(0,0,routine,params,0,&useless);
+    return (*thread == INVALID_HANDLE_VALUE);
+}
+
+int stopRoutine(HANDLE* thread, HANDLE stopEvent)
+{
+    // return immediately if the routine is already stopped
+    if(*thread == INVALID_HANDLE_VALUE)
+    {
+        return 1;
+    }
+
+    // set the stop event to stop the thread
+    SetEvent(stopEvent);
+    WaitForSingleObject(*thread,INFINITE);
+
+    // invalidate thread handle, so we know it's terminated
+    *thread = INVALID_HANDLE_VALUE;
+    return 0;
+}
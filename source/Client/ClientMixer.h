@@ -0,0 +1,146 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: ClientMixer.h
+--
+-- NOTES:
+-- The {ClientMixer} plays everything the client hears on one
+-- audio device. It reads the music the {MusicReader} enqueues,
+-- and the voice of every peer from its jitter buffer, and has
+-- an {AudioMixer} add them up, a period at a time, in the
+-- format of the song being played.
+--
+-- The periods are handed to one {PlayWave}, which gathers them
+-- into device periods of {CLIENT_MIXER_PERIOD_MS} milliseconds,
+-- and only lets a few of those be queued on the device at a
+-- time; that is what paces the mixing, and keeps voice from
+-- falling behind.
+--
+-- The music is played at the rate of the sound card, but sent
+-- at the rate of the server's clock; a {DriftCompensator} is
+-- told how much music is buffered every period, and the music
+-- is read that much faster or slower, so what is buffered stays
+-- where it was.
+--
+-- The jitter buffer of a voice holds {VoiceFrame}s; each frame
+-- is as long as the packet it came in, and records when it
+-- arrived, so the time voice waits to be mixed is measured.
+--------------------------------------------------------------*/
+#ifndef CLIENTMIXER_H
+#define CLIENTMIXER_H
+
+#include "../Common.h"
+#include "../protocol.h"
+#include "AudioMixer.h"
+#include "DriftCompensator.h"
+#include <map>
+
+class MessageQueue;
+class JitterBuffer;
+class PlayWave;
+class AudioOutput;
+struct PlayWaveStats;
+
+/**
+ * milliseconds of audio written to the device at a time, and how many of
+ *   those may be queued on it; together, the latency added by the device.
+ */
+#define CLIENT_MIXER_PERIOD_MS 20
+#define CLIENT_MIXER_DEVICE_PERIODS 4
+
+/**
+ * a frame of voice, the element of the jitter buffer of a voice.
+ *
+ * {len}; bytes of {data} to play
+ *
+ * {arrived}; performance counter value of when the frame was received
+ *
+ * {data}; unsigned 8 bit PCM data, in the format of voice
+ */
+struct VoiceFrame
+{
+    int len;
+    LARGE_INTEGER arrived;
+    char data[DATA_LEN];
+};
+
+/**
+ * statistics about the time voice frames waited from when they were
+ *   received, until they were mixed.
+ */
+struct VoiceLatency
+{
+    int count;
+    double totalMs;
+    double maxMs;
+};
+
+class ClientMixer
+{
+public:
+    ClientMixer(MessageQueue* musicQueue, AudioOutput* output = NULL);
+    ~ClientMixer();
+    void start();
+    void stop();
+    int playFormat(int samplesPerSecond, int bitsPerSample, int numChannels);
+    void flushMusic();
+    void addVoice(JitterBuffer* voiceJitterBuffer);
+    void removeVoice(JitterBuffer* voiceJitterBuffer);
+    void setVolume(char volume);
+    void getDeviceStats(PlayWaveStats* stats);
+    void getVoiceLatency(VoiceLatency* latency);
+    void setMusicBacklog(unsigned long bytes);
+    void setMusicPaused(bool paused);
+    void getDriftStats(DriftStats* stats);
+
+private:
+    class Source;
+
+    static DWORD WINAPI _threadRoutine(void* params);
+    int _mixPeriod(char* element);
+
+    /**
+     * adds up the music and the voices.
+     */
+    AudioMixer* mixer;
+
+    /**
+     * the music, and the voice of each peer by its jitter buffer; a voice
+     *   taken out of the mix keeps its source, for when it is added again.
+     */
+    Source* music;
+    std::map<JitterBuffer*,Source*> voices;
+
+    /**
+     * bytes of music received that haven't been enqueued for the mixer yet,
+     *   and what the music is read faster or slower by to follow the clock it
+     *   is sent by; the drift isn't followed while the music is paused.
+     */
+    volatile LONG musicBacklog;
+    DriftCompensator drift;
+    bool musicPaused;
+
+    /**
+     * format the device is playing; the same as the song being played.
+     */
+    int sampleRate;
+    int bitsPerSample;
+    int channels;
+
+    /**
+     * mixed periods on their way to the device, and the device.
+     */
+    MessageQueue* deviceQueue;
+    PlayWave* device;
+
+    /**
+     * thread that mixes the periods, and the event that stops it.
+     */
+    HANDLE thread;
+    HANDLE threadStopEv;
+
+    /**
+     * protects the mixer, and the sources, while a period is being mixed.
+     */
+    HANDLE access;
+};
+
+#endif
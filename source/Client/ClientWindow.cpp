@@ -37,9 +37,8 @@
 #include "../Buffer/MessageQueue.h"
 #include "../Buffer/JitterBuffer.h"
 #include "ReceiveThread.h"
-#include "VoiceBufferer.h"
 #include "MicReader.h"
-#include "PlayWave.h"
+#include "ClientMixer.h"
 #include "MusicBufferer.h"
 #include "MusicReader.h"
 #include "MusicBuffer.h"
@@ -81,10 +80,11 @@ ClientWindow::ClientWindow(HINSTANCE hInst)
 	borderPen = (HPEN)CreatePen(PS_SOLID, 1, RGB(128, 0, 128));
 
     voiceTargetAddress[0] = 0;
+	lowLatencyVoice = true;
 
 	recording = false;
 	requestingRecorderStop = false;
-	micMQueue = new MessageQueue(1000,AUDIO_BUFFER_LENGTH);
+	micMQueue = new MessageQueue(MIC_READER_BUFFERS,sizeof(MicBuffer*));
 
 	curClientWindow = this;
 }
@@ -99,15 +99,19 @@ DWORD ClientWindow::ThreadStart(void)
 {
 	int useless;
 	int length;
+	MicBuffer *buffer;
 
 	voicePacket.index = 0;
 
-	// continuously send voice data over the network when it becomes available
+	// continuously send voice data over the network when it becomes available;
+	// the packet is sent from the buffer it was captured into, then given back.
+	// each packet carries one frame, and is only as long as it
 	while (true)
 	{
-		++(voicePacket.index);
-		micMQueue->dequeue(&useless, voicePacket.data, &length);
-        udpSock->Send(MICSTREAM,&voicePacket,sizeof(voicePacket),voiceTargetAddress,MULTICAST_PORT);
+		micMQueue->dequeue(&useless, &buffer, &length);
+		buffer->packet.index = ++(voicePacket.index);
+        udpSock->Send(MICSTREAM,&buffer->packet,sizeof(buffer->packet.index)+buffer->len,voiceTargetAddress,MULTICAST_PORT);
+		micReader->release(buffer);
 	}
 }
 
@@ -139,6 +143,8 @@ ClientWindow::~ClientWindow()
 	delete playButton;
 	delete stopButton;
 	delete voiceTargetInput;
+	delete stationInput;
+	delete tuneButton;
 	//delete voiceTargetLabel;
 
 	DeleteObject(playButtonUp);
@@ -175,6 +181,8 @@ void ClientWindow::addRemoteFile(SongName song)
 -- FUNCTION: onCreate
 --
 -- REVISIONS:
+--		October 18, 2026 - voice is captured and played in small frames in the
+--		low-latency voice mode.
 --
 -- DESIGNER: Calvin Rempel
 --
@@ -188,7 +196,14 @@ void ClientWindow::onCreate()
 {
 	setTitle(L"CommAudio Client");
 	setSize(700, 325);
-	micReader = new MicReader(AUDIO_SAMPLE_RATE, AUDIO_BUFFER_LENGTH, micMQueue, getHWND());
+	if (lowLatencyVoice)
+	{
+		micReader = new MicReader(AUDIO_SAMPLE_RATE, VOICE_LOW_LATENCY_FRAME_MS / 1000.0f, micMQueue, getHWND());
+	}
+	else
+	{
+		micReader = new MicReader(AUDIO_SAMPLE_RATE, AUDIO_BUFFER_LENGTH, micMQueue, getHWND());
+	}
 	this->addMessageListener(WM_MIC_STOPPED_READING, onMicStop, this);
 
 	// Create Elements
@@ -199,6 +214,8 @@ void ClientWindow::onCreate()
 	//voiceTargetLabel = new GuiLabel(hInst, topPanel);
 	voiceTargetInput = new GuiTextBox(hInst, topPanel, false);
 	micTargetButton = new GuiButton(hInst, topPanel, IDB_MIC_TOGGLE);
+	stationInput = new GuiTextBox(hInst, topPanel, false);
+	tuneButton = new GuiButton(hInst, topPanel, IDB_TUNE_STATION);
 	statusBar = new GuiStatusBar(hInst, this);
 	trackerPanel = new PlaybackTrackerPanel(hInst, this);
 	playButton = new ButtonPanel(hInst, seekPanel, playButtonUp, playButtonDown);
@@ -256,6 +273,13 @@ void ClientWindow::onCreate()
 	bottomSpacer->setBackgroundBrush(darkBackground);
 	layout->addComponent(bottomSpacer);
 
+	// Add Status Bar, showing the memory held by the music buffer and how long seeks take
+	int statusParts[] = { 480, -1 };
+	statusBar->init();
+	statusBar->setPreferredSize(0, 22);
+	statusBar->setParts(2, statusParts);
+	layout->addComponent(statusBar);
+
 	// Add Top Spacer
 	layout = (GuiLinearLayout*)topPanel->getLayoutManager();
 	layout->setHorizontal(true);
@@ -283,6 +307,19 @@ void ClientWindow::onCreate()
 	layout->addComponent(micTargetButton);
 	topPanel->addCommandListener(BN_CLICKED, onClickMic, this);
 
+	// Add Station Textbox
+	stationInput->init();
+	stationInput->enableCustomDrawing(false);
+	stationInput->setPreferredSize(40, 28);
+	stationInput->setText(L"0");
+	layout->addComponent(stationInput);
+
+	// Add Tune Button
+	tuneButton->init();
+	tuneButton->setText(L"Tune");
+	layout->addComponent(tuneButton);
+	topPanel->addCommandListener(BN_CLICKED, onClickTune, this);
+
 	// Create Play Button
 	playButton->init();
 	playButton->setClickListener(ClientWindow::onClickPlay);
@@ -319,53 +356,65 @@ void ClientWindow::onCreate()
 	layout->addComponent(stopButton);
 	layout->addComponent(buttonSpacer2);
 
-    // create all the buffers and stuff
-	JitterBuffer* musicJitBuf = new JitterBuffer(5000,100,AUDIO_BUFFER_LENGTH,50,0);
+    // create all the buffers and stuff; the music and every voice play
+    // through the one mixer
+	musicJitBuf = new JitterBuffer(5000,100,AUDIO_BUFFER_LENGTH,50,0);
+	MessageQueue* q2 = new MessageQueue(100,AUDIO_BUFFER_LENGTH);
+	mixer = new ClientMixer(q2);
 	
 	q1 = new MessageQueue(100,sizeof(LocalDataPacket));
 	udpSock = new UDPSocket(MULTICAST_PORT,q1);
 	udpSock->setGroup(MULTICAST_ADDR,1);
-	ReceiveThread* recvThread = new ReceiveThread(musicJitBuf,q1);
+	recvThread = new ReceiveThread(musicJitBuf,q1);
+	recvThread->setMixer(mixer);
+	recvThread->setVoiceDelay(lowLatencyVoice ? VOICE_LOW_LATENCY_JITTER_MS : VOICE_JITTER_MS);
 	recvThread->start();
 	
 
 	ClientControlThread * cct = ClientControlThread::getInstance();
 	cct->setClientWindow( this );
 
-	MessageQueue* q2 = new MessageQueue(100,AUDIO_BUFFER_LENGTH);
-	musicPlayer = new PlayWave(200,q2);
-	musicfile = new MusicBuffer(trackerPanel, musicPlayer);	
-	MusicBufferer* musicbuf = new MusicBufferer(musicJitBuf, musicfile);
+	musicfile = new MusicBuffer(trackerPanel, mixer);	
+	musicBufferer = new MusicBufferer(musicJitBuf, musicfile);
+	recvThread->setMusicBufferer(musicBufferer);
 	MusicReader* mreader = new MusicReader(q2, musicfile);
 	
-	musicPlayer->setVolume(0);
-	musicPlayer->startPlaying(AUDIO_SAMPLE_RATE, AUDIO_BITS_PER_SAMPLE, NUM_AUDIO_CHANNELS);
+	mixer->setVolume(0);
+	mixer->start();
 
      DWORD useless;
 	CreateThread(NULL, 0, MicThread, (void*)this, 0, &useless);
+
+	addMessageListener(WM_TIMER, refreshStats, this);
+	SetTimer(getHWND(), IDT_REFRESH_STATS, STATS_REFRESH_MS, NULL);
 	
 }
 
 void ClientWindow::startConnection()
 {
-	musicPlayer->setVolume(0xFFFF);
+	mixer->setVolume(0xFFFF);
 }
 
 void ClientWindow::onClickPlay(void*)
 {
 	curClientWindow->musicfile->resumeEnqueue();
-	curClientWindow->musicPlayer->resumePlaying();
 }
 void ClientWindow::onClickStop(void*)
 {
 	curClientWindow->musicfile->stopEnqueue();
-	curClientWindow->musicPlayer->stopPlaying();
+	curClientWindow->mixer->flushMusic();
 }
 
 bool ClientWindow::onClickMic(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval)
 {
 	ClientWindow *pThis = (ClientWindow*)_pThis;
 
+	// the other buttons of the top panel have their own listeners
+	if (id != IDB_MIC_TOGGLE)
+	{
+		return false;
+	}
+
 	if (!pThis->requestingRecorderStop)
 	{
 		if (pThis->recording)
@@ -399,6 +448,21 @@ bool ClientWindow::onClickMic(GuiComponent *_pThis, UINT command, UINT id, WPARA
 	return true;
 }
 
+bool ClientWindow::onClickTune(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval)
+{
+	ClientWindow *pThis = (ClientWindow*)_pThis;
+
+	if (id != IDB_TUNE_STATION)
+	{
+		return false;
+	}
+
+	// the server ignores stations it doesn't send
+	ClientControlThread::getInstance()->requestStation(_wtoi(pThis->stationInput->getText()));
+
+	return true;
+}
+
 bool ClientWindow::onMicStop(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval)
 {
 	ClientWindow *pThis = (ClientWindow*)_pThis;
@@ -417,7 +481,61 @@ bool ClientWindow::onSeek(GuiComponent *_pThis, UINT command, UINT id, WPARAM wP
 
 	double percent = ((double)wParam) / 1000.0;
 
-    pThis->musicfile->seekBuf(percent);
+	// have the server stream from positions that haven't been received
+	if (pThis->musicfile->isBuffered(percent))
+	{
+		pThis->musicfile->seekBuf(percent);
+	}
+	else
+	{
+		ClientControlThread::getInstance()->requestSeek(percent);
+	}
+
+	return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: refreshStats
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: bool refreshStats(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam,
+--		LPARAM lParam, INT_PTR *retval)
+--		GuiComponent *_pThis : the ClientWindow
+--		WPARAM wParam        : id of the timer that went off
+--
+-- RETURNS: true if the timer was the statistics refresh timer
+--
+-- NOTES:
+-- Shows how much of the current song the music buffer holds, and how much memory and disk it
+-- takes, in the status bar; and next to it, how long seeks took until the first audio from the
+-- new position, both within what was buffered and when the server had to stream it.
+-------------------------------------------------------------------------------------------------*/
+bool ClientWindow::refreshStats(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval)
+{
+	ClientWindow *pThis = (ClientWindow*)_pThis;
+
+	if (wParam != IDT_REFRESH_STATS)
+	{
+		return false;
+	}
+
+	MusicBufferStats stats;
+	pThis->musicfile->getStats(&stats);
+
+	wchar_t line[256];
+	swprintf(line, 256, L"music buffer: held %lu KB, mapped %lu KB, resident %llu KB, on disk %llu KB, released %lu KB",
+		stats.held / 1024, stats.mapped / 1024, stats.resident / 1024, stats.stored / 1024, stats.released / 1024);
+	pThis->statusBar->setText(0, line);
+
+	PlaybackLatency local, remote;
+	pThis->musicfile->getSeekLatency(&local, &remote);
+	swprintf(line, 256, L"seeks: buffered %d avg %.1f ms, streamed %d avg %.1f ms max %.1f ms",
+		local.count, local.count ? local.totalMs / local.count : 0.0,
+		remote.count, remote.count ? remote.totalMs / remote.count : 0.0, remote.maxMs);
+	pThis->statusBar->setText(1, line);
 
 	return true;
 }
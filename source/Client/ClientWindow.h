@@ -24,7 +24,12 @@
 #include "../GuiLibrary/GuiWindow.h"
 #include "Sockets.h"
 #include "../Common.h"
-#include "../Client/PlayWave.h"
+
+/*
+	Milliseconds between refreshes of the music buffer statistics in the
+	status bar.
+*/
+#define STATS_REFRESH_MS 1000
 
 class ConnectionWindow;
 class GuiPanel;
@@ -38,6 +43,10 @@ class GuiScrollList;
 class MessageQueue;
 class MicReader;
 class MusicBuffer;
+class MusicBufferer;
+class ClientMixer;
+class JitterBuffer;
+class ReceiveThread;
 class ClientControlThread;
 class ClientWindow;
 
@@ -56,8 +65,10 @@ private:
 	static void onClickPlay(void*);
 	static void onClickStop(void*);
 	static bool onClickMic(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
+	static bool onClickTune(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
 	static bool onMicStop(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
 	static bool onSeek(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
+	static bool refreshStats(GuiComponent *_pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
 	static DWORD WINAPI MicThread(LPVOID lpParameter);
 	DWORD ThreadStart(void);
 
@@ -66,11 +77,18 @@ private:
 
 	char voiceTargetAddress[STR_LEN];
 
+	// true to capture, send and play voice in frames of
+	// VOICE_LOW_LATENCY_FRAME_MS, for conversation; full packets otherwise
+	bool lowLatencyVoice;
+
 	DataPacket voicePacket;
 	MessageQueue *micMQueue;
 	MicReader *micReader;
 	MusicBuffer* musicfile;
-	PlayWave* musicPlayer;
+	MusicBufferer* musicBufferer;
+	ClientMixer* mixer;
+	JitterBuffer* musicJitBuf;
+	ReceiveThread* recvThread;
 
 	HBITMAP playButtonUp;
 	HBITMAP playButtonDown;
@@ -91,6 +109,8 @@ private:
 	GuiPanel *seekPanel;
 	GuiLabel *micTargetLabel;
 	GuiButton *micTargetButton;
+	GuiTextBox *stationInput;
+	GuiButton *tuneButton;
 	GuiStatusBar *statusBar;
 	PlaybackTrackerPanel *trackerPanel;
 	GuiPanel *buttonSpacer1;
@@ -0,0 +1,568 @@
+/*-----------------------------------------------------------------------------
+-- SOURCE FILE: DownloadSink.cpp - This file provides a buffered writer for
+-- files that are being downloaded.
+--
+-- PUBLIC FUNCTIONS:
+-- bool isOpen();
+-- bool contains(unsigned long start, unsigned long end);
+-- bool gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end);
+-- void write(unsigned long offset, const char *data, unsigned long len);
+-- bool read(unsigned long offset, char *data, unsigned long len);
+-- char *getBuffer();
+-- void submit(char *buffer, unsigned long offset, unsigned long len);
+-- void sync();
+-- bool finish();
+-- void release();
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- NOTES:
+-- The file is preallocated to its final size when it is opened. Data is
+-- collected in large page-aligned buffers that are written by a dedicated
+-- I/O thread, so the threads receiving the data never wait on the disk.
+-- The written ranges are saved to the download's sidecar at most once every
+-- DOWNLOAD_SINK_SAVE_INTERVAL, and the file is only flushed to disk once,
+-- when the download finishes.
+-----------------------------------------------------------------------------*/
+
+#include "DownloadSink.h"
+
+/*
+	Message types used on the queue of the I/O thread.
+*/
+#define SINK_WRITE 1
+#define SINK_STOP 2
+#define SINK_RELEASE 3
+
+/*
+	A buffer waiting to be written by the I/O thread. {runs} holds the ranges
+	[start, end) of the file that were copied into a buffer filled by write,
+	if they don't make one range starting at {offset}; otherwise it is NULL,
+	and the first {len} bytes of the buffer are written.
+*/
+struct PendingWrite
+{
+	char *buffer;
+	unsigned long offset;
+	unsigned long len;
+	std::vector<std::pair<unsigned long, unsigned long>> *runs;
+};
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: DownloadSink
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: DownloadSink(const char *path, unsigned long size)
+--		const char *path   : path of the file being downloaded.
+--		unsigned long size : final size of the file.
+--
+-- NOTES: Opens the file, keeping whatever a previous download recorded in the sidecar, and
+-- preallocates it to its final size so the file system can lay it out in one piece.
+-------------------------------------------------------------------------------------------------*/
+DownloadSink::DownloadSink(const char *path, unsigned long size)
+	: size(size)
+	, partPath(std::string(path) + PART_FILE_EXTENSION)
+	, lastSave(GetTickCount())
+	, unsaved(false)
+	, access(CreateMutex(NULL, FALSE, NULL))
+	, writes(DOWNLOAD_SINK_BUFFERS + 1, sizeof(PendingWrite))
+	, current(NULL)
+	, currentOffset(0)
+	, currentLen(0)
+	, currentRuns(NULL)
+	, failed(false)
+	, finished(false)
+{
+	// Keep whatever a previous download left on disk
+	file = INVALID_HANDLE_VALUE;
+	if (ranges.load(partPath.c_str()))
+	{
+		file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, NULL);
+	}
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		ranges.clear();
+		file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL, NULL);
+	}
+
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		// Preallocate the file
+		LARGE_INTEGER end;
+		end.QuadPart = size;
+		if (SetFilePointerEx(file, end, NULL, FILE_BEGIN))
+		{
+			SetEndOfFile(file);
+		}
+
+		// Create the sidecar now, so a dropped connection can be resumed
+		ranges.save(partPath.c_str());
+	}
+	else
+	{
+		failed = true;
+	}
+
+	// Page-aligned buffers for the I/O thread
+	memory = (char*) VirtualAlloc(NULL, DOWNLOAD_SINK_BUFFERS * DOWNLOAD_SINK_BUFFER_SIZE,
+		MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	for (int i = 0; i < DOWNLOAD_SINK_BUFFERS; ++i)
+	{
+		freeBuffers.push_back(memory + i * DOWNLOAD_SINK_BUFFER_SIZE);
+	}
+	bufferAvailable = CreateSemaphore(NULL, DOWNLOAD_SINK_BUFFERS, DOWNLOAD_SINK_BUFFERS, NULL);
+
+	thread = CreateThread(NULL, 0, IoThread, this, 0, NULL);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: ~DownloadSink
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: ~DownloadSink()
+--
+-- NOTES: Finishes the download if that has not been done yet, and frees the buffers.
+-------------------------------------------------------------------------------------------------*/
+DownloadSink::~DownloadSink()
+{
+	finish();
+	VirtualFree(memory, 0, MEM_RELEASE);
+	CloseHandle(bufferAvailable);
+	CloseHandle(thread);
+	CloseHandle(access);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: isOpen
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: isOpen()
+--
+-- NOTES: Returns false if the file could not be opened.
+-------------------------------------------------------------------------------------------------*/
+bool DownloadSink::isOpen()
+{
+	return file != INVALID_HANDLE_VALUE;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: contains
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: contains(unsigned long start, unsigned long end)
+--		unsigned long start : first byte of the range
+--		unsigned long end   : one past the last byte of the range
+--
+-- NOTES: Returns true if the range has already been written to the file, either by this
+-- download or by an earlier one.
+-------------------------------------------------------------------------------------------------*/
+bool DownloadSink::contains(unsigned long start, unsigned long end)
+{
+	WaitForSingleObject(access, INFINITE);
+	bool contained = ranges.contains(start, end);
+	ReleaseMutex(access);
+	return contained;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: gapIn
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end)
+--		unsigned long from   : first byte to look at
+--		unsigned long to     : one past the last byte to look at
+--		unsigned long *start : set to the first byte that has not been written
+--		unsigned long *end   : set to one past the last byte of the gap
+--
+-- NOTES: Find the first range inside [from, to) that has not been written to the file yet.
+-- Returns false if all of it has.
+-------------------------------------------------------------------------------------------------*/
+bool DownloadSink::gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end)
+{
+	WaitForSingleObject(access, INFINITE);
+	bool found = ranges.gapIn(from, to, start, end);
+	ReleaseMutex(access);
+	return found;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: write
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Collect data that skips over holes in the same buffer.
+--
+-- INTERFACE: write(unsigned long offset, const char *data, unsigned long len)
+--		unsigned long offset : offset into the file the data belongs at.
+--		const char *data     : the data.
+--		unsigned long len    : number of bytes of data.
+--
+-- NOTES: Copies the data into the sink's current buffer, which stands for the
+-- DOWNLOAD_SINK_BUFFER_SIZE bytes of the file from where its first data belongs. Data anywhere
+-- in that window is collected in the buffer, even if it leaves holes, so data that arrives with
+-- gaps, like the blocks of a carousel, is still written in large batches. The buffer is handed
+-- to the I/O thread once data reaches the end of its window, or when data arrives outside it.
+-- Only one thread may use write at a time.
+-------------------------------------------------------------------------------------------------*/
+void DownloadSink::write(unsigned long offset, const char *data, unsigned long len)
+{
+	while (len > 0)
+	{
+		if (current && (offset < currentOffset || offset - currentOffset >= DOWNLOAD_SINK_BUFFER_SIZE))
+		{
+			flushCurrent();
+		}
+		if (!current)
+		{
+			current = getBuffer();
+			currentOffset = offset;
+			currentLen = 0;
+			currentRuns = new std::vector<std::pair<unsigned long, unsigned long>>;
+		}
+
+		unsigned long at = offset - currentOffset;
+		unsigned long copied = min(len, DOWNLOAD_SINK_BUFFER_SIZE - at);
+		memcpy(current + at, data, copied);
+		if (!currentRuns->empty() && currentRuns->back().second == offset)
+		{
+			currentRuns->back().second += copied;
+		}
+		else
+		{
+			currentRuns->push_back(std::make_pair(offset, offset + copied));
+		}
+		currentLen = max(currentLen, at + copied);
+		offset += copied;
+		data += copied;
+		len -= copied;
+
+		if (at + copied == DOWNLOAD_SINK_BUFFER_SIZE)
+		{
+			flushCurrent();
+		}
+	}
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: read
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: read(unsigned long offset, char *data, unsigned long len)
+--		unsigned long offset : offset into the file to read from.
+--		char *data           : set to the data.
+--		unsigned long len    : number of bytes to read.
+--
+-- NOTES: Reads back part of the file. Only ranges that contains says are in the file can be read;
+-- data handed to the sink since it was opened may still be waiting to be written. Returns false
+-- if the data could not be read.
+-------------------------------------------------------------------------------------------------*/
+bool DownloadSink::read(unsigned long offset, char *data, unsigned long len)
+{
+	OVERLAPPED position;
+	DWORD bytesRead;
+
+	memset(&position, 0, sizeof(position));
+	position.Offset = offset;
+	return ReadFile(file, data, len, &bytesRead, &position) && bytesRead == len;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: getBuffer
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: getBuffer()
+--
+-- NOTES: Takes one of the sink's free buffers, waiting for the I/O thread to free one up if
+-- there are none. The buffer is DOWNLOAD_SINK_BUFFER_SIZE bytes long, and must be handed back
+-- with submit.
+-------------------------------------------------------------------------------------------------*/
+char *DownloadSink::getBuffer()
+{
+	WaitForSingleObject(bufferAvailable, INFINITE);
+
+	WaitForSingleObject(access, INFINITE);
+	char *buffer = freeBuffers.back();
+	freeBuffers.pop_back();
+	ReleaseMutex(access);
+
+	return buffer;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: submit
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: submit(char *buffer, unsigned long offset, unsigned long len)
+--		char *buffer         : a buffer taken with getBuffer.
+--		unsigned long offset : offset into the file the data in the buffer belongs at.
+--		unsigned long len    : number of bytes of data in the buffer; 0 to just give it back.
+--
+-- NOTES: Hands a buffer to the I/O thread, which writes it to the file and then frees it.
+-------------------------------------------------------------------------------------------------*/
+void DownloadSink::submit(char *buffer, unsigned long offset, unsigned long len)
+{
+	if (len == 0)
+	{
+		WaitForSingleObject(access, INFINITE);
+		freeBuffers.push_back(buffer);
+		ReleaseMutex(access);
+		ReleaseSemaphore(bufferAvailable, 1, NULL);
+		return;
+	}
+
+	PendingWrite pending;
+	pending.buffer = buffer;
+	pending.offset = offset;
+	pending.len = len;
+	pending.runs = NULL;
+	writes.enqueue(SINK_WRITE, &pending);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: sync
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: sync()
+--
+-- NOTES: Waits for everything handed to the sink so far to reach the file, so contains and gapIn
+-- know about it. Every buffer taken with getBuffer must have been handed back first.
+-------------------------------------------------------------------------------------------------*/
+void DownloadSink::sync()
+{
+	flushCurrent();
+
+	// The I/O thread is idle once it has given every buffer back
+	for (int i = 0; i < DOWNLOAD_SINK_BUFFERS; ++i)
+	{
+		WaitForSingleObject(bufferAvailable, INFINITE);
+	}
+	ReleaseSemaphore(bufferAvailable, DOWNLOAD_SINK_BUFFERS, NULL);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: finish
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: finish()
+--
+-- NOTES: Writes out everything that was handed to the sink, and closes the file. If the whole
+-- file is there, it is flushed to disk and the sidecar is deleted; otherwise the sidecar is
+-- brought up to date and kept so the download can be resumed. Returns true if the whole file was written.
+-------------------------------------------------------------------------------------------------*/
+bool DownloadSink::finish()
+{
+	if (finished)
+		return !failed;
+
+	// Let the I/O thread write everything out
+	flushCurrent();
+	writes.enqueue(SINK_STOP, NULL, 0);
+	WaitForSingleObject(thread, INFINITE);
+
+	return closeFile();
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: release
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: release()
+--
+-- NOTES: Finishes the download like finish, but on the I/O thread, which then deletes the sink;
+-- the caller never waits for the writes or the flush to disk, and must not use the sink again.
+-------------------------------------------------------------------------------------------------*/
+void DownloadSink::release()
+{
+	flushCurrent();
+	writes.enqueue(SINK_RELEASE, NULL, 0);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: closeFile
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: closeFile()
+--
+-- NOTES: Closes the file once everything has been written. If the whole file is there, it is
+-- flushed to disk and the sidecar is deleted; otherwise the sidecar is brought up to date. Returns
+-- true if the whole file was written.
+-------------------------------------------------------------------------------------------------*/
+bool DownloadSink::closeFile()
+{
+	bool complete = !failed && ranges.covers(size);
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		if (complete)
+		{
+			FlushFileBuffers(file);
+		}
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+	if (complete)
+	{
+		DeleteFileA(partPath.c_str());
+	}
+	else if (unsaved)
+	{
+		ranges.save(partPath.c_str());
+		unsaved = false;
+	}
+
+	failed = !complete;
+	finished = true;
+	return complete;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: flushCurrent
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: flushCurrent()
+--
+-- NOTES: Hands the buffer that write is filling to the I/O thread, along with the ranges of it
+-- that hold data if there are holes in it.
+-------------------------------------------------------------------------------------------------*/
+void DownloadSink::flushCurrent()
+{
+	if (!current)
+		return;
+
+	PendingWrite pending;
+	pending.buffer = current;
+	pending.offset = currentOffset;
+	pending.len = currentLen;
+	pending.runs = currentRuns;
+	if (currentRuns->size() == 1)
+	{
+		delete currentRuns;
+		pending.runs = NULL;
+	}
+	writes.enqueue(SINK_WRITE, &pending);
+
+	current = NULL;
+	currentRuns = NULL;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: IoThread
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Save the sidecar at most every DOWNLOAD_SINK_SAVE_INTERVAL.
+--		October 18, 2026 - Finish and delete released sinks.
+--		October 18, 2026 - Write only the ranges of a buffer that hold data.
+--
+-- INTERFACE: IoThread(LPVOID sink)
+--		LPVOID sink : the DownloadSink to write for.
+--
+-- NOTES: Writes the submitted buffers to their offsets in the file one after the other, records
+-- each one in the ranges once it has been written, and frees the buffer. The sidecar is rewritten
+-- from the ranges at most once every DOWNLOAD_SINK_SAVE_INTERVAL; finish saves what is left.
+-- Stops when finish is called, or closes the file and deletes the sink when release is called.
+-------------------------------------------------------------------------------------------------*/
+DWORD WINAPI DownloadSink::IoThread(LPVOID sink)
+{
+	DownloadSink *pThis = (DownloadSink*) sink;
+	PendingWrite pending;
+	int type;
+
+	while (true)
+	{
+		pThis->writes.dequeue(&type, &pending);
+		if (type == SINK_STOP)
+			break;
+
+		if (type == SINK_RELEASE)
+		{
+			pThis->closeFile();
+			delete pThis;
+			break;
+		}
+
+		// A buffer filled by write may have holes; only the ranges holding data are written
+		std::vector<std::pair<unsigned long, unsigned long>> whole(1,
+			std::make_pair(pending.offset, pending.offset + pending.len));
+		std::vector<std::pair<unsigned long, unsigned long>> *runs = pending.runs ? pending.runs : &whole;
+		bool ok = true;
+		for (size_t i = 0; i < runs->size() && ok; ++i)
+		{
+			OVERLAPPED position;
+			DWORD written;
+			DWORD len = (*runs)[i].second - (*runs)[i].first;
+			memset(&position, 0, sizeof(position));
+			position.Offset = (*runs)[i].first;
+			ok = WriteFile(pThis->file, pending.buffer + ((*runs)[i].first - pending.offset), len,
+				&written, &position) && written == len;
+		}
+
+		WaitForSingleObject(pThis->access, INFINITE);
+		if (ok)
+		{
+			for (size_t i = 0; i < runs->size(); ++i)
+			{
+				pThis->ranges.add((*runs)[i].first, (*runs)[i].second);
+			}
+			pThis->unsaved = true;
+			if (GetTickCount() - pThis->lastSave >= DOWNLOAD_SINK_SAVE_INTERVAL)
+			{
+				pThis->ranges.save(pThis->partPath.c_str());
+				pThis->lastSave = GetTickCount();
+				pThis->unsaved = false;
+			}
+		}
+		else
+		{
+			pThis->failed = true;
+		}
+		pThis->freeBuffers.push_back(pending.buffer);
+		ReleaseMutex(pThis->access);
+		ReleaseSemaphore(pThis->bufferAvailable, 1, NULL);
+		delete pending.runs;
+	}
+
+	return 0;
+}
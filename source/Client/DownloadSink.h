@@ -0,0 +1,117 @@
+/*-----------------------------------------------------------------------------
+-- SOURCE FILE: DownloadSink.h - This file provides a buffered writer for
+-- files that are being downloaded.
+--
+-- PUBLIC FUNCTIONS:
+-- bool isOpen();
+-- bool contains(unsigned long start, unsigned long end);
+-- bool gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end);
+-- void write(unsigned long offset, const char *data, unsigned long len);
+-- bool read(unsigned long offset, char *data, unsigned long len);
+-- char *getBuffer();
+-- void submit(char *buffer, unsigned long offset, unsigned long len);
+-- void sync();
+-- bool finish();
+-- void release();
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- NOTES:
+-- The file is preallocated to its final size when it is opened. Data is
+-- collected in large page-aligned buffers that are written by a dedicated
+-- I/O thread, so the threads receiving the data never wait on the disk.
+-- The written ranges are recorded in the download's sidecar at most once
+-- every DOWNLOAD_SINK_SAVE_INTERVAL, and when the download finishes; the file
+-- is only flushed to disk once, when the download finishes.
+-----------------------------------------------------------------------------*/
+
+#ifndef _DOWNLOAD_SINK_H_
+#define _DOWNLOAD_SINK_H_
+
+#include "../common.h"
+#include "../Buffer/MessageQueue.h"
+#include "FileRanges.h"
+#include <string>
+#include <vector>
+
+/*
+	Size of each of the buffers data is collected in before it is written.
+*/
+#define DOWNLOAD_SINK_BUFFER_SIZE (1024*1024)
+
+/*
+	Number of buffers a DownloadSink owns. Receivers wait for a free buffer
+	once this many are waiting to be written, so a slow disk slows down the
+	download instead of using more memory.
+*/
+#define DOWNLOAD_SINK_BUFFERS 8
+
+/*
+	Milliseconds between writes of the sidecar. A download that is dropped
+	loses at most what was written in this time, which it fetches again.
+*/
+#define DOWNLOAD_SINK_SAVE_INTERVAL 1000
+
+/*-----------------------------------------------------------------------------
+-- CLASS: DownloadSink
+--
+-- DESCRIPTION: Writes a downloaded file in the background. Data can be handed
+-- over with write, which copies it into the sink's own buffer, or received
+-- straight into a buffer taken with getBuffer and handed back with submit.
+-- The sink deletes the sidecar once the whole file is on disk.
+-----------------------------------------------------------------------------*/
+class DownloadSink
+{
+	public:
+		/* CONSTRUCTORS/DESTRUCTORS */
+		DownloadSink(const char *path, unsigned long size);
+		~DownloadSink();
+
+		/* PUBLIC MEMBER METHODS */
+		bool isOpen();
+		bool contains(unsigned long start, unsigned long end);
+		bool gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end);
+		void write(unsigned long offset, const char *data, unsigned long len);
+		bool read(unsigned long offset, char *data, unsigned long len);
+		char *getBuffer();
+		void submit(char *buffer, unsigned long offset, unsigned long len);
+		void sync();
+		bool finish();
+		void release();
+
+	private:
+		/* PRIVATE STATIC MEMBER METHODS */
+		static DWORD WINAPI IoThread(LPVOID sink);
+
+		/* PRIVATE MEMBER METHODS */
+		void flushCurrent();
+		bool closeFile();
+
+		/* PRIVATE MEMBER DATA */
+		HANDLE file;
+		unsigned long size;
+		std::string partPath;
+		FileRanges ranges;
+		DWORD lastSave;
+		bool unsaved;
+		HANDLE access;
+
+		MessageQueue writes;
+		HANDLE thread;
+
+		std::vector<char*> freeBuffers;
+		HANDLE bufferAvailable;
+		char *memory;
+
+		char *current;
+		unsigned long currentOffset;
+		unsigned long currentLen;
+		std::vector<std::pair<unsigned long, unsigned long>> *currentRuns;
+
+		bool failed;
+		bool finished;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include "DriftCompensator.h"
+#include <string.h>
+
+// static function forward declarations
+
+static double clampPpm(double ppm);
+
+// drift compensator implementation
+
+DriftCompensator::DriftCompensator()
+{
+    memset(&stats,0,sizeof(stats));
+    reset();
+    stats.resets = 0;
+}
+
+/**
+ * starts over, when the music buffered no longer follows on from what was
+ *   measured; after a seek, or a change of format. the target is measured
+ *   again once the compensator has settled. the drift is a property of the
+ *   clocks, so the last estimate of it goes on being corrected for until
+ *   there is a new one.
+ *
+ * @date     2026-10-18
+ */
+void DriftCompensator::reset()
+{
+    intervalMs  = 0;
+    depthSum    = 0;
+    depthCount  = 0;
+    correctedMs = 0;
+    first       = 0;
+    count       = 0;
+    intervals   = 0;
+    targetSum   = 0;
+
+    stats.correctionPpm = stats.driftPpm;
+    stats.depthMs       = 0;
+    stats.targetMs      = 0;
+    stats.maxErrorMs    = 0;
+    stats.playedMs      = 0;
+    ++stats.resets;
+}
+
+/**
+ * measures the music buffered, once every period played.
+ *
+ * @date     2026-10-18
+ *
+ * @param    elapsedMs   milliseconds of audio played since the last call; the
+ *   length of a period.
+ * @param    depthMs   milliseconds of music buffered that hasn't been played.
+ *
+ * @return   parts per million to play the music faster by; negative to play
+ *   it slower.
+ */
+double DriftCompensator::update(double elapsedMs, double depthMs)
+{
+    stats.playedMs += elapsedMs;
+    correctedMs    += elapsedMs*stats.correctionPpm/1000000;
+    intervalMs     += elapsedMs;
+    depthSum       += depthMs;
+    ++depthCount;
+
+    if(intervalMs >= DRIFT_INTERVAL_MS)
+    {
+        _endInterval();
+    }
+    return stats.correctionPpm;
+}
+
+void DriftCompensator::getStats(DriftStats* stats)
+{
+    *stats = this->stats;
+}
+
+/**
+ * adds the average depth of the interval to the window, and works out the
+ *   correction from then on; the drift, plus what makes up the difference
+ *   from the target over {DRIFT_CONVERGE_MS}.
+ *
+ * @date     2026-10-18
+ */
+void DriftCompensator::_endInterval()
+{
+    double depth = depthSum/depthCount;
+    intervalMs = 0;
+    depthSum   = 0;
+    depthCount = 0;
+
+    // nothing was buffered for a whole interval, so the stream has stopped;
+    // the intervals it took to drain say nothing about the clocks
+    if(depth <= 0)
+    {
+        if(intervals > 0)
+        {
+            stats.driftPpm = 0;
+            reset();
+        }
+        return;
+    }
+    stats.depthMs = depth;
+
+    int last = (first+count)%DRIFT_WINDOW_INTERVALS;
+    if(count == DRIFT_WINDOW_INTERVALS)
+    {
+        first = (first+1)%DRIFT_WINDOW_INTERVALS;
+    }
+    else
+    {
+        ++count;
+    }
+    times[last]  = stats.playedMs;
+    depths[last] = depth+correctedMs;
+
+    // the target is the depth over the first few intervals
+    if(++intervals <= DRIFT_SETTLE_INTERVALS)
+    {
+        targetSum += depth;
+        if(intervals == DRIFT_SETTLE_INTERVALS)
+        {
+            stats.targetMs = targetSum/DRIFT_SETTLE_INTERVALS;
+        }
+        return;
+    }
+
+    double error = depth-stats.targetMs;
+    if(error > stats.maxErrorMs || -error > stats.maxErrorMs)
+    {
+        stats.maxErrorMs = error < 0 ? -error : error;
+    }
+
+    if(count >= DRIFT_MIN_INTERVALS)
+    {
+        stats.driftPpm = _estimateDrift();
+    }
+    stats.correctionPpm = clampPpm(stats.driftPpm+error*1000000/DRIFT_CONVERGE_MS);
+}
+
+/**
+ * fits a line through the depths in the window, as they would have been
+ *   without any correction, by least squares.
+ *
+ * @date     2026-10-18
+ *
+ * @return   slope of the line in parts per million.
+ */
+double DriftCompensator::_estimateDrift()
+{
+    double meanTime  = 0;
+    double meanDepth = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        int j = (first+i)%DRIFT_WINDOW_INTERVALS;
+        meanTime  += times[j];
+        meanDepth += depths[j];
+    }
+    meanTime  /= count;
+    meanDepth /= count;
+
+    double covariance = 0;
+    double variance   = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        int j = (first+i)%DRIFT_WINDOW_INTERVALS;
+        covariance += (times[j]-meanTime)*(depths[j]-meanDepth);
+        variance   += (times[j]-meanTime)*(times[j]-meanTime);
+    }
+    return variance > 0 ? clampPpm(covariance/variance*1000000) : 0;
+}
+
+// static function implementations
+
+double clampPpm(double ppm)
+{
+    return ppm > DRIFT_MAX_PPM ? DRIFT_MAX_PPM : ppm < -DRIFT_MAX_PPM ? -DRIFT_MAX_PPM : ppm;
+}
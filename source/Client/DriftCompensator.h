@@ -0,0 +1,131 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: DriftCompensator.h
+--
+-- NOTES:
+-- The server paces the music it sends by its own clock, while
+-- the client plays it at the rate of its sound card; the two
+-- are never quite the same, so over a long song the music
+-- buffered on the client slowly grows, or drains until it runs
+-- dry.
+--
+-- The {DriftCompensator} is told, once every period played,
+-- how much music is buffered. It averages that over intervals
+-- of {DRIFT_INTERVAL_MS}, and fits a line through the last
+-- {DRIFT_WINDOW_INTERVALS} of them; the slope of the line is
+-- the drift between the clocks. The music is then played that
+-- much faster or slower, plus a little more to pull the depth
+-- back to the target, which is the depth it had when the
+-- compensator settled.
+--
+-- Time is measured in audio played, so the drift is relative
+-- to the sound card's clock. Nothing here depends on the
+-- platform.
+--------------------------------------------------------------*/
+#ifndef DRIFTCOMPENSATOR_H
+#define DRIFTCOMPENSATOR_H
+
+/**
+ * milliseconds the depth is averaged over, and the number of those
+ *   averages the drift is estimated from; a long window keeps the jitter of
+ *   the network out of the estimate.
+ */
+#define DRIFT_INTERVAL_MS 1000
+#define DRIFT_WINDOW_INTERVALS 300
+
+/**
+ * intervals averaged for the target depth after a reset, and the fewest
+ *   intervals the drift is estimated from.
+ */
+#define DRIFT_SETTLE_INTERVALS 5
+#define DRIFT_MIN_INTERVALS 10
+
+/**
+ * milliseconds over which a difference from the target depth is made up,
+ *   and the most the rate is ever changed by, in parts per million; both
+ *   keep the change of pitch far below what can be heard.
+ */
+#define DRIFT_CONVERGE_MS 60000
+#define DRIFT_MAX_PPM 5000
+
+/**
+ * state of a {DriftCompensator}.
+ *
+ * {driftPpm}; parts per million the music arrives faster than it is played;
+ *   negative if it arrives slower
+ *
+ * {correctionPpm}; parts per million the music is played faster by; negative
+ *   if slower
+ *
+ * {depthMs}; milliseconds of music buffered over the last interval
+ *
+ * {targetMs}; milliseconds of music the compensator keeps buffered; 0 until
+ *   it has settled
+ *
+ * {maxErrorMs}; furthest the depth has been from the target since it
+ *   settled
+ *
+ * {playedMs}; milliseconds of music played since the last reset
+ *
+ * {resets}; times the compensator started over
+ */
+struct DriftStats
+{
+    double driftPpm;
+    double correctionPpm;
+    double depthMs;
+    double targetMs;
+    double maxErrorMs;
+    double playedMs;
+    unsigned long resets;
+};
+
+class DriftCompensator
+{
+public:
+    DriftCompensator();
+    void reset();
+    double update(double elapsedMs, double depthMs);
+    void getStats(DriftStats* stats);
+
+private:
+    void _endInterval();
+    double _estimateDrift();
+
+    /**
+     * time played, and the sum and number of depths measured, in the current
+     *   interval.
+     */
+    double intervalMs;
+    double depthSum;
+    int depthCount;
+
+    /**
+     * milliseconds of music played because of the correction, on top of what
+     *   would have been played at the nominal rate; added to each depth, it
+     *   gives the depth there would have been without any correction.
+     */
+    double correctedMs;
+
+    /**
+     * time at the end of each interval in the window, and the depth there
+     *   would have been without any correction, oldest first from {first}.
+     */
+    double times[DRIFT_WINDOW_INTERVALS];
+    double depths[DRIFT_WINDOW_INTERVALS];
+    int first;
+    int count;
+
+    /**
+     * intervals since the last reset, and the sum of the depths of the ones
+     *   used for the target.
+     */
+    int intervals;
+    double targetSum;
+
+    /**
+     * current estimate, correction, and statistics.
+     */
+    DriftStats stats;
+};
+
+#endif
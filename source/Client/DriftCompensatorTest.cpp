@@ -0,0 +1,188 @@
+#include "DriftCompensator.h"
+#include "AudioMixer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TEST_DRIFT_COMPENSATOR
+
+/**
+ * test of the DriftCompensator, with the {PcmSource} it drives. it uses
+ *   nothing but those, so it runs without an audio device, on any platform.
+ *
+ * hours of a stream of 44100 Hz 16 bit stereo are simulated, a period at a
+ *   time, for clocks that drift apart by different amounts. the server sends
+ *   a packet every {PACKET_BYTES} by its clock, and each one arrives late by
+ *   up to {JITTER_MS}; the client starts playing once {PREBUFFER_MS} has
+ *   arrived, and reads a period from the source by the clock of the sound
+ *   card, which is what time is counted in. every period, the compensator is
+ *   told how much is buffered, and the source is made to drift by what it
+ *   says.
+ *
+ * reports, for each drift, the estimate of it, the target depth, how far the
+ *   depth strayed from it once settled, the most the rate was changed by,
+ *   and the times the source ran dry; and, for comparison, where the depth
+ *   ends up without the compensator. fails if the estimate is off by more
+ *   than {MAX_ESTIMATE_ERROR_PPM}, the depth strays by more than
+ *   {MAX_DEPTH_ERROR_MS}, or the source ever runs dry.
+ */
+
+#define HOURS 4
+#define RATE 44100
+#define CHANNELS 2
+#define BYTES_PER_FRAME 4
+#define PACKET_BYTES 256
+#define JITTER_MS 30
+#define PREBUFFER_MS 200
+#define SETTLE_MS (10*60*1000)
+#define MAX_ESTIMATE_ERROR_PPM 2
+#define MAX_DEPTH_ERROR_MS 15
+
+/**
+ * a stream that hands over the bytes that have arrived.
+ */
+class StreamSource : public PcmSource
+{
+public:
+    StreamSource() : PcmSource(RATE,16,CHANNELS), arrived(0), handed(0)
+    {
+        for(int i = 0; i < (int) (sizeof(tone)/sizeof(tone[0])); ++i)
+        {
+            tone[i] = (short) (sin(i*0.05)*8000);
+        }
+    }
+
+    /**
+     * bytes that have arrived, and haven't been handed over.
+     */
+    double buffered()
+    {
+        return (double) (arrived-handed);
+    }
+
+    unsigned long long arrived;
+
+protected:
+    virtual int fill(char* dest, int len)
+    {
+        int n = (int) (arrived-handed < (unsigned long long) len ? arrived-handed : len);
+        for(int i = 0; i < n; i += 2)
+        {
+            memcpy(dest+i,&tone[(handed+i)/2%(sizeof(tone)/sizeof(tone[0]))],sizeof(short));
+        }
+        handed += n;
+        return n;
+    }
+
+    unsigned long long handed;
+    short tone[4096];
+};
+
+struct Result
+{
+    DriftStats stats;
+    double maxErrorMs;
+    double maxCorrectionPpm;
+    double endDepthMs;
+    unsigned long dry;
+};
+
+/**
+ * simulates {HOURS} of the stream.
+ *
+ * @param    driftPpm   parts per million the server's clock is faster than the
+ *   sound card's.
+ * @param    compensate   whether to use the compensator.
+ */
+Result simulate(double driftPpm, bool compensate)
+{
+    StreamSource* source = new StreamSource();
+    DriftCompensator compensator;
+    Result result;
+    memset(&result,0,sizeof(result));
+
+    double bytesPerMs = (double) RATE*BYTES_PER_FRAME/1000;
+    double packetMs = PACKET_BYTES/bytesPerMs/(1+driftPpm/1000000);
+    double periodMs = (double) MIXER_PERIOD_FRAMES*1000/RATE;
+    double endMs = HOURS*3600.0*1000;
+
+    static short period[MIXER_PERIOD_FRAMES*CHANNELS];
+    unsigned long long packet = 0;
+    double lastArrival = 0;
+    double nextArrival = 0;
+    double now = 0;
+    bool playing = false;
+    srand(50);
+
+    while(now < endMs)
+    {
+        // packets arrive in order, each late by up to the jitter
+        while(nextArrival <= now)
+        {
+            source->arrived += PACKET_BYTES;
+            lastArrival = nextArrival;
+            double late = (double) rand()/RAND_MAX*JITTER_MS;
+            nextArrival = ++packet*packetMs+late;
+            nextArrival = nextArrival > lastArrival ? nextArrival : lastArrival;
+        }
+        playing = playing || source->buffered() >= PREBUFFER_MS*bytesPerMs;
+
+        if(playing)
+        {
+            double depthMs = source->buffered()/bytesPerMs;
+            if(compensate)
+            {
+                double ppm = compensator.update(periodMs,depthMs);
+                source->setDrift(ppm);
+                result.maxCorrectionPpm = fabs(ppm) > result.maxCorrectionPpm
+                    ? fabs(ppm) : result.maxCorrectionPpm;
+            }
+            if(source->read(period,MIXER_PERIOD_FRAMES,RATE,CHANNELS) < MIXER_PERIOD_FRAMES)
+            {
+                ++result.dry;
+            }
+
+            DriftStats stats;
+            compensator.getStats(&stats);
+            double error = fabs(stats.depthMs-stats.targetMs);
+            if(stats.playedMs >= SETTLE_MS && error > result.maxErrorMs)
+            {
+                result.maxErrorMs = error;
+            }
+            result.endDepthMs = depthMs;
+        }
+        now += periodMs;
+    }
+
+    compensator.getStats(&result.stats);
+    delete source;
+    return result;
+}
+
+int main(void)
+{
+    int failed = 0;
+    double drifts[] = {0,25,-25,80,-80,300,-300};
+
+    printf("%d hours of %d Hz stereo, packets late by up to %d ms, %d ms buffered to start\n",
+        HOURS,RATE,JITTER_MS,PREBUFFER_MS);
+    for(int d = 0; d < (int) (sizeof(drifts)/sizeof(drifts[0])); ++d)
+    {
+        Result on  = simulate(drifts[d],true);
+        Result off = simulate(drifts[d],false);
+
+        bool ok = fabs(on.stats.driftPpm-drifts[d]) <= MAX_ESTIMATE_ERROR_PPM
+            && on.maxErrorMs <= MAX_DEPTH_ERROR_MS && on.dry == 0;
+        failed += !ok;
+
+        printf("drift %+5.0f ppm: estimated %+8.2f ppm, target %6.1f ms, off by at most %5.1f ms "
+            "after %d min, rate changed by at most %5.0f ppm, %lu dry; "
+            "uncompensated ends at %7.1f ms, %lu dry %s\n",
+            drifts[d],on.stats.driftPpm,on.stats.targetMs,on.maxErrorMs,SETTLE_MS/60000,
+            on.maxCorrectionPpm,on.dry,off.endDepthMs,off.dry,ok ? "" : "FAILED");
+    }
+
+    return failed != 0;
+}
+
+#endif
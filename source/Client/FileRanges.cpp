@@ -0,0 +1,251 @@
+/*-----------------------------------------------------------------------------
+-- SOURCE FILE: FileRanges.cpp - This file provides a set of byte ranges that
+-- can be saved next to a partially downloaded file.
+--
+-- PUBLIC FUNCTIONS:
+-- void add(unsigned long start, unsigned long end);
+-- bool firstGap(unsigned long size, unsigned long *start, unsigned long *end);
+-- bool gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end);
+-- bool covers(unsigned long size);
+-- bool contains(unsigned long start, unsigned long end);
+-- bool load(const char *path);
+-- bool save(const char *path);
+-- void clear();
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- NOTES:
+-- The sidecar file holds the completed ranges as pairs of unsigned longs, so
+-- a download that was cancelled or dropped can be resumed from the first
+-- byte that is still missing.
+-----------------------------------------------------------------------------*/
+
+#include "FileRanges.h"
+
+#include "../common.h"
+#include <stdio.h>
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: add
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: add(unsigned long start, unsigned long end)
+--		unsigned long start : first byte of the range
+--		unsigned long end   : one past the last byte of the range
+--
+-- NOTES: Add a range to the set, merging it with any ranges it overlaps or touches.
+-------------------------------------------------------------------------------------------------*/
+void FileRanges::add(unsigned long start, unsigned long end)
+{
+	if (start >= end)
+		return;
+
+	// Merge with the range before, if it reaches the new range
+	std::map<unsigned long, unsigned long>::iterator it = ranges.upper_bound(start);
+	if (it != ranges.begin())
+	{
+		std::map<unsigned long, unsigned long>::iterator prev = it;
+		--prev;
+		if (prev->second >= start)
+		{
+			start = prev->first;
+			end = max(end, prev->second);
+			ranges.erase(prev);
+		}
+	}
+
+	// Merge with the ranges after, while they start inside the new range
+	it = ranges.lower_bound(start);
+	while (it != ranges.end() && it->first <= end)
+	{
+		end = max(end, it->second);
+		it = ranges.erase(it);
+	}
+
+	ranges[start] = end;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: firstGap
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: firstGap(unsigned long size, unsigned long *start, unsigned long *end)
+--		unsigned long size  : size of the whole file
+--		unsigned long *start : set to the first missing byte
+--		unsigned long *end   : set to one past the last missing byte of the gap
+--
+-- NOTES: Find the first range of a file of the given size that is not in the set.
+-- Returns false if the whole file is covered.
+-------------------------------------------------------------------------------------------------*/
+bool FileRanges::firstGap(unsigned long size, unsigned long *start, unsigned long *end)
+{
+	return gapIn(0, size, start, end);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: gapIn
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end)
+--		unsigned long from   : first byte to look at
+--		unsigned long to     : one past the last byte to look at
+--		unsigned long *start : set to the first missing byte
+--		unsigned long *end   : set to one past the last missing byte of the gap
+--
+-- NOTES: Find the first range inside [from, to) that is not in the set. Returns false if the
+-- whole of [from, to) is covered.
+-------------------------------------------------------------------------------------------------*/
+bool FileRanges::gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end)
+{
+	unsigned long cursor = from;
+
+	// Ranges never touch each other, so only the range starting at or before from can cover it
+	std::map<unsigned long, unsigned long>::iterator it = ranges.upper_bound(cursor);
+	if (it != ranges.begin())
+	{
+		--it;
+		cursor = max(cursor, it->second);
+	}
+
+	if (cursor >= to)
+		return false;
+
+	std::map<unsigned long, unsigned long>::iterator next = ranges.upper_bound(cursor);
+	*start = cursor;
+	*end = (next == ranges.end()) ? to : min(next->first, to);
+	return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: covers
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: covers(unsigned long size)
+--		unsigned long size : size of the whole file
+--
+-- NOTES: Returns true if every byte of a file of the given size is in the set.
+-------------------------------------------------------------------------------------------------*/
+bool FileRanges::covers(unsigned long size)
+{
+	unsigned long start, end;
+	return !firstGap(size, &start, &end);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: contains
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: contains(unsigned long start, unsigned long end)
+--		unsigned long start : first byte of the range
+--		unsigned long end   : one past the last byte of the range
+--
+-- NOTES: Returns true if every byte of the range [start, end) is in the set.
+-------------------------------------------------------------------------------------------------*/
+bool FileRanges::contains(unsigned long start, unsigned long end)
+{
+	if (start >= end)
+		return true;
+
+	// Ranges never touch each other, so only the range starting at or before start can hold it
+	std::map<unsigned long, unsigned long>::iterator it = ranges.upper_bound(start);
+	if (it == ranges.begin())
+		return false;
+
+	--it;
+	return it->second >= end;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: load
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: load(const char *path)
+--		const char *path : path of the sidecar file
+--
+-- NOTES: Replace the set with the ranges saved in a sidecar file. Returns false, leaving the
+-- set empty, if there is no sidecar.
+-------------------------------------------------------------------------------------------------*/
+bool FileRanges::load(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	unsigned long range[2];
+
+	ranges.clear();
+	if (!file)
+		return false;
+
+	while (fread(range, sizeof(range), 1, file) == 1)
+	{
+		add(range[0], range[1]);
+	}
+
+	fclose(file);
+	return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: save
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: save(const char *path)
+--		const char *path : path of the sidecar file
+--
+-- NOTES: Write the set into a sidecar file, replacing its previous contents.
+-------------------------------------------------------------------------------------------------*/
+bool FileRanges::save(const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	unsigned long range[2];
+
+	if (!file)
+		return false;
+
+	for (std::map<unsigned long, unsigned long>::iterator it = ranges.begin(); it != ranges.end(); ++it)
+	{
+		range[0] = it->first;
+		range[1] = it->second;
+		fwrite(range, sizeof(range), 1, file);
+	}
+
+	fclose(file);
+	return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: clear
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: clear()
+--
+-- NOTES: Remove every range from the set.
+-------------------------------------------------------------------------------------------------*/
+void FileRanges::clear()
+{
+	ranges.clear();
+}
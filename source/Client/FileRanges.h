@@ -0,0 +1,59 @@
+/*-----------------------------------------------------------------------------
+-- SOURCE FILE: FileRanges.h - This file provides a set of byte ranges that
+-- can be saved next to a partially downloaded file.
+--
+-- PUBLIC FUNCTIONS:
+-- void add(unsigned long start, unsigned long end);
+-- bool firstGap(unsigned long size, unsigned long *start, unsigned long *end);
+-- bool gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end);
+-- bool covers(unsigned long size);
+-- bool contains(unsigned long start, unsigned long end);
+-- bool load(const char *path);
+-- bool save(const char *path);
+-- void clear();
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- NOTES:
+-- The sidecar file holds the completed ranges as pairs of unsigned longs, so
+-- a download that was cancelled or dropped can be resumed from the first
+-- byte that is still missing.
+-----------------------------------------------------------------------------*/
+
+#ifndef _FILE_RANGES_H_
+#define _FILE_RANGES_H_
+
+#include <map>
+
+/*
+	Extension appended to a downloaded file's name to get the name of its sidecar.
+*/
+#define PART_FILE_EXTENSION ".part"
+
+/*-----------------------------------------------------------------------------
+-- CLASS: FileRanges
+--
+-- DESCRIPTION: Keeps a set of half-open byte ranges [start, end). Adjacent and
+-- overlapping ranges are merged as they are added.
+-----------------------------------------------------------------------------*/
+class FileRanges
+{
+	public:
+		/* PUBLIC MEMBER METHODS */
+		void add(unsigned long start, unsigned long end);
+		bool firstGap(unsigned long size, unsigned long *start, unsigned long *end);
+		bool gapIn(unsigned long from, unsigned long to, unsigned long *start, unsigned long *end);
+		bool covers(unsigned long size);
+		bool contains(unsigned long start, unsigned long end);
+		bool load(const char *path);
+		bool save(const char *path);
+		void clear();
+
+	private:
+		/* PRIVATE MEMBER DATA */
+		std::map<unsigned long, unsigned long> ranges;
+};
+
+#endif
@@ -3,9 +3,16 @@
 -- transferring files between multiple computers.
 --
 -- PUBLIC FUNCTIONS:
--- void sendFile(char *filename, TCPSocket *socket);
+-- void sendFile(char *filename, TCPSocket *socket, unsigned long offset, unsigned long length,
+--     bool bulk);
 -- void recvFile(char *data);
+-- void requestFile(SongName *song, TCPSocket *socket);
+-- void recvHeader(char *data);
+-- void recvChunk(char *data);
+-- bool isReceiving();
 -- void cancelTransfer(char *filename, TCPSocket *socket);
+-- void serveDataConnection(TCPSocket *socket);
+-- void setBulkMode(bool bulk);
 --
 -- DATE:
 --
@@ -25,8 +32,12 @@
 #include <fstream>
 #include <string>
 #include <errno.h>
+#include <limits.h>
 
 #include "../protocol.h"
+#include "../Server/SongStore.h"
+#include "../Server/DownloadCarousel.h"
+#include "../Server/TransferScheduler.h"
 
 /*-------------------------------------------------------------------------------------------------
 -- FUNCTION: FileTransferer
@@ -46,38 +57,109 @@
 -------------------------------------------------------------------------------------------------*/
 FileTransferer::FileTransferer(OnDownloadComplete downloadComplete)
 	: onDownloadComplete(downloadComplete)
+	, bulkMode(false)
+	, access(CreateMutex(NULL, FALSE, NULL))
 {
 }
 
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: ~FileTransferer
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: ~FileTransferer()
+--
+-- NOTES: Destroy a FileTransferer.
+-------------------------------------------------------------------------------------------------*/
+FileTransferer::~FileTransferer()
+{
+	CloseHandle(access);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: setBulkMode
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- REVISIONS: October 18, 2026 - Bulk transfers are asked for by the receiver, instead of being
+--		chosen by the sender for every client.
+--
+-- INTERFACE: setBulkMode(bool bulk)
+--		bool bulk : true to ask for downloads in bulk, false to have them sent as
+--		            FileTransferData packets.
+--
+-- NOTES: In bulk mode, a file is sent as one DOWNLOAD_HEADER message followed by large
+-- DOWNLOAD_CHUNK messages whose data is sent with TransmitFile. Otherwise every FILE_PACKET_SIZE
+-- bytes of the file are sent in their own DOWNLOAD message. A sender only sends in bulk when the
+-- request has DOWNLOAD_FLAG_BULK set, so receivers that don't know about bulk transfers keep
+-- getting DOWNLOAD packets. Bulk mode is off by default.
+-------------------------------------------------------------------------------------------------*/
+void FileTransferer::setBulkMode(bool bulk)
+{
+	bulkMode = bulk;
+}
+
 /*-------------------------------------------------------------------------------------------------
 -- FUNCTION: sendFile
 --
 -- DATE:
 --
--- REVISIONS:
+-- REVISIONS: October 18, 2026 - Send a range of the file, so downloads can be resumed.
+--		October 18, 2026 - Only send in bulk when the client asked for it.
+--		October 18, 2026 - Queue ranges asked for while the file is already being sent.
 --
 -- DESIGNER: Calvin Rempel
 --
 -- PROGRAMMER: Calvin Rempel
 --
--- INTERFACE: sendFile(char *filename, TCPSocket *socket)
---		char *filename	  : the name of the file to send.
---		TCPSocket *socket : the client to send the file to.
+-- INTERFACE: sendFile(char *filename, TCPSocket *socket, unsigned long offset, unsigned long length,
+--		bool bulk)
+--		char *filename	     : the name of the file to send.
+--		TCPSocket *socket    : the client to send the file to.
+--		unsigned long offset : offset of the first byte to send.
+--		unsigned long length : number of bytes to send; 0 to send the rest of the file.
+--		bool bulk            : true if the client asked for the file in bulk.
 --
 -- NOTES: Start sending a file to a client. Multiple file transfers can occur at once, both up
--- and down, from the same instance.
+-- and down, from the same instance. Ranges are only honoured in bulk transfers; otherwise the
+-- whole file is sent. A range of a file that is already being sent in bulk to the same client is
+-- sent after it, by the same thread.
 -------------------------------------------------------------------------------------------------*/
-void FileTransferer::sendFile(SongName *song, TCPSocket *socket)
+void FileTransferer::sendFile(SongName *song, TCPSocket *socket, unsigned long offset, unsigned long length,
+	bool bulk)
 {
 	int songId = song->id;
-	char *path = song->cFilepath;
 	char *filename = song->cFilename;
 
+	// Only one transfer of a song to the same client at a time; other clients
+	// can download the same song concurrently, sharing the SongStore mapping.
+	WaitForSingleObject(access, INFINITE);
+	if (transferring[songId][socket])
+	{
+		if (bulk)
+		{
+			FileRange range;
+			range.offset = offset;
+			range.length = length;
+			queuedRanges[songId][socket].push_back(range);
+		}
+		ReleaseMutex(access);
+		return;
+	}
+	transferring[songId][socket] = true;
+	ReleaseMutex(access);
+
 	FileTransferInfo *info = new FileTransferInfo;
 	FileTransferData *data = new FileTransferData;
 	info->pThis = this;
 	info->socket = socket;
 	info->data = data;
+	info->offset = offset;
+	info->length = length;
 
 	memcpy(data->filename, filename, strlen(filename) + 1);
 	memset(data->data, 0, FILE_PACKET_SIZE);
@@ -86,15 +168,8 @@ void FileTransferer::sendFile(SongName *song, TCPSocket *socket)
 	data->dataLen = 0;
 	data->songId = songId;
 
-	if (filesOut.find(songId) == filesOut.end())
-	{
-		int i = errno;
-		filesOut[songId][socket] = fopen(path, "rb");
-		i = errno;
-		i = GetLastError();
-		transferring[songId][socket] = true;
-		CreateThread(NULL, 0, FileTransferer::TransferThread, info, 0, NULL);
-	}
+	CreateThread(NULL, 0, bulk ? FileTransferer::BulkTransferThread : FileTransferer::TransferThread,
+		info, 0, NULL);
 }
 
 /*-------------------------------------------------------------------------------------------------
@@ -123,7 +198,7 @@ void FileTransferer::recvFile(char *data)
 	if (ft_data->f_SOF)
 	{
 		//CreateDirectory(DOWNLOAD_FOLDER, NULL);
-		filesIn[ft_data->songId] = fopen(ft_data->filename, "w");
+		filesIn[ft_data->songId] = fopen(ft_data->filename, "wb");
 	}
 
 	file = filesIn[ft_data->songId];
@@ -138,11 +213,161 @@ void FileTransferer::recvFile(char *data)
 		if (ft_data->f_EOF)
 		{
 			fclose(file);
+			filesIn[ft_data->songId] = NULL;
 			//onDownloadComplete("", true);
 		}
 	}
 }
 
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: requestFile
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: requestFile(SongName *song, TCPSocket *socket)
+--		SongName *song    : the song to download.
+--		TCPSocket *socket : the connection to the server.
+--
+-- NOTES: Ask the server for a song. In bulk mode, a download that was cancelled or dropped is
+-- resumed: every range that is still missing on disk is asked for in its own REQUEST_DOWNLOAD,
+-- and the transfer is only finished once all of them have ended. The completed ranges are read
+-- from the sidecar file next to the partially downloaded file, which was preallocated to the
+-- size of the whole file when the download started.
+-------------------------------------------------------------------------------------------------*/
+void FileTransferer::requestFile(SongName *song, TCPSocket *socket)
+{
+	std::string partPath = std::string(song->cFilename) + PART_FILE_EXTENSION;
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	FileRanges ranges;
+	DownloadRequestPacket packet;
+	unsigned long size, start, end;
+	int requests = 0;
+
+	packet.index = song->id;
+	packet.offset = 0;
+	packet.length = 0;
+	packet.flags = bulkMode ? DOWNLOAD_FLAG_BULK : 0;
+
+	// Without a sidecar, or if the partial file is gone, download everything
+	if (!bulkMode || !ranges.load(partPath.c_str())
+		|| !GetFileAttributesExA(song->cFilename, GetFileExInfoStandard, &attributes))
+	{
+		rangesIn[song->id] = 1;
+		socket->Send(REQUEST_DOWNLOAD, &packet, sizeof(packet));
+		return;
+	}
+
+	// Ask for every gap; if there are none, asking for the end of the file still gets the header
+	// and the empty chunk that finish the download
+	size = attributes.nFileSizeLow;
+	for (start = 0; ranges.gapIn(start, size, &start, &end); start = end)
+	{
+		packet.offset = start;
+		packet.length = end - start;
+		socket->Send(REQUEST_DOWNLOAD, &packet, sizeof(packet));
+		++requests;
+	}
+	if (requests == 0)
+	{
+		packet.offset = size;
+		packet.length = 0;
+		socket->Send(REQUEST_DOWNLOAD, &packet, sizeof(packet));
+		++requests;
+	}
+	rangesIn[song->id] = requests;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: recvHeader
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Write the file through a DownloadSink.
+--		October 18, 2026 - Keep the sink open across the ranges of a resumed download.
+--
+-- INTERFACE: recvHeader(char *data)
+--		char *data : the received FileTransferHeader
+--
+-- NOTES: Start of a range of a bulk transfer sent by a remote FileTransferer. Opens a
+-- DownloadSink for the file that the following chunks are written into, unless one is already
+-- open for an earlier range of the same download. If the file was partially downloaded before,
+-- it is kept along with the ranges recorded in its sidecar.
+-------------------------------------------------------------------------------------------------*/
+void FileTransferer::recvHeader(char *data)
+{
+	FileTransferHeader *header = (FileTransferHeader*) data;
+
+	if (!downloadsIn[header->songId])
+	{
+		downloadsIn[header->songId] = new DownloadSink(header->filename, header->size);
+	}
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: recvChunk
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Write the file through a DownloadSink.
+--		October 18, 2026 - Only finish once every range that was asked for has ended.
+--		October 18, 2026 - Finish the file on the sink's thread, not the control thread.
+--
+-- INTERFACE: recvChunk(char *data)
+--		char *data : the received FileChunkHeader, followed by its data
+--
+-- NOTES: A chunk of a bulk transfer sent by a remote FileTransferer. The data is handed to the
+-- file's DownloadSink, which writes it on its own thread, so the control thread never waits on
+-- the disk. An empty chunk ends a range; once the last range asked for by requestFile has ended,
+-- the sink is released, so it finishes the file and deletes itself on its own thread; it keeps
+-- the sidecar unless the whole file is there.
+-------------------------------------------------------------------------------------------------*/
+void FileTransferer::recvChunk(char *data)
+{
+	FileChunkHeader *chunk = (FileChunkHeader*) data;
+	DownloadSink *sink = downloadsIn[chunk->songId];
+
+	if (!sink)
+		return;
+
+	if (chunk->dataLen > 0)
+	{
+		sink->write(chunk->offset, data + sizeof(FileChunkHeader), chunk->dataLen);
+	}
+	else if (--rangesIn[chunk->songId] <= 0)
+	{
+		sink->release();
+		downloadsIn[chunk->songId] = NULL;
+	}
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: isReceiving
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: isReceiving()
+--
+-- NOTES: Returns true if a file sent by a remote FileTransferer is still being received.
+-------------------------------------------------------------------------------------------------*/
+bool FileTransferer::isReceiving()
+{
+	for (std::map<int, FILE*>::iterator it = filesIn.begin(); it != filesIn.end(); ++it)
+	{
+		if (it->second)
+			return true;
+	}
+	for (std::map<int, DownloadSink*>::iterator it = downloadsIn.begin(); it != downloadsIn.end(); ++it)
+	{
+		if (it->second)
+			return true;
+	}
+	return false;
+}
+
 /*-------------------------------------------------------------------------------------------------
 -- FUNCTION: cancelTransfer
 --
@@ -162,16 +387,98 @@ void FileTransferer::recvFile(char *data)
 -------------------------------------------------------------------------------------------------*/
 void FileTransferer::cancelTransfer(int songId, TCPSocket *socket)
 {
-	transferring[songId][socket] = false;
+	endTransfer(songId, socket);
 	//onDownloadComplete("", false);
 }
 
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: isTransferring
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: isTransferring(int songId, TCPSocket *socket)
+--		int songId        : the id of the song being sent
+--		TCPSocket *socket : the socket of the client being transferred to.
+--
+-- RETURNS: true if the song is being sent to the client, and the transfer hasn't been cancelled.
+--
+-- NOTES: The transfer threads and the UI thread all use the transfers, so they are only looked at
+-- with the mutex held.
+-------------------------------------------------------------------------------------------------*/
+bool FileTransferer::isTransferring(int songId, TCPSocket *socket)
+{
+	bool sending = false;
+
+	WaitForSingleObject(access, INFINITE);
+	std::map<int, std::map<TCPSocket*, bool>>::iterator song = transferring.find(songId);
+	if (song != transferring.end())
+	{
+		std::map<TCPSocket*, bool>::iterator client = song->second.find(socket);
+		sending = client != song->second.end() && client->second;
+	}
+	ReleaseMutex(access);
+
+	return sending;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: endTransfer
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: endTransfer(int songId, TCPSocket *socket)
+--		int songId        : the id of the song being sent
+--		TCPSocket *socket : the socket of the client being transferred to.
+--
+-- NOTES: Forget the transfer of a song to a client, when it is cancelled or done. The thread
+-- sending it stops before its next packet.
+-------------------------------------------------------------------------------------------------*/
+void FileTransferer::endTransfer(int songId, TCPSocket *socket)
+{
+	WaitForSingleObject(access, INFINITE);
+	std::map<int, std::map<TCPSocket*, bool>>::iterator song = transferring.find(songId);
+	if (song != transferring.end())
+	{
+		song->second.erase(socket);
+		if (song->second.empty())
+		{
+			transferring.erase(song);
+		}
+	}
+	ReleaseMutex(access);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: serveDataConnection
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: serveDataConnection(TCPSocket *socket)
+--		TCPSocket *socket : a connection accepted on the data port.
+--
+-- NOTES: Serve download requests sent over a data connection in a thread of its own. Clients
+-- open several data connections to fetch the chunks of a song in parallel. The socket must have
+-- been created to send DISCONNECT when the connection closes; it is closed, and deleted along
+-- with its message queue, once its receive thread has stopped.
+-------------------------------------------------------------------------------------------------*/
+void FileTransferer::serveDataConnection(TCPSocket *socket)
+{
+	CreateThread(NULL, 0, FileTransferer::DataConnectionThread, socket, 0, NULL);
+}
+
 /*-------------------------------------------------------------------------------------------------
 -- FUNCTION: TransferThread
 --
 -- DATE:
 --
--- REVISIONS:
+-- REVISIONS: October 18, 2026 - Share the upload budget through the TransferScheduler.
+--		October 18, 2026 - Look at the transfer with the mutex held.
 --
 -- DESIGNER: Calvin Rempel
 --
@@ -188,24 +495,45 @@ DWORD WINAPI FileTransferer::TransferThread(LPVOID transferInfo)
 	FileTransferInfo *info = (FileTransferInfo*) transferInfo;
 	FileTransferData *data = (FileTransferData*) info->data;
 
-	FILE *file = info->pThis->filesOut[data->songId][info->socket];
+	SongStore *store = SongStore::getInstance();
+	TransferScheduler *scheduler = TransferScheduler::getInstance();
+	unsigned long fileSize;
+	const char *file = store->acquire(data->songId, &fileSize);
+	int transfer = scheduler->open(info->socket->getPeerAddress(), data->songId);
 
-	char buffer[FILE_PACKET_SIZE];
+	unsigned long offset = 0;
+	unsigned long readAhead = 0;
 	bool success = false;
 	int buffLen = 0;
 
 	// Close if File is not opened
 	if (!file)
+	{
+		scheduler->close(transfer);
+		info->pThis->endTransfer(data->songId, info->socket);
+		delete data;
+		delete info;
 		return 1;
+	}
 
 	// Transfer data until end of file.
-	while (info->pThis->transferring[data->songId][info->socket] && (buffLen = fread(buffer, 1, FILE_PACKET_SIZE, file)))
+	while (info->pThis->isTransferring(data->songId, info->socket) && offset < fileSize)
 	{
+		// Ask for the next region to be read in before we get to it
+		if (offset >= readAhead)
+		{
+			store->willRead(data->songId, readAhead, SONG_STORE_READ_AHEAD);
+			readAhead += SONG_STORE_READ_AHEAD;
+		}
+
 		// Update the FileTransferInfo struct with new data
+		buffLen = min(fileSize - offset, (unsigned long) FILE_PACKET_SIZE);
 		data->dataLen = buffLen;
-		memcpy(data->data, buffer, data->dataLen);
+		memcpy(data->data, file + offset, data->dataLen);
+		offset += buffLen;
 
-		// Send Data
+		// Send Data once the scheduler allows it
+		scheduler->send(transfer, sizeof(FileTransferData));
 		info->socket->Send(DOWNLOAD, (void*)data, sizeof(FileTransferData));
 
 		// Mark all but first packet as NOT the start of file
@@ -218,11 +546,262 @@ DWORD WINAPI FileTransferer::TransferThread(LPVOID transferInfo)
 
 	// Send EOF packet
 	data->f_EOF = true;
+	data->dataLen = 0;
 	info->socket->Send(DOWNLOAD, (void*)data, sizeof(FileTransferData));
 
-	// Close the File
-	fclose(file);
+	// Release the song
+	store->release(data->songId);
+	scheduler->close(transfer);
+	info->pThis->endTransfer(data->songId, info->socket);
 	//info->pThis->onDownloadComplete(data->filename, success);
 
+	delete data;
+	delete info;
+	return 0;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: BulkTransferThread
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Share the upload budget through the TransferScheduler.
+--		October 18, 2026 - Send the ranges queued by sendFile after the requested one.
+--		October 18, 2026 - Look at the transfer with the mutex held, instead of through a pointer
+--		into the map.
+--
+-- INTERFACE: BulkTransferThread(LPVOID transferInfo)
+--		LPVOID transferInfo : the file transfer information
+--
+-- NOTES: Transfer the requested range of a file in a thread until it is completely sent, or
+-- transfer is cancelled, then each range of the file the client asked for in the meantime. Once
+-- cancelled, the remaining ranges are still answered with their header and empty chunk, so the
+-- client sees every range it asked for end. The filename is only sent once in a DOWNLOAD_HEADER; the range itself
+-- is sent in FILE_CHUNK_SIZE DOWNLOAD_CHUNKs, straight from the file cache using
+-- TCPSocket::SendFile.
+-------------------------------------------------------------------------------------------------*/
+DWORD WINAPI FileTransferer::BulkTransferThread(LPVOID transferInfo)
+{
+	FileTransferInfo *info = (FileTransferInfo*) transferInfo;
+	TransferScheduler *scheduler = TransferScheduler::getInstance();
+	int songId = info->data->songId;
+	int transfer = scheduler->open(info->socket->getPeerAddress(), songId);
+
+	bool sent = true;
+
+	while (true)
+	{
+		sent = sendRange(info->socket, songId, info->data->filename, info->offset, info->length,
+			transfer, info->pThis) && sent;
+
+		// Carry on with the next range the client asked for, if there is one
+		WaitForSingleObject(info->pThis->access, INFINITE);
+		std::deque<FileRange> &queue = info->pThis->queuedRanges[songId][info->socket];
+		if (queue.empty())
+		{
+			info->pThis->endTransfer(songId, info->socket);
+			ReleaseMutex(info->pThis->access);
+			break;
+		}
+		info->offset = queue.front().offset;
+		info->length = queue.front().length;
+		queue.pop_front();
+		ReleaseMutex(info->pThis->access);
+	}
+
+	scheduler->close(transfer);
+
+	delete info->data;
+	delete info;
+	return sent ? 0 : 1;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: DataConnectionThread
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Offer clients the carousel of songs somebody else is already
+--		downloading.
+--		October 18, 2026 - Share the upload budget through the TransferScheduler.
+--
+-- INTERFACE: DataConnectionThread(LPVOID dataSocket)
+--		LPVOID dataSocket : the TCPSocket of the data connection
+--
+-- NOTES: Serve the REQUEST_DOWNLOAD requests sent over a data connection one after the other,
+-- until the connection is closed. Each request is answered with a DOWNLOAD_HEADER, followed by
+-- the requested range in DOWNLOAD_CHUNKs and an empty DOWNLOAD_CHUNK, by sendRange.
+--
+-- A client starts a download by asking for the size of the song. If another client is already
+-- downloading the same song, that request is preceded by a CAROUSEL_OFFER; the client is counted
+-- as listening to the carousel until it sends its next request, or closes the connection.
+-------------------------------------------------------------------------------------------------*/
+DWORD WINAPI FileTransferer::DataConnectionThread(LPVOID dataSocket)
+{
+	TCPSocket *socket = (TCPSocket*) dataSocket;
+	MessageQueue *msgq = socket->getMessageQueue();
+	DownloadCarousel *carousel = DownloadCarousel::getInstance();
+	TransferScheduler *scheduler = TransferScheduler::getInstance();
+	TCPPacket packet;
+	int type;
+	int downloading = -1;
+	bool listening = false;
+	int transfer = -1;
+	int transferSong = -1;
+
+	while (true)
+	{
+		msgq->dequeue(&type, &packet);
+
+		// The receive thread of the socket sends DISCONNECT when the connection closes
+		if (type == DISCONNECT)
+			break;
+
+		if (type != REQUEST_DOWNLOAD)
+			continue;
+
+		DownloadRequestPacket *request = &packet.downloadRequestPacket;
+
+		// Asking for anything else means the client is done with the carousel
+		if (listening)
+		{
+			carousel->leave(downloading);
+			listening = false;
+		}
+
+		// Asking for the size of a song starts a new download
+		if (request->offset == ULONG_MAX)
+		{
+			CarouselOfferPacket offer;
+
+			if (downloading != -1)
+			{
+				carousel->endDownload(downloading);
+			}
+			downloading = request->index;
+
+			if (carousel->startDownload(downloading, &offer))
+			{
+				socket->Send(CAROUSEL_OFFER, &offer, sizeof(offer));
+				listening = true;
+			}
+		}
+
+		// The connections of a client downloading the same song share its share of the budget
+		if (request->index != transferSong)
+		{
+			if (transfer != -1)
+			{
+				scheduler->close(transfer);
+			}
+			transfer = scheduler->open(socket->getPeerAddress(), request->index);
+			transferSong = request->index;
+		}
+
+		sendRange(socket, request->index, "", request->offset, request->length, transfer, NULL);
+	}
+
+	if (listening)
+	{
+		carousel->leave(downloading);
+	}
+	if (downloading != -1)
+	{
+		carousel->endDownload(downloading);
+	}
+	if (transfer != -1)
+	{
+		scheduler->close(transfer);
+	}
+
+	// The receive thread may still be running after it sent DISCONNECT
+	socket->Close();
+	delete socket;
+	delete msgq;
 	return 0;
 }
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: sendRange
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Share the upload budget through the TransferScheduler.
+--		October 18, 2026 - Answer a song that cannot be read here, for every caller.
+--		October 18, 2026 - Ask the FileTransferer if the transfer was cancelled, instead of reading
+--		a flag the caller points at.
+--
+-- INTERFACE: sendRange(TCPSocket *socket, int songId, const char *filename, unsigned long offset,
+--		unsigned long length, int transfer, FileTransferer *transferer)
+--		TCPSocket *socket    : the socket to send the range over
+--		int songId           : the id of the song to send
+--		const char *filename : the name the client saves the song under
+--		unsigned long offset : offset of the first byte to send
+--		unsigned long length : number of bytes to send; 0 to send the rest of the file
+--		int transfer         : id of the download in the TransferScheduler
+--		FileTransferer *transferer : the transfer stops once it is cancelled here; NULL to always finish
+--
+-- NOTES: Send a range of a song as a DOWNLOAD_HEADER, FILE_CHUNK_SIZE DOWNLOAD_CHUNKs sent
+-- straight from the file cache using TCPSocket::SendFile, and an empty DOWNLOAD_CHUNK. The range
+-- is clamped to the file. Every chunk waits for the TransferScheduler before it is sent. A song
+-- that cannot be read is answered with an empty header and the empty chunk, so the client never
+-- waits for a reply that will not come, and false is returned.
+-------------------------------------------------------------------------------------------------*/
+bool FileTransferer::sendRange(TCPSocket *socket, int songId, const char *filename, unsigned long offset,
+	unsigned long length, int transfer, FileTransferer *transferer)
+{
+	SongStore *store = SongStore::getInstance();
+	TransferScheduler *scheduler = TransferScheduler::getInstance();
+	unsigned long fileSize;
+	FileTransferHeader header;
+	FileChunkHeader chunk;
+
+	if (!store->acquire(songId, &fileSize))
+	{
+		memset(&header, 0, sizeof(header));
+		header.songId = songId;
+		socket->Send(DOWNLOAD_HEADER, &header, sizeof(header));
+
+		chunk.songId = songId;
+		chunk.offset = offset;
+		chunk.dataLen = 0;
+		socket->Send(DOWNLOAD_CHUNK, &chunk, sizeof(chunk));
+		return false;
+	}
+
+	HANDLE fileHandle = store->getFile(songId);
+
+	// Clamp the requested range to the file
+	offset = min(offset, fileSize);
+	unsigned long end = (length == 0 || length > fileSize - offset) ? fileSize : offset + length;
+
+	// Send the file details once
+	header.songId = songId;
+	header.size = fileSize;
+	header.offset = offset;
+	header.length = end - offset;
+	strncpy(header.filename, filename, FILENAME_PACKET_LENGTH);
+	socket->Send(DOWNLOAD_HEADER, &header, sizeof(header));
+
+	// Send the range in large chunks until its end, or until cancelled
+	chunk.songId = songId;
+	chunk.offset = offset;
+	while ((!transferer || transferer->isTransferring(songId, socket)) && chunk.offset < end)
+	{
+		chunk.dataLen = min(end - chunk.offset, (unsigned long) FILE_CHUNK_SIZE);
+		store->willRead(songId, chunk.offset, chunk.dataLen);
+		scheduler->send(transfer, chunk.dataLen);
+
+		if (!socket->SendFile(DOWNLOAD_CHUNK, &chunk, sizeof(chunk), fileHandle, chunk.offset, chunk.dataLen))
+			break;
+
+		chunk.offset += chunk.dataLen;
+	}
+
+	// Send the empty chunk ending the transfer
+	chunk.dataLen = 0;
+	socket->Send(DOWNLOAD_CHUNK, &chunk, sizeof(chunk));
+
+	store->release(songId);
+	return true;
+}
@@ -3,9 +3,16 @@
 -- transferring files between multiple computers.
 --
 -- PUBLIC FUNCTIONS:
--- void sendFile(char *filename, TCPSocket *socket);
+-- void sendFile(char *filename, TCPSocket *socket, unsigned long offset, unsigned long length,
+--     bool bulk);
 -- void recvFile(char *data);
+-- void requestFile(SongName *song, TCPSocket *socket);
+-- void recvHeader(char *data);
+-- void recvChunk(char *data);
+-- bool isReceiving();
 -- void cancelTransfer(char *filename, TCPSocket *socket);
+-- void serveDataConnection(TCPSocket *socket);
+-- void setBulkMode(bool bulk);
 --
 -- DATE:
 --
@@ -24,7 +31,10 @@
 #define _FILE_TRANSFERER_H_
 
 #include "../common.h"
+#include "DownloadSink.h"
+#include <deque>
 #include <map>
+#include <string>
 
 #define FILENAME_PACKET_LENGTH 128
 #define FILE_PACKET_SIZE 256
@@ -45,6 +55,18 @@ struct FileTransferInfo
 	FileTransferer *pThis;
 	TCPSocket *socket;
 	FileTransferData *data;
+	unsigned long offset;
+	unsigned long length;
+};
+
+/*
+	A range of a file that a client asked for while another range of the same file was still being
+	sent to it.
+*/
+struct FileRange
+{
+	unsigned long offset;
+	unsigned long length;
 };
 
 struct SongName;
@@ -64,22 +86,41 @@ class FileTransferer
 	public:
 		/* CONSTRUCTORS/DESTRUCTORS */
 		FileTransferer(OnDownloadComplete downloadComplete);
-		~FileTransferer(){};
+		~FileTransferer();
 
 		/* PUBLIC MEMBER METHODS */
-		void sendFile(SongName *song, TCPSocket *socket);
+		void sendFile(SongName *song, TCPSocket *socket, unsigned long offset = 0, unsigned long length = 0,
+			bool bulk = false);
 		void recvFile(char *data);
+		void requestFile(SongName *song, TCPSocket *socket);
+		void recvHeader(char *data);
+		void recvChunk(char *data);
+		bool isReceiving();
 		void cancelTransfer(int songId, TCPSocket *socket);
+		void serveDataConnection(TCPSocket *socket);
+		void setBulkMode(bool bulk);
 
 	private:
 		/* PRIVATE STATIC MEMBER METHODS */
 		static DWORD WINAPI TransferThread(LPVOID transferInfo);
+		static DWORD WINAPI BulkTransferThread(LPVOID transferInfo);
+		static DWORD WINAPI DataConnectionThread(LPVOID dataSocket);
+		static bool sendRange(TCPSocket *socket, int songId, const char *filename, unsigned long offset,
+			unsigned long length, int transfer, FileTransferer *transferer);
+
+		/* PRIVATE MEMBER METHODS */
+		bool isTransferring(int songId, TCPSocket *socket);
+		void endTransfer(int songId, TCPSocket *socket);
 
 		/* PRIVATE MEMBER DATA */
-		std::map<int, std::map<TCPSocket*, FILE*>> filesOut;
 		std::map<int, FILE*> filesIn;
+		std::map<int, DownloadSink*> downloadsIn;
+		std::map<int, int> rangesIn;
 		std::map<int, std::map<TCPSocket*, bool>> transferring;
+		std::map<int, std::map<TCPSocket*, std::deque<FileRange>>> queuedRanges;
+		HANDLE access;
 		OnDownloadComplete onDownloadComplete;
+		bool bulkMode;
 };
 
 #endif
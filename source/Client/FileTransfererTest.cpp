@@ -0,0 +1,158 @@
+#include "Sockets.h"
+#include "../Common.h"
+
+#ifdef TEST_FILE_TRANSFERER
+
+/**
+ * loopback benchmark comparing the per-packet FileTransferData transfer with
+ *   the bulk TransmitFile transfer. reports throughput in MB/s and processor
+ *   time spent by the process per MB sent.
+ */
+
+#define TEST_PORT 7790
+#define TEST_FILE_SIZE (64*1024*1024)
+#define TEST_FILE_NAME L"FileTransfererTest.tmp"
+
+static unsigned long long drained = 0;
+
+DWORD WINAPI drainer(void* params)
+{
+    SOCKET sd = (SOCKET) params;
+    static char buffer[FILE_CHUNK_SIZE];
+    int received;
+
+    while((received = recv(sd,buffer,sizeof(buffer),0)) > 0)
+    {
+        drained += received;
+    }
+
+    closesocket(sd);
+    return 0;
+}
+
+unsigned long long cpuTime()
+{
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(),&created,&exited,&kernel,&user);
+
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+
+    // 100 nanosecond units
+    return k.QuadPart+u.QuadPart;
+}
+
+void report(const char* name, LARGE_INTEGER start, LARGE_INTEGER stop,
+    unsigned long long cpuStart, unsigned long long cpuStop)
+{
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    double seconds = (double) (stop.QuadPart-start.QuadPart)/freq.QuadPart;
+    double megabytes = (double) TEST_FILE_SIZE/(1024*1024);
+    double cpuMs = (double) (cpuStop-cpuStart)/10000;
+
+    printf("%-8s %8.1f MB/s %8.3f CPU ms/MB\n",name,megabytes/seconds,
+        cpuMs/megabytes);
+}
+
+TCPSocket* connectPair(SOCKET listener, MessageQueue* msgq, HANDLE* drainThread)
+{
+    TCPSocket* sock = new TCPSocket("127.0.0.1",TEST_PORT,msgq);
+    SOCKET accepted = accept(listener,NULL,NULL);
+
+    drained = 0;
+    *drainThread = CreateThread(NULL,0,drainer,(void*) accepted,0,NULL);
+    return sock;
+}
+
+int main(void)
+{
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2),&wsaData);
+
+    MessageQueue msgq(10,DATA_BUFSIZE);
+    HANDLE drainThread;
+    LARGE_INTEGER start, stop;
+    unsigned long long cpuStart, cpuStop;
+
+    // create the file to transfer; opened for overlapped io, the way the
+    // SongStore opens song files, so TransmitFile reads it the same way
+    HANDLE file = CreateFile(TEST_FILE_NAME,GENERIC_READ|GENERIC_WRITE,
+        FILE_SHARE_READ,NULL,CREATE_ALWAYS,
+        FILE_FLAG_DELETE_ON_CLOSE|FILE_FLAG_OVERLAPPED,NULL);
+    char* contents = (char*) malloc(TEST_FILE_SIZE);
+    DWORD written;
+    OVERLAPPED overlapped;
+    memset(contents,'x',TEST_FILE_SIZE);
+    memset(&overlapped,0,sizeof(overlapped));
+    overlapped.hEvent = CreateEvent(NULL,TRUE,FALSE,NULL);
+    if(!WriteFile(file,contents,TEST_FILE_SIZE,&written,&overlapped)
+        && GetLastError() != ERROR_IO_PENDING)
+    {
+        printf("could not write the test file\n");
+        return 1;
+    }
+    GetOverlappedResult(file,&overlapped,&written,TRUE);
+    CloseHandle(overlapped.hEvent);
+
+    // listen on loopback
+    SOCKET listener = socket(AF_INET,SOCK_STREAM,0);
+    sockaddr_in addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TEST_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(listener,(sockaddr*) &addr,sizeof(addr));
+    listen(listener,1);
+
+    // per packet transfer, the way TransferThread sends files
+    TCPSocket* sock = connectPair(listener,&msgq,&drainThread);
+    FileTransferData data;
+    memset(&data,0,sizeof(data));
+    cpuStart = cpuTime();
+    QueryPerformanceCounter(&start);
+    for(unsigned long offset = 0; offset < TEST_FILE_SIZE; offset += FILE_PACKET_SIZE)
+    {
+        memcpy(data.data,contents+offset,FILE_PACKET_SIZE);
+        data.dataLen = FILE_PACKET_SIZE;
+        sock->Send(DOWNLOAD,&data,sizeof(data));
+    }
+    sock->Close();
+    delete sock;
+    WaitForSingleObject(drainThread,INFINITE);
+    CloseHandle(drainThread);
+    QueryPerformanceCounter(&stop);
+    cpuStop = cpuTime();
+    report("packet",start,stop,cpuStart,cpuStop);
+
+    // bulk transfer, the way BulkTransferThread sends files
+    sock = connectPair(listener,&msgq,&drainThread);
+    FileChunkHeader chunk;
+    memset(&chunk,0,sizeof(chunk));
+    cpuStart = cpuTime();
+    QueryPerformanceCounter(&start);
+    for(chunk.offset = 0; chunk.offset < TEST_FILE_SIZE; chunk.offset += FILE_CHUNK_SIZE)
+    {
+        chunk.dataLen = FILE_CHUNK_SIZE;
+        sock->SendFile(DOWNLOAD_CHUNK,&chunk,sizeof(chunk),file,chunk.offset,chunk.dataLen);
+    }
+    sock->Close();
+    delete sock;
+    WaitForSingleObject(drainThread,INFINITE);
+    CloseHandle(drainThread);
+    QueryPerformanceCounter(&stop);
+    cpuStop = cpuTime();
+    report("bulk",start,stop,cpuStart,cpuStop);
+
+    closesocket(listener);
+    CloseHandle(file);
+    free(contents);
+    WSACleanup();
+    return 0;
+}
+
+#endif
@@ -3,66 +3,53 @@
 -- microphone input data into a MessageQueue.
 --
 -- PUBLIC FUNCTIONS:
--- static MicReader *getInstance();
--- MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner);
+-- MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner, AudioInput *input);
 -- void startReading();
 -- void stopReading();
+-- void release(MicBuffer *buffer);
+-- void getCaptureLatency(CaptureLatency *latency);
+-- float getFrameLength();
 -- static size_t calculateBufferSize(int sampleRate, float intervalLength);
 --
 -- DATE: April 4, 2015
 --
 -- REVISIONS:
+--		October 18, 2026 - reads from an AudioInput, which is the microphone
+--		unless another is passed.
+--		October 18, 2026 - captures into a fixed pool of buffers, which are
+--		queued as they are, and taken back once they have been sent; there
+--		may be any number of MicReaders.
 --
 -- DESIGNER: Calvin Rempel
 --
 -- PROGRAMMER: Calvin Rempel
 --
 -- NOTES:
--- This class uses the Win32 waveform functions to read data from the
--- microphone and feed it into a MessageQueue.
+-- This class reads data from an AudioInput, by default the microphone
+-- through the Win32 waveform functions, and feeds it into a MessageQueue.
 -----------------------------------------------------------------------------*/
 
 #include "MicReader.h"
 #include <iostream>
 
 #include "../Buffer/MessageQueue.h"
+#include "WinmmBackend.h"
 
-MicReader *MicReader::instance = NULL;
-
-/*-------------------------------------------------------------------------------------------------
--- FUNCTION: getInstance
---
--- DATE: April 4, 2015
---
--- REVISIONS:
---
--- DESIGNER: Calvin Rempel
---
--- PROGRAMMER: Calvin Rempel
---
--- INTERFACE: MicReader *getInstance()
---
--- RETURNS: the last instantiated MicReader
---
--- NOTES:
--- This is a static function that provides access to the last created instance
--- of MicReader.
--------------------------------------------------------------------------------------------------*/
-MicReader *MicReader::getInstance()
+MicReader::MicReader(int sampleRate, int buffLen, MessageQueue *queue, HWND owner, AudioInput *input)
 {
-	return instance;
-}
-
-MicReader::MicReader(int sampleRate, int buffLen, MessageQueue *queue, HWND owner)
-{
-	instance = this;
-
 	// Initialize data
+	this->input = input != NULL ? input : new WinmmInput();
+	this->ownsInput = input == NULL;
 	this->mqueue = queue;
-	this->recordLength = buffLen / sampleRate;
-	this->buffLen = buffLen;
+	this->recordLength = (float) min(buffLen, DATA_LEN) / sampleRate;
+	this->buffLen = min(buffLen, DATA_LEN);
 	this->recording = false;
 	this->owner = owner;
+	this->pool = NULL;
+	this->poolSize = 0;
+	this->unusedCount = 0;
+	this->access = CreateMutex(NULL, FALSE, NULL);
+	memset(&latency, 0, sizeof(latency));
 
 	// Create the WAV format for the MicReader
 	result = 0;
@@ -81,29 +68,37 @@ MicReader::MicReader(int sampleRate, int buffLen, MessageQueue *queue, HWND owne
 -- DATE: April 4, 2015
 --
 -- REVISIONS:
+--		October 18, 2026 - the buffers are no longer than the data of a packet,
+--		so they can be sent as they are.
 --
 -- DESIGNER: Calvin Rempel
 --
 -- PROGRAMMER: Calvin Rempel
 --
--- INTERFACE: MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner)
+-- INTERFACE: MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner, AudioInput *input)
 --		int sampleRate		 : the number of samples to record per second
 --		float intervalLength : the number of seconds to record into a single buffer
 --		MessageQueue *queue	 : the MessageQueue to write data into as it's available
 --		HWND owner			 : the window that will receive the shutdown message.
+--		AudioInput *input	 : the input to read from; the microphone if NULL.
 --
 -- NOTES: Create a new MicReader
 -------------------------------------------------------------------------------------------------*/
-MicReader::MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner)
+MicReader::MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner, AudioInput *input)
 {
-	instance = this;
-
 	// Initialize data
+	this->input = input != NULL ? input : new WinmmInput();
+	this->ownsInput = input == NULL;
 	this->mqueue = queue;
-	this->recordLength = intervalLength;
-	this->buffLen = calculateBufferSize(sampleRate, intervalLength);
+	this->buffLen = min((int) calculateBufferSize(sampleRate, intervalLength), DATA_LEN);
+	this->recordLength = (float) buffLen / sampleRate;
 	this->recording = false;
 	this->owner = owner;
+	this->pool = NULL;
+	this->poolSize = 0;
+	this->unusedCount = 0;
+	this->access = CreateMutex(NULL, FALSE, NULL);
+	memset(&latency, 0, sizeof(latency));
 
 	// Create the WAV format for the MicReader
 	result = 0;
@@ -116,12 +111,42 @@ MicReader::MicReader(int sampleRate, float intervalLength, MessageQueue *queue,
 	format.cbSize = 0;
 }
 
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: ~MicReader
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- DESIGNER: Calvin Rempel
+--
+-- PROGRAMMER: Calvin Rempel
+--
+-- INTERFACE: ~MicReader()
+--
+-- NOTES: Stops reading, and deletes the input if the MicReader made it. Every buffer that
+-- was queued must have been released.
+-------------------------------------------------------------------------------------------------*/
+MicReader::~MicReader()
+{
+	stopReading();
+	if (ownsInput)
+	{
+		delete input;
+	}
+	free(pool);
+	CloseHandle(access);
+}
+
 /*-------------------------------------------------------------------------------------------------
 -- FUNCTION: startReading
 --
 -- DATE: April 4, 2015
 --
 -- REVISIONS:
+--		October 18, 2026 - allocates the pool of buffers the first time it is called
+--		October 18, 2026 - the pool holds MIC_READER_POOL_MS of audio, so short
+--		frames get more buffers
 --
 -- DESIGNER: Calvin Rempel
 --
@@ -136,10 +161,23 @@ MicReader::MicReader(int sampleRate, float intervalLength, MessageQueue *queue,
 -------------------------------------------------------------------------------------------------*/
 void MicReader::startReading()
 {
-	if (!recording)
+	WaitForSingleObject(access, INFINITE);
+	if (pool == NULL)
+	{
+		poolSize = format.nAvgBytesPerSec * MIC_READER_POOL_MS / 1000 / buffLen;
+		poolSize = max(2, min(poolSize, MIC_READER_BUFFERS));
+		pool = (MicBuffer*) calloc(poolSize, sizeof(MicBuffer));
+		for (unusedCount = 0; unusedCount < poolSize; ++unusedCount)
+		{
+			unused[unusedCount] = &pool[unusedCount];
+		}
+	}
+	bool start = !recording;
+	recording = true;
+	ReleaseMutex(access);
+
+	if (start)
 	{
-		recording = true;
-		DWORD threadId;
 		readIn();
 	}
 }
@@ -163,15 +201,15 @@ void MicReader::startReading()
 -------------------------------------------------------------------------------------------------*/
 void MicReader::stopReading()
 {
-	if (recording)
-	{
-		recording = false;
-
-		// Mark all Buffers as Complete
-		waveInReset(mic);
+	WaitForSingleObject(access, INFINITE);
+	bool stop = recording;
+	recording = false;
+	ReleaseMutex(access);
 
-		// Wait for the device to close
-		while (waveInClose(mic) == WAVERR_STILLPLAYING){}
+	if (stop)
+	{
+		// Stop the input, and wait for it to close; it gives back the buffers it had
+		input->close();
 	}
 }
 
@@ -200,44 +238,53 @@ size_t MicReader::calculateBufferSize(int sampleRate, float intervalLength)
 }
 
 /*-------------------------------------------------------------------------------------------------
--- FUNCTION: addBuffer
+-- FUNCTION: readIn
 --
 -- DATE: April 4, 2015
 --
 -- REVISIONS:
+--		October 18, 2026 - opens the input, and gives it the unused buffers of the pool
 --
 -- DESIGNER: Calvin Rempel
 --
 -- PROGRAMMER: Calvin Rempel
 --
--- INTERFACE: addBuffer()
+-- INTERFACE: readIn()
 --
 -- RETURNS: void
 --
--- NOTES: This function adds a new buffer to the WaveIn structure, allowing for more data to be
--- recorded. It results in memory being allocated with malloc which should be freed in the
--- waveInProc().
+-- NOTES: This function attempts to open the microphone and begin reading from it into the
+-- readers buffers.
 -------------------------------------------------------------------------------------------------*/
-void MicReader::addBuffer()
+void MicReader::readIn()
 {
-	WAVEHDR *hdr = (WAVEHDR*) malloc(sizeof(WAVEHDR));
+	// Attempt to open the Microphone for reading.
+	result = input->open(format.nSamplesPerSec, format.wBitsPerSample, format.nChannels, this);
+
+	if (result)
+	{
+		#ifdef DEBUG
+		MessageBox(NULL, L"Error opening microphone.", L"Error", MB_ICONERROR);
+		#endif
+		return;
+	}
 
-	hdr->lpData = (LPSTR)(new int[buffLen]);
-	hdr->dwBufferLength = this->buffLen;
-	hdr->dwBytesRecorded = 0;
-	hdr->dwUser = 0l;
-	hdr->dwFlags = 0l;
-	hdr->dwLoops = 0l;
+	// Give it the buffers that aren't queued to read into
+	WaitForSingleObject(access, INFINITE);
+	int count = unusedCount;
+	unusedCount = 0;
+	ReleaseMutex(access);
 
-	waveInPrepareHeader(mic, hdr, sizeof(WAVEHDR));
-	waveInAddBuffer(mic, hdr, sizeof(WAVEHDR));
-	wavHeaders.push(hdr);
+	for (int i = 0; i < count; ++i)
+	{
+		recycle(unused[i]);
+	}
 }
 
 /*-------------------------------------------------------------------------------------------------
--- FUNCTION: readIn
+-- FUNCTION: captured
 --
--- DATE: April 4, 2015
+-- DATE: October 18, 2026
 --
 -- REVISIONS:
 --
@@ -245,58 +292,42 @@ void MicReader::addBuffer()
 --
 -- PROGRAMMER: Calvin Rempel
 --
--- INTERFACE: readIn()
+-- INTERFACE: captured(char *data, int len)
+--		char *data : the data of the buffer that was captured into
+--		int len	   : the number of bytes captured
 --
 -- RETURNS: void
 --
--- NOTES: This function attempts to open the microphone and begin reading from it into the
--- readers buffers.
+-- NOTES: Called by the input, from its own thread, whenever a buffer has been captured. A
+-- pointer to the buffer is queued; the audio itself isn't copied. Buffers handed back empty, or
+-- once reading has stopped, go back to the pool.
 -------------------------------------------------------------------------------------------------*/
-void MicReader::readIn()
+void MicReader::captured(char *data, int len)
 {
-	// Attempt to open the Microphone for reading.
-	result = waveInOpen(&mic, WAVE_MAPPER, &format, (DWORD_PTR)MicReader::waveInProc, 0L, WAVE_FORMAT_DIRECT | CALLBACK_FUNCTION);
+	MicBuffer *buffer = (MicBuffer*) (data - offsetof(MicBuffer, packet.data));
 
-	if (result)
+	WaitForSingleObject(access, INFINITE);
+	bool queue = recording && len > 0;
+	if (!queue)
 	{
-		#ifdef DEBUG
-		MessageBox(NULL, L"Error opening microphone.", L"Error", MB_ICONERROR);
-		#endif
-		return;
+		unused[unusedCount++] = buffer;
 	}
-	else
-	{
-		// Add an initial buffers to start with
-		for(int i = 0; i < 10; ++i)
-		{
-			addBuffer();
-		}
+	ReleaseMutex(access);
 
-		if (result)
-		{
-			#ifdef DEBUG
-			MessageBox(NULL, L"Error preparing WAV Buffer.", L"Error", MB_ICONERROR);
-			#endif
-			return;
-		}
-
-		// Start reading from the microphone into it's buffers.
-		result = waveInStart(mic);
+	if (queue)
+	{
+		buffer->len = len;
+		QueryPerformanceCounter(&buffer->captured);
 
-		if (result)
-		{
-			#ifdef DEBUG
-			MessageBox(NULL, L"Error reading data from microphone.", L"Error", MB_ICONERROR);
-			#endif
-			return;
-		}
+		// there is room in the queue for every buffer, so this never blocks
+		mqueue->enqueue(MIC_INPUT_MQUEUE_TYPE, &buffer, sizeof(buffer));
 	}
 }
 
 /*-------------------------------------------------------------------------------------------------
--- FUNCTION: waveInProc
+-- FUNCTION: release
 --
--- DATE: April 4, 2015
+-- DATE: October 18, 2026
 --
 -- REVISIONS:
 --
@@ -304,61 +335,130 @@ void MicReader::readIn()
 --
 -- PROGRAMMER: Calvin Rempel
 --
--- INTERFACE: waveInProc(HWAVEIN hwi, UINT uMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2)
---		HWAVEIN hwi			 : The Handle of the microphone that generated the callback call
---		UINT uMsg			 : The event that triggered the call (WIM_OPEN, WIM_CLOSE, WIM_DATA)
---		DWORD_PTR dwInstance : An instance of the callback
---		DWORD_PTR dwParam1   : A generic parameter for the callback
---		DWORD_PTR dwParam2   : A second generic parameter for the callback
+-- INTERFACE: release(MicBuffer *buffer)
+--		MicBuffer *buffer : a buffer that was dequeued from the MicReader's MessageQueue
 --
 -- RETURNS: void
 --
--- NOTES: This function is a Windows callback that is called whenever a microphone is opened,
--- closed, or has data available for reading. If data is available, this function copies that
--- data into the MicReaders' MessageQueue, adds a new buffer to allow for continuous reading,
--- frees the used buffer.
---
--- If the event is WIM_CLOSE, this function clears all memory required by the buffers and sends
--- a WM_MIC_STOPPED_READING message through the Window Message Pump to it's owner.
+-- NOTES: Gives back a buffer once it has been sent, so it can be captured into again. The time
+-- since its capture finished is added to the capture latency.
 -------------------------------------------------------------------------------------------------*/
-void CALLBACK MicReader::waveInProc(HWAVEIN hwi, UINT uMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2)
+void MicReader::release(MicBuffer *buffer)
 {
-	// If data is available from the microphone, copy into a message queue
-	if (uMsg == WIM_DATA)
-	{
-		MicReader *micReader = MicReader::getInstance();
-		WAVEHDR *completed = (WAVEHDR*) dwParam1;
+	LARGE_INTEGER now, freq;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&freq);
+	double ms = (double) (now.QuadPart - buffer->captured.QuadPart) * 1000 / freq.QuadPart;
 
-		// Add the recorded data to the output message queue
-		micReader->mqueue->enqueue(MIC_INPUT_MQUEUE_TYPE, completed->lpData);
+	WaitForSingleObject(access, INFINITE);
+	++latency.count;
+	latency.totalMs += ms;
+	latency.maxMs = max(latency.maxMs, ms);
+	ReleaseMutex(access);
 
-		// Add another buffer to read into
-		if (micReader->recording)
-			micReader->addBuffer();
+	recycle(buffer);
+}
 
-		// Remove the used up buffer
-		if (micReader->wavHeaders.size() > 0)
-		{
-			delete micReader->wavHeaders.front()->lpData;
-			free(micReader->wavHeaders.front());
-			micReader->wavHeaders.pop();
-		}
-	}
-	// If recording has stopped, clean up buffers and post message to WM pump
-	else if (uMsg == WIM_CLOSE)
-	{
-		MicReader *micReader = MicReader::getInstance();
-		micReader->recording = false;
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: getCaptureLatency
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- DESIGNER: Calvin Rempel
+--
+-- PROGRAMMER: Calvin Rempel
+--
+-- INTERFACE: getCaptureLatency(CaptureLatency *latency)
+--		CaptureLatency *latency : filled with the time from the end of each capture until the
+--		buffer was released
+--
+-- RETURNS: void
+-------------------------------------------------------------------------------------------------*/
+void MicReader::getCaptureLatency(CaptureLatency *latency)
+{
+	WaitForSingleObject(access, INFINITE);
+	*latency = this->latency;
+	ReleaseMutex(access);
+}
 
-		// Free all allocated buffers
-		while (micReader->wavHeaders.size() > 0)
-		{
-			delete micReader->wavHeaders.front()->lpData;
-			free(micReader->wavHeaders.front());
-			micReader->wavHeaders.pop();
-		}
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: getFrameLength
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- DESIGNER: Calvin Rempel
+--
+-- PROGRAMMER: Calvin Rempel
+--
+-- INTERFACE: getFrameLength()
+--
+-- RETURNS: float - the number of seconds recorded into each buffer
+--
+-- NOTES: The first sample of a buffer waits this long before the buffer is captured, so it is
+-- part of the latency of the voice.
+-------------------------------------------------------------------------------------------------*/
+float MicReader::getFrameLength()
+{
+	return recordLength;
+}
 
-		// Send a WM message to indicate the recording has stopped
-		SendMessage(micReader->owner, WM_MIC_STOPPED_READING, 0, 0);
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: recycle
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- DESIGNER: Calvin Rempel
+--
+-- PROGRAMMER: Calvin Rempel
+--
+-- INTERFACE: recycle(MicBuffer *buffer)
+--		MicBuffer *buffer : a buffer of the pool that is no longer in use
+--
+-- RETURNS: void
+--
+-- NOTES: Gives a buffer back to the input while reading; keeps it unused until reading starts
+-- again otherwise, or if the input won't take it.
+-------------------------------------------------------------------------------------------------*/
+void MicReader::recycle(MicBuffer *buffer)
+{
+	WaitForSingleObject(access, INFINITE);
+	if (!recording || input->addBuffer(buffer->packet.data, buffLen) != 0)
+	{
+		unused[unusedCount++] = buffer;
 	}
+	ReleaseMutex(access);
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: stopped
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- DESIGNER: Calvin Rempel
+--
+-- PROGRAMMER: Calvin Rempel
+--
+-- INTERFACE: stopped()
+--
+-- RETURNS: void
+--
+-- NOTES: Called by the input when it has stopped reading. Sends a WM_MIC_STOPPED_READING
+-- message through the Window Message Pump to the MicReader's owner.
+-------------------------------------------------------------------------------------------------*/
+void MicReader::stopped()
+{
+	WaitForSingleObject(access, INFINITE);
+	recording = false;
+	ReleaseMutex(access);
+
+	// Send a WM message to indicate the recording has stopped
+	SendMessage(owner, WM_MIC_STOPPED_READING, 0, 0);
 }
@@ -3,23 +3,32 @@
 -- microphone input data into a MessageQueue.
 --
 -- PUBLIC FUNCTIONS:
--- static MicReader *getInstance();
--- MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner);
+-- MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner, AudioInput *input);
 -- void startReading();
 -- void stopReading();
+-- void release(MicBuffer *buffer);
+-- void getCaptureLatency(CaptureLatency *latency);
+-- float getFrameLength();
 -- static size_t calculateBufferSize(int sampleRate, float intervalLength);
 --
 -- DATE: April 4, 2015
 --
 -- REVISIONS:
+--		October 18, 2026 - reads from an AudioInput, which is the microphone
+--		unless another is passed.
+--		October 18, 2026 - captures into a fixed pool of buffers, which are
+--		queued as they are, and taken back once they have been sent; there
+--		may be any number of MicReaders.
+--		October 18, 2026 - the pool holds a fixed length of audio, however
+--		short the frames are.
 --
 -- DESIGNER: Calvin Rempel
 --
 -- PROGRAMMER: Calvin Rempel
 --
 -- NOTES:
--- This class uses the Win32 waveform functions to read data from the
--- microphone and feed it into a MessageQueue.
+-- This class reads data from an AudioInput, by default the microphone
+-- through the Win32 waveform functions, and feeds it into a MessageQueue.
 -----------------------------------------------------------------------------*/
 
 #ifndef _MIC_READER_H_
@@ -27,53 +36,94 @@
 
 #include "../common.h"
 #include "../protocol.h"
-#include <mmsystem.h>
-#include <queue>
+#include "AudioBackend.h"
 
 #define WM_MIC_STOPPED_READING (WM_USER + 0x0001)
 #define MIC_INPUT_MQUEUE_TYPE 101
 
+/**
+ * milliseconds of audio the pool each MicReader captures into can hold, and
+ *   the most buffers it may have. the MessageQueue it feeds needs room for
+ *   {MIC_READER_BUFFERS} MicBuffer pointers.
+ */
+#define MIC_READER_POOL_MS 120
+#define MIC_READER_BUFFERS 32
+
 class MessageQueue;
 
+/*-----------------------------------------------------------------------------
+-- STRUCT: MicBuffer
+--
+-- DESCRIPTION: A buffer the microphone captures into. It is laid out as the
+-- packet the voice is sent in, so the audio is captured straight into the
+-- packet's data, and the packet can be sent as it is once its index is
+-- filled in.
+--
+-- packet	: the packet; the audio is captured into packet.data
+-- len		: number of bytes captured into packet.data
+-- captured	: performance counter value of when the capture finished
+-----------------------------------------------------------------------------*/
+struct MicBuffer
+{
+	DataPacket packet;
+	int len;
+	LARGE_INTEGER captured;
+};
+
+/*-----------------------------------------------------------------------------
+-- STRUCT: CaptureLatency
+--
+-- DESCRIPTION: Statistics about the time from when buffers finish capturing
+-- until they are released after being sent.
+-----------------------------------------------------------------------------*/
+struct CaptureLatency
+{
+	int count;
+	double totalMs;
+	double maxMs;
+};
+
 /*-----------------------------------------------------------------------------
 -- CLASS: MicReader
 --
 -- DESCRIPTION: This class provides functionality for reading Microphone
--- input data into a MessageQueue. It contains a static "getInstance" method
--- which will return the PREVIOUSLY instantiated instance. This means it is
--- ideal to create a single instance ONCE at the beginning of the program and
--- then use getInstance afterwards to get access to the created instance
--- elsewhere in the application.
+-- input data into a MessageQueue. A pointer to each MicBuffer is queued as
+-- it is filled; whoever dequeues it must give it back with release once it
+-- is done with it, so it can be captured into again.
+--
+-- It is the AudioInputHandler of its input, which hands it each buffer as
+-- it is captured.
 -----------------------------------------------------------------------------*/
-class MicReader
+class MicReader : public AudioInputHandler
 {
 public:
 	/* CONSTRUCTORS/DESTRUCTORS */
-	MicReader(int sampleRate, int buflen, MessageQueue *queue, HWND owner);
-	MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner);
-	~MicReader(){};
+	MicReader(int sampleRate, int buflen, MessageQueue *queue, HWND owner, AudioInput *input = NULL);
+	MicReader(int sampleRate, float intervalLength, MessageQueue *queue, HWND owner, AudioInput *input = NULL);
+	~MicReader();
 
 	/* PUBLIC MEMBER METHODS */
 	void startReading();
 	void stopReading();
+	void release(MicBuffer *buffer);
+	void getCaptureLatency(CaptureLatency *latency);
+	float getFrameLength();
 
 	/* PUBLIC STATIC MEMBER METHODS */
-	static MicReader *getInstance();
 	static size_t calculateBufferSize(int sampleRate, float intervalLength);
 
+	/* AUDIO INPUT HANDLER METHODS */
+	virtual void captured(char *data, int len);
+	virtual void stopped();
+
 private:
 	/* PRIVATE MEMBER METHODS */
-	void addBuffer();
 	void readIn();
-
-	/* PRIVATE STATIC MEMBER METHODS */
-	static void CALLBACK waveInProc(HWAVEIN hwi, UINT uMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2);
-
-	/* PRIVATE STATIC MEMBER DATA */
-	static MicReader *instance;
+	void recycle(MicBuffer *buffer);
 
 	/* PRIVATE MEMBER DATA */
-	HWAVEIN mic;
+	AudioInput *input;
+	bool ownsInput;
 	HWND owner;
 	MessageQueue *mqueue;
 	MMRESULT result;
@@ -83,7 +133,18 @@ private:
 	float recordLength;
 	int sampleRate;
 	int buffLen;
-	std::queue<WAVEHDR*> wavHeaders;
+
+	// the pool of buffers, allocated the first time reading starts, its
+	// size, and the ones not given to the input or the queue
+	MicBuffer *pool;
+	int poolSize;
+	MicBuffer *unused[MIC_READER_BUFFERS];
+	int unusedCount;
+
+	CaptureLatency latency;
+
+	// protects recording, the unused buffers, and the latency
+	HANDLE access;
 };
 
 #endif
@@ -7,11 +7,20 @@
 	void writeBuf(char* data, int len);
 	void readBuf(char* data, int len);
 	void seekBuf(long index);
-	void newSong();
+	void newSong(unsigned long song_size, int bps, unsigned long data_offset);
+	void nextSong(FormatPacket* format);
+	bool isBuffered(double percentage);
+	void restartAt(unsigned long index);
+	void getStats(MusicBufferStats* stats);
+	void getSeekLatency(PlaybackLatency* local, PlaybackLatency* remote);
+	void getStartLatency(PlaybackLatency* start);
 --
 -- DATE: April 5, 2015
 --
--- REVISIONS: --
+-- REVISIONS: October 18, 2026 - Keep the current song in a sparse temporary file that is mapped
+--	into memory a window at a time, instead of in a 100MB ring allocated up front.
+--			October 18, 2026 - Hold the start of the next song of the stream aside until the current one is
+--	played out, instead of making the writer wait for it.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -20,18 +29,26 @@
 -- NOTES:
 -- This is the file containing all the necessary functions to make use of a music buffer. It has fucntions to read
 --	and write into it as well as semaphores to control the flow of data.
+--
+--	The whole of the current song is kept in a temporary file, so any part of it that has been received can be
+--	seeked to. Only the window being written and the window being read are mapped into memory; the rest lives in
+--	the file cache, which the system is free to write out or drop. When memory runs low, the part of the song that
+--	has already been played is given back.
 ----------------------------------------------------------------------------------------------------------------------*/
 
 #include "MusicBuffer.h"
 #include "../Client/PlaybackTrackerPanel.h"
-#include "../Client/PlayWave.h"
+#include "../Client/ClientMixer.h"
+#include "../MemoryHelper.h"
+#include "ClientControlThread.h"
+#include <winioctl.h>
 
 /*------------------------------------------------------------------------------------------------------------------
 -- FUNCTION: MusicBuffer
 --
 -- DATE: April 5, 2015
 --
--- REVISIONS: (Date and Description)
+-- REVISIONS: October 18, 2026 - Create the temporary file instead of allocating the buffer.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -42,20 +59,36 @@
 --	RETURNS: nothing.
 --
 --	NOTES:
---  This is the constructor for the Music Reader it will allocate memory for the buffer and will instatiate the semaphore
---	and mutex.
+--  This is the constructor for the Music Reader it will create the temporary file for the buffer and will instatiate
+--	the event and mutex. Nothing is mapped until data arrives.
 ----------------------------------------------------------------------------------------------------------------------*/
-MusicBuffer::MusicBuffer(PlaybackTrackerPanel* TrackerP, PlayWave* musicplaya)
+MusicBuffer::MusicBuffer(PlaybackTrackerPanel* TrackerP, ClientMixer* clientMixer)
 {
-	musicplayer = musicplaya;
+	mixer = clientMixer;
 	TrackerPanel = TrackerP;
-	buffer = (char*)malloc(sizeof(char) * SUPERSIZEBUF);
 	writeindex = 0;
 	readindex = 0;
-	song_startindex = 0;
+	releasedindex = 0;
+	currentsong_size = 0;
+	bpss = 1;
 	playing = 1;
+	songs = 0;
+	songPending = false;
+
+	seekStarted.QuadPart = 0;
+	seekRemote = false;
+	memset(seekLatency, 0, sizeof(seekLatency));
+	songStarted.QuadPart = 0;
+	memset(&startLatency, 0, sizeof(startLatency));
+
+	mapping = NULL;
+	capacity = 0;
+	readView.base = NULL;
+	writeView.base = NULL;
+	createFile();
 
-	canRead = CreateSemaphore(NULL, 0, SUPERSIZEBUF, NULL);
+	lowMemory = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+	canRead = CreateEvent(NULL, FALSE, FALSE, NULL);
 	mutexx = CreateMutex(NULL, FALSE, NULL);
 }
 
@@ -64,7 +97,7 @@ MusicBuffer::MusicBuffer(PlaybackTrackerPanel* TrackerP, PlayWave* musicplaya)
 --
 -- DATE: April 5, 2015
 --
--- REVISIONS: (Date and Description)
+-- REVISIONS: October 18, 2026 - Unmap the windows and close the temporary file, which deletes it.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -79,7 +112,23 @@ MusicBuffer::MusicBuffer(PlaybackTrackerPanel* TrackerP, PlayWave* musicplaya)
 ----------------------------------------------------------------------------------------------------------------------*/
 MusicBuffer::~MusicBuffer()
 {
-	free(buffer);
+	logStats();
+
+	unmapView(&readView);
+	unmapView(&writeView);
+	if (mapping != NULL)
+	{
+		CloseHandle(mapping);
+	}
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file);
+	}
+
+	if (lowMemory != NULL)
+	{
+		CloseHandle(lowMemory);
+	}
 	CloseHandle(canRead);
 	CloseHandle(mutexx);
 }
@@ -89,7 +138,10 @@ MusicBuffer::~MusicBuffer()
 --
 -- DATE: April 5, 2015
 --
--- REVISIONS: (Date and Description)
+-- REVISIONS: October 18, 2026 - Write through the mapped window of the temporary file, and give back what has been
+--	played when memory runs low.
+--			October 18, 2026 - Tell the mixer how much is left to read, so it can follow the drift of the stream.
+--			October 18, 2026 - Hold the data aside while the next song waits for the current one to be played out.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -103,33 +155,38 @@ MusicBuffer::~MusicBuffer()
 --	RETURNS: nothing.
 --
 --	NOTES:
---  This function will write the data into the buffer. it is guarded by a mutex.
+--  This function will write the data into the buffer. it is guarded by a mutex. The data is dropped if the file
+--	cannot be grown to hold it. Once nextSong has been called, the data belongs to the next song, and is held aside
+--	until the reader has played out the current one; if playback is stopped, the next song is started right away.
 ----------------------------------------------------------------------------------------------------------------------*/
 void MusicBuffer::writeBuf(char* data, int len)
 {
-	unsigned long wdifference;
-
 	WaitForSingleObject(mutexx, INFINITE);
 
-	if (writeindex + len > SUPERSIZEBUF)
+	FormatPacket started;
+	bool carried = songPending && !playing;
+	if (carried)
 	{
-		wdifference = writeindex + len - SUPERSIZEBUF - 1;
-		memcpy(buffer + writeindex, data, wdifference);
-		writeindex = 0;
-		memcpy(buffer + writeindex, data + wdifference, len - wdifference);
-		writeindex = len - wdifference;
+		carryOn(&started);
+	}
+
+	if (songPending)
+	{
+		pendingData.insert(pendingData.end(), data, data + len);
 	}
 	else
 	{
-		memcpy(buffer + writeindex, data, len);
-		writeindex += len;
+		store(data, len);
 	}
 
-	double current_wpercentage = (double) (writeindex - song_startindex) / currentsong_size;
-	TrackerPanel->setPercentageBuffered(current_wpercentage);
-
+	mixer->setMusicBacklog(writeindex - readindex + pendingData.size());
 	ReleaseMutex(mutexx);
-	ReleaseSemaphore(canRead, 1, NULL);
+	SetEvent(canRead);
+
+	if (carried)
+	{
+		ClientControlThread::getInstance()->nextSongStarted(&started);
+	}
 }
 
 /*------------------------------------------------------------------------------------------------------------------
@@ -137,7 +194,11 @@ void MusicBuffer::writeBuf(char* data, int len)
 --
 -- DATE: April 5, 2015
 --
--- REVISIONS: (Date and Description)
+-- REVISIONS: October 18, 2026 - Wait until len bytes have been written past the read index, instead of for one
+--	write, and read through the mapped window of the temporary file.
+--			October 18, 2026 - Finish timing the time to first audio of a new song.
+--			October 18, 2026 - Tell the mixer how much is left to read.
+--			October 18, 2026 - Carry on into the next song once the current one is played out, within the same read.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -148,38 +209,69 @@ void MusicBuffer::writeBuf(char* data, int len)
 --  data : pointer to location to store the data
 --	len : length of data to be read in bytes
 --
---	RETURNS: nothing.
+--	RETURNS: 1 if data was read, 0 if playback is stopped.
 --
 --	NOTES:
---  This function will read the data into the pointer passed. it is guarded by a mutex and a semaphore.
+--  This function will read the data into the pointer passed. it is guarded by a mutex and an event. A read that
+--	runs past the end of the current song is finished from the start of the next one, if it is waiting, so there is
+--	no gap between them.
 ----------------------------------------------------------------------------------------------------------------------*/
 int MusicBuffer::readBuf(char* data, int len)
 {
 	if (playing)
 	{
-		unsigned long rdifference;
-
-		WaitForSingleObject(canRead, INFINITE);
 		WaitForSingleObject(mutexx, INFINITE);
 
-		if (readindex + len > SUPERSIZEBUF)
+		// wait for enough data to be written, counting what the next song has so far
+		while (readindex + len > writeindex + pendingData.size())
 		{
-			rdifference = readindex + len - SUPERSIZEBUF - 1;
-			memcpy(data, buffer + readindex, rdifference);
-			readindex = 0;
-			memcpy(data + rdifference, buffer + readindex, len - rdifference);
-			readindex = len - rdifference;
+			ReleaseMutex(mutexx);
+			WaitForSingleObject(canRead, INFINITE);
+			if (!playing)
+			{
+				return 0;
+			}
+			WaitForSingleObject(mutexx, INFINITE);
 		}
-		else
+
+		int left = (int) min((unsigned long) len, writeindex - readindex);
+		fetch(data, left);
+
+		FormatPacket started;
+		bool carried = left < len;
+		if (carried)
 		{
-			memcpy(data, buffer + readindex, len);
-			readindex += len;
+			carryOn(&started);
+			fetch(data + left, len - left);
 		}
 
-		double current_rpercentage = (double)(readindex - song_startindex) / currentsong_size;
-		TrackerPanel->setTrackerPercentage(current_rpercentage, false);
+		if (currentsong_size > 0)
+		{
+			double current_rpercentage = (double) readindex / currentsong_size;
+			TrackerPanel->setTrackerPercentage(current_rpercentage, false);
+		}
 
+		if (seekStarted.QuadPart != 0)
+		{
+			finishSeek();
+		}
+
+		if (songStarted.QuadPart != 0)
+		{
+			double ms = record(&startLatency, &songStarted);
+
+			wchar_t s[128];
+			swprintf(s, 128, L"time to first audio %.1f ms\n", ms);
+			OutputDebugString(s);
+		}
+
+		mixer->setMusicBacklog(writeindex - readindex + pendingData.size());
 		ReleaseMutex(mutexx);
+
+		if (carried)
+		{
+			ClientControlThread::getInstance()->nextSongStarted(&started);
+		}
 		return 1;
 	}
 
@@ -191,7 +283,9 @@ int MusicBuffer::readBuf(char* data, int len)
 --
 -- DATE: April 5, 2015
 --
--- REVISIONS: (Date and Description)
+-- REVISIONS: October 18, 2026 - Seek anywhere in the part of the song that has been received and not given back.
+--		October 18, 2026 - Flush the music from the mixer instead of restarting the speakers, so voice plays on.
+--		October 18, 2026 - Tell the mixer how much is left to read.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -204,27 +298,29 @@ int MusicBuffer::readBuf(char* data, int len)
 --	RETURNS: nothing.
 --
 --	NOTES:
---  This function will set the current readindex to the desired one.
+--  This function will set the current readindex to the desired one. Seeking to a part of the song that was given
+--	back under memory pressure goes to the earliest part that is still held instead. Use isBuffered to find out if
+--	the position is held, and restartAt to have the stream start over from one that isn't.
 ----------------------------------------------------------------------------------------------------------------------*/
 void MusicBuffer::seekBuf(double percentage)
 {
 	WaitForSingleObject(mutexx, INFINITE);
 
 	unsigned long index = percentage * currentsong_size;
-	index = song_startindex + index;
+	index = max(index, releasedindex);
 
 	index /= bpss;
 	index *= bpss;
 
-	musicplayer->stopPlaying();
+	mixer->flushMusic();
 	
 	if (index < writeindex)
 	{
 			readindex = index;		
+			startSeek(false);
 	}
 
-	musicplayer->resumePlaying();
-
+	mixer->setMusicBacklog(writeindex - readindex + pendingData.size());
 	ReleaseMutex(mutexx);
 }
 
@@ -233,38 +329,709 @@ void MusicBuffer::seekBuf(double percentage)
 --
 -- DATE: April 5, 2015
 --
--- REVISIONS: (Date and Description)
+-- REVISIONS: October 18, 2026 - Start the new song at the beginning of the temporary file, and give back the
+--	space used by the old one.
+--			October 18, 2026 - Start timing the time to first audio.
+--			October 18, 2026 - Tell the mixer how much is left to read.
+--			October 18, 2026 - Start at the offset of the audio in the song, since the header isn't streamed, and
+--	drop the next song if one was waiting.
 --
 -- DESIGNER: Manuel Gonzales
 --
 -- PROGRAMMER: Manuel Gonzales
 --
--- INTERFACE: void MusicBuffer::newSong()
+-- INTERFACE: void MusicBuffer::newSong(unsigned long song_size, int bps, unsigned long data_offset)
+--
+--	song_size : size of the audio of the song
+--	bps : bits per sample of the song
+--	data_offset : offset of the audio in the song
 --
 --	RETURNS: nothing.
 --
 --	NOTES:
---  This function will set the current read index to match the write index. This means a new song has started
---  and it should stop reading data form the old one.
+--  This function will discard the old song and start over at the start of the buffer. This means a new song has
+--  started and it should stop reading data form the old one. The buffer holds the song at the same offsets as its
+--	file, so positions in the song can be used as they are. The file is sized for the whole song up front; being
+--	sparse, only what is written takes up space.
 ----------------------------------------------------------------------------------------------------------------------*/
-void MusicBuffer::newSong(unsigned long song_size, int bps)
+void MusicBuffer::newSong(unsigned long song_size, int bps, unsigned long data_offset)
 {
 	WaitForSingleObject(mutexx, INFINITE);
 
-	currentsong_size = song_size;
-	song_startindex = writeindex;
-	readindex = writeindex;
-	bpss = bps / 8;
+	logStats();
+
+	// throw the old song away
+	unmapView(&readView);
+	unmapView(&writeView);
+	release(writeindex);
+
+	++songs;
+	songPending = false;
+	pendingData.clear();
+	currentsong_size = data_offset + song_size;
+	writeindex = data_offset;
+	readindex = data_offset;
+	releasedindex = data_offset;
+	seekStarted.QuadPart = 0;
+	QueryPerformanceCounter(&songStarted);
+	bpss = max(bps / 8, 1);
+	reserve(currentsong_size);
 
+	mixer->setMusicBacklog(0);
 	ReleaseMutex(mutexx);
 }
 
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: nextSong
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Hold the next song aside instead of waiting for the current one to be played out.
+--
+-- DESIGNER: Manuel Gonzales
+--
+-- PROGRAMMER: Manuel Gonzales
+--
+-- INTERFACE: void MusicBuffer::nextSong(FormatPacket* format)
+--
+--	format : the song the stream goes on to
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Called by the writer when the stream goes on to the next song on its own; everything written after it belongs to
+--	the next song. The writer carries on right away: the reader finishes the current song, and starts the next one
+--	like newSong does once it is played out, so none of either is cut off. If a song is already waiting, it is
+--	started now, and the rest of the current song is dropped.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::nextSong(FormatPacket* format)
+{
+	WaitForSingleObject(mutexx, INFINITE);
+
+	FormatPacket started;
+	bool carried = songPending;
+	if (carried)
+	{
+		carryOn(&started);
+	}
+
+	songPending = true;
+	pendingSong = *format;
+	pendingData.clear();
+
+	ReleaseMutex(mutexx);
+
+	if (carried)
+	{
+		ClientControlThread::getInstance()->nextSongStarted(&started);
+	}
+}
+
 void MusicBuffer::stopEnqueue()
 {
 	playing = 0;
+	mixer->setMusicPaused(true);
+
+	// wake the reader if it is waiting for data, so it sees playback stopped
+	SetEvent(canRead);
 }
 
 void MusicBuffer::resumeEnqueue()
 {
 	playing = 1;
-}
\ No newline at end of file
+	mixer->setMusicPaused(false);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: isBuffered
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: bool MusicBuffer::isBuffered(double percentage)
+--
+--  percentage : position in the current song, from 0 to 1
+--
+--	RETURNS: true if seekBuf can seek to the position.
+--
+--	NOTES:
+--  Tells if the position in the song has been received, and not given back since.
+----------------------------------------------------------------------------------------------------------------------*/
+bool MusicBuffer::isBuffered(double percentage)
+{
+	WaitForSingleObject(mutexx, INFINITE);
+
+	unsigned long index = percentage * currentsong_size;
+	bool buffered = index >= releasedindex && index < writeindex;
+
+	ReleaseMutex(mutexx);
+	return buffered;
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: restartAt
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026 - Flush the music from the mixer instead of restarting the speakers, so voice plays on.
+--			October 18, 2026 - Tell the mixer how much is left to read.
+--			October 18, 2026 - Drop the next song if one was waiting.
+--
+-- INTERFACE: void MusicBuffer::restartAt(unsigned long index)
+--
+--  index : offset into the current song the stream will start over from
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Called when the server is asked to stream the current song from a position that isn't buffered. Throws away
+--	what is held of the song, and has the data written from now on stored from index onwards. The time until the
+--	first audio from index is read is measured as the latency of the seek.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::restartAt(unsigned long index)
+{
+	WaitForSingleObject(mutexx, INFINITE);
+
+	mixer->flushMusic();
+
+	unmapView(&readView);
+	unmapView(&writeView);
+	release(writeindex);
+
+	songPending = false;
+	pendingData.clear();
+	releasedindex = index;
+	writeindex = index;
+	readindex = index;
+	startSeek(true);
+
+	mixer->setMusicBacklog(0);
+	ReleaseMutex(mutexx);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: getStats
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::getStats(MusicBufferStats* stats)
+--
+--  stats : set to the statistics of the buffer
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Reports how much of the song is held, how much of it is mapped into memory and how much of that is resident, and
+--	how much of the temporary file is allocated on disk.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::getStats(MusicBufferStats* stats)
+{
+	WaitForSingleObject(mutexx, INFINITE);
+
+	stats->held = writeindex - releasedindex;
+	stats->released = releasedindex;
+	stats->mapped = 0;
+	stats->resident = 0;
+	stats->stored = 0;
+
+	View* views[] = { &readView, &writeView };
+	for (int i = 0; i < 2; ++i)
+	{
+		if (views[i]->base != NULL)
+		{
+			stats->mapped += MUSIC_VIEW_SIZE;
+			stats->resident += residentBytes(views[i]->base, MUSIC_VIEW_SIZE);
+		}
+	}
+
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		FILE_STANDARD_INFO info;
+		if (GetFileInformationByHandleEx(file, FileStandardInfo, &info, sizeof(info)))
+		{
+			stats->stored = info.AllocationSize.QuadPart;
+		}
+	}
+
+	ReleaseMutex(mutexx);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: createFile
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::createFile()
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Creates the sparse temporary file the songs are kept in. The file is deleted when it is closed. If it cannot be
+--	created, the buffer is backed by the paging file instead.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::createFile()
+{
+	wchar_t dir[MAX_PATH];
+	wchar_t name[MAX_PATH];
+
+	file = INVALID_HANDLE_VALUE;
+	if (GetTempPath(MAX_PATH, dir) && GetTempFileName(dir, L"cam", 0, name))
+	{
+		file = CreateFile(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+			FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	}
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		#ifdef DEBUG
+		MessageBox(NULL, L"Could not create the music buffer file", L"Error", MB_ICONERROR);
+		#endif
+		return;
+	}
+
+	DWORD useless;
+	DeviceIoControl(file, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &useless, NULL);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: store
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::store(char* data, int len)
+--
+--  data : data to store in the current song
+--	len : length of data in bytes
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Writes the data at the write index through the mapped window of the temporary file, and gives back what has been
+--	played when memory runs low. The data is dropped if the file cannot be grown to hold it. Must be called with the
+--	mutex held.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::store(char* data, int len)
+{
+	if (!reserve(writeindex + len))
+	{
+		return;
+	}
+
+	// copy the data a window at a time
+	for (int copied = 0; copied < len;)
+	{
+		char* dest = mapView(&writeView, writeindex);
+		int piece = min(len - copied, (int) (MUSIC_VIEW_SIZE - writeindex % MUSIC_VIEW_SIZE));
+		if (dest == NULL)
+		{
+			break;
+		}
+
+		memcpy(dest, data + copied, piece);
+		copied += piece;
+		writeindex += piece;
+	}
+
+	// give back the windows that have already been played when memory runs low
+	BOOL low = FALSE;
+	if (lowMemory != NULL && QueryMemoryResourceNotification(lowMemory, &low) && low)
+	{
+		release(readindex - readindex % MUSIC_VIEW_SIZE);
+	}
+
+	if (currentsong_size > 0)
+	{
+		double current_wpercentage = (double) writeindex / currentsong_size;
+		TrackerPanel->setPercentageBuffered(current_wpercentage);
+	}
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: fetch
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::fetch(char* data, int len)
+--
+--  data : pointer to location to store the data
+--	len : length of data to be read in bytes; no more than has been written past the read index
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Reads the data at the read index through the mapped window of the temporary file. What cannot be mapped is read
+--	as silence. Must be called with the mutex held.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::fetch(char* data, int len)
+{
+	// copy the data a window at a time
+	for (int copied = 0; copied < len;)
+	{
+		char* src = mapView(&readView, readindex);
+		int piece = min(len - copied, (int) (MUSIC_VIEW_SIZE - readindex % MUSIC_VIEW_SIZE));
+		if (src == NULL)
+		{
+			memset(data + copied, 0, len - copied);
+			readindex += len - copied;
+			break;
+		}
+
+		memcpy(data + copied, src, piece);
+		copied += piece;
+		readindex += piece;
+	}
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: carryOn
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::carryOn(FormatPacket* started)
+--
+--  started : set to the song that was started
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Starts the song that was waiting like newSong does, and stores what has been written of it so far. The caller
+--	lets the control thread know the song started once it has released the mutex. Must be called with the mutex held,
+--	and a song waiting.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::carryOn(FormatPacket* started)
+{
+	std::vector<char> data;
+	data.swap(pendingData);
+	*started = pendingSong;
+
+	newSong(started->size, started->bps, started->dataOffset);
+	if (!data.empty())
+	{
+		store(&data[0], (int) data.size());
+	}
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: reserve
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: bool MusicBuffer::reserve(unsigned long size)
+--
+--  size : number of bytes the buffer must be able to hold
+--
+--	RETURNS: true if the buffer can hold size bytes.
+--
+--	NOTES:
+--  Grows the file mapping to hold at least size bytes, in whole windows. The mapping is grown to twice what is
+--	needed, so a song that runs past its expected size doesn't remap it on every write. A buffer backed by the
+--	paging file can only grow while it is empty. Must be called with the mutex held.
+----------------------------------------------------------------------------------------------------------------------*/
+bool MusicBuffer::reserve(unsigned long size)
+{
+	if (size <= capacity && mapping != NULL)
+	{
+		return true;
+	}
+
+	// a mapping of the paging file loses its contents when it is recreated
+	if (file == INVALID_HANDLE_VALUE && mapping != NULL && writeindex > 0)
+	{
+		return false;
+	}
+
+	unsigned long needed = (max(size, 1UL) + MUSIC_VIEW_SIZE - 1) / MUSIC_VIEW_SIZE * MUSIC_VIEW_SIZE;
+	if (capacity > 0)
+	{
+		needed *= 2;
+	}
+
+	unmapView(&readView);
+	unmapView(&writeView);
+	if (mapping != NULL)
+	{
+		CloseHandle(mapping);
+	}
+
+	mapping = CreateFileMapping(file, NULL, PAGE_READWRITE, 0, needed, NULL);
+	if (mapping == NULL)
+	{
+		#ifdef DEBUG
+		MessageBox(NULL, L"Could not map the music buffer file", L"Error", MB_ICONERROR);
+		#endif
+		capacity = 0;
+		return false;
+	}
+
+	capacity = needed;
+	return true;
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: mapView
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: char* MusicBuffer::mapView(View* view, unsigned long index)
+--
+--  view : the window to move
+--	index : index in the buffer the window must hold
+--
+--	RETURNS: address of index in the window, or NULL if it could not be mapped.
+--
+--	NOTES:
+--  Moves the window to the part of the file holding index, unless it is already there. Must be called with the
+--	mutex held.
+----------------------------------------------------------------------------------------------------------------------*/
+char* MusicBuffer::mapView(View* view, unsigned long index)
+{
+	unsigned long offset = index - index % MUSIC_VIEW_SIZE;
+
+	if (view->base == NULL || view->offset != offset)
+	{
+		unmapView(view);
+		if (mapping == NULL || offset + MUSIC_VIEW_SIZE > capacity)
+		{
+			return NULL;
+		}
+
+		view->base = (char*) MapViewOfFile(mapping, FILE_MAP_WRITE, 0, offset, MUSIC_VIEW_SIZE);
+		view->offset = offset;
+		if (view->base == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	return view->base + index % MUSIC_VIEW_SIZE;
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: unmapView
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::unmapView(View* view)
+--
+--  view : the window to unmap
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Unmaps the window, if it is mapped. The data stays in the file.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::unmapView(View* view)
+{
+	if (view->base != NULL)
+	{
+		UnmapViewOfFile(view->base);
+		view->base = NULL;
+	}
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: release
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::release(unsigned long upto)
+--
+--  upto : index up to which the buffer is given back
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Gives back the start of the buffer by turning it back into holes in the sparse file. It can no longer be seeked
+--	to. Must be called with the mutex held, and the read window must not be in the released part.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::release(unsigned long upto)
+{
+	if (file == INVALID_HANDLE_VALUE || upto <= releasedindex)
+	{
+		return;
+	}
+
+	// the windows being released must not be mapped
+	if (writeView.base != NULL && writeView.offset < upto)
+	{
+		unmapView(&writeView);
+	}
+
+	FILE_ZERO_DATA_INFORMATION zero;
+	DWORD useless;
+	zero.FileOffset.QuadPart = releasedindex;
+	zero.BeyondFinalZero.QuadPart = upto;
+	if (DeviceIoControl(file, FSCTL_SET_ZERO_DATA, &zero, sizeof(zero), NULL, 0, &useless, NULL))
+	{
+		releasedindex = upto;
+	}
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: logStats
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::logStats()
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Logs the memory used by the buffer for the current song.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::logStats()
+{
+	MusicBufferStats stats;
+	getStats(&stats);
+
+	wchar_t s[256];
+	swprintf(s, 256, L"music buffer: held %lu KB, mapped %lu KB, resident %llu KB, on disk %llu KB, released %lu KB\n",
+		stats.held / 1024, stats.mapped / 1024, stats.resident / 1024, stats.stored / 1024, stats.released / 1024);
+	OutputDebugString(s);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: getSeekLatency
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::getSeekLatency(PlaybackLatency* local, PlaybackLatency* remote)
+--
+--  local : set to the latencies of seeks within what was buffered
+--	remote : set to the latencies of seeks the server had to stream from
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Copies the seek latencies measured so far.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::getSeekLatency(PlaybackLatency* local, PlaybackLatency* remote)
+{
+	WaitForSingleObject(mutexx, INFINITE);
+	*local = seekLatency[0];
+	*remote = seekLatency[1];
+	ReleaseMutex(mutexx);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: getStartLatency
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::getStartLatency(PlaybackLatency* start)
+--
+--  start : set to the times from a new song being started until its first audio was handed to the player
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Copies the time to first audio measured so far, for the songs joined or switched to.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::getStartLatency(PlaybackLatency* start)
+{
+	WaitForSingleObject(mutexx, INFINITE);
+	*start = startLatency;
+	ReleaseMutex(mutexx);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: startSeek
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::startSeek(bool remote)
+--
+--  remote : true if the server has to stream from the new position
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Starts timing a seek. Must be called with the mutex held.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::startSeek(bool remote)
+{
+	QueryPerformanceCounter(&seekStarted);
+	seekRemote = remote;
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: finishSeek
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void MusicBuffer::finishSeek()
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Finishes timing the pending seek, once the first audio from the new position has been read. Must be called with
+--	the mutex held.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBuffer::finishSeek()
+{
+	double ms = record(&seekLatency[seekRemote ? 1 : 0], &seekStarted);
+
+	wchar_t s[128];
+	swprintf(s, 128, L"seek took %.1f ms (%s)\n", ms, seekRemote ? L"streamed by the server" : L"buffered");
+	OutputDebugString(s);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: record
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: double MusicBuffer::record(PlaybackLatency* latency, LARGE_INTEGER* started)
+--
+--  latency : statistics to add the latency to
+--	started : performance counter value of when the latency started; cleared
+--
+--	RETURNS: the latency in milliseconds.
+--
+--	NOTES:
+--  Adds the time since started to the statistics. Must be called with the mutex held.
+----------------------------------------------------------------------------------------------------------------------*/
+double MusicBuffer::record(PlaybackLatency* latency, LARGE_INTEGER* started)
+{
+	LARGE_INTEGER now, freq;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&freq);
+	double ms = (double) (now.QuadPart - started->QuadPart) * 1000 / freq.QuadPart;
+	started->QuadPart = 0;
+
+	++latency->count;
+	latency->totalMs += ms;
+	latency->maxMs = max(latency->maxMs, ms);
+	return ms;
+}
@@ -1,33 +1,116 @@
 #include "../Common.h"
+#include <vector>
 
-#define SUPERSIZEBUF	99999999
+/*
+	Size of the windows of the temporary file that are mapped into memory at
+	a time; a multiple of the allocation granularity.
+*/
+#define MUSIC_VIEW_SIZE		(1024*1024)
+
+/*
+	Statistics about the memory used by a MusicBuffer.
+
+	held; bytes of the current song that can still be played or seeked to
+	mapped; bytes of the temporary file mapped into memory
+	resident; bytes of the mapped windows in the working set of the process
+	stored; bytes of the temporary file actually allocated on disk
+	released; bytes of the current song given back under memory pressure
+*/
+struct MusicBufferStats
+{
+	unsigned long held;
+	unsigned long mapped;
+	unsigned long long resident;
+	unsigned long long stored;
+	unsigned long released;
+};
+
+/*
+	Latency until the first audio is handed to the player; after a seek, from
+	the seek, and after a new song, from the song being started.
+
+	count; number of latencies measured
+	totalMs; sum of the latencies in milliseconds
+	maxMs; largest of the latencies in milliseconds
+*/
+struct PlaybackLatency
+{
+	int count;
+	double totalMs;
+	double maxMs;
+};
 
 class PlaybackTrackerPanel;
-class PlayWave;
+class ClientMixer;
 
 class MusicBuffer
 {
 private:
-	char* buffer;
+	/*
+		A window of the temporary file mapped into memory.
+	*/
+	struct View
+	{
+		char* base;
+		unsigned long offset;
+	};
+
+	HANDLE file;
+	HANDLE mapping;
+	HANDLE lowMemory;
+	unsigned long capacity;
+	View readView;
+	View writeView;
+
 	unsigned long writeindex;
 	unsigned long readindex;
+	unsigned long releasedindex;
 	unsigned long currentsong_size;
-	unsigned long song_startindex;
 	int playing;
 	int bpss;
+	unsigned long songs;
+
+	bool songPending;
+	FormatPacket pendingSong;
+	std::vector<char> pendingData;
+
+	LARGE_INTEGER seekStarted;
+	bool seekRemote;
+	PlaybackLatency seekLatency[2];
+	LARGE_INTEGER songStarted;
+	PlaybackLatency startLatency;
 
 	PlaybackTrackerPanel* TrackerPanel;
-	PlayWave* musicplayer;
+	ClientMixer* mixer;
 	HANDLE canRead;
 	HANDLE mutexx;
 
+	void createFile();
+	void store(char* data, int len);
+	void fetch(char* data, int len);
+	void carryOn(FormatPacket* started);
+	bool reserve(unsigned long size);
+	char* mapView(View* view, unsigned long index);
+	void unmapView(View* view);
+	void release(unsigned long upto);
+	void logStats();
+	void startSeek(bool remote);
+	void finishSeek();
+	double record(PlaybackLatency* latency, LARGE_INTEGER* started);
+
 public:
-	MusicBuffer(PlaybackTrackerPanel* TrackerP, PlayWave* musicplaya);
+	MusicBuffer(PlaybackTrackerPanel* TrackerP, ClientMixer* clientMixer);
 	~MusicBuffer();
 	void writeBuf(char* data, int len);
 	int readBuf(char* data, int len);
 	void seekBuf(double percentage);
-	void newSong(unsigned long song_size, int bps);
+	bool isBuffered(double percentage);
+	void restartAt(unsigned long index);
+	void newSong(unsigned long song_size, int bps, unsigned long data_offset);
+	void nextSong(FormatPacket* format);
 	void stopEnqueue();
 	void resumeEnqueue();
-};
\ No newline at end of file
+	void getStats(MusicBufferStats* stats);
+	void getSeekLatency(PlaybackLatency* local, PlaybackLatency* remote);
+	void getStartLatency(PlaybackLatency* start);
+};
@@ -7,11 +7,15 @@
 	static DWORD WINAPI fileThread(LPVOID lpParameter);
 	DWORD ThreadStart(void);	
 	void clearBuffer();
+	void queueSong(FormatPacket* format);
+	void skipLead(int index, int len);
 	int getSize();
 --
 -- DATE: April 4, 2015
 --
 -- REVISIONS: April 5, Added music buffer support instead of using a text file.
+--			October 18, 2026 - Go on to the next song of the stream where the server announced it starts.
+--			October 18, 2026 - Split the packet the end of a song shares with the start of the next one.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -50,6 +54,9 @@ MusicBufferer::MusicBufferer(JitterBuffer* musicJB, MusicBuffer* mbuffer) : musi
 {
 	elementSize = music_jitter->getElementSize();
 	music_buffer = mbuffer;
+	songQueued = false;
+	skipLen = 0;
+	access = CreateMutex(NULL, FALSE, NULL);
 
 	HANDLE ThreadHandle;
 	DWORD ThreadId;
@@ -92,7 +99,8 @@ MusicBufferer::~MusicBufferer()
 --
 -- DATE: April 4, 2015
 --
--- REVISIONS: (Date and Description)
+-- REVISIONS: October 18, 2026 - Forget the song queued by queueSong.
+--			October 18, 2026 - Forget the bytes to skip set by skipLead.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -100,18 +108,77 @@ MusicBufferer::~MusicBufferer()
 --
 -- INTERFACE: void MusicBufferer::clearBuffer()
 --
---	lpParameter : instance of the object
---
 --	RETURNS: nothing.
 --
 --	NOTES:
---  This function will move the index on themusic buffer so the reader cna start reading from the new song.
+--  This function is called when the stream is changed or starts over, so a song announced by the old stream isn't
+--	started in the middle of the new one.
 ----------------------------------------------------------------------------------------------------------------------*/
 void MusicBufferer::clearBuffer()
 {
-	//musicfile = fopen("tempmusic.txt", "wb");
-	//fseek(musicfile, 0, SEEK_SET);
-	//music_buffer->newSong();
+	WaitForSingleObject(access, INFINITE);
+	songQueued = false;
+	skipLen = 0;
+	ReleaseMutex(access);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: queueSong
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- DESIGNER: Manuel Gonzales
+--
+-- PROGRAMMER: Manuel Gonzales
+--
+-- INTERFACE: void MusicBufferer::queueSong(FormatPacket* format)
+--
+--	format : the song the stream goes on to, and the index of its first packet
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  This function is called for every announcement of the next song the server multicasts. Once the packet the song
+--	starts at comes out of the jitter buffer, the music buffer goes on to the song.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBufferer::queueSong(FormatPacket* format)
+{
+	WaitForSingleObject(access, INFINITE);
+	queuedSong = *format;
+	songQueued = true;
+	ReleaseMutex(access);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: skipLead
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- DESIGNER: Manuel Gonzales
+--
+-- PROGRAMMER: Manuel Gonzales
+--
+-- INTERFACE: void MusicBufferer::skipLead(int index, int len)
+--
+--	index : index of the packet
+--	len : bytes at the start of the packet to skip
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  This function is called before a prefill whose first packet starts with the end of the song before the one being
+--	joined. Those bytes are dropped when the packet comes out of the jitter buffer.
+----------------------------------------------------------------------------------------------------------------------*/
+void MusicBufferer::skipLead(int index, int len)
+{
+	WaitForSingleObject(access, INFINITE);
+	skipIndex = index;
+	skipLen = min(max(len, 0), elementSize);
+	ReleaseMutex(access);
 }
 
 /*------------------------------------------------------------------------------------------------------------------
@@ -146,6 +213,10 @@ DWORD WINAPI MusicBufferer::fileThread(LPVOID lpParameter)
 -- DATE: April 4, 2015
 --
 -- REVISIONS: April 5 Added music buffer.
+--			October 18, 2026 - Skip gets that come back empty after the jitter buffer is reset.
+--			October 18, 2026 - Start the queued song at the packet it starts at.
+--			October 18, 2026 - Write the end of the current song before starting the queued one, instead of waiting
+--	for it to be played out.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -162,13 +233,46 @@ DWORD MusicBufferer::ThreadStart(void)
 {
 	//musicfile = fopen("tempmusic.txt", "wb");	
 	char* music_data = (char*) malloc (sizeof(char) * elementSize);
-
+	int index;
 
 	while(true)
 	{
 		WaitForSingleObject(music_jitter->canGet,INFINITE);
-		music_jitter->get(music_data);
-		music_buffer->writeBuf(music_data, elementSize);
+		if (!music_jitter->get(music_data, &index))
+		{
+			continue;
+		}
+
+		// go on to the queued song once its first packet comes out; or a little
+		// after, if the announcement came late
+		WaitForSingleObject(access, INFINITE);
+		bool starts = songQueued && (unsigned int) (index - queuedSong.firstIndex) < MAX_JB_SIZE;
+		FormatPacket format = queuedSong;
+		if (starts)
+		{
+			songQueued = false;
+		}
+		int skip = 0;
+		if (skipLen > 0 && index == skipIndex)
+		{
+			skip = skipLen;
+			skipLen = 0;
+		}
+		ReleaseMutex(access);
+
+		// the packet the song starts at begins with the end of the current one
+		if (starts)
+		{
+			int lead = index == format.firstIndex ? min(max(format.lead, 0), elementSize) : 0;
+			if (lead > 0)
+			{
+				music_buffer->writeBuf(music_data, lead);
+			}
+			music_buffer->nextSong(&format);
+			skip = lead;
+		}
+
+		music_buffer->writeBuf(music_data + skip, elementSize - skip);
 	}
 }
 
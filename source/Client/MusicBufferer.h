@@ -13,6 +13,11 @@ private:
 	int elementSize;
 	JitterBuffer* music_jitter;
 	MusicBuffer* music_buffer;
+	FormatPacket queuedSong;
+	bool songQueued;
+	int skipIndex;
+	int skipLen;
+	HANDLE access;
 	static DWORD WINAPI fileThread(LPVOID lpParameter);
 	DWORD ThreadStart(void);
 
@@ -20,6 +25,8 @@ public:
 	MusicBufferer(JitterBuffer* musicJB, MusicBuffer* musicB);
 	~MusicBufferer();
 	void clearBuffer();
+	void queueSong(FormatPacket* format);
+	void skipLead(int index, int len);
 	int getSize();
 };
 
@@ -0,0 +1,837 @@
+#include "PcmKernels.h"
+#include <math.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PCM_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+// static function forward declarations
+
+static inline short saturate16(int sample);
+
+#ifdef PCM_X86
+static int sse2U8ToS16(short* dest, const unsigned char* src, int count);
+static int sse2S16ToU8(unsigned char* dest, const short* src, int count);
+static int sse2S16ToFloat(float* dest, const short* src, int count);
+static int sse2FloatToS16(short* dest, const float* src, int count);
+static int sse2Interleave(short* dest, const short* left, const short* right, int frames);
+static int sse2Deinterleave(short* left, short* right, const short* src, int frames);
+static int sse2StereoToMono(short* dest, const short* src, int frames);
+static int sse2GainS16(short* dest, const short* src, short gain, int count);
+static int sse2GainU8(unsigned char* dest, const unsigned char* src, short gain, int count);
+static int sse2Accumulate(int* total, const short* samples, short gain, int count);
+static int sse2Saturate(short* dest, const int* total, int count);
+static int sse2Mix(short* dest, const short* const* sources, const short* gains,
+    int sourceCount, int count);
+
+static int avx2U8ToS16(short* dest, const unsigned char* src, int count);
+static int avx2S16ToU8(unsigned char* dest, const short* src, int count);
+static int avx2S16ToFloat(float* dest, const short* src, int count);
+static int avx2FloatToS16(short* dest, const float* src, int count);
+static int avx2Interleave(short* dest, const short* left, const short* right, int frames);
+static int avx2Deinterleave(short* left, short* right, const short* src, int frames);
+static int avx2StereoToMono(short* dest, const short* src, int frames);
+static int avx2GainS16(short* dest, const short* src, short gain, int count);
+static int avx2GainU8(unsigned char* dest, const unsigned char* src, short gain, int count);
+static int avx2Accumulate(int* total, const short* samples, short gain, int count);
+static int avx2Saturate(short* dest, const int* total, int count);
+static int avx2Mix(short* dest, const short* const* sources, const short* gains,
+    int sourceCount, int count);
+#endif
+
+// pcm kernels implementation
+
+int PcmKernels::level = -1;
+
+int PcmKernels::getLevel()
+{
+    return _level();
+}
+
+/**
+ * picks the version of the kernels that is used from now on; used to compare
+ *   them. a level the processor doesn't support falls back to the best one
+ *   it does.
+ *
+ * @date     2026-10-18
+ *
+ * @param    level   one of {PCM_LEVEL_SCALAR}, {PCM_LEVEL_SSE2} or
+ *   {PCM_LEVEL_AVX2}.
+ *
+ * @return   the level that is used.
+ */
+int PcmKernels::setLevel(int level)
+{
+    int best = getBestLevel();
+    PcmKernels::level = level < PCM_LEVEL_SCALAR ? PCM_LEVEL_SCALAR
+        : level > best ? best : level;
+    return PcmKernels::level;
+}
+
+/**
+ * @return   the best version of the kernels the processor, and the system,
+ *   supports.
+ */
+int PcmKernels::getBestLevel()
+{
+#ifdef PCM_X86
+#ifdef _MSC_VER
+    // AVX2 needs the system to save the AVX registers as well
+    int info[4];
+    __cpuid(info,0);
+    if(info[0] >= 7)
+    {
+        __cpuid(info,1);
+        bool avx = (info[2]&(1 << 27)) && (info[2]&(1 << 28))
+            && (_xgetbv(0)&6) == 6;
+        __cpuidex(info,7,0);
+        if(avx && (info[1]&(1 << 5)))
+        {
+            return PCM_LEVEL_AVX2;
+        }
+    }
+    return PCM_LEVEL_SSE2;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? PCM_LEVEL_AVX2
+        : __builtin_cpu_supports("sse2") ? PCM_LEVEL_SSE2 : PCM_LEVEL_SCALAR;
+#endif
+#else
+    return PCM_LEVEL_SCALAR;
+#endif
+}
+
+const char* PcmKernels::getLevelName(int level)
+{
+    return level == PCM_LEVEL_AVX2 ? "avx2" : level == PCM_LEVEL_SSE2 ? "sse2" : "scalar";
+}
+
+/**
+ * converts a gain to fixed point, keeping it between 0 and {PCM_MAX_GAIN}.
+ */
+short PcmKernels::toGain(float gain)
+{
+    float fixed = gain*PCM_UNITY_GAIN+0.5f;
+    float most  = (float) (PCM_MAX_GAIN << PCM_GAIN_BITS)-1;
+    return (short) (fixed < 0 ? 0 : fixed > most ? most : fixed);
+}
+
+/**
+ * converts unsigned 8 bit samples to signed 16 bit ones.
+ *
+ * @date     2026-10-18
+ */
+void PcmKernels::u8ToS16(short* dest, const unsigned char* src, int count)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2U8ToS16(dest,src,count)
+        : level == PCM_LEVEL_SSE2 ? sse2U8ToS16(dest,src,count) : 0;
+#endif
+    for(; i < count; ++i)
+    {
+        dest[i] = (short) ((src[i]-128) << 8);
+    }
+}
+
+/**
+ * converts signed 16 bit samples to unsigned 8 bit ones, dropping the low
+ *   byte.
+ *
+ * @date     2026-10-18
+ */
+void PcmKernels::s16ToU8(unsigned char* dest, const short* src, int count)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2S16ToU8(dest,src,count)
+        : level == PCM_LEVEL_SSE2 ? sse2S16ToU8(dest,src,count) : 0;
+#endif
+    for(; i < count; ++i)
+    {
+        dest[i] = (unsigned char) ((src[i] >> 8)+128);
+    }
+}
+
+/**
+ * converts signed 16 bit samples to floats between -1 and 1.
+ *
+ * @date     2026-10-18
+ */
+void PcmKernels::s16ToFloat(float* dest, const short* src, int count)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2S16ToFloat(dest,src,count)
+        : level == PCM_LEVEL_SSE2 ? sse2S16ToFloat(dest,src,count) : 0;
+#endif
+    for(; i < count; ++i)
+    {
+        dest[i] = src[i]*(1.0f/32768);
+    }
+}
+
+/**
+ * converts floats between -1 and 1 to signed 16 bit samples, rounded to the
+ *   nearest, and saturating the ones out of range.
+ *
+ * @date     2026-10-18
+ */
+void PcmKernels::floatToS16(short* dest, const float* src, int count)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2FloatToS16(dest,src,count)
+        : level == PCM_LEVEL_SSE2 ? sse2FloatToS16(dest,src,count) : 0;
+#endif
+    for(; i < count; ++i)
+    {
+        float sample = src[i]*32768;
+        sample = sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample;
+        dest[i] = (short) lrintf(sample);
+    }
+}
+
+/**
+ * interleaves two channels into stereo frames.
+ *
+ * @date     2026-10-18
+ */
+void PcmKernels::interleave(short* dest, const short* left, const short* right, int frames)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2Interleave(dest,left,right,frames)
+        : level == PCM_LEVEL_SSE2 ? sse2Interleave(dest,left,right,frames) : 0;
+#endif
+    for(; i < frames; ++i)
+    {
+        dest[i*2]   = left[i];
+        dest[i*2+1] = right[i];
+    }
+}
+
+/**
+ * splits stereo frames into two channels.
+ *
+ * @date     2026-10-18
+ */
+void PcmKernels::deinterleave(short* left, short* right, const short* src, int frames)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2Deinterleave(left,right,src,frames)
+        : level == PCM_LEVEL_SSE2 ? sse2Deinterleave(left,right,src,frames) : 0;
+#endif
+    for(; i < frames; ++i)
+    {
+        left[i]  = src[i*2];
+        right[i] = src[i*2+1];
+    }
+}
+
+/**
+ * repeats mono samples into both channels of stereo frames.
+ *
+ * @date     2026-10-18
+ */
+void PcmKernels::monoToStereo(short* dest, const short* src, int frames)
+{
+    interleave(dest,src,src,frames);
+}
+
+/**
+ * mixes stereo frames down to mono, averaging the two channels.
+ *
+ * @date     2026-10-18
+ */
+void PcmKernels::stereoToMono(short* dest, const short* src, int frames)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2StereoToMono(dest,src,frames)
+        : level == PCM_LEVEL_SSE2 ? sse2StereoToMono(dest,src,frames) : 0;
+#endif
+    for(; i < frames; ++i)
+    {
+        dest[i] = (short) ((src[i*2]+src[i*2+1]) >> 1);
+    }
+}
+
+/**
+ * multiplies signed 16 bit samples by a gain, saturating the ones that
+ *   don't fit. {dest} may be {src}.
+ *
+ * @date     2026-10-18
+ *
+ * @param    gain   gain with {PCM_GAIN_BITS} fraction bits.
+ */
+void PcmKernels::gainS16(short* dest, const short* src, short gain, int count)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2GainS16(dest,src,gain,count)
+        : level == PCM_LEVEL_SSE2 ? sse2GainS16(dest,src,gain,count) : 0;
+#endif
+    for(; i < count; ++i)
+    {
+        dest[i] = saturate16((src[i]*gain+(1 << (PCM_GAIN_BITS-1))) >> PCM_GAIN_BITS);
+    }
+}
+
+/**
+ * multiplies unsigned 8 bit samples by a gain, around their middle value of
+ *   128, saturating the ones that don't fit. {dest} may be {src}.
+ *
+ * @date     2026-10-18
+ *
+ * @param    gain   gain with {PCM_GAIN_BITS} fraction bits.
+ */
+void PcmKernels::gainU8(unsigned char* dest, const unsigned char* src, short gain, int count)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2GainU8(dest,src,gain,count)
+        : level == PCM_LEVEL_SSE2 ? sse2GainU8(dest,src,gain,count) : 0;
+#endif
+    for(; i < count; ++i)
+    {
+        short sample = saturate16((((src[i]-128) << 8)*gain+(1 << (PCM_GAIN_BITS-1))) >> PCM_GAIN_BITS);
+        dest[i] = (unsigned char) ((sample >> 8)+128);
+    }
+}
+
+/**
+ * adds samples, multiplied by a gain, to a 32 bit total; the products keep
+ *   {PCM_GAIN_BITS} fraction bits.
+ *
+ * @date     2026-10-18
+ *
+ * @param    gain   gain with {PCM_GAIN_BITS} fraction bits.
+ */
+void PcmKernels::accumulate(int* total, const short* samples, short gain, int count)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2Accumulate(total,samples,gain,count)
+        : level == PCM_LEVEL_SSE2 ? sse2Accumulate(total,samples,gain,count) : 0;
+#endif
+    for(; i < count; ++i)
+    {
+        total[i] += samples[i]*gain;
+    }
+}
+
+/**
+ * rounds a total made by {accumulate} back to 16 bit samples, saturating the
+ *   ones that don't fit.
+ *
+ * @date     2026-10-18
+ */
+void PcmKernels::saturate(short* dest, const int* total, int count)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2Saturate(dest,total,count)
+        : level == PCM_LEVEL_SSE2 ? sse2Saturate(dest,total,count) : 0;
+#endif
+    for(; i < count; ++i)
+    {
+        dest[i] = saturate16((total[i]+(1 << (PCM_GAIN_BITS-1))) >> PCM_GAIN_BITS);
+    }
+}
+
+/**
+ * adds up many sources, each multiplied by its gain, in one pass; the sum is
+ *   kept in 32 bit registers, and only rounded and saturated back to 16 bits
+ *   once every source has been added.
+ *
+ * @date     2026-10-18
+ *
+ * @param    dest   where to put the {count} mixed samples.
+ * @param    sources   {count} samples of each source.
+ * @param    gains   gain of each source, with {PCM_GAIN_BITS} fraction bits.
+ * @param    sourceCount   number of sources; up to {PCM_MAX_SOURCES}.
+ * @param    count   number of samples.
+ */
+void PcmKernels::mix(short* dest, const short* const* sources, const short* gains,
+    int sourceCount, int count)
+{
+    int i = 0;
+#ifdef PCM_X86
+    int level = _level();
+    i = level == PCM_LEVEL_AVX2 ? avx2Mix(dest,sources,gains,sourceCount,count)
+        : level == PCM_LEVEL_SSE2 ? sse2Mix(dest,sources,gains,sourceCount,count) : 0;
+#endif
+    for(; i < count; ++i)
+    {
+        int sum = 0;
+        for(int s = 0; s < sourceCount; ++s)
+        {
+            sum += sources[s][i]*gains[s];
+        }
+        dest[i] = saturate16((sum+(1 << (PCM_GAIN_BITS-1))) >> PCM_GAIN_BITS);
+    }
+}
+
+/**
+ * @return   the level of the kernels; the best one supported, the first time
+ *   it is asked for, unless one was set.
+ */
+int PcmKernels::_level()
+{
+    if(level < 0)
+    {
+        level = getBestLevel();
+    }
+    return level;
+}
+
+// static function implementations
+
+short saturate16(int sample)
+{
+    return (short) (sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample);
+}
+
+#ifdef PCM_X86
+
+// sse2 kernels; each returns the number of samples, or frames, it did, and
+// leaves the rest to the plain version
+
+/**
+ * multiplies eight 16 bit samples by a gain; the low and high halves of the
+ *   products are interleaved back into 32 bits, rounded, and saturated.
+ */
+static inline __m128i sse2Gain(__m128i samples, __m128i gain)
+{
+    __m128i half = _mm_set1_epi32(1 << (PCM_GAIN_BITS-1));
+    __m128i lo = _mm_mullo_epi16(samples,gain);
+    __m128i hi = _mm_mulhi_epi16(samples,gain);
+    __m128i a  = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo,hi),half),PCM_GAIN_BITS);
+    __m128i b  = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo,hi),half),PCM_GAIN_BITS);
+    return _mm_packs_epi32(a,b);
+}
+
+int sse2U8ToS16(short* dest, const unsigned char* src, int count)
+{
+    __m128i bias = _mm_set1_epi8((char) 0x80);
+    __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (src+i)),bias);
+        _mm_storeu_si128((__m128i*) (dest+i),_mm_unpacklo_epi8(zero,x));
+        _mm_storeu_si128((__m128i*) (dest+i+8),_mm_unpackhi_epi8(zero,x));
+    }
+    return i;
+}
+
+int sse2S16ToU8(unsigned char* dest, const short* src, int count)
+{
+    __m128i bias = _mm_set1_epi8((char) 0x80);
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m128i a = _mm_srai_epi16(_mm_loadu_si128((const __m128i*) (src+i)),8);
+        __m128i b = _mm_srai_epi16(_mm_loadu_si128((const __m128i*) (src+i+8)),8);
+        _mm_storeu_si128((__m128i*) (dest+i),_mm_xor_si128(_mm_packs_epi16(a,b),bias));
+    }
+    return i;
+}
+
+int sse2S16ToFloat(float* dest, const short* src, int count)
+{
+    __m128 scale = _mm_set1_ps(1.0f/32768);
+    int i = 0;
+    for(; i+8 <= count; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*) (src+i));
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(x,x),16);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(x,x),16);
+        _mm_storeu_ps(dest+i,_mm_mul_ps(_mm_cvtepi32_ps(a),scale));
+        _mm_storeu_ps(dest+i+4,_mm_mul_ps(_mm_cvtepi32_ps(b),scale));
+    }
+    return i;
+}
+
+int sse2FloatToS16(short* dest, const float* src, int count)
+{
+    __m128 scale = _mm_set1_ps(32768);
+    __m128 most  = _mm_set1_ps(32767);
+    __m128 least = _mm_set1_ps(-32768);
+    int i = 0;
+    for(; i+8 <= count; i += 8)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src+i),scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src+i+4),scale);
+        a = _mm_max_ps(_mm_min_ps(a,most),least);
+        b = _mm_max_ps(_mm_min_ps(b,most),least);
+        _mm_storeu_si128((__m128i*) (dest+i),_mm_packs_epi32(_mm_cvtps_epi32(a),_mm_cvtps_epi32(b)));
+    }
+    return i;
+}
+
+int sse2Interleave(short* dest, const short* left, const short* right, int frames)
+{
+    int i = 0;
+    for(; i+8 <= frames; i += 8)
+    {
+        __m128i l = _mm_loadu_si128((const __m128i*) (left+i));
+        __m128i r = _mm_loadu_si128((const __m128i*) (right+i));
+        _mm_storeu_si128((__m128i*) (dest+i*2),_mm_unpacklo_epi16(l,r));
+        _mm_storeu_si128((__m128i*) (dest+i*2+8),_mm_unpackhi_epi16(l,r));
+    }
+    return i;
+}
+
+int sse2Deinterleave(short* left, short* right, const short* src, int frames)
+{
+    int i = 0;
+    for(; i+8 <= frames; i += 8)
+    {
+        // each frame is a 32 bit lane; the left sample is its low half
+        __m128i a = _mm_loadu_si128((const __m128i*) (src+i*2));
+        __m128i b = _mm_loadu_si128((const __m128i*) (src+i*2+8));
+        __m128i la = _mm_srai_epi32(_mm_slli_epi32(a,16),16);
+        __m128i lb = _mm_srai_epi32(_mm_slli_epi32(b,16),16);
+        _mm_storeu_si128((__m128i*) (left+i),_mm_packs_epi32(la,lb));
+        _mm_storeu_si128((__m128i*) (right+i),_mm_packs_epi32(_mm_srai_epi32(a,16),_mm_srai_epi32(b,16)));
+    }
+    return i;
+}
+
+int sse2StereoToMono(short* dest, const short* src, int frames)
+{
+    __m128i ones = _mm_set1_epi16(1);
+    int i = 0;
+    for(; i+8 <= frames; i += 8)
+    {
+        __m128i a = _mm_madd_epi16(_mm_loadu_si128((const __m128i*) (src+i*2)),ones);
+        __m128i b = _mm_madd_epi16(_mm_loadu_si128((const __m128i*) (src+i*2+8)),ones);
+        _mm_storeu_si128((__m128i*) (dest+i),_mm_packs_epi32(_mm_srai_epi32(a,1),_mm_srai_epi32(b,1)));
+    }
+    return i;
+}
+
+int sse2GainS16(short* dest, const short* src, short gain, int count)
+{
+    __m128i g = _mm_set1_epi16(gain);
+    int i = 0;
+    for(; i+8 <= count; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*) (src+i));
+        _mm_storeu_si128((__m128i*) (dest+i),sse2Gain(x,g));
+    }
+    return i;
+}
+
+int sse2GainU8(unsigned char* dest, const unsigned char* src, short gain, int count)
+{
+    __m128i bias = _mm_set1_epi8((char) 0x80);
+    __m128i zero = _mm_setzero_si128();
+    __m128i g = _mm_set1_epi16(gain);
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (src+i)),bias);
+        __m128i a = _mm_srai_epi16(sse2Gain(_mm_unpacklo_epi8(zero,x),g),8);
+        __m128i b = _mm_srai_epi16(sse2Gain(_mm_unpackhi_epi8(zero,x),g),8);
+        _mm_storeu_si128((__m128i*) (dest+i),_mm_xor_si128(_mm_packs_epi16(a,b),bias));
+    }
+    return i;
+}
+
+int sse2Accumulate(int* total, const short* samples, short gain, int count)
+{
+    __m128i g = _mm_set1_epi16(gain);
+    int i = 0;
+    for(; i+8 <= count; i += 8)
+    {
+        __m128i s  = _mm_loadu_si128((const __m128i*) (samples+i));
+        __m128i lo = _mm_mullo_epi16(s,g);
+        __m128i hi = _mm_mulhi_epi16(s,g);
+
+        __m128i* t = (__m128i*) (total+i);
+        _mm_storeu_si128(t,_mm_add_epi32(_mm_loadu_si128(t),_mm_unpacklo_epi16(lo,hi)));
+        _mm_storeu_si128(t+1,_mm_add_epi32(_mm_loadu_si128(t+1),_mm_unpackhi_epi16(lo,hi)));
+    }
+    return i;
+}
+
+int sse2Saturate(short* dest, const int* total, int count)
+{
+    __m128i half = _mm_set1_epi32(1 << (PCM_GAIN_BITS-1));
+    int i = 0;
+    for(; i+8 <= count; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*) (total+i));
+        __m128i b = _mm_loadu_si128((const __m128i*) (total+i+4));
+        a = _mm_srai_epi32(_mm_add_epi32(a,half),PCM_GAIN_BITS);
+        b = _mm_srai_epi32(_mm_add_epi32(b,half),PCM_GAIN_BITS);
+        _mm_storeu_si128((__m128i*) (dest+i),_mm_packs_epi32(a,b));
+    }
+    return i;
+}
+
+int sse2Mix(short* dest, const short* const* sources, const short* gains,
+    int sourceCount, int count)
+{
+    __m128i half = _mm_set1_epi32(1 << (PCM_GAIN_BITS-1));
+    __m128i g[PCM_MAX_SOURCES];
+    for(int s = 0; s < sourceCount; ++s)
+    {
+        g[s] = _mm_set1_epi16(gains[s]);
+    }
+
+    int i = 0;
+    for(; i+8 <= count; i += 8)
+    {
+        __m128i a = half;
+        __m128i b = half;
+        for(int s = 0; s < sourceCount; ++s)
+        {
+            __m128i x  = _mm_loadu_si128((const __m128i*) (sources[s]+i));
+            __m128i lo = _mm_mullo_epi16(x,g[s]);
+            __m128i hi = _mm_mulhi_epi16(x,g[s]);
+            a = _mm_add_epi32(a,_mm_unpacklo_epi16(lo,hi));
+            b = _mm_add_epi32(b,_mm_unpackhi_epi16(lo,hi));
+        }
+        a = _mm_srai_epi32(a,PCM_GAIN_BITS);
+        b = _mm_srai_epi32(b,PCM_GAIN_BITS);
+        _mm_storeu_si128((__m128i*) (dest+i),_mm_packs_epi32(a,b));
+    }
+    return i;
+}
+
+// avx2 kernels; the 256 bit unpacks and packs work within each 128 bit half,
+// so some results are put back in order with a permute
+
+/**
+ * multiplies sixteen 16 bit samples by a gain, like {sse2Gain}; unpacking
+ *   and packing within each half leaves the samples in order.
+ */
+AVX2_TARGET static inline __m256i avx2Gain(__m256i samples, __m256i gain)
+{
+    __m256i half = _mm256_set1_epi32(1 << (PCM_GAIN_BITS-1));
+    __m256i lo = _mm256_mullo_epi16(samples,gain);
+    __m256i hi = _mm256_mulhi_epi16(samples,gain);
+    __m256i a  = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(lo,hi),half),PCM_GAIN_BITS);
+    __m256i b  = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(lo,hi),half),PCM_GAIN_BITS);
+    return _mm256_packs_epi32(a,b);
+}
+
+AVX2_TARGET int avx2U8ToS16(short* dest, const unsigned char* src, int count)
+{
+    __m128i bias = _mm_set1_epi8((char) 0x80);
+    int i = 0;
+    for(; i+32 <= count; i += 32)
+    {
+        __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (src+i)),bias);
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (src+i+16)),bias);
+        _mm256_storeu_si256((__m256i*) (dest+i),_mm256_slli_epi16(_mm256_cvtepi8_epi16(a),8));
+        _mm256_storeu_si256((__m256i*) (dest+i+16),_mm256_slli_epi16(_mm256_cvtepi8_epi16(b),8));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2S16ToU8(unsigned char* dest, const short* src, int count)
+{
+    __m256i bias = _mm256_set1_epi8((char) 0x80);
+    int i = 0;
+    for(; i+32 <= count; i += 32)
+    {
+        __m256i a = _mm256_srai_epi16(_mm256_loadu_si256((const __m256i*) (src+i)),8);
+        __m256i b = _mm256_srai_epi16(_mm256_loadu_si256((const __m256i*) (src+i+16)),8);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a,b),0xD8);
+        _mm256_storeu_si256((__m256i*) (dest+i),_mm256_xor_si256(packed,bias));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2S16ToFloat(float* dest, const short* src, int count)
+{
+    __m256 scale = _mm256_set1_ps(1.0f/32768);
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m256i a = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (src+i)));
+        __m256i b = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (src+i+8)));
+        _mm256_storeu_ps(dest+i,_mm256_mul_ps(_mm256_cvtepi32_ps(a),scale));
+        _mm256_storeu_ps(dest+i+8,_mm256_mul_ps(_mm256_cvtepi32_ps(b),scale));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2FloatToS16(short* dest, const float* src, int count)
+{
+    __m256 scale = _mm256_set1_ps(32768);
+    __m256 most  = _mm256_set1_ps(32767);
+    __m256 least = _mm256_set1_ps(-32768);
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src+i),scale);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src+i+8),scale);
+        a = _mm256_max_ps(_mm256_min_ps(a,most),least);
+        b = _mm256_max_ps(_mm256_min_ps(b,most),least);
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a),_mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i*) (dest+i),_mm256_permute4x64_epi64(packed,0xD8));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2Interleave(short* dest, const short* left, const short* right, int frames)
+{
+    int i = 0;
+    for(; i+16 <= frames; i += 16)
+    {
+        __m256i l  = _mm256_loadu_si256((const __m256i*) (left+i));
+        __m256i r  = _mm256_loadu_si256((const __m256i*) (right+i));
+        __m256i lo = _mm256_unpacklo_epi16(l,r);
+        __m256i hi = _mm256_unpackhi_epi16(l,r);
+        _mm256_storeu_si256((__m256i*) (dest+i*2),_mm256_permute2x128_si256(lo,hi,0x20));
+        _mm256_storeu_si256((__m256i*) (dest+i*2+16),_mm256_permute2x128_si256(lo,hi,0x31));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2Deinterleave(short* left, short* right, const short* src, int frames)
+{
+    int i = 0;
+    for(; i+16 <= frames; i += 16)
+    {
+        __m256i a  = _mm256_loadu_si256((const __m256i*) (src+i*2));
+        __m256i b  = _mm256_loadu_si256((const __m256i*) (src+i*2+16));
+        __m256i la = _mm256_srai_epi32(_mm256_slli_epi32(a,16),16);
+        __m256i lb = _mm256_srai_epi32(_mm256_slli_epi32(b,16),16);
+        __m256i l  = _mm256_packs_epi32(la,lb);
+        __m256i r  = _mm256_packs_epi32(_mm256_srai_epi32(a,16),_mm256_srai_epi32(b,16));
+        _mm256_storeu_si256((__m256i*) (left+i),_mm256_permute4x64_epi64(l,0xD8));
+        _mm256_storeu_si256((__m256i*) (right+i),_mm256_permute4x64_epi64(r,0xD8));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2StereoToMono(short* dest, const short* src, int frames)
+{
+    __m256i ones = _mm256_set1_epi16(1);
+    int i = 0;
+    for(; i+16 <= frames; i += 16)
+    {
+        __m256i a = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i*) (src+i*2)),ones);
+        __m256i b = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i*) (src+i*2+16)),ones);
+        __m256i mono = _mm256_packs_epi32(_mm256_srai_epi32(a,1),_mm256_srai_epi32(b,1));
+        _mm256_storeu_si256((__m256i*) (dest+i),_mm256_permute4x64_epi64(mono,0xD8));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2GainS16(short* dest, const short* src, short gain, int count)
+{
+    __m256i g = _mm256_set1_epi16(gain);
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (src+i));
+        _mm256_storeu_si256((__m256i*) (dest+i),avx2Gain(x,g));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2GainU8(unsigned char* dest, const unsigned char* src, short gain, int count)
+{
+    __m128i bias = _mm_set1_epi8((char) 0x80);
+    __m256i g = _mm256_set1_epi16(gain);
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (src+i)),bias);
+        __m256i y = _mm256_srai_epi16(avx2Gain(_mm256_slli_epi16(_mm256_cvtepi8_epi16(x),8),g),8);
+
+        // the 8 bit samples of both halves end up in the low 64 bits of each
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(y,y),0x08);
+        _mm_storeu_si128((__m128i*) (dest+i),_mm_xor_si128(_mm256_castsi256_si128(packed),bias));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2Accumulate(int* total, const short* samples, short gain, int count)
+{
+    __m256i g = _mm256_set1_epi16(gain);
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m256i s  = _mm256_loadu_si256((const __m256i*) (samples+i));
+        __m256i lo = _mm256_mullo_epi16(s,g);
+        __m256i hi = _mm256_mulhi_epi16(s,g);
+        __m256i a  = _mm256_unpacklo_epi16(lo,hi);
+        __m256i b  = _mm256_unpackhi_epi16(lo,hi);
+
+        __m256i* t = (__m256i*) (total+i);
+        _mm256_storeu_si256(t,_mm256_add_epi32(_mm256_loadu_si256(t),_mm256_permute2x128_si256(a,b,0x20)));
+        _mm256_storeu_si256(t+1,_mm256_add_epi32(_mm256_loadu_si256(t+1),_mm256_permute2x128_si256(a,b,0x31)));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2Saturate(short* dest, const int* total, int count)
+{
+    __m256i half = _mm256_set1_epi32(1 << (PCM_GAIN_BITS-1));
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (total+i));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (total+i+8));
+        a = _mm256_srai_epi32(_mm256_add_epi32(a,half),PCM_GAIN_BITS);
+        b = _mm256_srai_epi32(_mm256_add_epi32(b,half),PCM_GAIN_BITS);
+        _mm256_storeu_si256((__m256i*) (dest+i),_mm256_permute4x64_epi64(_mm256_packs_epi32(a,b),0xD8));
+    }
+    return i;
+}
+
+AVX2_TARGET int avx2Mix(short* dest, const short* const* sources, const short* gains,
+    int sourceCount, int count)
+{
+    __m256i half = _mm256_set1_epi32(1 << (PCM_GAIN_BITS-1));
+    int i = 0;
+    for(; i+16 <= count; i += 16)
+    {
+        __m256i a = half;
+        __m256i b = half;
+        for(int s = 0; s < sourceCount; ++s)
+        {
+            __m256i g  = _mm256_set1_epi16(gains[s]);
+            __m256i x  = _mm256_loadu_si256((const __m256i*) (sources[s]+i));
+            __m256i lo = _mm256_mullo_epi16(x,g);
+            __m256i hi = _mm256_mulhi_epi16(x,g);
+            a = _mm256_add_epi32(a,_mm256_unpacklo_epi16(lo,hi));
+            b = _mm256_add_epi32(b,_mm256_unpackhi_epi16(lo,hi));
+        }
+        a = _mm256_srai_epi32(a,PCM_GAIN_BITS);
+        b = _mm256_srai_epi32(b,PCM_GAIN_BITS);
+        _mm256_storeu_si256((__m256i*) (dest+i),_mm256_packs_epi32(a,b));
+    }
+    return i;
+}
+
+#endif
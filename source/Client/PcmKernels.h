@@ -0,0 +1,83 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: PcmKernels.h
+--
+-- NOTES:
+-- The sample level processing of the client's audio; the
+-- conversions between unsigned 8 bit, signed 16 bit and float
+-- samples, between mono, stereo and separate channels, gain,
+-- and the sum of many sources.
+--
+-- Every kernel has an AVX2, an SSE2 and a plain version. The
+-- best one the processor supports is picked the first time a
+-- kernel is called; {setLevel} picks another, so they can be
+-- compared. All of them give exactly the same results.
+--
+-- Gains are fixed point numbers with {PCM_GAIN_BITS} fraction
+-- bits; products are rounded, and saturated wherever they
+-- don't fit.
+--
+-- Nothing here depends on the platform but the processor; the
+-- SIMD versions are only built for x86.
+--------------------------------------------------------------*/
+#ifndef PCMKERNELS_H
+#define PCMKERNELS_H
+
+/**
+ * fraction bits of a gain; a gain of 1 is 1 << {PCM_GAIN_BITS}.
+ */
+#define PCM_GAIN_BITS 8
+#define PCM_UNITY_GAIN (1 << PCM_GAIN_BITS)
+
+/**
+ * most sources {PcmKernels::mix} adds up at a time; gains are kept below
+ *   {PCM_MAX_GAIN}, so their 32 bit sum can't overflow.
+ */
+#define PCM_MAX_SOURCES 64
+#define PCM_MAX_GAIN 4
+
+/**
+ * versions of the kernels.
+ */
+#define PCM_LEVEL_SCALAR 0
+#define PCM_LEVEL_SSE2 1
+#define PCM_LEVEL_AVX2 2
+
+class PcmKernels
+{
+public:
+    static int getLevel();
+    static int setLevel(int level);
+    static int getBestLevel();
+    static const char* getLevelName(int level);
+
+    static short toGain(float gain);
+
+    static void u8ToS16(short* dest, const unsigned char* src, int count);
+    static void s16ToU8(unsigned char* dest, const short* src, int count);
+    static void s16ToFloat(float* dest, const short* src, int count);
+    static void floatToS16(short* dest, const float* src, int count);
+
+    static void interleave(short* dest, const short* left, const short* right, int frames);
+    static void deinterleave(short* left, short* right, const short* src, int frames);
+    static void monoToStereo(short* dest, const short* src, int frames);
+    static void stereoToMono(short* dest, const short* src, int frames);
+
+    static void gainS16(short* dest, const short* src, short gain, int count);
+    static void gainU8(unsigned char* dest, const unsigned char* src, short gain, int count);
+
+    static void accumulate(int* total, const short* samples, short gain, int count);
+    static void saturate(short* dest, const int* total, int count);
+    static void mix(short* dest, const short* const* sources, const short* gains,
+        int sourceCount, int count);
+
+private:
+    static int _level();
+
+    /**
+     * version of the kernels that is used; -1 until the first kernel is
+     *   called.
+     */
+    static int level;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include "PcmKernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#ifdef TEST_PCM_KERNELS
+
+/**
+ * test and benchmark of the PcmKernels. the kernels depend on nothing but the
+ *   processor, so it runs on any platform.
+ *
+ * every level the processor supports is checked against the plain version on
+ *   the same random samples, at lengths that aren't a multiple of any vector,
+ *   so the tails are checked as well; a level that differs in one sample
+ *   fails. then each kernel is run many times over a period of samples at
+ *   each level, and the millions of samples it does per second are reported.
+ */
+
+#define SAMPLES 4099
+#define BENCH_SAMPLES 2048
+#define BENCH_SECONDS 0.2
+#define SOURCES 16
+
+static short s16[SOURCES][SAMPLES*2];
+static unsigned char u8[SAMPLES];
+static float floats[SAMPLES];
+static short gains[SOURCES];
+static const short* sources[SOURCES];
+
+/**
+ * results of every kernel at one level.
+ */
+struct Results
+{
+    short fromU8[SAMPLES];
+    unsigned char toU8[SAMPLES];
+    float toFloat[SAMPLES];
+    short fromFloat[SAMPLES];
+    short interleaved[SAMPLES*2];
+    short left[SAMPLES];
+    short right[SAMPLES];
+    short stereo[SAMPLES*2];
+    short mono[SAMPLES];
+    short gainS16[SAMPLES];
+    unsigned char gainU8[SAMPLES];
+    int total[SAMPLES];
+    short saturated[SAMPLES];
+    short mixed[SAMPLES];
+};
+
+void run(Results* r, int count)
+{
+    PcmKernels::u8ToS16(r->fromU8,u8,count);
+    PcmKernels::s16ToU8(r->toU8,s16[0],count);
+    PcmKernels::s16ToFloat(r->toFloat,s16[0],count);
+    PcmKernels::floatToS16(r->fromFloat,floats,count);
+    PcmKernels::interleave(r->interleaved,s16[0],s16[1],count);
+    PcmKernels::deinterleave(r->left,r->right,s16[2],count);
+    PcmKernels::monoToStereo(r->stereo,s16[3],count);
+    PcmKernels::stereoToMono(r->mono,s16[4],count);
+    PcmKernels::gainS16(r->gainS16,s16[5],gains[5],count);
+    PcmKernels::gainU8(r->gainU8,u8,gains[6],count);
+
+    memset(r->total,0,sizeof(r->total));
+    for(int s = 0; s < SOURCES; ++s)
+    {
+        PcmKernels::accumulate(r->total,sources[s],gains[s],count);
+    }
+    PcmKernels::saturate(r->saturated,r->total,count);
+    PcmKernels::mix(r->mixed,sources,gains,SOURCES,count);
+}
+
+/**
+ * runs a kernel over {BENCH_SAMPLES} samples for {BENCH_SECONDS}.
+ *
+ * @return   millions of samples done per second.
+ */
+template<typename Kernel>
+double benchmark(Kernel kernel)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> taken;
+    long runs = 0;
+    do
+    {
+        for(int i = 0; i < 1000; ++i)
+        {
+            kernel();
+        }
+        runs += 1000;
+        taken = std::chrono::high_resolution_clock::now()-start;
+    }
+    while(taken.count() < BENCH_SECONDS);
+    return runs*(double) BENCH_SAMPLES/taken.count()/1000000;
+}
+
+static short dest[BENCH_SAMPLES*2];
+static short dest2[BENCH_SAMPLES];
+static unsigned char destU8[BENCH_SAMPLES];
+static float destFloat[BENCH_SAMPLES];
+static int total[BENCH_SAMPLES];
+
+void bench(int level)
+{
+    const int n = BENCH_SAMPLES;
+    printf("%-7s",PcmKernels::getLevelName(level));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::u8ToS16(dest,u8,n); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::s16ToU8(destU8,s16[0],n); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::s16ToFloat(destFloat,s16[0],n); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::floatToS16(dest,floats,n); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::interleave(dest,s16[0],s16[1],n/2); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::deinterleave(dest,dest2,s16[2],n/2); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::monoToStereo(dest,s16[3],n/2); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::stereoToMono(dest,s16[4],n/2); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::gainS16(dest,s16[5],gains[5],n); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::gainU8(destU8,u8,gains[6],n); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::accumulate(total,s16[7],gains[7],n); }));
+    printf(" %8.0f",benchmark([&]{ PcmKernels::saturate(dest,total,n); }));
+
+    // the samples of every source count towards the mix
+    printf(" %8.0f\n",SOURCES*benchmark([&]{ PcmKernels::mix(dest,sources,gains,SOURCES,n); }));
+}
+
+int main(void)
+{
+    // random samples, some of them at the extremes, so saturation is hit
+    srand(49);
+    for(int s = 0; s < SOURCES; ++s)
+    {
+        for(int i = 0; i < SAMPLES*2; ++i)
+        {
+            int r = rand()%20;
+            s16[s][i] = (short) (r == 0 ? 32767 : r == 1 ? -32768 : rand()%65536-32768);
+        }
+        gains[s]   = (short) (rand()%(PCM_MAX_GAIN << PCM_GAIN_BITS));
+        sources[s] = s16[s];
+    }
+    gains[0] = PCM_UNITY_GAIN;
+    gains[1] = PCM_MAX_GAIN*PCM_UNITY_GAIN-1;
+    for(int i = 0; i < SAMPLES; ++i)
+    {
+        u8[i]     = (unsigned char) rand();
+        floats[i] = (rand()%3001-1500)/1000.0f;
+    }
+    floats[0] = 0.5f/32768;
+    floats[1] = 1.5f/32768;
+    floats[2] = -2.5f/32768;
+
+    int best = PcmKernels::getBestLevel();
+    int failed = 0;
+    static Results expected;
+    static Results actual;
+    int counts[] = {SAMPLES,1,7,15,31,33,256};
+    for(int c = 0; c < (int) (sizeof(counts)/sizeof(counts[0])); ++c)
+    {
+        PcmKernels::setLevel(PCM_LEVEL_SCALAR);
+        memset(&expected,0,sizeof(expected));
+        run(&expected,counts[c]);
+        for(int level = PCM_LEVEL_SSE2; level <= best; ++level)
+        {
+            PcmKernels::setLevel(level);
+            memset(&actual,0,sizeof(actual));
+            run(&actual,counts[c]);
+            if(memcmp(&expected,&actual,sizeof(expected)) != 0)
+            {
+                printf("%s differs from scalar for %d samples\n",
+                    PcmKernels::getLevelName(level),counts[c]);
+                ++failed;
+            }
+        }
+    }
+    printf("best level %s; %s\n",PcmKernels::getLevelName(best),failed ? "FAILED" : "every level matches scalar");
+
+    printf("\nmillions of samples per second, %d samples at a time\n",BENCH_SAMPLES);
+    printf("level    u8>s16  s16>u8 s16>float float>s16 interlv deinterlv mono>st st>mono gainS16  gainU8   accum   satur   mix%d\n",SOURCES);
+    for(int level = PCM_LEVEL_SCALAR; level <= best; ++level)
+    {
+        PcmKernels::setLevel(level);
+        bench(level);
+    }
+
+    return failed != 0;
+}
+
+#endif
@@ -8,11 +8,12 @@
 #include "../common.h"
 #include "../handlerHelper.h"
 #include "../Buffer/MessageQueue.h"
+#include "WinmmBackend.h"
+#include "PcmKernels.h"
 
 #include <stdio.h>
 
 #pragma warning(disable:4996)
-#pragma comment(lib,"winmm.lib")
 
 #define SAMPLE_RATE 44100
 #define BITS_PER_SAMPLE 8
@@ -20,29 +21,8 @@
 #define BITS_PER_BYTE 8
 #define MILLISEC_PER_SEC 1000
 
-/**
- * interval of time to wait between checks to free allocated audio packets to
- *   play.
- */
-#define CHECK_FOR_FREEING_INTERVAL 100
-
 using namespace std;
 
-////////////////////////////
-// structure declarations //
-////////////////////////////
-
-/**
- * used as thread parameters for the cleanupRoutine.
- */
-struct CrParams
-{
-	PlayWave* dis;
-	WAVEHDR* audioPacket;
-};
-
-typedef struct CrParams CrParams;
-
 /////////////////////////////////////////
 // static function forward declaration //
 /////////////////////////////////////////
@@ -60,22 +40,35 @@ static int stopRoutine(HANDLE* thread, HANDLE stopEvent);
  *
  * @date     2015-04-02T18:28:46-0800
  *
+ * @revision 2026-10-18 {capacity} is the size of the ring of audio headers,
+ *   which is only allocated when the device is opened.
+ *           2026-10-18 each header holds a period of {PLAY_WAVE_PERIOD_MS}
+ *   milliseconds, unless changed with {setPeriod}.
+ *           2026-10-18 plays on {output}, or on the system's speakers if it is
+ *   NULL.
+ *
  * @author   Eric Tsang
  */
-PlayWave::PlayWave(int capacity, MessageQueue* msgq)
+PlayWave::PlayWave(int capacity, MessageQueue* msgq, AudioOutput* output)
 {
 	this->msgq = msgq;
-	this->speakers = 0;
+	this->output = output != NULL ? output : new WinmmOutput();
+	this->ownsOutput = output == NULL;
+	this->deviceOpen = false;
+	this->capacity = capacity;
+	this->queued = 0;
+	this->periodMs = PLAY_WAVE_PERIOD_MS;
+	this->periodBytes = 0;
+	this->filling = 0;
+	this->pending = (char*) malloc(msgq->elementSize);
+	this->pendingOffset = 0;
+	this->pendingLen = 0;
+	this->writes = 0;
+	this->underruns = 0;
 	this->playThread = INVALID_HANDLE_VALUE;
-	this->cleanupThread = INVALID_HANDLE_VALUE;
 	this->playThreadStopEv = CreateEvent(NULL,TRUE,FALSE,NULL);
-	this->cleanupThreadEv = CreateEvent(NULL,TRUE,FALSE,NULL);
-	this->lastAudioPacket = 0;
-	this->lastAudioPacketAccess = CreateMutex(NULL, FALSE, NULL);
-	this->canEnqueue = CreateSemaphore(NULL,capacity,capacity,NULL);
-	this->canDequeue = CreateSemaphore(NULL,0,capacity,NULL);
 	this->interfaceAccess = CreateMutex(NULL, FALSE, NULL);
-	memset(&volume,0xFFFFFFFF,sizeof(volume));
+	this->gain = PCM_UNITY_GAIN;
 }
 
 /**
@@ -90,6 +83,11 @@ PlayWave::~PlayWave()
 {
 	stopPlaying();
 	closeDevice();
+	free(pending);
+	if(ownsOutput)
+	{
+		delete output;
+	}
 }
 
 /**
@@ -98,6 +96,10 @@ PlayWave::~PlayWave()
  *
  * @date     2015-04-03T10:44:30-0800
  *
+ * @revision 2026-10-18 allocates and prepares the ring of audio headers.
+ *           2026-10-18 the device allocates its periods itself, when it is
+ *   opened.
+ *
  * @author   Eric Tsang
  *
  * @param    samplesPerSecond   the number of samples per second the audio device should play
@@ -119,7 +121,6 @@ int PlayWave::startPlaying(
 	{
 		startRoutine(&playThread,playThreadStopEv,playRoutine,this);
 		msgq->clear();
-		setVolume(*(short*)&volume);
 	}
 	else
 	{
@@ -139,23 +140,106 @@ int PlayWave::resumePlaying()
 	return startPlaying(wfx.nSamplesPerSec,wfx.wBitsPerSample,wfx.nChannels);
 }
 
+/**
+ * makes sure audio is being played in the passed format. the device is only
+ *   closed and opened again if it isn't open, or is open in another format,
+ *   so songs of the same format play without the device being reopened.
+ *
+ * @date     2026-10-18
+ *
+ * @param    samplesPerSecond   the number of samples per second the audio device should play
+ * @param    bitsPerSample   the number of bits used per sample for the passed PCM data
+ * @param    numChannels   the number of channels there are in the passed PCM data.
+ *
+ * @return   MMSYSERR_NOERROR if the device was already playing in the format;
+ *   see startPlaying otherwise.
+ */
+int PlayWave::playFormat(
+	int samplesPerSecond,
+	int bitsPerSample,
+	int numChannels)
+{
+	WaitForSingleObject(interfaceAccess,INFINITE);
+	bool same = deviceOpen
+		&& wfx.nSamplesPerSec == samplesPerSecond
+		&& wfx.wBitsPerSample == bitsPerSample
+		&& wfx.nChannels == numChannels;
+	ReleaseMutex(interfaceAccess);
+
+	if(same)
+	{
+		return MMSYSERR_NOERROR;
+	}
+	stopPlaying();
+	return startPlaying(samplesPerSecond,bitsPerSample,numChannels);
+}
+
+/**
+ * sets the volume the audio is played at. the volume is applied to the
+ *   samples as a gain, before they are written to the device, rather than to
+ *   the device itself, which could change the volume of everything else
+ *   playing on it too.
+ *
+ * @date     2026-10-18
+ *
+ * @param    volume   0 for silence, up to 0xFF to play the audio as it is.
+ */
 void PlayWave::setVolume(char volume)
 {
-	char* chrPtr = (char*) &this->volume;
-	chrPtr[0] = volume;
-	chrPtr[1] = volume;
-	if(speakers != 0)
+	gain = (short) ((unsigned char) volume*PCM_UNITY_GAIN/0xFF);
+}
+
+/**
+ * sets how much audio is written to the device at a time. longer periods mean
+ *   fewer writes to the device, and more audio queued ahead of what is heard;
+ *   the audio queued is the period times the capacity. takes effect the next
+ *   time the device is opened.
+ *
+ * @date     2026-10-18
+ *
+ * @param    periodMs   milliseconds of audio in each buffer written to the
+ *   device.
+ */
+void PlayWave::setPeriod(int periodMs)
+{
+	WaitForSingleObject(interfaceAccess,INFINITE);
+	this->periodMs = periodMs;
+	ReleaseMutex(interfaceAccess);
+}
+
+/**
+ * gets the size of the periods written to the device, the latency they add up
+ *   to, and how often the device ran out of them.
+ *
+ * @date     2026-10-18
+ *
+ * @param    stats   filled with the statistics.
+ */
+void PlayWave::getStats(PlayWaveStats* stats)
+{
+	WaitForSingleObject(interfaceAccess,INFINITE);
+	stats->periodMs  = periodMs;
+	if(periodBytes > 0 && wfx.nAvgBytesPerSec > 0)
 	{
-		waveOutSetVolume(speakers,this->volume);
+		stats->periodMs = (double) periodBytes*1000/wfx.nAvgBytesPerSec;
 	}
+	stats->periods   = capacity;
+	stats->latencyMs = stats->periodMs*capacity;
+	stats->writes    = writes;
+	stats->underruns = underruns;
+	ReleaseMutex(interfaceAccess);
 }
 
 /**
- * stops the playing thread, then waits for the cleanup thread to stop as well,
+ * stops the playing thread, and takes back every audio header from the device,
  *   before closing the device and returning.
  *
  * @date     2015-04-03T10:49:13-0800
  *
+ * @revision 2026-10-18 unprepares and frees the ring of audio headers,
+ *   instead of waiting for the cleanup thread.
+ *           2026-10-18 the device takes back its periods when it is closed.
+ *
  * @author   Eric Tsang
  *
  * @return   see closeDevice()
@@ -169,8 +253,9 @@ int PlayWave::stopPlaying()
 	printf("PlayWave::stopPlaying called\n");
 	#endif
 	stopRoutine(&playThread,playThreadStopEv);
-	waveOutReset(speakers);
-	stopRoutine(&cleanupThread,cleanupThreadEv);
+	queued     = 0;
+	filling    = 0;
+	pendingLen = 0;
 
 	#ifdef DEBUG
 	printf("PlayWave::stopPlaying returns\n");
@@ -189,6 +274,12 @@ int PlayWave::stopPlaying()
  *
  * @date     2015-04-02T18:24:49-0800
  *
+ * @revision 2026-10-18 the device sets {headerDone} each time it finishes
+ *   playing an audio header.
+ *           2026-10-18 opens {output}, with room for {capacity} periods of
+ *   {periodMs} milliseconds; a period is a whole number of frames, and at
+ *   least one.
+ *
  * @author   Eric Tsang
  *
  * @param    settings
@@ -199,7 +290,8 @@ int PlayWave::stopPlaying()
  * the data is copied from the passed structure into the object's internal
  *   members, so it can be safely deallocated after this function returns.
  *
- * @return   this function can return the following values:
+ * @return   0 on success. for the system's speakers, this function can return
+ *   the following values:
  *
  * MMSYSERR_NOERROR successfully obtained the audio device.
  *
@@ -231,15 +323,22 @@ int PlayWave::openDevice(
 	wfx.nBlockAlign     = (wfx.wBitsPerSample >> 3) * wfx.nChannels;
 	wfx.nAvgBytesPerSec = wfx.nBlockAlign * wfx.nSamplesPerSec;
 
+	periodBytes = wfx.nAvgBytesPerSec*periodMs/1000;
+	periodBytes -= periodBytes%wfx.nBlockAlign;
+	periodBytes = max(periodBytes,(int) wfx.nBlockAlign);
+	queued      = 0;
+	filling     = 0;
+	pendingLen  = 0;
+
 	// open the audio device
-	int ret = waveOutOpen(&speakers,WAVE_MAPPER,&wfx,0,0,CALLBACK_NULL);
+	int ret = output->open(samplesPerSecond,bitsPerSample,numChannels,periodBytes,capacity);
 
-	// if there is an error opening the device, set our speakers to 0
+	// if there is an error opening the device, close what was opened of it
 	if(ret != MMSYSERR_NOERROR)
 	{
-		perror("unable to open WAVE_MAPPER device\n");
-		speakers = 0;
+		output->close();
 	}
+	deviceOpen = ret == MMSYSERR_NOERROR;
 
 	// return result of trying to get a device
 	return ret;
@@ -251,9 +350,13 @@ int PlayWave::openDevice(
  *
  * @date     2015-04-02T18:55:55-0800
  *
+ * @revision 2026-10-18 closes {output}, which throws away whatever it hadn't
+ *   played.
+ *
  * @author   Eric Tsang
  *
- * @return   this function can return the following values:
+ * @return   0 on success. for the system's speakers, this function can return
+ *   the following values:
  *
  * MMSYSERR_NOERROR; successfully closed the audio device handle.
  *
@@ -268,24 +371,119 @@ int PlayWave::openDevice(
 int PlayWave::closeDevice()
 {
 	// try to close the device
-	int ret = waveOutClose(speakers);
+	int ret = output->close();
 
-	// if success, set our device handle to 0
+	// if success, the device is no longer open
 	if(ret == MMSYSERR_NOERROR)
 	{
-		speakers = 0;
+		deviceOpen = false;
 	}
 
 	// return the result of the operation
 	return ret;
 }
 
+/**
+ * asks the device how many of the periods written are still playing. if they
+ *   have all finished, the device has run out of audio, which is counted as
+ *   an underrun.
+ *
+ * @date     2026-10-18
+ */
+void PlayWave::recyclePeriods()
+{
+	bool playing = queued > 0;
+	queued = output->queued();
+	if(playing && queued == 0)
+	{
+		InterlockedIncrement(&underruns);
+	}
+}
+
+/**
+ * copies what is left of the dequeued element into the device's free
+ *   periods, writing each one as soon as it is whole. if the device has
+ *   nothing left to play, the period is written without waiting for the rest
+ *   of it, to cut the gap short.
+ *
+ * @date     2026-10-18
+ */
+void PlayWave::fillPeriods()
+{
+	while(pendingLen > 0 && queued < capacity)
+	{
+		char* period = output->getPeriod();
+		if(period == NULL)
+		{
+			break;
+		}
+
+		int len = min(pendingLen,periodBytes-filling);
+		memcpy(period+filling,pending+pendingOffset,len);
+		filling       += len;
+		pendingOffset += len;
+		pendingLen    -= len;
+
+		if(filling == periodBytes)
+		{
+			writePeriod();
+		}
+	}
+
+	if(queued == 0 && filling > 0)
+	{
+		writePeriod();
+	}
+}
+
+/**
+ * writes the period being filled to the device, with as much as it holds.
+ *
+ * @date     2026-10-18
+ *
+ * @revision 2026-10-18 applies the volume to the period first.
+ */
+void PlayWave::writePeriod()
+{
+	int len = filling;
+	filling = 0;
+
+	short g = gain;
+	if(g != PCM_UNITY_GAIN)
+	{
+		char* period = output->getPeriod();
+		if(wfx.wBitsPerSample == 8)
+		{
+			PcmKernels::gainU8((unsigned char*) period,(unsigned char*) period,g,len);
+		}
+		else if(wfx.wBitsPerSample == 16)
+		{
+			PcmKernels::gainS16((short*) period,(short*) period,g,len/sizeof(short));
+		}
+	}
+
+	// the period is only in use if the device took it
+	if(output->writePeriod(len) == MMSYSERR_NOERROR)
+	{
+		++queued;
+		InterlockedIncrement(&writes);
+	}
+}
+
 /**
  * the play routine reads audio data from the message queue into the speaker's
  *   output buffers as quickly as possible, until the thread is stopped.
  *
  * @date     2015-04-03T11:12:51-0800
  *
+ * @revision 2026-10-18 while every audio header is playing, waits for the
+ *   device to finish one, instead of for the message queue.
+ *           2026-10-18 elements are gathered into periods before they are
+ *   written; the next element is only dequeued once the last one has been
+ *   copied into the headers.
+ *           2026-10-18 waits on the device for a period to finish, checking
+ *   the stop event in between.
+ *
  * @author   Eric Tsang
  *
  * @param    params   pointer to the calling PlayWave instance.
@@ -305,16 +503,30 @@ DWORD WINAPI PlayWave::playRoutine(void* params)
 	int breakLoop = FALSE;
 	while(!breakLoop)
 	{
-		HANDLE handles[] = {
-			dis->playThreadStopEv,
-			dis->msgq->hasMessage
-		};
+		dis->recyclePeriods();
+		dis->fillPeriods();
+
+		// the device is full; wait for it to finish a period
+		if(dis->pendingLen > 0)
+		{
+			if(WaitForSingleObject(dis->playThreadStopEv,0) == WAIT_OBJECT_0)
+			{
+				breakLoop = TRUE;
+			}
+			else
+			{
+				dis->output->wait(dis->periodMs);
+			}
+			continue;
+		}
+
+		HANDLE handles[] = {dis->playThreadStopEv,dis->msgq->hasMessage};
 		switch(WaitForMultipleObjects(2,handles,FALSE,INFINITE))
 		{
 		case WAIT_OBJECT_0+0:   // stop event triggered
 			breakLoop = TRUE;
 			break;
-		case WAIT_OBJECT_0+1:   // message queue has message
+		case WAIT_OBJECT_0+1:   // the queue has a message
 			dis->handleMsgqMsg();
 			break;
 		default:
@@ -336,126 +548,25 @@ DWORD WINAPI PlayWave::playRoutine(void* params)
  *   all data in the message queue is assumed to be PCM data that should be
  *   played.
  *
- * reads data from the message queue, and enqueues it to the speaker's output
- *   buffer, waiting to be played.
- *
- * this function may block if the speaker's audio buffer is full.
+ * dequeues the next element, to be copied into the device's periods by
+ *   {PlayWave::fillPeriods}.
  *
  * @date     2015-04-03T11:17:36-0800
  *
+ * @revision 2026-10-18 only as much as was enqueued is played, so elements
+ *   shorter than the message queue's element size can be played.
+ *           2026-10-18 the data is read into a header of the ring, which is
+ *   already prepared, instead of a newly allocated one.
+ *           2026-10-18 the element is only dequeued; it is gathered into
+ *   periods by {PlayWave::fillPeriods}.
+ *
  * @author   Eric Tsang
  */
 void PlayWave::handleMsgqMsg()
 {
-	// allocate, and set header data
-	WAVEHDR* audioPacket = (WAVEHDR*) malloc(sizeof(*audioPacket));
-
-	// prepare the current audio packet
-	memset(audioPacket,0,sizeof(*audioPacket));
-	audioPacket->dwUser         = 0;
-	audioPacket->lpData         = (char*) malloc(msgq->elementSize);
-	audioPacket->dwBufferLength = msgq->elementSize;
-
-	// copy the audio data from message queue to our own buffer
 	int useless;
-	msgq->dequeue((int*)&useless,audioPacket->lpData);
-
-	// prepare the header.
-	waveOutPrepareHeader(speakers,audioPacket,sizeof(*audioPacket));
-	waveOutWrite(speakers,audioPacket,sizeof(*audioPacket));
-
-	// acquire synchronization objects
-	WaitForSingleObject(canEnqueue,INFINITE);
-	WaitForSingleObject(lastAudioPacketAccess,INFINITE);
-
-	// link the previous audio packet, if it has not been deallocated yet, to
-	// the current packet. if it has been deallocated already, then start
-	// another thread used to deallocate them
-	if(lastAudioPacket != 0)
-	{
-		lastAudioPacket->dwUser = (DWORD_PTR) audioPacket;
-	}
-    startCleanupRoutine(this,audioPacket);
-	lastAudioPacket = audioPacket;
-
-	// release synchronization objects
-	ReleaseMutex(lastAudioPacketAccess);
-	ReleaseSemaphore(canDequeue,1,NULL);
-}
-
-void PlayWave::startCleanupRoutine(PlayWave* dis, WAVEHDR* audioPacket)
-{
-	// prepare thread parameters
-	CrParams* params = (CrParams*) malloc(sizeof(*params));
-	params->dis = dis;
-	params->audioPacket = audioPacket;
-
-	// start the thread
-	startRoutine(&dis->cleanupThread,dis->cleanupThreadEv,cleanupRoutine,params);
-}
-
-DWORD WINAPI PlayWave::cleanupRoutine(void* params)
-{
-	#ifdef DEBUG
-	OutputDebugString(L"cleanup thread started\n");
-	#endif
-	// parse thread parameters
-	CrParams* p = (CrParams*) params;
-
-	while(p->audioPacket != 0)
-	{
-		// wait for the "header finished being used" flag to be set. the flag is
-		// set once the audio device has finished reading it, and playing out
-		// the speakers
-		while(!(p->audioPacket->dwFlags&WHDR_DONE))
-		{
-			#ifdef DEBUG
-			OutputDebugString(L"cleanup thread waiting\n");
-			#endif
-			Sleep(CHECK_FOR_FREEING_INTERVAL);
-		}
-
-		// acquire synchronization objects
-		WaitForSingleObject(p->dis->canDequeue,INFINITE);
-		WaitForSingleObject(p->dis->lastAudioPacketAccess,INFINITE);
-
-		// save where the next packet to deallocate is
-		WAVEHDR* next = (WAVEHDR*) p->audioPacket->dwUser;
-
-		// unprepare the audio header, free the audio header and free the
-		// payload
-		#ifdef DEBUG
-        char output[256];
-		wsprintf((LPWSTR)output,L"cleanup thread freeing packet %p\n",p->audioPacket);
-        OutputDebugString((LPWSTR)output);
-		#endif
-		waveOutUnprepareHeader(p->dis->speakers,p->audioPacket,sizeof(WAVEHDR));
-		free(p->audioPacket->lpData);
-		free(p->audioPacket);
-
-		// if the packet we deallocated is the class's "last audio packet", then
-		// set the class's "last audio packet" to 0, indicating to it that it
-		// has been deallocated
-		if(p->dis->lastAudioPacket == p->audioPacket)
-		{
-			p->dis->lastAudioPacket = 0;
-		}
-
-		// assign the next packet packet to deallocate
-		p->audioPacket = next;
-
-		// release synchronization objects
-		ReleaseMutex(p->dis->lastAudioPacketAccess);
-		ReleaseSemaphore(p->dis->canEnqueue,1,NULL);
-	}
-
-	// free thread parameters & return
-	#ifdef DEBUG
-	OutputDebugString(L"cleanup thread stopped\n");
-	#endif
-	stopRoutine(&p->dis->cleanupThread,0);
-	free(p);
-	return 0;
+	msgq->dequeue((int*)&useless,pending,&pendingLen);
+	pendingOffset = 0;
 }
 
 /////////////////////////////////////
@@ -2,35 +2,72 @@
 #define _PLAY_WAVE_H_
 
 #include "../Common.h"
+#include "AudioBackend.h"
 #include <stdio.h>
 
 class MessageQueue;
 
 /**
- * used to decode & play audio out speakers from raw PCM data.
+ * default milliseconds of audio in each buffer written to the device.
+ */
+#define PLAY_WAVE_PERIOD_MS 20
+
+/**
+ * statistics about the audio played by a {PlayWave}.
+ *
+ * {periodMs}; milliseconds of audio in each buffer written to the device
+ *
+ * {periods}; most buffers written to the device at a time
+ *
+ * {latencyMs}; milliseconds of audio the device may have queued ahead of what
+ *   is heard; {periodMs} times {periods}
+ *
+ * {writes}; buffers written to the device so far
+ *
+ * {underruns}; times the device played everything it was given, and had to
+ *   wait for more
+ */
+struct PlayWaveStats
+{
+	double periodMs;
+	int periods;
+	double latencyMs;
+	unsigned long writes;
+	unsigned long underruns;
+};
+
+/**
+ * used to decode & play audio out speakers from raw PCM data. the audio is
+ *   played on an {AudioOutput}; the system's speakers unless another is
+ *   passed.
  */
 class PlayWave
 {
 public:
-	PlayWave(int capacity, MessageQueue* msgq);
+	PlayWave(int capacity, MessageQueue* msgq, AudioOutput* output = NULL);
 	~PlayWave();
 	int startPlaying(int samplesPerSecond, int bitsPerSample, int numChannels);
 	int resumePlaying();
+	int playFormat(int samplesPerSecond, int bitsPerSample, int numChannels);
 	int stopPlaying();
 	void setVolume(char volume);
+	void setPeriod(int periodMs);
+	void getStats(PlayWaveStats* stats);
 
 private:
 	int openDevice(int samplesPerSecond, int bitsPerSample, int numChannels);
 	int closeDevice();
+	void recyclePeriods();
+	void fillPeriods();
+	void writePeriod();
 	static DWORD WINAPI playRoutine(void* params);
 	void handleMsgqMsg();
-	static void startCleanupRoutine(PlayWave* dis, WAVEHDR* audioPacket);
-	static DWORD WINAPI cleanupRoutine(void* params);
 
 	/**
-	 * volume of the speakers
-	  */
-	DWORD volume;
+	 * gain the audio is played with, with {PCM_GAIN_BITS} fraction bits; set
+	 *   by {setVolume}.
+	 */
+	volatile short gain;
 
 	/**
 	 * handle to Mutex which protects the interface of the play wave.
@@ -38,45 +75,43 @@ private:
 	HANDLE interfaceAccess;
 
 	/**
-	 * pointer to the last enqueued audio packet if it exists; 0 otherwise.
-	 *
-	 * a pointer to the last packet is maintained, so when another packet is
-	 *   enqueued for playing, we can set the last packet's user pointer to the
-	 *   new packet, creating a linked list of audio packets.
-	 *
-	 * the idea, is to have a thread follow the linked list of enqueued audio
-	 *   packets, and deallocate them as they are played.
+	 * number of periods the device has room for; the most audio that can be
+	 *   written to the device at a time.
 	 */
-	WAVEHDR* lastAudioPacket;
+	int capacity;
 
 	/**
-	 * mutex used to protect the lastAudioPacket linked list.
+	 * milliseconds of audio in each period, and the number of bytes that is
+	 *   in the format the device was opened in.
 	 */
-	HANDLE lastAudioPacketAccess;
+	int periodMs;
+	int periodBytes;
 
 	/**
-	 * handle to a semaphore that is 0 then the queue is empty, positive
-	 *   otherwise.
+	 * number of periods written that hadn't finished playing, the last time
+	 *   the device was asked. only used by the play thread.
 	 */
-	HANDLE canDequeue;
+	int queued;
 
 	/**
-	 * handle to a semaphore that is 100 then the queue is empty, positive
-	 *   otherwise.
+	 * bytes copied into the device's next period, which is written once it
+	 *   holds a whole one.
 	 */
-	HANDLE canEnqueue;
+	int filling;
 
 	/**
-	 * handle to thread that's used to deallocate packets that have been
-	 *   allocated to be played by the speakers, after they have been played by
-	 *   the speakers.
+	 * element dequeued from the message queue, and what is left of it to copy
+	 *   into the device's periods.
 	 */
-	HANDLE cleanupThread;
+	char* pending;
+	int pendingOffset;
+	int pendingLen;
 
 	/**
-	 * handle to event, that when set, stops the cleanup thread.
+	 * periods written, and times the device ran out of them, so far.
 	 */
-	HANDLE cleanupThreadEv;
+	volatile LONG writes;
+	volatile LONG underruns;
 
 	/**
 	 * handle to thread used to dequeue audio from the message queue, and add
@@ -101,10 +136,16 @@ private:
 	WAVEFORMATEX wfx;
 
 	/**
-	 * handle to the system's primary speakers; 0 if not valid. non-zero
-	 *   otherwise.
+	 * the device the audio is played on, and whether it was made by, and is
+	 *   deleted with, this instance.
+	 */
+	AudioOutput* output;
+	bool ownsOutput;
+
+	/**
+	 * true while the device is open.
 	 */
-	HWAVEOUT speakers;
+	bool deviceOpen;
 };
 
 #endif
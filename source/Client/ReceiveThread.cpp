@@ -8,9 +8,9 @@
 #include "../Buffer/MessageQueue.h"
 #include "../Buffer/JitterBuffer.h"
 #include "ReceiveThread.h"
-#include "VoiceBufferer.h"
 #include "MicReader.h"
-#include "PlayWave.h"
+#include "ClientMixer.h"
+#include "MusicBufferer.h"
 #include "../protocol.h"
 
 // static function forward declarations
@@ -25,13 +25,39 @@ ReceiveThread::ReceiveThread(JitterBuffer* musicJitterBuffer, MessageQueue* sock
 {
     this->sockMsgQueue      = sockMsgQueue;
     this->musicJitterBuffer = musicJitterBuffer;
+    this->onDemand          = false;
+    this->musicBufferer     = NULL;
+    this->mixer             = NULL;
+    this->voiceIdleMs       = VOICE_IDLE_MS;
+    this->lastEviction      = GetTickCount();
+    this->evictions         = 0;
+    this->dropped           = 0;
+    this->access            = CreateMutex(NULL,FALSE,NULL);
     this->thread            = INVALID_HANDLE_VALUE;
     this->threadStopEv      = CreateEvent(NULL,TRUE,FALSE,NULL);
+
+    // the whole pool is made up front, and never grows
+    for(int i = 0; i < VOICE_SESSIONS; ++i)
+    {
+        voiceSessions[i].srcAddr      = 0;
+        voiceSessions[i].jitterBuffer = new JitterBuffer(VOICE_JITTER_CAPACITY,100,sizeof(VoiceFrame),VOICE_JITTER_MS,0);
+        voiceSessions[i].lastHeard    = 0;
+        voiceSessions[i].active       = false;
+    }
 }
 
 ReceiveThread::~ReceiveThread()
 {
     stop();
+    for(int i = 0; i < VOICE_SESSIONS; ++i)
+    {
+        if(voiceSessions[i].active)
+        {
+            evict(&voiceSessions[i]);
+        }
+        delete voiceSessions[i].jitterBuffer;
+    }
+    CloseHandle(access);
 }
 
 void ReceiveThread::start()
@@ -44,6 +70,109 @@ void ReceiveThread::stop()
     stopRoutine(&thread,threadStopEv);
 }
 
+/**
+ * chooses which music stream is played; the one multicast to all clients, or
+ *   the one the server sends to this client alone after it has seeked.
+ *
+ * @date     2026-10-18
+ *
+ * @param    onDemand   true to play the stream sent to this client alone;
+ *   false to go back to the multicast stream.
+ */
+void ReceiveThread::setOnDemand(bool onDemand)
+{
+    this->onDemand = onDemand;
+}
+
+/**
+ * sets the {MusicBufferer} that is told about the next song of the multicast
+ *   stream when the server announces it.
+ *
+ * @date     2026-10-18
+ *
+ * @param    musicBufferer   the {MusicBufferer} filled from the music jitter
+ *   buffer.
+ */
+void ReceiveThread::setMusicBufferer(MusicBufferer* musicBufferer)
+{
+    this->musicBufferer = musicBufferer;
+}
+
+/**
+ * sets the {ClientMixer} the voice of each peer is played through; it has to
+ *   be set before the thread is started.
+ *
+ * @date     2026-10-18
+ *
+ * @param    mixer   the {ClientMixer} that plays everything the client hears.
+ */
+void ReceiveThread::setMixer(ClientMixer* mixer)
+{
+    this->mixer = mixer;
+}
+
+/**
+ * sets how long a peer has to be silent before its voice session is taken
+ *   back into the pool, for the next peer that talks.
+ *
+ * @date     2026-10-18
+ *
+ * @param    ms   milliseconds of silence; {VOICE_IDLE_MS} by default.
+ */
+void ReceiveThread::setVoiceIdleTime(int ms)
+{
+    WaitForSingleObject(access,INFINITE);
+    voiceIdleMs = ms;
+    ReleaseMutex(access);
+}
+
+/**
+ * sets how long the jitter buffer of each voice session holds on to the
+ *   first frame a peer sends after being silent; the smaller it is, the
+ *   sooner the peer is heard, and the less jitter is absorbed.
+ *
+ * @date     2026-10-18
+ *
+ * @param    ms   milliseconds to hold on to the first frame;
+ *   {VOICE_JITTER_MS} by default.
+ */
+void ReceiveThread::setVoiceDelay(int ms)
+{
+    WaitForSingleObject(access,INFINITE);
+    for(int i = 0; i < VOICE_SESSIONS; ++i)
+    {
+        voiceSessions[i].jitterBuffer->setDelay(ms);
+    }
+    ReleaseMutex(access);
+}
+
+/**
+ * gets statistics about the voice sessions, and the memory they hold.
+ *
+ * @date     2026-10-18
+ *
+ * @param    stats   filled with the statistics.
+ */
+void ReceiveThread::getVoiceStats(VoiceSessionStats* stats)
+{
+    WaitForSingleObject(access,INFINITE);
+
+    stats->active  = activeSessions.size();
+    stats->pooled  = VOICE_SESSIONS;
+    stats->evicted = evictions;
+    stats->dropped = dropped;
+    stats->bytes   = 0;
+    for(int i = 0; i < VOICE_SESSIONS; ++i)
+    {
+        JitterBuffer* jitterBuffer = voiceSessions[i].jitterBuffer;
+        stats->bytes += sizeof(voiceSessions[i])+sizeof(*jitterBuffer)
+            +VOICE_JITTER_CAPACITY*sizeof(std::pair<int,void*>)
+            +jitterBuffer->size()*jitterBuffer->getElementSize();
+    }
+
+    ReleaseMutex(access);
+}
+
 DWORD WINAPI ReceiveThread::threadRoutine(void* params)
 {
     #ifdef DEBUG
@@ -61,7 +190,7 @@ DWORD WINAPI ReceiveThread::threadRoutine(void* params)
             dis->threadStopEv,
             dis->sockMsgQueue->hasMessage
         };
-        switch(WaitForMultipleObjects(2,handles,FALSE,INFINITE))
+        switch(WaitForMultipleObjects(2,handles,FALSE,VOICE_EVICT_INTERVAL_MS))
         {
         case WAIT_OBJECT_0+0:   // stop event triggered
             breakLoop = TRUE;
@@ -69,11 +198,14 @@ DWORD WINAPI ReceiveThread::threadRoutine(void* params)
         case WAIT_OBJECT_0+1:   // message queue has message
             ReceiveThread::handleMsgqMsg(dis);
             break;
+        case WAIT_TIMEOUT:      // nothing received; look for idle sessions
+            break;
         default:
             int err = GetLastError();
             OutputDebugString(L"ReceiveThread::_threadRoutine WaitForMultipleObjects");
             break;
         }
+        dis->evictIdleSessions();
     }
 
     // return...
@@ -96,16 +228,44 @@ void ReceiveThread::handleMsgqMsg(ReceiveThread* dis)
     switch(msgType)
     {
     case MUSICSTREAM:
+    case ONDEMAND_STREAM:
     {
+        // only play the stream the client is listening to
         LocalDataPacket* packet = (LocalDataPacket*) element;
-        dis->musicJitterBuffer->put(packet->index,packet->data);
+        if((msgType == ONDEMAND_STREAM) == dis->onDemand)
+        {
+            dis->musicJitterBuffer->put(packet->index,packet->data);
+        }
+        break;
+    }
+    case STREAM_FORMAT:
+    {
+        // the fields after the index were received as the packet's data
+        LocalDataPacket* packet = (LocalDataPacket*) element;
+        FormatPacket format;
+        format.firstIndex = packet->index;
+        memcpy(&format.songId,packet->data,sizeof(format)-sizeof(format.firstIndex));
+        if(!dis->onDemand && dis->musicBufferer != NULL)
+        {
+            dis->musicBufferer->queueSong(&format);
+        }
         break;
     }
     case MICSTREAM:
+    case VOICE_MIX:
     {
+        // the server's mix plays like the voice of one more client; a frame
+        // is as long as the packet it came in
         LocalDataPacket* packet = (LocalDataPacket*) element;
-        JitterBuffer* jb = dis->getJitterBuffer(packet->srcAddr);
-        jb->put(packet->index,packet->data);
+        JitterBuffer* jb = dis->getJitterBuffer(packet->srcAddr,packet->index);
+        if(jb != NULL && packet->len > 0)
+        {
+            VoiceFrame frame;
+            frame.len = packet->len;
+            QueryPerformanceCounter(&frame.arrived);
+            memcpy(frame.data,packet->data,packet->len);
+            jb->put(packet->index,&frame);
+        }
         break;
     }
     default:
@@ -121,37 +281,122 @@ void ReceiveThread::handleMsgqMsg(ReceiveThread* dis)
 
 /**
  * returns a jitter buffer used to store voice data from a specific source
- *   address; instantiates a new jitter buffer if needed.
+ *   address; gives the source a voice session from the pool, and adds it to
+ *   the mixer, if it doesn't have one yet.
  *
  * @date     2015-04-05T19:51:23-0800
  *
+ * @revision 2026-10-18 the voice is played through the mixer, instead of on
+ *   an audio device of its own.
+ *           2026-10-18 jitter buffers come from a fixed pool of sessions,
+ *   which are taken back when their peer goes silent.
+ *
  * @author   Eric Tsang
  *
  * @param    srcAddr   source address used to identify which jitter buffer to
  *   return.
+ * @param    index   index of the packet received from the source; a new
+ *   session plays from it.
  *
  * @return   the jitter buffer used to store the voice data from the passed
- *   source address
+ *   source address; NULL if every session of the pool is in use.
+ */
+JitterBuffer* ReceiveThread::getJitterBuffer(unsigned long srcAddr, int index)
+{
+    WaitForSingleObject(access,INFINITE);
+
+    VoiceSession* session = NULL;
+    std::map<unsigned long,VoiceSession*>::iterator found = activeSessions.find(srcAddr);
+    if(found != activeSessions.end())
+    {
+        session = found->second;
+    }
+    else
+    {
+        // if the source doesn't have a session, give it a free one
+        for(int i = 0; i < VOICE_SESSIONS && session == NULL; ++i)
+        {
+            if(!voiceSessions[i].active)
+            {
+                session = &voiceSessions[i];
+            }
+        }
+
+        if(session != NULL)
+        {
+            session->srcAddr = srcAddr;
+            session->active  = true;
+            session->jitterBuffer->reset(index-1);
+            activeSessions[srcAddr] = session;
+            mixer->addVoice(session->jitterBuffer);
+
+            wchar_t s[128];
+            swprintf(s,128,L"voice session started, %d of %d active\n",
+                (int) activeSessions.size(),VOICE_SESSIONS);
+            OutputDebugString(s);
+        }
+        else
+        {
+            ++dropped;
+        }
+    }
+
+    if(session != NULL)
+    {
+        session->lastHeard = GetTickCount();
+    }
+
+    ReleaseMutex(access);
+    return session != NULL ? session->jitterBuffer : NULL;
+}
+
+/**
+ * takes the sessions of peers that have been silent for long enough back
+ *   into the pool; does nothing if it has done so in the last
+ *   {VOICE_EVICT_INTERVAL_MS} milliseconds.
+ *
+ * @date     2026-10-18
  */
-JitterBuffer* ReceiveThread::getJitterBuffer(unsigned long srcAddr)
+void ReceiveThread::evictIdleSessions()
 {
-    JitterBuffer* jitterBuffer = voiceJitterBuffers[srcAddr];
+    WaitForSingleObject(access,INFINITE);
 
-    // if the jitter buffer doesn't exist make one, put it into the map
-    if(jitterBuffer == 0)
+    DWORD now = GetTickCount();
+    if(now-lastEviction >= VOICE_EVICT_INTERVAL_MS)
     {
-        jitterBuffer = new JitterBuffer(5000,100,DATA_LEN,50,0);
-        MessageQueue* queue = new MessageQueue(1500,DATA_LEN);
-        VoiceBufferer* voiceBufferer = new VoiceBufferer(queue,jitterBuffer);
-        voiceBufferer->start();
-        PlayWave* playWave = new PlayWave(1000,queue);
-        playWave->startPlaying(AUDIO_SAMPLE_RATE,AUDIO_BITS_PER_SAMPLE,NUM_AUDIO_CHANNELS);
-
-        voiceJitterBuffers[srcAddr] = jitterBuffer;
+        lastEviction = now;
+        for(int i = 0; i < VOICE_SESSIONS; ++i)
+        {
+            if(voiceSessions[i].active && now-voiceSessions[i].lastHeard >= (DWORD) voiceIdleMs)
+            {
+                evict(&voiceSessions[i]);
+            }
+        }
     }
 
-    // return the jitter buffer for the passed srcAddr
-    return jitterBuffer;
+    ReleaseMutex(access);
+}
+
+/**
+ * takes a session back into the pool; its voice is taken out of the mix, and
+ *   whatever is left in its jitter buffer is thrown away.
+ *
+ * @date     2026-10-18
+ *
+ * @param    session   the session to take back.
+ */
+void ReceiveThread::evict(VoiceSession* session)
+{
+    mixer->removeVoice(session->jitterBuffer);
+    session->jitterBuffer->reset(0);
+    session->active = false;
+    activeSessions.erase(session->srcAddr);
+    ++evictions;
+
+    wchar_t s[128];
+    swprintf(s,128,L"voice session evicted, %d of %d active\n",
+        (int) activeSessions.size(),VOICE_SESSIONS);
+    OutputDebugString(s);
 }
 
 int startRoutine(HANDLE* thread, HANDLE stopEvent,
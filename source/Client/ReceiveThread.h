@@ -5,10 +5,54 @@
 #include "../Buffer/JitterBuffer.h"
 #include <map>
 
-#include <map>
-
 class MessageQueue;
 class JitterBuffer;
+class MusicBufferer;
+class ClientMixer;
+
+/**
+ * number of voice sessions in the pool; a peer that starts talking while
+ *   every session belongs to someone heard from recently isn't played.
+ */
+#define VOICE_SESSIONS 16
+
+/**
+ * elements the jitter buffer of a voice session can hold.
+ */
+#define VOICE_JITTER_CAPACITY 5000
+
+/**
+ * milliseconds a peer has to be silent, by default, before its voice session
+ *   is taken back into the pool.
+ */
+#define VOICE_IDLE_MS 5000
+
+/**
+ * milliseconds between looking for idle voice sessions.
+ */
+#define VOICE_EVICT_INTERVAL_MS 1000
+
+/**
+ * statistics about the voice sessions.
+ *
+ * {active}; sessions playing the voice of a peer
+ *
+ * {pooled}; sessions in the pool
+ *
+ * {evicted}; sessions taken back from silent peers so far
+ *
+ * {dropped}; voice packets dropped because no session was free
+ *
+ * {bytes}; memory held by the sessions of the pool
+ */
+struct VoiceSessionStats
+{
+    int active;
+    int pooled;
+    unsigned long evicted;
+    unsigned long dropped;
+    unsigned long bytes;
+};
 
 class ReceiveThread
 {
@@ -19,13 +63,64 @@ public:
     ~ReceiveThread();
     void start();
     void stop();
+    void setOnDemand(bool onDemand);
+    void setMusicBufferer(MusicBufferer* musicBufferer);
+    void setMixer(ClientMixer* mixer);
+    void setVoiceIdleTime(int ms);
+    void setVoiceDelay(int ms);
+    void getVoiceStats(VoiceSessionStats* stats);
 private:
-    JitterBuffer* getJitterBuffer(unsigned long srcAddr);
+    /**
+     * the voice of one peer; the jitter buffer is made once, and kept for
+     *   whichever peer the session is given to next.
+     */
+    struct VoiceSession
+    {
+        unsigned long srcAddr;
+        JitterBuffer* jitterBuffer;
+        DWORD lastHeard;
+        bool active;
+    };
+    JitterBuffer* getJitterBuffer(unsigned long srcAddr, int index);
+    void evictIdleSessions();
+    void evict(VoiceSession* session);
     static DWORD WINAPI threadRoutine(void* params);
     static void handleMsgqMsg(ReceiveThread* dis);
-    std::map<unsigned long,JitterBuffer*> voiceJitterBuffers;
+    /**
+     * the pool of voice sessions, and the active ones by the address of
+     *   their peer.
+     */
+    VoiceSession voiceSessions[VOICE_SESSIONS];
+    std::map<unsigned long,VoiceSession*> activeSessions;
+    /**
+     * milliseconds a peer has to be silent before its session is taken back,
+     *   and when idle sessions were last looked for.
+     */
+    int voiceIdleMs;
+    DWORD lastEviction;
+    unsigned long evictions;
+    unsigned long dropped;
+    /**
+     * protects the voice sessions.
+     */
+    HANDLE access;
     MessageQueue* sockMsgQueue;
     JitterBuffer* musicJitterBuffer;
+    /**
+     * told about the next song of the multicast stream when the server
+     *   announces it.
+     */
+    MusicBufferer* musicBufferer;
+    /**
+     * plays the voice of every peer.
+     */
+    ClientMixer* mixer;
+    /**
+     * true while the server streams to this client alone; the music packets
+     *   multicast to everybody are ignored then, and the ones sent to this
+     *   client are played instead.
+     */
+    volatile bool onDemand;
     HANDLE thread;
     HANDLE threadStopEv;
 };
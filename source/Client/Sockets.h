@@ -27,7 +27,6 @@ private:
 	SOCKET sd;
 	HANDLE mutex;
 	ip_mreq mreq;
-	int stopSending;
 	DWORD ThreadStart(void);
 	static void CALLBACK UDPRoutine(DWORD Error, DWORD BytesTransferred,
 		LPWSAOVERLAPPED Overlapped, DWORD InFlags);
@@ -39,10 +38,10 @@ public:
 	~UDPSocket();
 	int Send(char type, void* data, int length, char* dest_ip, int dest_port);
 	int sendtoGroup(char type, void* data, int length);
+	int sendtoGroup(char type, void* data, int length, sockaddr_in* group);
 	void setGroup(char* group_address, int mem_flag);
+	void switchGroup(unsigned long group);
 	MessageQueue* getMessageQueue();
-	void stopSong();
-	void sendWave(SongName songloc, int speed, std::vector<TCPSocket*> sockets);
 
 };
 
@@ -52,19 +51,31 @@ friend class ServerControlThread;
 private:
 	SOCKET sd;
 	HANDLE mutex;
+	WSAEVENT sendEvent;
 	MessageQueue* msgqueue;
+	HANDLE thread;
+	bool notifyClose;
+	HANDLE priority;
+	HANDLE controlIdle;
+	int controlWaiting;
 	static DWORD WINAPI TCPThread(LPVOID lpParameter);
 	DWORD ThreadStart(void);
+	bool recvAll(char* buffer, int length);
+	void beginSend(bool bulk);
+	void endSend(bool bulk);
 	static void CALLBACK TCPRoutine(DWORD Error, DWORD BytesTransferred,
 		LPWSAOVERLAPPED Overlapped, DWORD InFlags);
 
 public:
-	TCPSocket(SOCKET socket, MessageQueue* mqueue);
+	TCPSocket(SOCKET socket, MessageQueue* mqueue, bool notifyClose = false);
 	TCPSocket(char* host, int port, MessageQueue* mqueue);
 	~TCPSocket();
+	void Close();
 	int Send(char type, void* data, int length);
+	int SendFile(char type, void* head, int headLen, HANDLE file, unsigned long offset, unsigned long length);
 
     MessageQueue * getMessageQueue( void );
+    unsigned long getPeerAddress( void );
 };
 
 #endif
@@ -2,19 +2,26 @@
 -- SOURCE FILE: TCPSocket.cpp
 --
 -- FUNCTIONS:
-	TCPSocket(SOCKET socket, MessageQueue* mqueue);
+	TCPSocket(SOCKET socket, MessageQueue* mqueue, bool notifyClose);
 	TCPSocket(char* host, int port, MessageQueue* mqueue);
 	~TCPSocket();
+	void Close();
 	static DWORD WINAPI TCPThread(LPVOID lpParameter);
 	DWORD ThreadStart(void);
+	void beginSend(bool bulk);
+	void endSend(bool bulk);
 	static void CALLBACK TCPRoutine(DWORD Error, DWORD BytesTransferred,
 	LPWSAOVERLAPPED Overlapped, DWORD InFlags);
 	int Send(char type, void* data, int length);
+	int SendFile(char type, void* head, int headLen, HANDLE file, unsigned long offset, unsigned long length);
+	unsigned long getPeerAddress(void);
 --
 -- DATE: April 1, 2015
 --
 -- REVISIONS: April 4, 2015		Eric Tsang
 --			Fixed Memory leaks and buffer size problems.
+--			October 18, 2026
+--			Added SendFile for zero-copy file transfers, and receive whole messages of any size.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -27,22 +34,27 @@
 
 #include "Sockets.h"
 #include "../Buffer/MessageQueue.h"
+#include <mswsock.h>
+#include <malloc.h>
+
+#pragma comment(lib,"mswsock.lib")
 
 /*------------------------------------------------------------------------------------------------------------------
 -- FUNCTION: TCPSocket
 --
 -- DATE: April 3, 2015
 --
--- REVISIONS: (Date and Description)
+-- REVISIONS: October 18, 2026  Optionally enqueue a DISCONNECT message when the connection closes.
 --
 -- DESIGNER: Manuel Gonzales
 --
 -- PROGRAMMER: Manuel Gonzales
 --
--- INTERFACE: TCPSocket::TCPSocket(SOCKET socket, MessageQueue* mqueue)
+-- INTERFACE: TCPSocket::TCPSocket(SOCKET socket, MessageQueue* mqueue, bool notifyClose)
 --
 --  socket : socket descriptor
 --  mqueue : message queue to use for storing the data.
+--  notifyClose : true to enqueue a DISCONNECT message when the connection closes.
 --
 --	RETURNS: nothing.
 --
@@ -50,17 +62,21 @@
 --  This is the constructor for the TCP socket, it will use the passed file descriptor as a socket and
 --  then it will start the thread to receive data.
 ----------------------------------------------------------------------------------------------------------------------*/
-TCPSocket::TCPSocket(SOCKET socket, MessageQueue* mqueue)
+TCPSocket::TCPSocket(SOCKET socket, MessageQueue* mqueue, bool notifyClose)
 {
 	sd = socket;
 	msgqueue = mqueue;
+	this->notifyClose = notifyClose;
 
 	mutex = CreateMutex(NULL, FALSE, NULL);
+	sendEvent = WSACreateEvent();
+	priority = CreateMutex(NULL, FALSE, NULL);
+	controlIdle = CreateEvent(NULL, TRUE, TRUE, NULL);
+	controlWaiting = 0;
 
-	HANDLE ThreadHandle;
 	DWORD ThreadId;
 
-	if ((ThreadHandle = CreateThread(NULL, 0, TCPThread, (void*)this, 0, &ThreadId)) == NULL)
+	if ((thread = CreateThread(NULL, 0, TCPThread, (void*)this, 0, &ThreadId)) == NULL)
 	{
 		#ifdef DEBUG
 		MessageBox(NULL, L"CreateThread failed with error", L"ERROR", MB_ICONERROR);
@@ -100,11 +116,16 @@ TCPSocket::TCPSocket(char* host, int port, MessageQueue* mqueue)
 	char** pptr;
 	WSADATA WSAData;
 	WORD wVersionRequested;
-	HANDLE ThreadHandle;
 	DWORD ThreadId;
 	msgqueue = mqueue;
+	thread = NULL;
+	notifyClose = false;
 
 	mutex = CreateMutex(NULL, FALSE, NULL);
+	sendEvent = WSACreateEvent();
+	priority = CreateMutex(NULL, FALSE, NULL);
+	controlIdle = CreateEvent(NULL, TRUE, TRUE, NULL);
+	controlWaiting = 0;
 
 	wVersionRequested = MAKEWORD(2, 2);
 	error = WSAStartup(wVersionRequested, &WSAData);
@@ -154,7 +175,7 @@ TCPSocket::TCPSocket(char* host, int port, MessageQueue* mqueue)
 
 	pptr = hp->h_addr_list;
 
-	if ((ThreadHandle = CreateThread(NULL, 0, TCPThread, (void*)this, 0, &ThreadId)) == NULL)
+	if ((thread = CreateThread(NULL, 0, TCPThread, (void*)this, 0, &ThreadId)) == NULL)
 	{
 		#ifdef DEBUG
 		MessageBox(NULL, L"CreateThread failed with error", L"ERROR", MB_ICONERROR);
@@ -194,7 +215,10 @@ DWORD WINAPI TCPSocket::TCPThread(LPVOID lpParameter)
 --
 -- DATE: March 17, 2015
 --
--- REVISIONS: (Date and Description)
+-- REVISIONS: October 18, 2026  Receive whole messages of any length, and enqueue a DISCONNECT message when
+--            the connection closes, if the socket was created to.
+--            October 18, 2026  Drop the connection on a message that doesn't fit in the message queue, instead
+--            of growing the receive buffer for it.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -206,63 +230,101 @@ DWORD WINAPI TCPSocket::TCPThread(LPVOID lpParameter)
 --
 --	NOTES:
 --  This function will start receiving the data from the socket, the first thing it will read would be the data
---  size and then will call the TCPRoutine
+--  size and then will call the TCPRoutine. The length comes from the peer, so a message longer than an element of
+--  the message queue, or with a negative length, shuts the connection down.
 ----------------------------------------------------------------------------------------------------------------------*/
 DWORD TCPSocket::ThreadStart(void)
+{
+	char header[sizeof(int)+1];
+	char* dataReceived = (char*) malloc(msgqueue->elementSize);
+	int length;
+
+	while (true)
+	{
+		char type;
+
+		if (!recvAll(header, sizeof(header)))
+		{
+			break;
+		}
+
+		type = header[0];
+		length = *(int*)&header[1];
+
+		// every reader of the queue takes its messages into an element's worth
+		if (length < 0 || length > msgqueue->elementSize)
+		{
+			shutdown(sd, SD_BOTH);
+			break;
+		}
+
+		if (!recvAll(dataReceived, length))
+		{
+			break;
+		}
+
+		msgqueue->enqueue(type, dataReceived, length);
+	}
+
+	// let the reader of the message queue know that the connection is gone
+	if (notifyClose)
+	{
+		msgqueue->enqueue(DISCONNECT, dataReceived, 0);
+	}
+
+	free(dataReceived);
+	return FALSE;
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: recvAll
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: bool TCPSocket::recvAll(char* buffer, int length)
+--
+--	buffer : buffer to receive into
+--  length : number of bytes to receive
+--
+--	RETURNS: true if all the bytes were received, false if the connection failed or was closed.
+--
+--	NOTES:
+--  TCP may hand a message over in several pieces; this keeps receiving until the whole length has arrived.
+----------------------------------------------------------------------------------------------------------------------*/
+bool TCPSocket::recvAll(char* buffer, int length)
 {
 	DWORD Flags;
-	SOCKET_INFORMATION socketInfo;
 	DWORD RecvBytes;
-	int length;
+	WSABUF DataBuf;
+
+	while (length > 0)
+	{
+		DataBuf.buf = buffer;
+		DataBuf.len = length;
+		Flags = 0;
 
-	socketInfo.Socket = sd;
-	ZeroMemory(&(socketInfo.Overlapped), sizeof(WSAOVERLAPPED));
-	socketInfo.DataBuf.buf = socketInfo.Buffer;
-	socketInfo.mqueue = msgqueue;
-	Flags = 0;
+		if (WSARecv(sd, &DataBuf, 1, &RecvBytes, &Flags, 0, 0) == SOCKET_ERROR)
+		{
+			#ifdef DEBUG
+			MessageBox(NULL, L"WSARecv() failed with error", L"ERROR", MB_ICONERROR);
+			#endif
+			return false;
+		}
 
-		while (true)
+		if (RecvBytes == 0)
 		{
-    		socketInfo.DataBuf.len = sizeof(int)+1;
-            char type;
-
-			if (WSARecv(socketInfo.Socket, &(socketInfo.DataBuf), 1, &RecvBytes, &Flags,
-				0, 0) == SOCKET_ERROR)
-			{
-                int err;
-				if ((err = WSAGetLastError()) != WSA_IO_PENDING)
-				{
-					#ifdef DEBUG
-					MessageBox(NULL, L"WSARecv() failed with error", L"ERROR", MB_ICONERROR);
-					#endif
-					return FALSE;
-				}
-			}
-
-            type = socketInfo.Buffer[0];
-			length = *(int*)&socketInfo.Buffer[1];
-			socketInfo.DataBuf.len = length;
-
-			if (WSARecv(socketInfo.Socket, &socketInfo.DataBuf, 1, &RecvBytes, &Flags,
-				0, 0) == SOCKET_ERROR)
-			{
-				if (WSAGetLastError() != WSA_IO_PENDING)
-				{
-					#ifdef DEBUG
-					MessageBox(NULL, L"WSARecv() failed with error", L"ERROR", MB_ICONERROR);
-					#endif
-					return 0;
-				}
-			}
-			else
-			{
-				char* dataReceived = (char*)malloc(sizeof(char) * length);
-				memcpy(dataReceived, socketInfo.Buffer, length);
-				socketInfo.mqueue->enqueue(type, dataReceived, length);
-				free(dataReceived);
-			}
+			return false;
 		}
+
+		buffer += RecvBytes;
+		length -= RecvBytes;
+	}
+
+	return true;
 }
+
 /*------------------------------------------------------------------------------------------------------------------
 -- FUNCTION: TCPRoutine
 --
@@ -336,16 +398,58 @@ DWORD TCPSocket::ThreadStart(void)
 ----------------------------------------------------------------------------------------------------------------------*/
 TCPSocket::~TCPSocket()
 {
-	closesocket(sd);
+	if (sd != INVALID_SOCKET)
+	{
+		closesocket(sd);
+	}
+	if (thread != NULL)
+	{
+		CloseHandle(thread);
+	}
+	WSACloseEvent(sendEvent);
+	CloseHandle(priority);
+	CloseHandle(controlIdle);
 	WSACleanup();
 }
 
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: Close
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void TCPSocket::Close()
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Closes the socket and waits for the receive thread to stop, so the socket can be deleted without the thread
+--  still using it. Must not be called while the receive thread could be blocked putting a message into a full
+--  message queue that nobody is reading.
+----------------------------------------------------------------------------------------------------------------------*/
+void TCPSocket::Close()
+{
+	if (sd != INVALID_SOCKET)
+	{
+		closesocket(sd);
+		sd = INVALID_SOCKET;
+	}
+	if (thread != NULL)
+	{
+		WaitForSingleObject(thread, INFINITE);
+	}
+}
+
 /*------------------------------------------------------------------------------------------------------------------
 -- FUNCTION: Send
 --
 -- DATE: March 17, 2015
 --
 -- REVISIONS: April 4, 2015  Added type
+--            October 18, 2026  Gather the header and payload instead of copying them into one buffer, and wait
+--            for overlapped sends to finish.
+--            October 18, 2026  Send control messages ahead of file data.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -360,60 +464,199 @@ TCPSocket::~TCPSocket()
 --	RETURNS: 1 in sucess, 0 in error
 --
 --	NOTES:
---  This will send the desired data to the server.
+--  This will send the desired data to the server. DOWNLOAD and DOWNLOAD_CHUNK messages are file data, and wait
+--  for every other message that is waiting to be sent.
 ----------------------------------------------------------------------------------------------------------------------*/
 int TCPSocket::Send(char type, void* data, int length)
 {
 	DWORD Flags;
-	SOCKET_INFORMATION socketInfo;
 	DWORD bytesSent;
 	DWORD WaitResult;
-	char* data_send = (char*) malloc(sizeof(char) * (length + 5));
-
-	data_send[0] = type;
-	memcpy(&data_send[1],&length,sizeof(length));
-
-	memcpy(data_send + 5, (char*)data, length);
-
+	WSAOVERLAPPED overlapped;
+	WSABUF buffers[2];
+	char header[5];
+	int result = 0;
+	bool bulk = (type == DOWNLOAD || type == DOWNLOAD_CHUNK);
+
+	// send the header and the payload straight from the caller's buffer
+	header[0] = type;
+	memcpy(&header[1],&length,sizeof(length));
+	buffers[0].buf = header;
+	buffers[0].len = sizeof(header);
+	buffers[1].buf = (char*) data;
+	buffers[1].len = length;
+
+	beginSend(bulk);
 	WaitResult = WaitForSingleObject( mutex, INFINITE);
 
 	if (WaitResult == WAIT_OBJECT_0)
 	{
-		socketInfo.Socket = sd;
-		ZeroMemory(&(socketInfo.Overlapped), sizeof(WSAOVERLAPPED));
-		socketInfo.DataBuf.len = length + 5;
-		socketInfo.DataBuf.buf = data_send;
+		ZeroMemory(&overlapped, sizeof(WSAOVERLAPPED));
+		overlapped.hEvent = sendEvent;
 		Flags = 0;
 
-		if (WSASend(socketInfo.Socket, &(socketInfo.DataBuf), 1, &bytesSent, Flags,
-			&(socketInfo.Overlapped), 0) == SOCKET_ERROR)
+		if (WSASend(sd, buffers, 2, &bytesSent, Flags, &overlapped, 0) == 0)
 		{
-			if (WSAGetLastError() != WSA_IO_PENDING)
-			{
-				#ifdef DEBUG
-				MessageBox(NULL, L"WSASend() failed with error", L"ERROR", MB_ICONERROR);
-				#endif
-				ReleaseMutex(mutex);
-				return 0;
-			}
-			ReleaseMutex(mutex);
+			result = 1;
 		}
-		else
+		else if (WSAGetLastError() == WSA_IO_PENDING)
 		{
-			ReleaseMutex(mutex);
-			free(data_send);
-			return 1;
+			// the buffers live on the stack; wait until they are sent
+			result = WSAGetOverlappedResult(sd, &overlapped, &bytesSent, TRUE, &Flags);
 		}
+
+		#ifdef DEBUG
+		if (!result)
+		{
+			MessageBox(NULL, L"WSASend() failed with error", L"ERROR", MB_ICONERROR);
+		}
+		#endif
+		ReleaseMutex(mutex);
 	}
 	else
 	{
 		#ifdef DEBUG
 		MessageBox(NULL, L"Error in the mutex", L"ERROR", MB_ICONERROR);
 		#endif
-        int err = GetLastError();
-		return 0;
+	}
+	endSend(bulk);
+
+	return result;
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: SendFile
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: October 18, 2026  Wait for control messages to be sent first.
+--
+-- INTERFACE: int TCPSocket::SendFile(char type, void* head, int headLen, HANDLE file, unsigned long offset,
+--		unsigned long length)
+--
+--	type : type of data
+--	head : data to send before the file data
+--  headLen : length of the data in head
+--  file : handle of a file opened for overlapped reads
+--  offset : offset into the file to start sending from
+--  length : number of bytes of the file to send
+--
+--	RETURNS: 1 in sucess, 0 in error
+--
+--	NOTES:
+--  This will send a single message made of head followed by a range of the file. The file data is sent by the
+--  kernel straight from the file cache using TransmitFile, so it is never copied into this process. The message
+--  is file data, so it waits for every control message that is waiting to be sent.
+----------------------------------------------------------------------------------------------------------------------*/
+int TCPSocket::SendFile(char type, void* head, int headLen, HANDLE file, unsigned long offset, unsigned long length)
+{
+	DWORD Flags = 0;
+	DWORD bytesSent;
+	WSAOVERLAPPED overlapped;
+	TRANSMIT_FILE_BUFFERS buffers;
+	char* header = (char*) _alloca(headLen + 5);
+	int messageLen = headLen + length;
+	int result = 0;
+
+	header[0] = type;
+	memcpy(&header[1], &messageLen, sizeof(messageLen));
+	memcpy(&header[5], head, headLen);
+	buffers.Head = header;
+	buffers.HeadLength = headLen + 5;
+	buffers.Tail = NULL;
+	buffers.TailLength = 0;
+
+	beginSend(true);
+	if (WaitForSingleObject(mutex, INFINITE) == WAIT_OBJECT_0)
+	{
+		ZeroMemory(&overlapped, sizeof(WSAOVERLAPPED));
+		overlapped.Offset = offset;
+		overlapped.hEvent = sendEvent;
+
+		if (TransmitFile(sd, file, length, 0, &overlapped, &buffers, 0))
+		{
+			result = 1;
+		}
+		else if (WSAGetLastError() == WSA_IO_PENDING || WSAGetLastError() == ERROR_IO_PENDING)
+		{
+			result = WSAGetOverlappedResult(sd, &overlapped, &bytesSent, TRUE, &Flags);
+		}
+
+		#ifdef DEBUG
+		if (!result)
+		{
+			MessageBox(NULL, L"TransmitFile() failed with error", L"ERROR", MB_ICONERROR);
+		}
+		#endif
+		ReleaseMutex(mutex);
+	}
+	endSend(true);
+
+	return result;
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: beginSend
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void TCPSocket::beginSend(bool bulk)
+--
+--	bulk : true if the message about to be sent is file data
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Called before taking the send mutex. Control messages count themselves as waiting; file data waits until no
+--  control message is waiting, so a control message never waits for more than the one message of file data that
+--  is already being sent, however many threads are sending files over the socket.
+----------------------------------------------------------------------------------------------------------------------*/
+void TCPSocket::beginSend(bool bulk)
+{
+	if (bulk)
+	{
+		WaitForSingleObject(controlIdle, INFINITE);
+		return;
 	}
 
+	WaitForSingleObject(priority, INFINITE);
+	++controlWaiting;
+	ResetEvent(controlIdle);
+	ReleaseMutex(priority);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: endSend
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: (Date and Description)
+--
+-- INTERFACE: void TCPSocket::endSend(bool bulk)
+--
+--	bulk : true if the message that was sent is file data
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  Called after releasing the send mutex. Lets file data through again once the last waiting control message has
+--  been sent.
+----------------------------------------------------------------------------------------------------------------------*/
+void TCPSocket::endSend(bool bulk)
+{
+	if (bulk)
+	{
+		return;
+	}
+
+	WaitForSingleObject(priority, INFINITE);
+	if (--controlWaiting == 0)
+	{
+		SetEvent(controlIdle);
+	}
+	ReleaseMutex(priority);
 }
 
 /*------------------------------------------------------------------------------------------------------------------
@@ -438,3 +681,28 @@ MessageQueue * TCPSocket::getMessageQueue( void )
 {
     return msgqueue;
 }
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: getPeerAddress
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: --
+--
+-- INTERFACE: unsigned long TCPSocket::getPeerAddress( void )
+--
+--	RETURNS: IPv4 address of the other end of the connection, in network byte order; 0 if it is not connected.
+--
+--	NOTES:
+--  This function will return the address of the host at the other end of the connection
+----------------------------------------------------------------------------------------------------------------------*/
+unsigned long TCPSocket::getPeerAddress( void )
+{
+	sockaddr_in address;
+	int length = sizeof(address);
+
+	if (getpeername(sd, (sockaddr*) &address, &length) == SOCKET_ERROR)
+		return 0;
+
+	return address.sin_addr.s_addr;
+}
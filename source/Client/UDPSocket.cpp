@@ -10,15 +10,19 @@
 	static DWORD WINAPI UDPThread(LPVOID lpParameter);
 	int Send(char type, void* data, int length, char* dest_ip, int dest_port);
 	int sendtoGroup(char type, void* data, int length);
+	int sendtoGroup(char type, void* data, int length, sockaddr_in* group);
 	void setGroup(char* group_address, int mem_flag);
+	void switchGroup(unsigned long group);
 	MessageQueue* getMessageQueue();
-	void stopSong();
-	void sendWave(SongName songloc, int speed, std::vector<TCPSocket*> sockets);
 --
 -- DATE: April 1, 2015
 --
 -- REVISIONS: April 4, 2015		Eric Tsang
 --			Fixed Memory leaks and buffer size problems.
+--			October 18, 2026
+--			Moved the sending of the stream to the server's StreamEngine.
+--			October 18, 2026
+--			Sends to and switches between the groups of the server's stations.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -66,7 +70,6 @@ UDPSocket::UDPSocket(int port, MessageQueue* mqueue)
 
 	HANDLE ThreadHandle;
 	DWORD ThreadId;
-	stopSending = false;
 
 	mutex = CreateMutex(NULL, FALSE, NULL);
 
@@ -270,6 +273,7 @@ DWORD WINAPI UDPSocket::UDPThread(LPVOID lpParameter)
 -- DATE: March 17, 2015
 --
 -- REVISIONS: (Date and Description)
+--			October 18, 2026	Records how much data each packet carried.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -324,6 +328,7 @@ DWORD UDPSocket::ThreadStart(void)
 			memcpy(&dataPacket,socketInfo.Buffer+1,len);
 			localDataPacket.index = dataPacket.index;
 			localDataPacket.srcAddr = source.sin_addr.s_addr;
+			localDataPacket.len = max(0, min(len - (int) sizeof(dataPacket.index), DATA_LEN));
 			memcpy(localDataPacket.data,dataPacket.data,DATA_LEN);
 			socketInfo.mqueue->enqueue(socketInfo.Buffer[0],&localDataPacket,sizeof(LocalDataPacket));
 		}
@@ -379,12 +384,46 @@ void UDPSocket::setGroup(char* group_address, int mem_flag)
 	setsockopt(sd, IPPROTO_IP, IP_MULTICAST_IF, (char*)&interfaceAddr, sizeof(interfaceAddr));
 }
 
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: switchGroup
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: --
+--
+-- DESIGNER: Manuel Gonzales
+--
+-- PROGRAMMER: Manuel Gonzales
+--
+-- INTERFACE: void UDPSocket::switchGroup(unsigned long group)
+--
+--	group : multicast group to join, in network byte order
+--
+--	RETURNS: nothing.
+--
+--	NOTES:
+--  This function will leave the group the socket was added to by setGroup, or the last call to this function,
+--	and add the socket to another one instead.
+----------------------------------------------------------------------------------------------------------------------*/
+void UDPSocket::switchGroup(unsigned long group)
+{
+	WaitForSingleObject(mutex, INFINITE);
+	if (mreq.imr_multiaddr.s_addr != group)
+	{
+		setsockopt(sd, IPPROTO_IP, IP_DROP_MEMBERSHIP, (char*)&mreq, sizeof(mreq));
+		mreq.imr_multiaddr.s_addr = group;
+		setsockopt(sd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char*)&mreq, sizeof(mreq));
+	}
+	ReleaseMutex(mutex);
+}
+
 /*------------------------------------------------------------------------------------------------------------------
 -- FUNCTION: sendtoGroup
 --
 -- DATE: April 2, 2015
 --
 -- REVISIONS: April 4  Eric Tsang
+--			October 18, 2026	Sends to the group given to the new overload.
 --
 -- DESIGNER: Manuel Gonzales
 --
@@ -396,17 +435,53 @@ void UDPSocket::setGroup(char* group_address, int mem_flag)
 --  data : data to send
 --	length : size of data in bytes
 --
---	RETURNS: nothing.
+--	RETURNS: 1 if the datagram was sent; 0 otherwise.
 --
 --	NOTES:
 --  This function will send a datagram via multicast to the default group for the socket
 ----------------------------------------------------------------------------------------------------------------------*/
 int UDPSocket::sendtoGroup(char type, void* data, int length)
+{
+	sockaddr_in address;
+	memset(&address,0,sizeof(address));
+	address.sin_family      = AF_INET;
+	address.sin_port        = htons(MULTICAST_PORT);
+	address.sin_addr.s_addr = inet_addr(MULTICAST_ADDR);
+
+	return sendtoGroup(type, data, length, &address);
+}
+
+/*------------------------------------------------------------------------------------------------------------------
+-- FUNCTION: sendtoGroup
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS: --
+--
+-- DESIGNER: Manuel Gonzales
+--
+-- PROGRAMMER: Manuel Gonzales
+--
+-- INTERFACE: int UDPSocket::sendtoGroup(char type, void* data, int length, sockaddr_in* group)
+--
+--	type : type of data to send
+--  data : data to send
+--	length : size of data in bytes
+--	group : multicast group and port to send to
+--
+--	RETURNS: 1 if the datagram was sent; 0 otherwise.
+--
+--	NOTES:
+--  This function will send a datagram via multicast to the given group, so one socket can send several
+--	groups.
+----------------------------------------------------------------------------------------------------------------------*/
+int UDPSocket::sendtoGroup(char type, void* data, int length, sockaddr_in* group)
 {
 	DWORD Flags;
 	SOCKET_INFORMATION socketInfo;
 	DWORD SendBytes;
 	DWORD WaitResult;
+	int sent = 0;
 	char* data_send = (char*)malloc(sizeof(char) * (length + 1));
 
 	data_send[0] = type;
@@ -424,14 +499,7 @@ int UDPSocket::sendtoGroup(char type, void* data, int length)
 		socketInfo.DataBuf.buf = data_send;
 		Flags = 0;
 
-		sockaddr_in address;
-		memset(&address,0,sizeof(address));
-		address.sin_family      = AF_INET;
-		address.sin_port        = htons(MULTICAST_PORT);
-        memcpy(&address.sin_addr,&mreq.imr_multiaddr,sizeof(mreq.imr_multiaddr));
-        address.sin_addr.s_addr = inet_addr(MULTICAST_ADDR);
-
-		if (WSASendTo(socketInfo.Socket, &(socketInfo.DataBuf), 1, &SendBytes, Flags, (struct sockaddr*)&address, sizeof(address),
+		if (WSASendTo(socketInfo.Socket, &(socketInfo.DataBuf), 1, &SendBytes, Flags, (struct sockaddr*)group, sizeof(*group),
 			0, 0) == SOCKET_ERROR)
 		{
 			int err;
@@ -442,15 +510,13 @@ int UDPSocket::sendtoGroup(char type, void* data, int length)
 				#ifdef DEBUG
 				MessageBox(NULL, errorStr, L"Error", MB_ICONERROR);
 				#endif
-				return 0;
 			}
 		}
 		else
 		{
-			free(data_send);
-			ReleaseMutex(mutex);
-			return 1;
+			sent = 1;
 		}
+		ReleaseMutex(mutex);
 	}
 	else
 	{
@@ -459,7 +525,8 @@ int UDPSocket::sendtoGroup(char type, void* data, int length)
 		#endif
 	}
 
-
+	free(data_send);
+	return sent;
 }
 
 /*------------------------------------------------------------------------------------------------------------------
@@ -484,98 +551,3 @@ MessageQueue* UDPSocket::getMessageQueue()
 {
 	return msgqueue;
 }
-
-/*------------------------------------------------------------------------------------------------------------------
--- FUNCTION: sendWave
---
--- DATE: April 2, 2015
---
--- REVISIONS: --
---
--- DESIGNER: Manuel Gonzales
---
--- PROGRAMMER: Manuel Gonzales
---
--- INTERFACE: void UDPSocket::sendWave(SongName songloc, int speed, vector<TCPSocket*> sockets)
---
---	songloc : structure golding the id and path of the song
---  speed : sending speed in bytes
---	sockets : a set of TCP sockets (clients)
---
---	RETURNS: nothing.
---
---	NOTES:
---  This function will send a song via multicast to all the clients and will send it in parts bnased on the speed
---	it will also send a flag notifying the clients the current song that is being played.
-----------------------------------------------------------------------------------------------------------------------*/
-void UDPSocket::sendWave(SongName songloc, int speed, vector<TCPSocket*> sockets)
-{
-	ServerControlThread * sct = ServerControlThread::getInstance();
-	wchar_t * path = sct->getPlaylist()->getSongPath( songloc.id );
-    char mbspath[STR_LEN];
-    sprintf(mbspath,"%S",path);
-	FILE* fp = fopen(mbspath, "rb");
-
-	free( path );
-
-	stopSending = false;
-
-	if (fp)
-	{
-		RequestPacket packet;
-
-		packet.index = songloc.id;
-
-		//for every client
-		for (int i = 0; i < sockets.size(); i++)
-		{
-			sockets[i]->Send(CHANGE_STREAM, &packet, sizeof(packet));
-		}
-
-		// continuously send voice data over the network when it becomes
-		// available
-		DataPacket voicePacket;
-		int count = 0;
-		voicePacket.index = 0;
-		char sound[DATA_LEN];
-		while(fread(sound,1,DATA_LEN,fp))
-		{
-			if(stopSending)
-			{
-				break;
-			}
-			++(voicePacket.index);
-			memcpy(voicePacket.data, sound, DATA_LEN);
-			sendtoGroup(MUSICSTREAM,&voicePacket,sizeof(voicePacket));
-			if(count++ > 11)
-			{
-				count = 0;
-				Sleep(5);
-			}
-		}
-		fclose(fp);
-	}
-}
-
-/*------------------------------------------------------------------------------------------------------------------
--- FUNCTION: stopSong
---
--- DATE: April 2, 2015
---
--- REVISIONS: --
---
--- DESIGNER: Manuel Gonzales
---
--- PROGRAMMER: Manuel Gonzales
---
--- INTERFACE: void UDPSocket::stopSong()
---
---	RETURNS: nothing.
---
---	NOTES:
---  This function will set the flag to stop sending music in the case of a change of song event
-----------------------------------------------------------------------------------------------------------------------*/
-void UDPSocket::stopSong()
-{
-	stopSending = true;
-}
@@ -61,8 +61,10 @@ DWORD WINAPI VoiceBufferer::_threadRoutine(void* params)
             break;
         case WAIT_OBJECT_0+1:   // jitter buffer has data
         {
-            dis->voiceJitterBuffer->get(element);
-            dis->speakerQueue->enqueue(1,element);
+            if(dis->voiceJitterBuffer->get(element))
+            {
+                dis->speakerQueue->enqueue(1,element);
+            }
             break;
         }
         default:
@@ -0,0 +1,318 @@
+#include "WinmmBackend.h"
+
+#pragma comment(lib,"winmm.lib")
+
+// winmm output implementation
+
+/**
+ * makes an output on the system's primary speakers. the device isn't opened
+ *   until {open} is called.
+ *
+ * @date     2026-10-18
+ */
+WinmmOutput::WinmmOutput()
+{
+    this->speakers   = 0;
+    this->capacity   = 0;
+    this->headers    = 0;
+    this->buffers    = 0;
+    this->oldest     = 0;
+    this->playing    = 0;
+    this->headerDone = CreateEvent(NULL,FALSE,FALSE,NULL);
+}
+
+WinmmOutput::~WinmmOutput()
+{
+    close();
+    CloseHandle(headerDone);
+}
+
+/**
+ * opens the device, which sets {headerDone} each time it finishes playing an
+ *   audio header, and allocates and prepares the ring of audio headers.
+ *
+ * @date     2026-10-18
+ *
+ * @return   MMSYSERR_NOERROR if the device was opened, and every header was
+ *   prepared; the error of waveOutOpen, or of the header that couldn't be
+ *   prepared, otherwise.
+ */
+int WinmmOutput::open(int sampleRate, int bitsPerSample, int channels,
+    int periodBytes, int periods)
+{
+    WAVEFORMATEX wfx;
+    wfx.nSamplesPerSec  = sampleRate;
+    wfx.wBitsPerSample  = bitsPerSample;
+    wfx.nChannels       = channels;
+    wfx.cbSize          = 0;
+    wfx.wFormatTag      = WAVE_FORMAT_PCM;
+    wfx.nBlockAlign     = (wfx.wBitsPerSample >> 3) * wfx.nChannels;
+    wfx.nAvgBytesPerSec = wfx.nBlockAlign * wfx.nSamplesPerSec;
+
+    int ret = waveOutOpen(&speakers,WAVE_MAPPER,&wfx,(DWORD_PTR) headerDone,0,CALLBACK_EVENT);
+    if(ret != MMSYSERR_NOERROR)
+    {
+        perror("unable to open WAVE_MAPPER device\n");
+        speakers = 0;
+        return ret;
+    }
+
+    capacity = periods;
+    headers  = (WAVEHDR*) calloc(capacity,sizeof(*headers));
+    buffers  = (char*) malloc(capacity*periodBytes);
+    oldest   = 0;
+    playing  = 0;
+
+    for(int i = 0; i < capacity && ret == MMSYSERR_NOERROR; ++i)
+    {
+        headers[i].lpData         = buffers+i*periodBytes;
+        headers[i].dwBufferLength = periodBytes;
+        ret = waveOutPrepareHeader(speakers,&headers[i],sizeof(headers[i]));
+    }
+    return ret;
+}
+
+/**
+ * takes back every audio header from the device, unprepares and frees the
+ *   ring, and closes the device.
+ *
+ * @date     2026-10-18
+ *
+ * @return   the result of waveOutClose; MMSYSERR_NOERROR if the device wasn't
+ *   open.
+ */
+int WinmmOutput::close()
+{
+    if(speakers == 0)
+    {
+        return MMSYSERR_NOERROR;
+    }
+
+    waveOutReset(speakers);
+    for(int i = 0; i < capacity; ++i)
+    {
+        if(headers[i].dwFlags&WHDR_PREPARED)
+        {
+            waveOutUnprepareHeader(speakers,&headers[i],sizeof(headers[i]));
+        }
+    }
+    free(headers);
+    free(buffers);
+    headers = 0;
+    buffers = 0;
+    playing = 0;
+
+    int ret = waveOutClose(speakers);
+    if(ret == MMSYSERR_NOERROR)
+    {
+        speakers = 0;
+    }
+    return ret;
+}
+
+char* WinmmOutput::getPeriod()
+{
+    _recycleHeaders();
+    return playing < capacity ? headers[(oldest+playing)%capacity].lpData : NULL;
+}
+
+int WinmmOutput::writePeriod(int len)
+{
+    WAVEHDR* header = &headers[(oldest+playing)%capacity];
+    header->dwBufferLength = len;
+
+    // the header is only in use if the device took it
+    int ret = waveOutWrite(speakers,header,sizeof(*header));
+    if(ret == MMSYSERR_NOERROR)
+    {
+        ++playing;
+    }
+    return ret;
+}
+
+int WinmmOutput::queued()
+{
+    _recycleHeaders();
+    return playing;
+}
+
+void WinmmOutput::wait(int timeoutMs)
+{
+    WaitForSingleObject(headerDone,timeoutMs);
+}
+
+void WinmmOutput::setVolume(unsigned long volume)
+{
+    if(speakers != 0)
+    {
+        waveOutSetVolume(speakers,volume);
+    }
+}
+
+/**
+ * takes back the headers the device has finished playing. the device plays
+ *   them in the order they were written, so they are taken back in order
+ *   from the oldest, until one that is still playing.
+ *
+ * @date     2026-10-18
+ */
+void WinmmOutput::_recycleHeaders()
+{
+    while(playing > 0 && (headers[oldest].dwFlags&WHDR_DONE))
+    {
+        oldest = (oldest+1)%capacity;
+        --playing;
+    }
+}
+
+// winmm input implementation
+
+WinmmInput::WinmmInput()
+{
+    this->mic       = 0;
+    this->handler   = NULL;
+    this->recording = false;
+    this->access    = CreateMutex(NULL,FALSE,NULL);
+}
+
+WinmmInput::~WinmmInput()
+{
+    close();
+    CloseHandle(access);
+}
+
+/**
+ * opens the microphone, and starts reading into the buffers added to it.
+ *
+ * @date     2026-10-18
+ *
+ * @return   MMSYSERR_NOERROR on success; the error of waveInOpen or
+ *   waveInStart otherwise.
+ */
+int WinmmInput::open(int sampleRate, int bitsPerSample, int channels,
+    AudioInputHandler* handler)
+{
+    WAVEFORMATEX format;
+    format.wFormatTag      = WAVE_FORMAT_PCM;
+    format.wBitsPerSample  = bitsPerSample;
+    format.nChannels       = channels;
+    format.nSamplesPerSec  = sampleRate;
+    format.nBlockAlign     = channels * bitsPerSample / 8;
+    format.nAvgBytesPerSec = format.nBlockAlign * sampleRate;
+    format.cbSize          = 0;
+
+    this->handler = handler;
+
+    // Attempt to open the Microphone for reading.
+    int ret = waveInOpen(&mic, WAVE_MAPPER, &format, (DWORD_PTR)WinmmInput::_waveInProc, (DWORD_PTR)this, WAVE_FORMAT_DIRECT | CALLBACK_FUNCTION);
+    if (ret != MMSYSERR_NOERROR)
+    {
+        mic = 0;
+        return ret;
+    }
+    recording = true;
+
+    // Start reading from the microphone into the buffers as they are added.
+    return waveInStart(mic);
+}
+
+/**
+ * adds a buffer to the device. its header is prepared the first time it is
+ *   added, and kept prepared until the device is closed, so adding it again
+ *   allocates nothing. must not be called from the handler, which runs in
+ *   the device's callback.
+ *
+ * @date     2026-10-18
+ *
+ * @return   MMSYSERR_NOERROR on success; the error of preparing or adding the
+ *   header otherwise.
+ */
+int WinmmInput::addBuffer(char* data, int len)
+{
+    WaitForSingleObject(access,INFINITE);
+
+    if (!recording)
+    {
+        ReleaseMutex(access);
+        return MMSYSERR_INVALHANDLE;
+    }
+
+    int ret = MMSYSERR_NOERROR;
+    WAVEHDR* hdr = wavHeaders[data];
+    if (hdr == NULL)
+    {
+        hdr = (WAVEHDR*) calloc(1, sizeof(WAVEHDR));
+        hdr->lpData = data;
+        hdr->dwBufferLength = len;
+        wavHeaders[data] = hdr;
+        ret = waveInPrepareHeader(mic, hdr, sizeof(WAVEHDR));
+    }
+    if (ret == MMSYSERR_NOERROR)
+    {
+        ret = waveInAddBuffer(mic, hdr, sizeof(WAVEHDR));
+    }
+
+    ReleaseMutex(access);
+    return ret;
+}
+
+/**
+ * hands back every buffer, unprepares and frees their headers, and waits for
+ *   the device to close; the handler is told when it does.
+ *
+ * @date     2026-10-18
+ */
+void WinmmInput::close()
+{
+    if (recording)
+    {
+        recording = false;
+
+        // Mark all Buffers as Complete; they are handed back by the callback
+        waveInReset(mic);
+
+        WaitForSingleObject(access,INFINITE);
+        std::map<char*,WAVEHDR*>::iterator i;
+        for (i = wavHeaders.begin(); i != wavHeaders.end(); ++i)
+        {
+            waveInUnprepareHeader(mic, i->second, sizeof(WAVEHDR));
+        }
+
+        // Wait for the device to close; the callback is done with the
+        // headers once it has
+        while (waveInClose(mic) == WAVERR_STILLPLAYING){}
+        mic = 0;
+
+        for (i = wavHeaders.begin(); i != wavHeaders.end(); ++i)
+        {
+            free(i->second);
+        }
+        wavHeaders.clear();
+        ReleaseMutex(access);
+    }
+}
+
+/**
+ * called by the device whenever it is opened, closed, or has filled a buffer.
+ *   a filled buffer is handed to the handler as it is; when the device
+ *   closes, the handler is told.
+ *
+ * @date     2026-10-18
+ *
+ * @param    dwInstance   the {WinmmInput}.
+ * @param    dwParam1   the filled buffer's header, for WIM_DATA.
+ */
+void CALLBACK WinmmInput::_waveInProc(HWAVEIN hwi, UINT uMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2)
+{
+    WinmmInput *dis = (WinmmInput*) dwInstance;
+
+    if (uMsg == WIM_DATA)
+    {
+        WAVEHDR *completed = (WAVEHDR*) dwParam1;
+        dis->handler->captured(completed->lpData, completed->dwBytesRecorded);
+    }
+    else if (uMsg == WIM_CLOSE)
+    {
+        dis->handler->stopped();
+    }
+}
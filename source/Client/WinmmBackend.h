@@ -0,0 +1,103 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: WinmmBackend.h
+--
+-- NOTES:
+-- The audio devices of Windows, through the waveOut and waveIn
+-- functions of winmm; see AudioBackend.h.
+--
+-- {WinmmOutput} writes periods from a ring of audio headers
+-- that are prepared once when it is opened, and has the device
+-- set an event each time it finishes one.
+--
+-- {WinmmInput} prepares a header for each buffer the first
+-- time it is added, and keeps it for when the buffer is added
+-- again; the device's callback only hands the buffers over as
+-- they are filled.
+--------------------------------------------------------------*/
+#ifndef WINMMBACKEND_H
+#define WINMMBACKEND_H
+
+#include "../Common.h"
+#include "AudioBackend.h"
+#include <map>
+
+class WinmmOutput : public AudioOutput
+{
+public:
+    WinmmOutput();
+    ~WinmmOutput();
+    virtual int open(int sampleRate, int bitsPerSample, int channels,
+        int periodBytes, int periods);
+    virtual int close();
+    virtual char* getPeriod();
+    virtual int writePeriod(int len);
+    virtual int queued();
+    virtual void wait(int timeoutMs);
+    virtual void setVolume(unsigned long volume);
+
+private:
+    void _recycleHeaders();
+
+    /**
+     * handle to the system's primary speakers; 0 while closed.
+     */
+    HWAVEOUT speakers;
+
+    /**
+     * ring of audio headers, and the buffers they point to; 0 while closed.
+     */
+    int capacity;
+    WAVEHDR* headers;
+    char* buffers;
+
+    /**
+     * index of the oldest header written to the device, and the number of
+     *   headers written that haven't finished playing yet.
+     */
+    int oldest;
+    int playing;
+
+    /**
+     * handle to event the device sets each time it finishes playing a header.
+     */
+    HANDLE headerDone;
+};
+
+class WinmmInput : public AudioInput
+{
+public:
+    WinmmInput();
+    ~WinmmInput();
+    virtual int open(int sampleRate, int bitsPerSample, int channels,
+        AudioInputHandler* handler);
+    virtual int addBuffer(char* data, int len);
+    virtual void close();
+
+private:
+    static void CALLBACK _waveInProc(HWAVEIN hwi, UINT uMsg, DWORD_PTR dwInstance,
+        DWORD_PTR dwParam1, DWORD_PTR dwParam2);
+
+    /**
+     * handle to the microphone; 0 while closed.
+     */
+    HWAVEIN mic;
+
+    /**
+     * told about every buffer that is filled.
+     */
+    AudioInputHandler* handler;
+
+    /**
+     * true from when the device is opened, until it is closed.
+     */
+    bool recording;
+
+    /**
+     * prepared header of every buffer that has been added, by its data, and
+     *   the mutex that protects them.
+     */
+    std::map<char*,WAVEHDR*> wavHeaders;
+    HANDLE access;
+};
+
+#endif
@@ -2,5 +2,7 @@
 #define _RESOURCE_H_
 
 #define IDB_MIC_TOGGLE		110
+#define IDB_TUNE_STATION	111
+#define IDT_REFRESH_STATS	120
 
 #endif
\ No newline at end of file
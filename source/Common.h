@@ -41,7 +41,7 @@
 
 /**
  * packet type requesting for a download. payload of this kind of packet is the
- *   {RequestPacket}
+ *   {DownloadRequestPacket}
  */
 #define REQUEST_DOWNLOAD '6'
 
@@ -61,6 +61,73 @@
  */
 #define DISCONNECT '9'
 
+/**
+ * packet type sent at the start of a bulk download. payload of this kind of
+ *   packet is the {FileTransferHeader}
+ */
+#define DOWNLOAD_HEADER 'A'
+
+/**
+ * packet type carrying a chunk of a bulk download. payload of this kind of
+ *   packet is the {FileChunkHeader}, followed by the chunk's file data.
+ */
+#define DOWNLOAD_CHUNK 'B'
+
+/**
+ * packet type offering a client a song that is being sent on a carousel.
+ *   payload of this kind of packet is the {CarouselOfferPacket}
+ */
+#define CAROUSEL_OFFER 'C'
+
+/**
+ * packet type of the datagrams sent on a carousel. payload of this kind of
+ *   packet is the {CarouselPacket}
+ */
+#define CAROUSEL_BLOCK 'D'
+
+/**
+ * packet type asking the server to stream a song to just this client from a
+ *   given sample, or telling the client its stream has ended. payload of this
+ *   kind of packet is the {SeekPacket}
+ */
+#define SEEK_STREAM 'E'
+
+/**
+ * packet type of the datagrams of a stream sent to a single client. payload
+ *   of this kind of packet is the {DataPacket}
+ */
+#define ONDEMAND_STREAM 'F'
+
+/**
+ * packet type carrying recent packets of the multicast stream to a client
+ *   that has just joined it or switched songs, so it can start playing
+ *   without waiting for the stream to fill its buffer. payload of this kind of
+ *   packet is the {PrefillPacket}
+ */
+#define STREAM_PREFILL 'G'
+
+/**
+ * packet type asking the server to tune the client to another station, or
+ *   telling the client which station it is tuned to. payload of the client's
+ *   packet is the {RequestPacket}, with the number of the station as its
+ *   index; payload of the server's is the {StationPacket}
+ */
+#define TUNE_STATION 'H'
+
+/**
+ * packet type multicast on a station's group ahead of, and at, the point where
+ *   the next song of the station starts, so clients carry on into it without
+ *   a change stream message. payload of this kind of packet is the
+ *   {FormatPacket}
+ */
+#define STREAM_FORMAT 'I'
+
+/**
+ * packet type of the voice the server mixed from every talker, when it mixes
+ *   the conference. payload of this kind of packet is the {DataPacket}
+ */
+#define VOICE_MIX 'J'
+
 #define WM_SEEK (WM_USER + 22)
 
 #endif
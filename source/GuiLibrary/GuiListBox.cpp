@@ -18,12 +18,37 @@ HWND GuiListBox::create(HINSTANCE hInstance, HWND parent)
 						  parent, NULL, hInstance, NULL);
 }
 
-void GuiListBox::addItem(LPWSTR text, int position)
+int GuiListBox::addItem(LPWSTR text, int position)
 {
-    SendMessage(hwnd, LB_INSERTSTRING, (WPARAM) position, (LPARAM)text);
+    return (int) SendMessage(hwnd, LB_INSERTSTRING, (WPARAM) position, (LPARAM)text);
 }
 
 void GuiListBox::removeItem(int n)
 {
 	SendMessage(hwnd, LB_DELETESTRING, (WPARAM)n, NULL);
+}
+
+void GuiListBox::clear()
+{
+	SendMessage(hwnd, LB_RESETCONTENT, 0, 0);
+}
+
+void GuiListBox::setItemData(int n, LPARAM data)
+{
+	SendMessage(hwnd, LB_SETITEMDATA, (WPARAM)n, data);
+}
+
+LPARAM GuiListBox::getItemData(int n)
+{
+	return (LPARAM) SendMessage(hwnd, LB_GETITEMDATA, (WPARAM)n, 0);
+}
+
+int GuiListBox::getSelected()
+{
+	return (int) SendMessage(hwnd, LB_GETCURSEL, 0, 0);
+}
+
+void GuiListBox::setSelected(int n)
+{
+	SendMessage(hwnd, LB_SETCURSEL, (WPARAM)n, 0);
 }
\ No newline at end of file
@@ -10,8 +10,13 @@ public:
 
 	virtual HWND create(HINSTANCE hInstance, HWND parent);
 
-	void addItem(LPWSTR text, int position);
+	int addItem(LPWSTR text, int position);
 	void removeItem(int n);
+	void clear();
+	void setItemData(int n, LPARAM data);
+	LPARAM getItemData(int n);
+	int getSelected();
+	void setSelected(int n);
 };
 
 #endif
\ No newline at end of file
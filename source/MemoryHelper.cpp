@@ -0,0 +1,152 @@
+#include "MemoryHelper.h"
+
+#include <psapi.h>
+
+#pragma comment(lib, "psapi.lib")
+
+///////////////////////////
+//  forward declarations //
+///////////////////////////
+
+/**
+ * maximum number of pages queried with a single call to QueryWorkingSetEx.
+ */
+#define QUERY_BATCH_PAGES 256
+
+/**
+ * range structure passed to PrefetchVirtualMemory; same layout as the SDK's
+ *   WIN32_MEMORY_RANGE_ENTRY, which older SDKs don't declare.
+ */
+struct MemoryRangeEntry
+{
+    PVOID VirtualAddress;
+    SIZE_T NumberOfBytes;
+};
+
+/**
+ * signature of PrefetchVirtualMemory, which only exists on Windows 8 and up,
+ *   so it is looked up at run time instead of being linked against.
+ */
+typedef BOOL (WINAPI * PrefetchVirtualMemoryFunc)(HANDLE, ULONG_PTR,
+    MemoryRangeEntry *, ULONG);
+
+static SIZE_T pageSize();
+
+//////////////////////////////
+// function implementations //
+//////////////////////////////
+
+/**
+ * returns the number of bytes of the passed range that are currently resident
+ *   in the working set of the process; bytes that would not page fault at all
+ *   when touched. pages that are only in the file cache are not counted.
+ *
+ * @function     residentBytes
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the range is rounded out to whole pages.
+ *
+ * @signature    unsigned long long residentBytes(const void* addr,
+ *   unsigned long long len)
+ *
+ * @param        addr   start of the range to inspect
+ * @param        len   length of the range to inspect in bytes
+ *
+ * @return       number of resident bytes in the range
+ */
+unsigned long long residentBytes(const void* addr, unsigned long long len)
+{
+    SIZE_T page = pageSize();
+    ULONG_PTR first = ((ULONG_PTR) addr) & ~(page - 1);
+    ULONG_PTR last  = ((ULONG_PTR) addr + (ULONG_PTR) len + page - 1) & ~(page - 1);
+
+    PSAPI_WORKING_SET_EX_INFORMATION info[QUERY_BATCH_PAGES];
+    unsigned long long resident = 0;
+
+    // query the pages in batches, and count the valid ones
+    for(ULONG_PTR cursor = first; cursor < last;)
+    {
+        int count = 0;
+        for(; count < QUERY_BATCH_PAGES && cursor < last; ++count, cursor += page)
+        {
+            info[count].VirtualAddress = (PVOID) cursor;
+        }
+
+        if(!QueryWorkingSetEx(GetCurrentProcess(), info, count * sizeof(info[0])))
+        {
+            break;
+        }
+
+        for(int i = 0; i < count; ++i)
+        {
+            if(info[i].VirtualAttributes.Valid)
+            {
+                resident += page;
+            }
+        }
+    }
+
+    return resident;
+}
+
+/**
+ * hints the operating system that the passed range is about to be read, so
+ *   it can start reading it in from disk ahead of time. does nothing on
+ *   systems that don't support PrefetchVirtualMemory.
+ *
+ * @function     prefetchRange
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void prefetchRange(const void* addr, unsigned long long len)
+ *
+ * @param        addr   start of the range that is about to be read
+ * @param        len   length of the range in bytes
+ */
+void prefetchRange(const void* addr, unsigned long long len)
+{
+    static PrefetchVirtualMemoryFunc prefetch = (PrefetchVirtualMemoryFunc)
+        GetProcAddress(GetModuleHandle(L"kernel32.dll"),"PrefetchVirtualMemory");
+
+    if(prefetch != 0 && len > 0)
+    {
+        MemoryRangeEntry range;
+        range.VirtualAddress = (PVOID) addr;
+        range.NumberOfBytes  = (SIZE_T) len;
+        prefetch(GetCurrentProcess(),1,&range,0);
+    }
+}
+
+/**
+ * returns the size of a page of virtual memory on this system.
+ *
+ * @function     pageSize
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    static SIZE_T pageSize()
+ *
+ * @return       size of a page in bytes
+ */
+static SIZE_T pageSize()
+{
+    static SIZE_T size = 0;
+    if(size == 0)
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        size = info.dwPageSize;
+    }
+    return size;
+}
@@ -0,0 +1,26 @@
+/**
+ * contains declarations of helper functions used to inspect and give hints
+ *   about regions of virtual memory, like mapped views of files.
+ *
+ * @sourceFile   MemoryHelper.h
+ *
+ * @program      commaudio.exe
+ *
+ * @function     unsigned long long residentBytes(const void* addr, unsigned long long len);
+ * @function     void prefetchRange(const void* addr, unsigned long long len);
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ */
+#ifndef _MEMORY_HELPER_H_
+#define _MEMORY_HELPER_H_
+
+#include "common.h"
+
+unsigned long long residentBytes(const void* addr, unsigned long long len);
+void prefetchRange(const void* addr, unsigned long long len);
+
+#endif
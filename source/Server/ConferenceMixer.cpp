@@ -0,0 +1,604 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: ConferenceMixer.cpp
+--
+-- NOTES:
+-- This file contains the implementation of the
+-- {ConferenceMixer} class.
+--------------------------------------------------------------*/
+#include "ConferenceMixer.h"
+#include "StreamEngine.h"
+#include "../Buffer/JitterBuffer.h"
+#include "../Buffer/MessageQueue.h"
+#include <emmintrin.h>
+
+/**
+ * a client that has sent its voice to the server.
+ *
+ * {address}; address the client's voice came from, and the mix is sent to
+ *
+ * {jitter}; voice of the client, in order
+ *
+ * {lastHeard}; performance counter value of when the client's voice was last
+ *   received
+ *
+ * {speaking}; true if a frame of the client was mixed in this period
+ *
+ * {frame}; the client's frame of this period
+ *
+ * {sentIndex}; index of the last packet of the mix sent to the client
+ *
+ * {frameLen}; length of the frames the client sends; 0 until the first one
+ *
+ * {gathering}; whole packets being gathered from shorter frames, each in the
+ *   slot of its index modulo {CONFERENCE_GATHER_PACKETS}
+ */
+struct ConferenceMixer::Talker
+{
+    /**
+     * a whole packet being gathered; {filled} is the number of bytes of it
+     *   received so far, or -1 once it has been put into the jitter buffer.
+     */
+    struct Gathering
+    {
+        int index;
+        int filled;
+        char data[ DATA_LEN ];
+    };
+
+    sockaddr_in address;
+    JitterBuffer * jitter;
+    volatile LONGLONG lastHeard;
+    bool speaking;
+    char frame[ DATA_LEN ];
+    int sentIndex;
+    int frameLen;
+    Gathering gathering[ CONFERENCE_GATHER_PACKETS ];
+};
+
+/**
+ * returns the singleton instance of the {ConferenceMixer}
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    ConferenceMixer * ConferenceMixer::getInstance()
+ *
+ * @return       the one and only {ConferenceMixer}
+ */
+ConferenceMixer * ConferenceMixer::getInstance()
+{
+    static ConferenceMixer * _instance = new ConferenceMixer();
+    return _instance;
+}
+
+/**
+ * creates a {ConferenceMixer} that isn't mixing anything.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the threads are started once the socket is set.
+ *
+ * @signature    ConferenceMixer::ConferenceMixer()
+ */
+ConferenceMixer::ConferenceMixer()
+    : udpSocket( NULL )
+    , mode( CONFERENCE_OFF )
+    , multicastIndex( 0 )
+    , framesMixed( 0 )
+    , packetsSent( 0 )
+    , receiveThread( NULL )
+    , mixThread( NULL )
+    , access( CreateMutex( NULL, FALSE, NULL ) )
+{
+    QueryPerformanceFrequency( &freq );
+}
+
+/**
+ * closes the handles of the {ConferenceMixer}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the mixer lives as long as the server, so its threads are
+ *   never stopped.
+ *
+ * @signature    ConferenceMixer::~ConferenceMixer()
+ */
+ConferenceMixer::~ConferenceMixer()
+{
+    CloseHandle( access );
+}
+
+/**
+ * sets the socket voice is received on and the mix is sent from, and starts
+ *   the threads of the {ConferenceMixer} if they aren't running yet.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the receiving thread empties the message queue of the socket
+ *   even when the mixer is off, so the socket never blocks on a full queue.
+ *
+ * @signature    void ConferenceMixer::setSocket( UDPSocket * sock )
+ *
+ * @param        sock   socket of the server
+ */
+void ConferenceMixer::setSocket( UDPSocket * sock )
+{
+    WaitForSingleObject( access, INFINITE );
+    udpSocket = sock;
+    if( receiveThread == NULL )
+    {
+        DWORD useless;
+        receiveThread = CreateThread( 0, 0, _receiveRoutine, 0, 0, &useless );
+        mixThread     = CreateThread( 0, 0, _mixRoutine, 0, 0, &useless );
+    }
+    ReleaseMutex( access );
+}
+
+/**
+ * sets how talkers are mixed, and who is sent the mix.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void ConferenceMixer::setMode( int mode )
+ *
+ * @param        mode   one of {CONFERENCE_OFF}, {CONFERENCE_UNICAST} or
+ *   {CONFERENCE_MULTICAST}
+ */
+void ConferenceMixer::setMode( int mode )
+{
+    WaitForSingleObject( access, INFINITE );
+    this->mode = mode;
+    ReleaseMutex( access );
+}
+
+/**
+ * returns how talkers are mixed, and who is sent the mix.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    int ConferenceMixer::getMode()
+ *
+ * @return       one of {CONFERENCE_OFF}, {CONFERENCE_UNICAST} or
+ *   {CONFERENCE_MULTICAST}
+ */
+int ConferenceMixer::getMode()
+{
+    WaitForSingleObject( access, INFINITE );
+    int mode = this->mode;
+    ReleaseMutex( access );
+    return mode;
+}
+
+/**
+ * copies the statistics of the {ConferenceMixer}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void ConferenceMixer::getStats( ConferenceStats * stats )
+ *
+ * @param        stats   filled with the statistics
+ */
+void ConferenceMixer::getStats( ConferenceStats * stats )
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter( &now );
+    LONGLONG idle = freq.QuadPart * CONFERENCE_IDLE_MS / 1000;
+
+    WaitForSingleObject( access, INFINITE );
+    stats->talkers = 0;
+    for( std::map< unsigned long, Talker * >::iterator it = talkers.begin(); it != talkers.end(); ++it )
+    {
+        stats->talkers += ( now.QuadPart - it->second->lastHeard <= idle );
+    }
+    stats->frames = InterlockedCompareExchange64( &framesMixed, 0, 0 );
+    stats->sent   = InterlockedCompareExchange64( &packetsSent, 0, 0 );
+    stats->cpuMs  = 0;
+
+    FILETIME created, exited, kernel, user;
+    if( mixThread != NULL && GetThreadTimes( mixThread, &created, &exited, &kernel, &user ) )
+    {
+        ULARGE_INTEGER k, u;
+        k.LowPart  = kernel.dwLowDateTime;
+        k.HighPart = kernel.dwHighDateTime;
+        u.LowPart  = user.dwLowDateTime;
+        u.HighPart = user.dwHighDateTime;
+        stats->cpuMs = (double) ( k.QuadPart + u.QuadPart ) / 10000.0;
+    }
+    ReleaseMutex( access );
+}
+
+/**
+ * adds a frame of voice to a sum, sixteen samples at a time. the unsigned 8
+ *   bit samples are made signed and widened to 16 bits, and added with
+ *   saturation.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void ConferenceMixer::accumulate( short * total,
+ *   const char * frame )
+ *
+ * @param        total   {DATA_LEN} 16 bit sums to add the frame to
+ * @param        frame   {DATA_LEN} unsigned 8 bit samples
+ */
+void ConferenceMixer::accumulate( short * total, const char * frame )
+{
+    __m128i bias = _mm_set1_epi8( (char) 0x80 );
+    for( int i = 0; i < DATA_LEN; i += 16 )
+    {
+        __m128i x  = _mm_xor_si128( _mm_loadu_si128( (const __m128i *) ( frame + i ) ), bias );
+        __m128i lo = _mm_srai_epi16( _mm_unpacklo_epi8( x, x ), 8 );
+        __m128i hi = _mm_srai_epi16( _mm_unpackhi_epi8( x, x ), 8 );
+        __m128i * t = (__m128i *) ( total + i );
+        _mm_storeu_si128( t, _mm_adds_epi16( _mm_loadu_si128( t ), lo ) );
+        _mm_storeu_si128( t + 1, _mm_adds_epi16( _mm_loadu_si128( t + 1 ), hi ) );
+    }
+}
+
+/**
+ * makes the mix a listener is sent; the sum of every talker, minus the
+ *   listener's own voice, saturated back to unsigned 8 bit samples. the same
+ *   work whatever the number of talkers.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void ConferenceMixer::mixMinus( char * dest,
+ *   const short * total, const char * own )
+ *
+ * @param        dest   filled with {DATA_LEN} unsigned 8 bit samples
+ * @param        total   {DATA_LEN} 16 bit sums of every talker
+ * @param        own   the listener's own frame; NULL if it didn't talk
+ */
+void ConferenceMixer::mixMinus( char * dest, const short * total, const char * own )
+{
+    __m128i bias = _mm_set1_epi8( (char) 0x80 );
+    for( int i = 0; i < DATA_LEN; i += 16 )
+    {
+        __m128i lo = _mm_loadu_si128( (const __m128i *) ( total + i ) );
+        __m128i hi = _mm_loadu_si128( (const __m128i *) ( total + i + 8 ) );
+        if( own != NULL )
+        {
+            __m128i x = _mm_xor_si128( _mm_loadu_si128( (const __m128i *) ( own + i ) ), bias );
+            lo = _mm_subs_epi16( lo, _mm_srai_epi16( _mm_unpacklo_epi8( x, x ), 8 ) );
+            hi = _mm_subs_epi16( hi, _mm_srai_epi16( _mm_unpackhi_epi8( x, x ), 8 ) );
+        }
+        __m128i mixed = _mm_xor_si128( _mm_packs_epi16( lo, hi ), bias );
+        _mm_storeu_si128( (__m128i *) ( dest + i ), mixed );
+    }
+}
+
+/**
+ * threaded routine that empties the message queue of the socket, and puts
+ *   the voice of each talker into its jitter buffer.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the socket may be replaced when the server is restarted, so
+ *   the queue to wait on is looked up again every so often.
+ *
+ * @signature    DWORD WINAPI ConferenceMixer::_receiveRoutine( void * params )
+ *
+ * @param        params   unused
+ *
+ * @return       exit code
+ */
+DWORD WINAPI ConferenceMixer::_receiveRoutine( void * params )
+{
+    ConferenceMixer * thiz = ConferenceMixer::getInstance();
+    LocalDataPacket packet;
+
+    while( true )
+    {
+        WaitForSingleObject( thiz->access, INFINITE );
+        MessageQueue * queue = thiz->udpSocket->getMessageQueue();
+        ReleaseMutex( thiz->access );
+
+        if( WaitForSingleObject( queue->hasMessage, 100 ) != WAIT_OBJECT_0 )
+        {
+            continue;
+        }
+
+        int type;
+        int len;
+        queue->dequeue( &type, &packet, &len );
+
+        // the server's own multicast comes back to it too; only voice is kept
+        if( type == MICSTREAM )
+        {
+            thiz->_receive( &packet );
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * threaded routine that mixes the talkers once every packet period of the
+ *   voice format, measured with the performance counter.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         if the thread falls far behind, it skips ahead instead of
+ *   sending a burst of mixes.
+ *
+ * @signature    DWORD WINAPI ConferenceMixer::_mixRoutine( void * params )
+ *
+ * @param        params   unused
+ *
+ * @return       exit code
+ */
+DWORD WINAPI ConferenceMixer::_mixRoutine( void * params )
+{
+    ConferenceMixer * thiz = ConferenceMixer::getInstance();
+    LONGLONG bytesPerSec = AUDIO_SAMPLE_RATE * AUDIO_BITS_PER_SAMPLE / 8 * NUM_AUDIO_CHANNELS;
+    LONGLONG period = thiz->freq.QuadPart * DATA_LEN / bytesPerSec;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter( &now );
+    LONGLONG due = now.QuadPart;
+
+    while( true )
+    {
+        QueryPerformanceCounter( &now );
+        if( now.QuadPart < due )
+        {
+            Sleep( max( (DWORD) ( ( due - now.QuadPart ) * 1000 / thiz->freq.QuadPart ), 1UL ) );
+            continue;
+        }
+
+        thiz->_mix();
+
+        due += period;
+        if( now.QuadPart - due > thiz->freq.QuadPart / 10 )
+        {
+            due = now.QuadPart;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * puts a packet of voice into the jitter buffer of its talker, making the
+ *   talker if it's the first packet from its address.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 frames shorter than a packet are gathered into
+ *   whole ones.
+ *               2026-10-18 frames are placed where their index puts them,
+ *   and whole packets are put under their own index.
+ *
+ * @note         only called from the receiving thread; voice is thrown away
+ *   while the mixer is off.
+ *
+ * @signature    void ConferenceMixer::_receive( LocalDataPacket * packet )
+ *
+ * @param        packet   the packet of voice
+ */
+void ConferenceMixer::_receive( LocalDataPacket * packet )
+{
+    Talker * talker = NULL;
+
+    WaitForSingleObject( access, INFINITE );
+    if( mode != CONFERENCE_OFF )
+    {
+        std::map< unsigned long, Talker * >::iterator it = talkers.find( packet->srcAddr );
+        if( it != talkers.end() )
+        {
+            talker = it->second;
+        }
+        else
+        {
+            talker = new Talker;
+            memset( &talker->address, 0, sizeof( talker->address ) );
+            talker->address.sin_family      = AF_INET;
+            talker->address.sin_port        = htons( MULTICAST_PORT );
+            talker->address.sin_addr.s_addr = packet->srcAddr;
+            talker->jitter    = new JitterBuffer( 5000, 100, DATA_LEN, 50, 0 );
+            talker->speaking  = false;
+            talker->sentIndex = 0;
+            talker->frameLen  = 0;
+            memset( talker->gathering, 0, sizeof( talker->gathering ) );
+            talkers[ packet->srcAddr ] = talker;
+        }
+        LARGE_INTEGER heard;
+        QueryPerformanceCounter( &heard );
+        talker->lastHeard = heard.QuadPart;
+    }
+    ReleaseMutex( access );
+
+    if( talker == NULL || packet->len <= 0 )
+    {
+        return;
+    }
+
+    // frames are numbered from 1, and are all as long as each other, so the
+    // index of a frame says where it goes in the talker's voice; a frame of
+    // a whole packet goes into the packet of the same index
+    unsigned long long offset = (unsigned long long) (unsigned int) ( packet->index - 1 ) * packet->len;
+    if( packet->len != talker->frameLen )
+    {
+        // the talker changed voice modes; its numbering starts over
+        if( talker->frameLen != 0 )
+        {
+            talker->jitter->reset( (int) ( offset / DATA_LEN ) );
+        }
+        talker->frameLen = packet->len;
+        memset( talker->gathering, 0, sizeof( talker->gathering ) );
+    }
+
+    for( int used = 0; used < packet->len; )
+    {
+        int index = (int) ( offset / DATA_LEN ) + 1;
+        int at    = (int) ( offset % DATA_LEN );
+        int n     = min( packet->len - used, DATA_LEN - at );
+        Talker::Gathering * whole = &talker->gathering[ (unsigned int) index % CONFERENCE_GATHER_PACKETS ];
+        offset += n;
+        used   += n;
+
+        // a frame of a packet that was already put into the jitter buffer
+        if( index - whole->index < 0 || ( index == whole->index && whole->filled < 0 ) )
+        {
+            continue;
+        }
+        if( index != whole->index )
+        {
+            // the slot's packet lost a frame; the rest of it is still played
+            if( whole->filled > 0 )
+            {
+                talker->jitter->put( whole->index, whole->data );
+            }
+            whole->index  = index;
+            whole->filled = 0;
+            memset( whole->data, 0x80, DATA_LEN );
+        }
+
+        memcpy( whole->data + at, packet->data + used - n, n );
+        whole->filled += n;
+        if( whole->filled >= DATA_LEN )
+        {
+            talker->jitter->put( whole->index, whole->data );
+            whole->filled = -1;
+        }
+    }
+}
+
+/**
+ * mixes a packet period of the talkers, and sends the mix. nothing is sent
+ *   if nobody talked, so the listeners' jitter buffers don't fill up with
+ *   silence.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 talkers silent for {CONFERENCE_EVICT_MS} are
+ *   forgotten.
+ *
+ * @note         only called from the mixing thread. the receiving thread
+ *   uses a talker right after hearing from it, so it never uses one that is
+ *   being forgotten.
+ *
+ * @signature    void ConferenceMixer::_mix()
+ */
+void ConferenceMixer::_mix()
+{
+    std::vector< Talker * > active;
+    std::vector< Talker * > gone;
+    UDPSocket * sock;
+    int mode;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter( &now );
+    LONGLONG idle  = freq.QuadPart * CONFERENCE_IDLE_MS / 1000;
+    LONGLONG evict = freq.QuadPart * CONFERENCE_EVICT_MS / 1000;
+
+    WaitForSingleObject( access, INFINITE );
+    mode = this->mode;
+    sock = udpSocket;
+    for( std::map< unsigned long, Talker * >::iterator it = talkers.begin(); it != talkers.end(); )
+    {
+        if( now.QuadPart - it->second->lastHeard > evict )
+        {
+            gone.push_back( it->second );
+            talkers.erase( it++ );
+            continue;
+        }
+        if( now.QuadPart - it->second->lastHeard <= idle )
+        {
+            active.push_back( it->second );
+        }
+        ++it;
+    }
+    ReleaseMutex( access );
+
+    for( int i = 0; i < (int) gone.size(); ++i )
+    {
+        delete gone[ i ]->jitter;
+        delete gone[ i ];
+    }
+
+    if( mode == CONFERENCE_OFF || active.empty() )
+    {
+        return;
+    }
+
+    // take a frame from every talker that has one ready
+    short total[ DATA_LEN ];
+    int speaking = 0;
+    memset( total, 0, sizeof( total ) );
+    for( int i = 0; i < (int) active.size(); ++i )
+    {
+        Talker * talker = active[ i ];
+        talker->speaking = WaitForSingleObject( talker->jitter->canGet, 0 ) == WAIT_OBJECT_0
+            && talker->jitter->get( talker->frame );
+        if( talker->speaking )
+        {
+            accumulate( total, talker->frame );
+            ++speaking;
+        }
+    }
+    if( speaking == 0 )
+    {
+        return;
+    }
+    InterlockedExchangeAdd64( &framesMixed, speaking );
+
+    DataPacket packet;
+    if( mode == CONFERENCE_MULTICAST )
+    {
+        // everybody's voice, once for every station
+        packet.index = ++multicastIndex;
+        mixMinus( packet.data, total, NULL );
+
+        StreamEngine * engine = StreamEngine::getInstance();
+        sockaddr_in group;
+        for( int i = 0; engine->getGroup( i, &group ); ++i )
+        {
+            sock->sendtoGroup( VOICE_MIX, &packet, sizeof( packet ), &group );
+            InterlockedIncrement64( &packetsSent );
+        }
+        return;
+    }
+
+    // everybody's voice but their own, to each talker
+    for( int i = 0; i < (int) active.size(); ++i )
+    {
+        Talker * talker = active[ i ];
+        packet.index = ++talker->sentIndex;
+        mixMinus( packet.data, total, talker->speaking ? talker->frame : NULL );
+        sock->sendtoGroup( VOICE_MIX, &packet, sizeof( packet ), &talker->address );
+        InterlockedIncrement64( &packetsSent );
+    }
+}
@@ -0,0 +1,160 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: ConferenceMixer.h
+--
+-- NOTES:
+-- The {ConferenceMixer} lets clients talk through the server,
+-- instead of sending their voice to each other. Every client
+-- that sends its voice to the server is a talker, with a jitter
+-- buffer of its own. Once every packet period, a frame of each
+-- talker is added up, and either each talker is sent the sum
+-- without its own voice, or the whole sum is multicast on every
+-- station. Either way, a client only ever plays one voice
+-- stream, however many people are talking, and the server
+-- spends the same on each listener.
+--
+-- Voice is 8 bit mono, like the microphones of the clients
+-- record it; the sum is kept in 16 bits, and saturated back to
+-- 8 when it is sent.
+--
+-- The mix works in frames of a whole packet. Talkers in the
+-- low-latency voice mode send shorter frames, which are gathered
+-- into whole ones, each where its index puts it, before they are
+-- put into the talker's jitter buffer under the index of the
+-- whole packet.
+--------------------------------------------------------------*/
+#ifndef CONFERENCEMIXER_H
+#define CONFERENCEMIXER_H
+
+#include "../common.h"
+#include "../protocol.h"
+#include <map>
+#include <vector>
+
+class JitterBuffer;
+
+/**
+ * modes of the {ConferenceMixer}.
+ *
+ * {CONFERENCE_OFF}; voice sent to the server is thrown away
+ *
+ * {CONFERENCE_UNICAST}; each talker is sent the mix of everybody else
+ *
+ * {CONFERENCE_MULTICAST}; the mix of everybody is multicast on every station
+ */
+#define CONFERENCE_OFF 0
+#define CONFERENCE_UNICAST 1
+#define CONFERENCE_MULTICAST 2
+
+/**
+ * milliseconds a talker has to be silent before it is left out of the mix,
+ *   and stops being sent the mix.
+ */
+#define CONFERENCE_IDLE_MS 3000
+
+/**
+ * milliseconds a talker has to be silent before it is forgotten, along with
+ *   its jitter buffer; it is made again if it talks after that.
+ */
+#define CONFERENCE_EVICT_MS 60000
+
+/**
+ * whole packets a talker's shorter frames are gathered into at once. a
+ *   packet still missing frames once a frame for the packet this many after
+ *   it arrives is put into the jitter buffer as it is, silent where the
+ *   missing frames would have gone.
+ */
+#define CONFERENCE_GATHER_PACKETS 4
+
+/**
+ * statistics about the {ConferenceMixer}.
+ *
+ * {talkers}; number of talkers heard from in the last {CONFERENCE_IDLE_MS}
+ *
+ * {frames}; number of talker frames mixed so far
+ *
+ * {sent}; number of mixed packets sent so far
+ *
+ * {cpuMs}; milliseconds of CPU time the mixing thread has used so far
+ */
+struct ConferenceStats
+{
+    int talkers;
+    unsigned long long frames;
+    unsigned long long sent;
+    double cpuMs;
+};
+
+class ConferenceMixer
+{
+public:
+    static ConferenceMixer * getInstance();
+
+    void setSocket( UDPSocket * sock );
+    void setMode( int mode );
+    int getMode();
+    void getStats( ConferenceStats * stats );
+
+    static void accumulate( short * total, const char * frame );
+    static void mixMinus( char * dest, const short * total, const char * own );
+
+protected:
+    ConferenceMixer();
+    ~ConferenceMixer();
+
+private:
+    struct Talker;
+
+    static DWORD WINAPI _receiveRoutine( void * params );
+    static DWORD WINAPI _mixRoutine( void * params );
+
+    void _receive( LocalDataPacket * packet );
+    void _mix();
+
+    /**
+     * socket voice is received on, and the mix is sent from.
+     */
+    UDPSocket * udpSocket;
+
+    /**
+     * one of {CONFERENCE_OFF}, {CONFERENCE_UNICAST} or
+     *   {CONFERENCE_MULTICAST}.
+     */
+    int mode;
+
+    /**
+     * talkers, indexed by their address; never shrinks, so the mixing thread
+     *   can hold on to them.
+     */
+    std::map< unsigned long, Talker * > talkers;
+
+    /**
+     * index of the last packet of the multicast mix.
+     */
+    int multicastIndex;
+
+    /**
+     * talker frames mixed, and mixed packets sent, so far; only changed by
+     *   the mixing thread, with interlocked operations.
+     */
+    volatile LONGLONG framesMixed;
+    volatile LONGLONG packetsSent;
+
+    /**
+     * frequency of the performance counter.
+     */
+    LARGE_INTEGER freq;
+
+    /**
+     * handles to the threads running {ConferenceMixer::_receiveRoutine} and
+     *   {ConferenceMixer::_mixRoutine}.
+     */
+    HANDLE receiveThread;
+    HANDLE mixThread;
+
+    /**
+     * protects the interface functions of the {ConferenceMixer}.
+     */
+    HANDLE access;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "ConferenceMixer.h"
+
+#ifdef TEST_CONFERENCE_MIXER
+
+/**
+ * benchmark of the mixing kernels of the ConferenceMixer. for more and more
+ *   talkers, a packet period of every talker is summed, and a mix without
+ *   their own voice is made for each of them, many times over. reports the
+ *   time taken to sum the talkers, and to make the mix of one listener, which
+ *   should not grow with the number of talkers.
+ */
+
+#define PERIODS 20000
+#define MAX_TALKERS 64
+
+int main(void)
+{
+    static char frames[MAX_TALKERS][DATA_LEN];
+    for(int t = 0; t < MAX_TALKERS; ++t)
+    {
+        for(int i = 0; i < DATA_LEN; ++i)
+        {
+            frames[t][i] = (char) (128+((i*(t+1))%64)-32);
+        }
+    }
+
+    // a talker alone hears silence
+    short total[DATA_LEN];
+    char mix[DATA_LEN];
+    memset(total,0,sizeof(total));
+    ConferenceMixer::accumulate(total,frames[5]);
+    ConferenceMixer::mixMinus(mix,total,frames[5]);
+    int wrong = 0;
+    for(int i = 0; i < DATA_LEN; ++i)
+    {
+        wrong += (unsigned char) mix[i] != 128;
+    }
+    printf("mix minus of a lone talker: %d of %d samples not silent\n",wrong,DATA_LEN);
+
+    LARGE_INTEGER freq, start, summed, mixed;
+    QueryPerformanceFrequency(&freq);
+
+    int counts[] = {1,2,4,8,16,32,64};
+    for(int c = 0; c < sizeof(counts)/sizeof(counts[0]); ++c)
+    {
+        int talkers = counts[c];
+        double sumUs = 0;
+        double mixUs = 0;
+        for(int p = 0; p < PERIODS; ++p)
+        {
+            QueryPerformanceCounter(&start);
+            memset(total,0,sizeof(total));
+            for(int t = 0; t < talkers; ++t)
+            {
+                ConferenceMixer::accumulate(total,frames[t]);
+            }
+            QueryPerformanceCounter(&summed);
+            for(int t = 0; t < talkers; ++t)
+            {
+                ConferenceMixer::mixMinus(mix,total,frames[t]);
+            }
+            QueryPerformanceCounter(&mixed);
+
+            sumUs += (double) (summed.QuadPart-start.QuadPart)*1000000/freq.QuadPart;
+            mixUs += (double) (mixed.QuadPart-summed.QuadPart)*1000000/freq.QuadPart;
+        }
+        printf("%3d talkers %8.3f us to sum %8.3f us per listener\n",
+            talkers,sumUs/PERIODS,mixUs/PERIODS/talkers);
+    }
+
+    return wrong != 0;
+}
+
+#endif
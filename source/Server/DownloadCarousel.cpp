@@ -0,0 +1,336 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: DownloadCarousel.cpp
+--
+-- NOTES:
+-- This file contains the implementation of the
+-- {DownloadCarousel} class.
+--------------------------------------------------------------*/
+#include "DownloadCarousel.h"
+#include "SongStore.h"
+#include "TransferScheduler.h"
+
+/**
+ * a song that is being sent on the carousel.
+ *
+ * {songId}; id of the song
+ *
+ * {data}; contents of the song, acquired from the {SongStore}
+ *
+ * {size}; size of the song file in bytes
+ *
+ * {listeners}; number of clients that were offered the carousel, and have
+ *   not left it yet. the carousel stops once there are none.
+ */
+struct DownloadCarousel::Carousel
+{
+    int songId;
+    const char * data;
+    unsigned long size;
+    int listeners;
+};
+
+/**
+ * returns the singleton instance of the {DownloadCarousel}
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    DownloadCarousel * DownloadCarousel::getInstance()
+ *
+ * @return       the one and only {DownloadCarousel}
+ */
+DownloadCarousel * DownloadCarousel::getInstance()
+{
+    static DownloadCarousel * _instance = new DownloadCarousel();
+    return _instance;
+}
+
+/**
+ * creates a {DownloadCarousel} with no carousels running.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the socket is created when the first carousel is started.
+ *
+ * @signature    DownloadCarousel::DownloadCarousel()
+ */
+DownloadCarousel::DownloadCarousel()
+    : sd( INVALID_SOCKET )
+    , access( CreateMutex( NULL, FALSE, NULL ) )
+{
+}
+
+/**
+ * closes the socket of the {DownloadCarousel}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    DownloadCarousel::~DownloadCarousel()
+ */
+DownloadCarousel::~DownloadCarousel()
+{
+    if( sd != INVALID_SOCKET )
+    {
+        closesocket( sd );
+    }
+    CloseHandle( access );
+}
+
+/**
+ * invoked when a client starts downloading a song. if somebody else is
+ *   already downloading the same song, the song is sent on a carousel, and the
+ *   client is offered the carousel instead of having the whole song sent to it
+ *   on its own.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the client that started downloading a song first keeps
+ *   downloading it over TCP; only the clients that come after it share the
+ *   carousel. every call must be matched by a call to
+ *   {DownloadCarousel::endDownload}, and every offer that was made by a call
+ *   to {DownloadCarousel::leave}.
+ *
+ * @signature    bool DownloadCarousel::startDownload( int songId,
+ *   CarouselOfferPacket * offer )
+ *
+ * @param        songId   id of the song the client is downloading
+ * @param        offer   set to the offer to send to the client
+ *
+ * @return       true if the client was offered the carousel.
+ */
+bool DownloadCarousel::startDownload( int songId, CarouselOfferPacket * offer )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    ++downloaders[ songId ];
+
+    Carousel * carousel = NULL;
+    std::map< int, Carousel * >::iterator it = carousels.find( songId );
+    if( it != carousels.end() )
+    {
+        carousel = it->second;
+    }
+    else if( downloaders[ songId ] > 1 )
+    {
+        // create the socket the first time it's needed
+        if( sd == INVALID_SOCKET )
+        {
+            char ttl = 2;
+            char loop = 1;
+            in_addr interfaceAddr;
+            interfaceAddr.s_addr = INADDR_ANY;
+
+            sd = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+            setsockopt( sd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof( ttl ) );
+            setsockopt( sd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof( loop ) );
+            setsockopt( sd, IPPROTO_IP, IP_MULTICAST_IF, (char *) &interfaceAddr, sizeof( interfaceAddr ) );
+        }
+
+        // start a carousel for the song
+        unsigned long size;
+        const char * data = SongStore::getInstance()->acquire( songId, &size );
+        if( data != NULL && size > 0 && sd != INVALID_SOCKET )
+        {
+            carousel = new Carousel;
+            carousel->songId    = songId;
+            carousel->data      = data;
+            carousel->size      = size;
+            carousel->listeners = 0;
+            carousels[ songId ] = carousel;
+
+            DWORD useless;
+            CloseHandle( CreateThread( 0, 0, _carouselRoutine, carousel, 0, &useless ) );
+        }
+        else if( data != NULL )
+        {
+            SongStore::getInstance()->release( songId );
+        }
+    }
+
+    if( carousel != NULL )
+    {
+        ++carousel->listeners;
+
+        offer->songId = songId;
+        offer->size   = carousel->size;
+        offer->port   = CAROUSEL_PORT;
+        strncpy( offer->group, CAROUSEL_ADDR, sizeof( offer->group ) );
+    }
+
+    ReleaseMutex( access );
+    return carousel != NULL;
+}
+
+/**
+ * invoked when a client that was offered the carousel of a song stops
+ *   listening to it.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void DownloadCarousel::leave( int songId )
+ *
+ * @param        songId   id of the song whose carousel the client left
+ */
+void DownloadCarousel::leave( int songId )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    std::map< int, Carousel * >::iterator it = carousels.find( songId );
+    if( it != carousels.end() && it->second->listeners > 0 )
+    {
+        --it->second->listeners;
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * invoked when a client stops downloading a song, whether or not it has
+ *   received all of it.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void DownloadCarousel::endDownload( int songId )
+ *
+ * @param        songId   id of the song the client was downloading
+ */
+void DownloadCarousel::endDownload( int songId )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    if( --downloaders[ songId ] <= 0 )
+    {
+        downloaders.erase( songId );
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * threaded routine that sends a song on the carousel. the song is cut into
+ *   {CAROUSEL_BLOCK_SIZE} blocks, and every {CAROUSEL_FEC_GROUP} blocks are
+ *   followed by their parity block. when the last group has been sent, the
+ *   carousel starts over from the first one.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - paced by the {TransferScheduler}
+ *
+ * @note         the blocks are sent at no more than {CAROUSEL_RATE}, however
+ *   many clients are listening, and share the upload budget with the other
+ *   downloads. the routine stops, and releases the song, as soon as
+ *   nobody is listening any more.
+ *
+ * @signature    DWORD WINAPI DownloadCarousel::_carouselRoutine( void * params )
+ *
+ * @param        params   the {Carousel} to send
+ *
+ * @return       exit code
+ */
+DWORD WINAPI DownloadCarousel::_carouselRoutine( void * params )
+{
+    DownloadCarousel * thiz = DownloadCarousel::getInstance();
+    Carousel * carousel = (Carousel *) params;
+    SongStore * store = SongStore::getInstance();
+
+    unsigned long blockCount = ( carousel->size + CAROUSEL_BLOCK_SIZE - 1 ) / CAROUSEL_BLOCK_SIZE;
+    unsigned long groupCount = ( blockCount + CAROUSEL_FEC_GROUP - 1 ) / CAROUSEL_FEC_GROUP;
+
+    sockaddr_in address;
+    memset( &address, 0, sizeof( address ) );
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons( CAROUSEL_PORT );
+    address.sin_addr.s_addr = inet_addr( CAROUSEL_ADDR );
+
+    char datagram[ 1 + sizeof( CarouselPacket ) ];
+    CarouselPacket packet;
+    CarouselPacket parity;
+    datagram[ 0 ] = CAROUSEL_BLOCK;
+    packet.songId = parity.songId = carousel->songId;
+    packet.size   = parity.size   = carousel->size;
+    packet.parity = 0;
+    parity.parity = 1;
+
+    // the carousel is a single download as far as the budget is concerned
+    TransferScheduler * scheduler = TransferScheduler::getInstance();
+    int transfer = scheduler->open( address.sin_addr.s_addr, carousel->songId );
+    scheduler->setLimit( transfer, CAROUSEL_RATE );
+
+    unsigned long group = 0;
+    unsigned long readAhead = 0;
+    while( true )
+    {
+        // stop once everybody has left
+        WaitForSingleObject( thiz->access, INFINITE );
+        if( carousel->listeners == 0 )
+        {
+            thiz->carousels.erase( carousel->songId );
+            ReleaseMutex( thiz->access );
+            break;
+        }
+        ReleaseMutex( thiz->access );
+
+        unsigned long first = group * CAROUSEL_FEC_GROUP;
+        unsigned long last  = min( first + CAROUSEL_FEC_GROUP, blockCount );
+        unsigned long offset = first * CAROUSEL_BLOCK_SIZE;
+
+        // ask for the next region to be read in before we get to it
+        if( offset == 0 )
+        {
+            readAhead = 0;
+        }
+        if( offset >= readAhead )
+        {
+            store->willRead( carousel->songId, readAhead, SONG_STORE_READ_AHEAD );
+            readAhead += SONG_STORE_READ_AHEAD;
+        }
+
+        // wait for the group's turn, then send its blocks, and their parity block
+        scheduler->send( transfer, ( last - first + 1 ) * sizeof( datagram ) );
+        memset( parity.data, 0, CAROUSEL_BLOCK_SIZE );
+        for( packet.block = first; packet.block < last; ++packet.block )
+        {
+            unsigned long len = min( carousel->size - offset, (unsigned long) CAROUSEL_BLOCK_SIZE );
+            memcpy( packet.data, carousel->data + offset, len );
+            memset( packet.data + len, 0, CAROUSEL_BLOCK_SIZE - len );
+            offset += len;
+
+            for( int i = 0; i < CAROUSEL_BLOCK_SIZE; ++i )
+            {
+                parity.data[ i ] ^= packet.data[ i ];
+            }
+
+            memcpy( datagram + 1, &packet, sizeof( packet ) );
+            sendto( thiz->sd, datagram, sizeof( datagram ), 0, (sockaddr *) &address, sizeof( address ) );
+        }
+        parity.block = group;
+        memcpy( datagram + 1, &parity, sizeof( parity ) );
+        sendto( thiz->sd, datagram, sizeof( datagram ), 0, (sockaddr *) &address, sizeof( address ) );
+
+        group = ( group + 1 ) % groupCount;
+    }
+
+    scheduler->close( transfer );
+    store->release( carousel->songId );
+    delete carousel;
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: DownloadCarousel.h
+--
+-- NOTES:
+-- The {DownloadCarousel} sends songs that several clients are
+-- downloading at the same time round and round on a multicast
+-- group, so the server sends each of them once no matter how
+-- many clients are downloading them.
+--------------------------------------------------------------*/
+#ifndef DOWNLOADCAROUSEL_H
+#define DOWNLOADCAROUSEL_H
+
+#include "../common.h"
+#include "../protocol.h"
+#include <map>
+
+/**
+ * most bytes per second each carousel is sent at.
+ */
+#define CAROUSEL_RATE (2*1024*1024)
+
+class DownloadCarousel
+{
+public:
+    static DownloadCarousel * getInstance();
+
+    bool startDownload( int songId, CarouselOfferPacket * offer );
+    void leave( int songId );
+    void endDownload( int songId );
+
+protected:
+    DownloadCarousel();
+    ~DownloadCarousel();
+
+private:
+    struct Carousel;
+
+    static DWORD WINAPI _carouselRoutine( void * params );
+
+    /**
+     * number of clients downloading each song, indexed by song id.
+     */
+    std::map< int, int > downloaders;
+
+    /**
+     * carousels that are running, indexed by song id.
+     */
+    std::map< int, Carousel * > carousels;
+
+    /**
+     * socket the carousels are sent from.
+     */
+    SOCKET sd;
+
+    /**
+     * protects the interface functions of the {DownloadCarousel}.
+     */
+    HANDLE access;
+};
+
+#endif
@@ -0,0 +1,489 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: FormatConverter.cpp
+--
+-- NOTES:
+-- This file contains the implementation of the
+-- {FormatConverter} class.
+--------------------------------------------------------------*/
+#include "FormatConverter.h"
+#include <emmintrin.h>
+#include <math.h>
+#include <malloc.h>
+
+#define PI 3.14159265358979323846
+
+/**
+ * creates a {FormatConverter} for a song.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - reads the samples from the song's data offset.
+ *
+ * @note         the converter only points at the contents of the song; they
+ *   have to stay acquired for as long as it is used.
+ *
+ * @signature    FormatConverter::FormatConverter( const char * data,
+ *   unsigned long size, SongName * song, StreamFormat * format )
+ *
+ * @param        data   contents of the song file, header and all
+ * @param        size   size of the song file
+ * @param        song   the song, in its own format
+ * @param        format   format to convert the song to
+ */
+FormatConverter::FormatConverter( const char * data, unsigned long size, SongName * song, StreamFormat * format )
+    : data( data )
+    , dataSize( size )
+    , source( *song )
+    , format( *format )
+    , renderedFirst( 0 )
+    , renderedCount( 0 )
+{
+    source.sample_rate = max( source.sample_rate, 1UL );
+    inFrameSize  = max( source.channels * source.bps / 8, 1 );
+    outFrameSize = format->channels * format->bps / 8;
+    inFrames     = ( size > source.dataOffset ) ? ( size - source.dataOffset ) / inFrameSize : 0;
+
+    SongName converted = source;
+    convert( &converted, format );
+    outFrames = converted.size / outFrameSize;
+    step      = ( (unsigned long long) source.sample_rate << 32 ) / format->sample_rate;
+
+    // the header of a plain PCM WAV file in the format of the stream
+    struct
+    {
+        char riff[4];
+        unsigned long riffSize;
+        char wave[4];
+        char fmt[4];
+        unsigned long fmtSize;
+        short formatTag, channels;
+        unsigned long sampleRate, byteRate;
+        short blockAlign, bitsPerSample;
+        char dataId[4];
+        unsigned long dataSize;
+    } wav = { {'R','I','F','F'}, getSize() - 8, {'W','A','V','E'},
+        {'f','m','t',' '}, 16, 1, format->channels, format->sample_rate,
+        format->sample_rate * outFrameSize, (short) outFrameSize, format->bps,
+        {'d','a','t','a'}, outFrames * outFrameSize };
+    memcpy( header, &wav, WAV_HEADER_SIZE );
+
+    span     = (long) ( ( CONVERTER_BLOCK_FRAMES * step ) >> 32 ) + CONVERTER_TAPS + 2;
+    filter   = (float *) _aligned_malloc( CONVERTER_PHASES * CONVERTER_TAPS * sizeof( float ), 16 );
+    input    = (float *) _aligned_malloc( span * format->channels * sizeof( float ), 16 );
+    mixed    = (float *) _aligned_malloc( CONVERTER_BLOCK_FRAMES * format->channels * sizeof( float ), 16 );
+    rendered = (char *) malloc( CONVERTER_BLOCK_FRAMES * outFrameSize );
+    _makeFilter();
+}
+
+/**
+ * frees the buffers of the {FormatConverter}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    FormatConverter::~FormatConverter()
+ */
+FormatConverter::~FormatConverter()
+{
+    _aligned_free( filter );
+    _aligned_free( input );
+    _aligned_free( mixed );
+    free( rendered );
+}
+
+/**
+ * tells whether a song has to be converted to be streamed in a format.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    bool FormatConverter::isNeeded( SongName * song,
+ *   StreamFormat * format )
+ *
+ * @param        song   the song
+ * @param        format   format of the stream; songs are streamed in their
+ *   own format if its sample rate is 0
+ *
+ * @return       true if the song isn't in the format of the stream already.
+ */
+bool FormatConverter::isNeeded( SongName * song, StreamFormat * format )
+{
+    return format->sample_rate != 0
+        && ( song->sample_rate != format->sample_rate
+        || song->bps != format->bps
+        || song->channels != format->channels );
+}
+
+/**
+ * changes the format and size of a song to what they are once it is
+ *   converted; left as is if it doesn't need to be. the clients use this to
+ *   know the size of the songs they are streamed.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - the converted song has a plain header.
+ *
+ * @note         the size doesn't count the header, just like the size of the
+ *   songs in the playlist.
+ *
+ * @signature    void FormatConverter::convert( SongName * song,
+ *   StreamFormat * format )
+ *
+ * @param        song   the song to change
+ * @param        format   format of the stream
+ */
+void FormatConverter::convert( SongName * song, StreamFormat * format )
+{
+    if( !isNeeded( song, format ) )
+    {
+        return;
+    }
+
+    unsigned long long frames = song->size / max( song->channels * song->bps / 8, 1 );
+    unsigned long long rate   = max( song->sample_rate, 1UL );
+    frames = ( frames * format->sample_rate + rate - 1 ) / rate;
+
+    song->sample_rate = format->sample_rate;
+    song->bps         = format->bps;
+    song->channels    = format->channels;
+    song->size        = (unsigned long) frames * ( format->channels * format->bps / 8 );
+    song->dataOffset  = WAV_HEADER_SIZE;
+}
+
+/**
+ * returns the size of the converted song, header and all.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    unsigned long FormatConverter::getSize()
+ *
+ * @return       size of the converted song in bytes
+ */
+unsigned long FormatConverter::getSize()
+{
+    return WAV_HEADER_SIZE + outFrames * outFrameSize;
+}
+
+/**
+ * returns the offset in the song file of the audio at an offset of the
+ *   converted song, so the right region of the file can be read ahead.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - counts from the song's data offset.
+ *
+ * @note         none
+ *
+ * @signature    unsigned long FormatConverter::sourceOffset(
+ *   unsigned long offset )
+ *
+ * @param        offset   offset in the converted song
+ *
+ * @return       offset in the song file
+ */
+unsigned long FormatConverter::sourceOffset( unsigned long offset )
+{
+    if( offset < WAV_HEADER_SIZE )
+    {
+        return 0;
+    }
+
+    unsigned long long frame = ( offset - WAV_HEADER_SIZE ) / outFrameSize;
+    frame = frame * ( step >> 32 ) + ( ( frame * ( step & 0xffffffff ) ) >> 32 );
+    return (unsigned long) min( source.dataOffset + frame * inFrameSize, (unsigned long long) dataSize );
+}
+
+/**
+ * reads part of the converted song. blocks of {CONVERTER_BLOCK_FRAMES}
+ *   frames are rendered as they are needed, so reading the song in order
+ *   converts each frame once.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         whatever is past the end of the converted song reads as 0.
+ *
+ * @signature    void FormatConverter::read( unsigned long offset,
+ *   char * dest, unsigned long len )
+ *
+ * @param        offset   offset in the converted song to read from
+ * @param        dest   buffer to read into
+ * @param        len   number of bytes to read
+ */
+void FormatConverter::read( unsigned long offset, char * dest, unsigned long len )
+{
+    while( len > 0 )
+    {
+        unsigned long n;
+        if( offset < WAV_HEADER_SIZE )
+        {
+            n = min( len, WAV_HEADER_SIZE - offset );
+            memcpy( dest, header + offset, n );
+        }
+        else
+        {
+            unsigned long pos   = offset - WAV_HEADER_SIZE;
+            unsigned long frame = pos / outFrameSize;
+            if( frame >= outFrames )
+            {
+                memset( dest, 0, len );
+                return;
+            }
+
+            if( frame < renderedFirst || frame >= renderedFirst + renderedCount )
+            {
+                _render( frame, min( outFrames - frame, (unsigned long) CONVERTER_BLOCK_FRAMES ) );
+            }
+
+            unsigned long from = pos - renderedFirst * outFrameSize;
+            n = min( len, renderedCount * outFrameSize - from );
+            memcpy( dest, rendered + from, n );
+        }
+        offset += n;
+        dest   += n;
+        len    -= n;
+    }
+}
+
+/**
+ * computes the coefficients of the filter; a sinc cut off below the lower of
+ *   the two Nyquist frequencies, shaped by a Blackman window. each phase sums
+ *   to 1, so the gain is the same whatever the phase.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         without resampling, phase 0 is the only one used, and it
+ *   passes the input through as is.
+ *
+ * @signature    void FormatConverter::_makeFilter()
+ */
+void FormatConverter::_makeFilter()
+{
+    double cutoff = 1.0;
+    if( source.sample_rate != format.sample_rate )
+    {
+        cutoff = min( 1.0, (double) format.sample_rate / source.sample_rate ) * 0.92;
+    }
+
+    for( int p = 0; p < CONVERTER_PHASES; ++p )
+    {
+        float * h = filter + p * CONVERTER_TAPS;
+        double sum = 0;
+        for( int k = 0; k < CONVERTER_TAPS; ++k )
+        {
+            // distance from the output sample to tap {k}
+            double d = k - CONVERTER_TAPS / 2 + 1 - (double) p / CONVERTER_PHASES;
+            double x = PI * cutoff * d;
+            double sinc = ( d == 0 ) ? 1.0 : sin( x ) / x;
+            double w = PI * d / ( CONVERTER_TAPS / 2 );
+            double window = 0.42 + 0.5 * cos( w ) + 0.08 * cos( 2 * w );
+            h[ k ] = (float) ( sinc * window );
+            sum += h[ k ];
+        }
+        for( int k = 0; k < CONVERTER_TAPS; ++k )
+        {
+            h[ k ] = (float) ( h[ k ] / sum );
+        }
+    }
+}
+
+/**
+ * renders output frames into {rendered}, in the format of the stream.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void FormatConverter::_render( unsigned long first,
+ *   unsigned long count )
+ *
+ * @param        first   first output frame to render
+ * @param        count   number of frames; at most {CONVERTER_BLOCK_FRAMES}
+ */
+void FormatConverter::_render( unsigned long first, unsigned long count )
+{
+    int channels = format.channels;
+
+    // position of the first frame in the input; the product is split so it
+    // doesn't overflow on long songs
+    unsigned long long stepInt  = step >> 32;
+    unsigned long long stepFrac = step & 0xffffffff;
+    unsigned long long fraction = (unsigned long long) first * stepFrac;
+    long index = (long) ( first * stepInt + ( fraction >> 32 ) );
+    fraction &= 0xffffffff;
+
+    long loaded = index - CONVERTER_TAPS / 2 + 1;
+    _load( loaded, span );
+
+    for( unsigned long n = 0; n < count; ++n )
+    {
+        const float * h = filter + ( fraction >> ( 32 - CONVERTER_PHASE_BITS ) ) * CONVERTER_TAPS;
+        long at = index - CONVERTER_TAPS / 2 + 1 - loaded;
+        for( int c = 0; c < channels; ++c )
+        {
+            const float * x = input + c * span + at;
+            __m128 acc = _mm_setzero_ps();
+            for( int k = 0; k < CONVERTER_TAPS; k += 4 )
+            {
+                acc = _mm_add_ps( acc, _mm_mul_ps( _mm_load_ps( h + k ), _mm_loadu_ps( x + k ) ) );
+            }
+            acc = _mm_add_ps( acc, _mm_movehl_ps( acc, acc ) );
+            acc = _mm_add_ss( acc, _mm_shuffle_ps( acc, acc, 1 ) );
+            mixed[ n * channels + c ] = _mm_cvtss_f32( acc );
+        }
+
+        fraction += stepFrac;
+        index    += (long) ( stepInt + ( fraction >> 32 ) );
+        fraction &= 0xffffffff;
+    }
+
+    // quantize, saturating what the filter overshot
+    int samples = count * channels;
+    int i = 0;
+    if( format.bps == 16 )
+    {
+        short * out = (short *) rendered;
+        __m128 scale = _mm_set1_ps( 32768.0f );
+        for( ; i + 8 <= samples; i += 8 )
+        {
+            __m128i lo = _mm_cvtps_epi32( _mm_mul_ps( _mm_load_ps( mixed + i ), scale ) );
+            __m128i hi = _mm_cvtps_epi32( _mm_mul_ps( _mm_load_ps( mixed + i + 4 ), scale ) );
+            _mm_storeu_si128( (__m128i *) ( out + i ), _mm_packs_epi32( lo, hi ) );
+        }
+        for( ; i < samples; ++i )
+        {
+            float s = mixed[ i ] * 32768.0f;
+            out[ i ] = (short) max( -32768.0f, min( 32767.0f, floorf( s + 0.5f ) ) );
+        }
+    }
+    else
+    {
+        unsigned char * out = (unsigned char *) rendered;
+        __m128 scale = _mm_set1_ps( 128.0f );
+        __m128i bias = _mm_set1_epi8( (char) 0x80 );
+        for( ; i + 16 <= samples; i += 16 )
+        {
+            __m128i a = _mm_cvtps_epi32( _mm_mul_ps( _mm_load_ps( mixed + i ), scale ) );
+            __m128i b = _mm_cvtps_epi32( _mm_mul_ps( _mm_load_ps( mixed + i + 4 ), scale ) );
+            __m128i c = _mm_cvtps_epi32( _mm_mul_ps( _mm_load_ps( mixed + i + 8 ), scale ) );
+            __m128i d = _mm_cvtps_epi32( _mm_mul_ps( _mm_load_ps( mixed + i + 12 ), scale ) );
+            __m128i bytes = _mm_packs_epi16( _mm_packs_epi32( a, b ), _mm_packs_epi32( c, d ) );
+            _mm_storeu_si128( (__m128i *) ( out + i ), _mm_xor_si128( bytes, bias ) );
+        }
+        for( ; i < samples; ++i )
+        {
+            float s = mixed[ i ] * 128.0f;
+            out[ i ] = (unsigned char) ( (int) max( -128.0f, min( 127.0f, floorf( s + 0.5f ) ) ) + 128 );
+        }
+    }
+
+    renderedFirst = first;
+    renderedCount = count;
+}
+
+/**
+ * decodes input frames into {input}, mixed to the channels of the stream.
+ *   a stream with fewer channels than the song gets the average of the
+ *   channels that fold onto each of its own; one with more repeats the
+ *   channels of the song.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         frames before the start or past the end of the song are
+ *   silent.
+ *
+ * @signature    void FormatConverter::_load( long first, long count )
+ *
+ * @param        first   first input frame to decode
+ * @param        count   number of frames; at most {span}
+ */
+void FormatConverter::_load( long first, long count )
+{
+    int inChannels  = max( source.channels, 1 );
+    int outChannels = format.channels;
+
+    for( int c = 0; c < outChannels; ++c )
+    {
+        float * row = input + c * span;
+        if( outChannels >= inChannels )
+        {
+            for( long i = 0; i < count; ++i )
+            {
+                row[ i ] = _sample( first + i, c % inChannels );
+            }
+            continue;
+        }
+
+        int folded = 0;
+        memset( row, 0, count * sizeof( float ) );
+        for( int from = c; from < inChannels; from += outChannels, ++folded )
+        {
+            for( long i = 0; i < count; ++i )
+            {
+                row[ i ] += _sample( first + i, from );
+            }
+        }
+        for( long i = 0; i < count; ++i )
+        {
+            row[ i ] /= folded;
+        }
+    }
+}
+
+/**
+ * decodes a sample of the song to a float between -1 and 1.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - reads from the song's data offset.
+ *
+ * @note         8 bit samples are unsigned, the rest signed, as in any WAV
+ *   file.
+ *
+ * @signature    float FormatConverter::_sample( long frame, int channel )
+ *
+ * @param        frame   input frame of the sample
+ * @param        channel   channel of the sample
+ *
+ * @return       the sample; 0 outside of the song
+ */
+float FormatConverter::_sample( long frame, int channel )
+{
+    if( frame < 0 || (unsigned long) frame >= inFrames )
+    {
+        return 0;
+    }
+
+    const unsigned char * p = (const unsigned char *) data + source.dataOffset
+        + frame * inFrameSize + channel * ( source.bps / 8 );
+    switch( source.bps )
+    {
+    case 8:
+        return ( (int) p[ 0 ] - 128 ) / 128.0f;
+    case 16:
+        return *(const short *) p / 32768.0f;
+    case 24:
+        return (float) (int) ( ( p[ 0 ] << 8 ) | ( p[ 1 ] << 16 ) | ( (unsigned) p[ 2 ] << 24 ) ) / 2147483648.0f;
+    case 32:
+        return *(const int *) p / 2147483648.0f;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,117 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: FormatConverter.h
+--
+-- NOTES:
+-- The {FormatConverter} presents a song in the format the
+-- server streams in, whatever the format of its file. The
+-- channels of the song are mixed down or copied out to the
+-- channels of the stream, and it is resampled with a polyphase
+-- windowed sinc filter, four taps at a time with SSE2.
+--
+-- The converted song is a WAV file of its own, header and all,
+-- and can be read from any offset, so the stations and on
+-- demand streams can read it just like the song file.
+--------------------------------------------------------------*/
+#ifndef FORMATCONVERTER_H
+#define FORMATCONVERTER_H
+
+#include "../common.h"
+#include "../protocol.h"
+
+/**
+ * taps of the filter per output sample; a multiple of 4.
+ */
+#define CONVERTER_TAPS 16
+
+/**
+ * phases the filter is computed for between two input samples.
+ */
+#define CONVERTER_PHASE_BITS 8
+#define CONVERTER_PHASES (1 << CONVERTER_PHASE_BITS)
+
+/**
+ * output frames rendered at a time.
+ */
+#define CONVERTER_BLOCK_FRAMES 256
+
+class FormatConverter
+{
+public:
+    FormatConverter( const char * data, unsigned long size, SongName * song, StreamFormat * format );
+    ~FormatConverter();
+
+    static bool isNeeded( SongName * song, StreamFormat * format );
+    static void convert( SongName * song, StreamFormat * format );
+
+    unsigned long getSize();
+    unsigned long sourceOffset( unsigned long offset );
+    void read( unsigned long offset, char * dest, unsigned long len );
+
+private:
+    void _makeFilter();
+    void _render( unsigned long first, unsigned long count );
+    void _load( long first, long count );
+    float _sample( long frame, int channel );
+
+    /**
+     * contents of the song file, and its size.
+     */
+    const char * data;
+    unsigned long dataSize;
+
+    /**
+     * header of the converted song.
+     */
+    char header[ WAV_HEADER_SIZE ];
+
+    /**
+     * format of the song file, and the format it is converted to.
+     */
+    SongName source;
+    StreamFormat format;
+
+    /**
+     * sizes of a sample frame in the song, and in the converted song.
+     */
+    unsigned long inFrameSize;
+    unsigned long outFrameSize;
+
+    /**
+     * sample frames in the song, and in the converted song.
+     */
+    unsigned long inFrames;
+    unsigned long outFrames;
+
+    /**
+     * input frames per output frame, in 32.32 fixed point.
+     */
+    unsigned long long step;
+
+    /**
+     * coefficients of the filter; {CONVERTER_TAPS} for each of the
+     *   {CONVERTER_PHASES} phases, aligned to 16 bytes.
+     */
+    float * filter;
+
+    /**
+     * input frames a block of output needs, mixed to the channels of the
+     *   stream; one row of {span} floats per channel.
+     */
+    float * input;
+    long span;
+
+    /**
+     * the last block rendered; {CONVERTER_BLOCK_FRAMES} frames in the format
+     *   of the stream, starting at frame {renderedFirst}.
+     */
+    char * rendered;
+    unsigned long renderedFirst;
+    unsigned long renderedCount;
+
+    /**
+     * the block being rendered, as floats, before it is quantized.
+     */
+    float * mixed;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "FormatConverter.h"
+#include <math.h>
+
+#ifdef TEST_FORMAT_CONVERTER
+
+/**
+ * throughput benchmark of the FormatConverter. songs of a few common formats
+ *   are generated in memory, and converted the way a station reads them, a
+ *   packet at a time, on the one thread. reports the output samples converted
+ *   per second on that core, and checks that a song converted to its own
+ *   rate comes out as it went in.
+ */
+
+#define TEST_SECONDS 30
+
+struct Case
+{
+    unsigned long sampleRate;
+    short bps;
+    short channels;
+    StreamFormat format;
+};
+
+char* makeSong(SongName* song, unsigned long sampleRate, short bps, short channels, unsigned long* size)
+{
+    unsigned long frameSize = channels*bps/8;
+    unsigned long frames = sampleRate*TEST_SECONDS;
+    *size = WAV_HEADER_SIZE+frames*frameSize;
+
+    memset(song,0,sizeof(*song));
+    song->sample_rate = sampleRate;
+    song->bps = bps;
+    song->channels = channels;
+    song->size = frames*frameSize;
+    song->dataOffset = WAV_HEADER_SIZE;
+
+    // a 440 Hz tone, a little quieter on each channel
+    char* data = (char*) calloc(*size,1);
+    for(unsigned long i = 0; i < frames; ++i)
+    {
+        for(int c = 0; c < channels; ++c)
+        {
+            double s = sin(2*3.14159265358979*440*i/sampleRate)*(0.5-0.1*c);
+            char* p = data+WAV_HEADER_SIZE+i*frameSize+c*bps/8;
+            if(bps == 8)
+            {
+                *(unsigned char*) p = (unsigned char) (s*127+128);
+            }
+            else
+            {
+                *(short*) p = (short) (s*32767);
+            }
+        }
+    }
+    return data;
+}
+
+int main(void)
+{
+    Case cases[] = {
+        {44100,16,2,{48000,16,2}},
+        {48000,16,2,{44100,16,2}},
+        {22050,8,1,{44100,16,2}},
+        {44100,16,2,{22050,8,1}},
+        {44100,16,1,{44100,16,2}},
+    };
+
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+    char packet[DATA_LEN];
+
+    printf("%d s songs, read %d bytes at a time\n",TEST_SECONDS,DATA_LEN);
+    for(int i = 0; i < sizeof(cases)/sizeof(cases[0]); ++i)
+    {
+        Case* c = &cases[i];
+        SongName song;
+        unsigned long size;
+        char* data = makeSong(&song,c->sampleRate,c->bps,c->channels,&size);
+
+        FormatConverter converter(data,size,&song,&c->format);
+        unsigned long converted = converter.getSize();
+
+        QueryPerformanceCounter(&start);
+        for(unsigned long offset = 0; offset < converted; offset += DATA_LEN)
+        {
+            converter.read(offset,packet,min(converted-offset,(unsigned long) DATA_LEN));
+        }
+        QueryPerformanceCounter(&end);
+
+        double seconds = (double) (end.QuadPart-start.QuadPart)/freq.QuadPart;
+        double samples = (double) (converted-WAV_HEADER_SIZE)/(c->format.bps/8);
+        printf("%6lu Hz %2d bit %d ch -> %6lu Hz %2d bit %d ch %10.0f samples/s %6.1fx real time\n",
+            c->sampleRate,c->bps,c->channels,
+            c->format.sample_rate,c->format.bps,c->format.channels,
+            samples/seconds,TEST_SECONDS/seconds);
+        free(data);
+    }
+
+    // at the same rate, the filter must pass the samples through
+    SongName song;
+    unsigned long size;
+    char* data = makeSong(&song,44100,8,1,&size);
+    StreamFormat format = {44100,16,1};
+    FormatConverter converter(data,size,&song,&format);
+
+    int wrong = 0;
+    for(unsigned long i = 0; i < 44100; ++i)
+    {
+        short out;
+        converter.read(WAV_HEADER_SIZE+i*2,(char*) &out,2);
+        int expected = ((int)(unsigned char) data[WAV_HEADER_SIZE+i]-128)*256;
+        wrong += abs(out-expected) > 1;
+    }
+    printf("passthrough: %d of 44100 samples wrong\n",wrong);
+    free(data);
+
+    return wrong != 0;
+}
+
+#endif
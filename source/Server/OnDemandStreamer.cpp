@@ -0,0 +1,303 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: OnDemandStreamer.cpp
+--
+-- NOTES:
+-- This file contains the implementation of the
+-- {OnDemandStreamer} class.
+--------------------------------------------------------------*/
+#include "OnDemandStreamer.h"
+#include "SongStore.h"
+#include "StreamEngine.h"
+#include "TransferScheduler.h"
+
+/**
+ * a song being streamed to a single client.
+ *
+ * {client}; control connection of the client
+ *
+ * {song}; the song being streamed
+ *
+ * {sample}; number of the sample frame the stream starts at, in the format
+ *   the song is streamed in
+ *
+ * {firstIndex}; index before the index of the first packet of the stream
+ *
+ * {address}; address the stream is sent to
+ *
+ * {stopping}; set to stop the stream before the end of the song
+ *
+ * {thread}; thread sending the stream
+ */
+struct OnDemandStreamer::Stream
+{
+    TCPSocket * client;
+    SongName song;
+    unsigned long sample;
+    int firstIndex;
+    sockaddr_in address;
+    volatile bool stopping;
+    HANDLE thread;
+};
+
+/**
+ * returns the singleton instance of the {OnDemandStreamer}
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    OnDemandStreamer * OnDemandStreamer::getInstance()
+ *
+ * @return       the one and only {OnDemandStreamer}
+ */
+OnDemandStreamer * OnDemandStreamer::getInstance()
+{
+    static OnDemandStreamer * _instance = new OnDemandStreamer();
+    return _instance;
+}
+
+/**
+ * creates an {OnDemandStreamer} with no streams running.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the socket is created when the first stream is started.
+ *
+ * @signature    OnDemandStreamer::OnDemandStreamer()
+ */
+OnDemandStreamer::OnDemandStreamer()
+    : sd( INVALID_SOCKET )
+    , access( CreateMutex( NULL, FALSE, NULL ) )
+{
+}
+
+/**
+ * closes the socket of the {OnDemandStreamer}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    OnDemandStreamer::~OnDemandStreamer()
+ */
+OnDemandStreamer::~OnDemandStreamer()
+{
+    if( sd != INVALID_SOCKET )
+    {
+        closesocket( sd );
+    }
+    CloseHandle( access );
+}
+
+/**
+ * starts streaming a song to a client, from the sample it seeked to. the
+ *   stream the client was sent before is stopped first.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the stream is sent to the client's address, on the port the
+ *   client receives the multicast stream on.
+ *
+ * @signature    void OnDemandStreamer::start( TCPSocket * client,
+ *   SongName * song, SeekPacket * seek )
+ *
+ * @param        client   control connection of the client
+ * @param        song   the song to stream
+ * @param        seek   the seek request of the client
+ */
+void OnDemandStreamer::start( TCPSocket * client, SongName * song, SeekPacket * seek )
+{
+    stop( client );
+
+    WaitForSingleObject( access, INFINITE );
+
+    // create the socket the first time it's needed
+    if( sd == INVALID_SOCKET )
+    {
+        sd = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    }
+
+    Stream * stream = new Stream;
+    stream->client     = client;
+    stream->song       = *song;
+    stream->sample     = seek->sample;
+    stream->firstIndex = seek->firstIndex;
+    stream->stopping   = false;
+
+    memset( &stream->address, 0, sizeof( stream->address ) );
+    stream->address.sin_family      = AF_INET;
+    stream->address.sin_port        = htons( MULTICAST_PORT );
+    stream->address.sin_addr.s_addr = client->getPeerAddress();
+
+    DWORD useless;
+    stream->thread = CreateThread( 0, 0, _streamRoutine, stream, 0, &useless );
+    streams[ client ] = stream;
+
+    ReleaseMutex( access );
+}
+
+/**
+ * stops the stream sent to a client, if there is one, and waits for it to
+ *   stop.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         invoked when the client seeks again, goes back to the
+ *   multicast stream, or disconnects.
+ *
+ * @signature    void OnDemandStreamer::stop( TCPSocket * client )
+ *
+ * @param        client   control connection of the client
+ */
+void OnDemandStreamer::stop( TCPSocket * client )
+{
+    Stream * stream = NULL;
+
+    WaitForSingleObject( access, INFINITE );
+    std::map< TCPSocket *, Stream * >::iterator it = streams.find( client );
+    if( it != streams.end() )
+    {
+        stream = it->second;
+        streams.erase( it );
+    }
+    ReleaseMutex( access );
+
+    if( stream != NULL )
+    {
+        stream->stopping = true;
+        WaitForSingleObject( stream->thread, INFINITE );
+        CloseHandle( stream->thread );
+        delete stream;
+    }
+}
+
+/**
+ * threaded routine that sends a stream. the first {ONDEMAND_PREFILL_MS} of
+ *   audio are sent at once, and the rest as it becomes due at the song's byte
+ *   rate, measured with the performance counter.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - converts the song to the stream format of the
+ *   {StreamEngine}, if it has one.
+ *               2026-10-18 - counts every packet against the stream reserve.
+ *               2026-10-18 - starts at the song's data offset, and echoes the
+ *   first index of the stream when it ends.
+ *
+ * @note         when the end of the song is reached, the client is sent a
+ *   {SEEK_STREAM} with an index of -1 and the stream's first index, so it
+ *   goes back to the multicast stream unless it has seeked again since.
+ *
+ * @signature    DWORD WINAPI OnDemandStreamer::_streamRoutine( void * params )
+ *
+ * @param        params   the {Stream} to send
+ *
+ * @return       exit code
+ */
+DWORD WINAPI OnDemandStreamer::_streamRoutine( void * params )
+{
+    OnDemandStreamer * thiz = OnDemandStreamer::getInstance();
+    Stream * stream = (Stream *) params;
+    SongStore * store = SongStore::getInstance();
+
+    unsigned long size;
+    const char * song = store->acquire( stream->song.id, &size );
+
+    if( song != NULL )
+    {
+        // stream the song in the same format as the stations
+        StreamFormat format;
+        FormatConverter * converter = NULL;
+        StreamEngine::getInstance()->getStreamFormat( &format );
+        if( FormatConverter::isNeeded( &stream->song, &format ) )
+        {
+            converter = new FormatConverter( song, size, &stream->song, &format );
+            size      = converter->getSize();
+            FormatConverter::convert( &stream->song, &format );
+        }
+
+        unsigned long frameSize   = max( stream->song.channels * stream->song.bps / 8, 1 );
+        unsigned long bytesPerSec = max( stream->song.sample_rate * frameSize, 1UL );
+        unsigned long prefill     = bytesPerSec / 1000 * ONDEMAND_PREFILL_MS;
+        unsigned long offset      = min( stream->song.dataOffset + stream->sample * frameSize, size );
+        unsigned long readAhead   = offset;
+        unsigned long long sent   = 0;
+
+        char datagram[ 1 + sizeof( DataPacket ) ];
+        DataPacket packet;
+        datagram[ 0 ] = ONDEMAND_STREAM;
+        packet.index  = stream->firstIndex;
+
+        LARGE_INTEGER freq;
+        LARGE_INTEGER start;
+        LARGE_INTEGER now;
+        QueryPerformanceFrequency( &freq );
+        QueryPerformanceCounter( &start );
+
+        while( offset < size && !stream->stopping )
+        {
+            // hold back until the next packet is due
+            LONGLONG due = start.QuadPart;
+            if( sent > prefill )
+            {
+                due += (LONGLONG) ( ( sent - prefill ) * freq.QuadPart / bytesPerSec );
+            }
+            QueryPerformanceCounter( &now );
+            if( now.QuadPart < due )
+            {
+                Sleep( max( (DWORD) ( ( due - now.QuadPart ) * 1000 / freq.QuadPart ), 1UL ) );
+                continue;
+            }
+
+            // ask for the next region to be read in before we get to it
+            if( offset >= readAhead )
+            {
+                store->willRead( stream->song.id, converter != NULL ? converter->sourceOffset( readAhead ) : readAhead, SONG_STORE_READ_AHEAD );
+                readAhead += SONG_STORE_READ_AHEAD;
+            }
+
+            unsigned long len = min( size - offset, (unsigned long) DATA_LEN );
+            ++packet.index;
+            if( converter != NULL )
+            {
+                converter->read( offset, packet.data, len );
+            }
+            else
+            {
+                memcpy( packet.data, song + offset, len );
+            }
+            memset( packet.data + len, 0, DATA_LEN - len );
+            offset += len;
+            sent   += len;
+
+            memcpy( datagram + 1, &packet, sizeof( packet ) );
+            TransferScheduler::getInstance()->sendStream( sizeof( datagram ) );
+            sendto( thiz->sd, datagram, sizeof( datagram ), 0, (sockaddr *) &stream->address, sizeof( stream->address ) );
+        }
+
+        delete converter;
+        store->release( stream->song.id );
+    }
+
+    // let the client know the stream has ended
+    if( !stream->stopping )
+    {
+        SeekPacket end;
+        end.index      = -1;
+        end.sample     = 0;
+        end.firstIndex = stream->firstIndex;
+        stream->client->Send( SEEK_STREAM, &end, sizeof( end ) );
+    }
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: OnDemandStreamer.h
+--
+-- NOTES:
+-- The {OnDemandStreamer} streams a song to a single client,
+-- starting at the sample it seeked to, while everybody else
+-- keeps listening to the multicast stream.
+--------------------------------------------------------------*/
+#ifndef ONDEMANDSTREAMER_H
+#define ONDEMANDSTREAMER_H
+
+#include "../common.h"
+#include "../protocol.h"
+#include <map>
+
+/**
+ * milliseconds of audio sent as fast as possible when a stream starts, so the
+ *   client can start playing right away; the rest is sent in real time.
+ */
+#define ONDEMAND_PREFILL_MS 500
+
+class OnDemandStreamer
+{
+public:
+    static OnDemandStreamer * getInstance();
+
+    void start( TCPSocket * client, SongName * song, SeekPacket * seek );
+    void stop( TCPSocket * client );
+
+protected:
+    OnDemandStreamer();
+    ~OnDemandStreamer();
+
+private:
+    struct Stream;
+
+    static DWORD WINAPI _streamRoutine( void * params );
+
+    /**
+     * streams being sent, indexed by the control connection of the client
+     *   they are sent to.
+     */
+    std::map< TCPSocket *, Stream * > streams;
+
+    /**
+     * socket the streams are sent from.
+     */
+    SOCKET sd;
+
+    /**
+     * protects the interface functions of the {OnDemandStreamer}.
+     */
+    HANDLE access;
+};
+
+#endif
@@ -24,7 +24,8 @@ static int getSongfileInfo(SongName* song, wchar_t* filepath, wchar_t* filename,
 -- NOTES:
 -- Initiates the {Playlist} by reading the files
 -- in a directory,  specified by a
--- path which can include wildcards ('*', '?')
+-- path which can include wildcards ('*', '?').
+-- Files that can't be read as wave files are skipped.
 --------------------------------------------------------------*/
 Playlist::Playlist( wchar_t * _dir )
 {
@@ -68,8 +69,11 @@ Playlist::Playlist( wchar_t * _dir )
 
 			// get the song information
 			SongName temp;
-			getSongfileInfo(&temp,directory,fileName,++curId);
-			playlist.emplace_back(temp);
+			// files that aren't wave files with a data chunk are left out
+			if (getSongfileInfo(&temp,directory,fileName,++curId) == 0)
+			{
+				playlist.emplace_back(temp);
+			}
 		}
 	} while (FindNextFile(hFind, &ffd) != 0);
 
@@ -138,6 +142,7 @@ int getSongfileInfo(SongName* song, wchar_t* filepath, wchar_t* filename, int so
 
 	// set song id and filename
 	song->id = songId;
+	song->dataOffset = WAV_HEADER_SIZE;
 	wsprintf(song->filepath,L"%s",filename);
 	sprintf_s(song->cFilename,"%S",filename);
 
@@ -186,9 +191,24 @@ int getSongfileInfo(SongName* song, wchar_t* filepath, wchar_t* filename, int so
 	fread(&avg_bytes_sec, sizeof(unsigned long), 1, fp);
 	fread(&block_align, sizeof(short), 1, fp);
 	fread(&song->bps, sizeof(short), 1, fp);
-	fread(id, sizeof(char), 4, fp);
-	fread(&data_size, sizeof(unsigned long), 1, fp);
 
+	// skip the rest of the format chunk, and any chunks before the data
+	fseek(fp, 20 + format_length, SEEK_SET);
+	while (fread(id, sizeof(char), 4, fp) == 4 && fread(&data_size, sizeof(unsigned long), 1, fp) == 1)
+	{
+		if (!strncmp(id, "data", 4))
+		{
+			song->dataOffset = ftell(fp);
+			song->size = data_size;
+			fclose(fp);
+			return 0;
+		}
+		fseek(fp, data_size + (data_size & 1), SEEK_CUR);
+	}
+
+	#ifdef DEBUG
+	MessageBox(NULL, L"NO DATA", L"ERROR", MB_ICONERROR);
+	#endif
 	fclose(fp);
-	return 0;
+	return 1;
 }
@@ -16,6 +16,7 @@ class Playlist
 {// friendly !!!
     friend class ServerControlThread;
     friend class ServerWindow; 
+    friend class StreamEngine;
 public:
     /*
     -- Initiates the {Playlist} by reading the files
@@ -12,6 +12,9 @@
 #include "../Client/FileTransferer.h"
 #include "../GuiLibrary/GuiWindow.h"
 #include "../GuiLibrary/GuiListBox.h"
+#include "OnDemandStreamer.h"
+#include "StreamEngine.h"
+#include "ConferenceMixer.h"
 
 /*
  * message queue constructor parameters
@@ -122,7 +125,8 @@ ServerControlThread::~ServerControlThread()
  *
  * @date         2015-04-09
  *
- * @revision     none
+ * @revision     2026-10-18 - hands the playlist to the {StreamEngine}, and
+ *   sets up its stations.
  *
  * @designer     Eric Tsang, Georgi Hristov
  *
@@ -141,6 +145,9 @@ void ServerControlThread::setPlaylist( Playlist * _playlist )
         WaitForSingleObject(access,INFINITE);
         playlist = _playlist;
         ReleaseMutex(access);
+
+        StreamEngine::getInstance()->setPlaylist( _playlist );
+        StreamEngine::getInstance()->setStations( STREAM_DEFAULT_STATIONS );
     }
 }
 
@@ -171,7 +178,9 @@ Playlist * ServerControlThread::getPlaylist()
  *
  * @date         2015-04-09
  *
- * @revision     none
+ * @revision     2026-10-18 - hands the socket to the {StreamEngine}.
+ *               2026-10-18 - and to the {ConferenceMixer}, which receives
+ *   the voice sent to the server.
  *
  * @designer     Eric Tsang, Georgi Hristov
  *
@@ -190,6 +199,8 @@ void ServerControlThread::setUDPSocket( UDPSocket * sock )
         WaitForSingleObject(access,INFINITE);
         udpSocket = sock;
         udpSocket->setGroup(MULTICAST_ADDR,0);
+        StreamEngine::getInstance()->setSocket(udpSocket);
+        ConferenceMixer::getInstance()->setSocket(udpSocket);
         ReleaseMutex(access);
     }
 }
@@ -199,7 +210,8 @@ void ServerControlThread::setUDPSocket( UDPSocket * sock )
  *
  * @date         2015-04-09
  *
- * @revision     none
+ * @revision     2026-10-18 - the change stream message is left to the
+ *   {StreamEngine}, which sends it after the playlist.
  *
  * @designer     Eric Tsang, Georgi Hristov
  *
@@ -219,15 +231,29 @@ void ServerControlThread::addConnection( TCPSocket * connection )
     QueueUserAPC( _sendPlaylistToOne        // _In_  PAPCFUNC pfnAPC,
                 , _thread                   // _In_  HANDLE hThread,
                 , (ULONG_PTR) connection ); // _In_  ULONG_PTR dwData
-	RequestPacket packet;
-	if(currentsong)
-	{
-		packet.index = currentsong->id;
-		connection->Send(CHANGE_STREAM, &packet, sizeof(packet));
-	}
     ReleaseMutex(access);
 }
 
+/**
+ * invoked when a client has opened a data connection with the server. data
+ *   connections only carry downloads, so they are served by the
+ *   {FileTransferer} instead of the control thread.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void ServerControlThread::addDataConnection( TCPSocket * connection )
+ *
+ * @param        connection   connection accepted on the data port
+ */
+void ServerControlThread::addDataConnection( TCPSocket * connection )
+{
+    fileTransferer->serveDataConnection( connection );
+}
+
 /**
  * stgarts the {ServerControlThread}
  *
@@ -320,7 +346,7 @@ DWORD WINAPI ServerControlThread::_threadRoutine( void * params )
 				thiz->_handleMsgChangeStream( &packet.requestPacket, sock );
                 break;
             case REQUEST_DOWNLOAD:
-                thiz->_handleMsgRequestDownload( &packet.requestPacket, sock);
+                thiz->_handleMsgRequestDownload( &packet.downloadRequestPacket, sock);
                 break;
             case CANCEL_DOWNLOAD:
                 thiz->_handleMsgCancelDownload( &packet.requestPacket, sock );
@@ -328,6 +354,12 @@ DWORD WINAPI ServerControlThread::_threadRoutine( void * params )
             case DISCONNECT:
                 thiz->_handleMsgDisconnect( handleNum - 1 );
                 break;
+            case SEEK_STREAM:
+                thiz->_handleMsgSeekStream( &packet.seekPacket, sock );
+                break;
+            case TUNE_STATION:
+                thiz->_handleMsgTuneStation( &packet.requestPacket, sock );
+                break;
             }
 		}
 		else if( handleNum == WAIT_IO_COMPLETION )
@@ -353,7 +385,12 @@ DWORD WINAPI ServerControlThread::_threadRoutine( void * params )
  *
  * @date         2015-04-09
  *
- * @revision     none
+ * @revision     2026-10-18 - stops the stream sent to the client alone, if it
+ *   was listening to one.
+ *               2026-10-18 - swaps the song of the {StreamEngine} instead of
+ *   stopping the multicast thread and starting a new one.
+ *               2026-10-18 - only swaps the song of the station the client
+ *   is tuned to.
  *
  * @designer     Eric Tsang, Georgi Hristov
  *
@@ -369,11 +406,20 @@ DWORD WINAPI ServerControlThread::_threadRoutine( void * params )
 void ServerControlThread::_handleMsgChangeStream( RequestPacket * data, TCPSocket * sock )
 {
 	ServerControlThread * sct = ServerControlThread::getInstance();
-    udpSocket->stopSong();
-    WaitForSingleObject(_multicastThread,5000);
-    DWORD useless;
+    LARGE_INTEGER requested;
+    QueryPerformanceCounter( &requested );
+
+    OnDemandStreamer::getInstance()->stop( sock );
 	SongName * song = playlist->getSong( data->index );
-    _multicastThread = CreateThread( 0, 0, _multicastRoutine, song, 0, &useless );
+    if( song == NULL )
+    {
+        return;
+    }
+
+    WaitForSingleObject( access, INFINITE );
+    currentsong = song;
+    ReleaseMutex( access );
+    StreamEngine::getInstance()->play( sock, song, requested.QuadPart );
 
 	sockaddr_in sockAddr;
 	int uusless = sizeof( sockaddr_in );
@@ -394,11 +440,14 @@ void ServerControlThread::_handleMsgChangeStream( RequestPacket * data, TCPSocke
 }
 
 /**
- * starts the download.
+ * starts the download of the requested range of the song.
  *
  * @date         2015-04-09
  *
- * @revision     none
+ * @revision     2026-10-18 - the request carries a byte range, so clients can
+ *   resume partial downloads.
+ *               2026-10-18 - the song is only sent in bulk if the client
+ *   asked for it.
  *
  * @designer     Eric Tsang, Georgi Hristov
  *
@@ -406,14 +455,16 @@ void ServerControlThread::_handleMsgChangeStream( RequestPacket * data, TCPSocke
  *
  * @note         none
  *
- * @signature    void ServerControlThread::_handleMsgRequestDownload( RequestPacket * data, TCPSocket* socket )
+ * @signature    void ServerControlThread::_handleMsgRequestDownload(
+ *   DownloadRequestPacket * data, TCPSocket* socket )
  *
  * @param        data   data of the packet
  * @param        socket   socket that the message was received from
  */
-void ServerControlThread::_handleMsgRequestDownload( RequestPacket * data, TCPSocket* socket )
+void ServerControlThread::_handleMsgRequestDownload( DownloadRequestPacket * data, TCPSocket* socket )
 {
-	fileTransferer->sendFile(playlist->getSong( data->index ), socket);
+	fileTransferer->sendFile( playlist->getSong( data->index ), socket, data->offset, data->length,
+        ( data->flags & DOWNLOAD_FLAG_BULK ) != 0 );
 }
 
 /**
@@ -444,7 +495,9 @@ void ServerControlThread::_handleMsgCancelDownload( RequestPacket * data, TCPSoc
  *
  * @date         2015-04-09
  *
- * @revision     none
+ * @revision     2026-10-18 - stops the stream sent to the client alone, if
+ *   there is one.
+ *               2026-10-18 - untunes the client from its station.
  *
  * @designer     Eric Tsang, Georgi Hristov
  *
@@ -458,12 +511,70 @@ void ServerControlThread::_handleMsgCancelDownload( RequestPacket * data, TCPSoc
  */
 void ServerControlThread::_handleMsgDisconnect( int client )
 {
+    OnDemandStreamer::getInstance()->stop( _socks[ client ] );
+    StreamEngine::getInstance()->leave( _socks[ client ] );
+
     WaitForSingleObject( access, INFINITE );
     _socks.erase( _socks.begin() + client );
     _sockHandles.erase( _sockHandles.begin() + client + 1 );
     ReleaseMutex( access );
 }
 
+/**
+ * handles a seek message from the client; starts streaming the song to the
+ *   client alone from the sample it seeked to, or stops the stream when the
+ *   index is -1.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the multicast stream is left alone, so the other clients
+ *   keep listening to it.
+ *
+ * @signature    void ServerControlThread::_handleMsgSeekStream( SeekPacket * data, TCPSocket * sock )
+ *
+ * @param        data   data of the packet
+ * @param        sock   socket that the message was received from
+ */
+void ServerControlThread::_handleMsgSeekStream( SeekPacket * data, TCPSocket * sock )
+{
+    if( data->index < 0 )
+    {
+        OnDemandStreamer::getInstance()->stop( sock );
+        return;
+    }
+
+    SongName * song = playlist->getSong( data->index );
+    if( song != NULL )
+    {
+        OnDemandStreamer::getInstance()->start( sock, song, data );
+    }
+}
+
+/**
+ * handles a tune station message from the client; tunes it to the station it
+ *   asked for, leaving the stream it was sent alone, if there was one.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the {StreamEngine} replies with the group of the station,
+ *   its song and the start of its stream.
+ *
+ * @signature    void ServerControlThread::_handleMsgTuneStation( RequestPacket * data, TCPSocket * sock )
+ *
+ * @param        data   data of the packet; its index is the number of the
+ *   station
+ * @param        sock   socket that the message was received from
+ */
+void ServerControlThread::_handleMsgTuneStation( RequestPacket * data, TCPSocket * sock )
+{
+    OnDemandStreamer::getInstance()->stop( sock );
+    StreamEngine::getInstance()->tune( sock, data->index );
+}
+
 /**
  * sends the playlist to all connected clients
  *
@@ -523,7 +634,9 @@ VOID CALLBACK ServerControlThread::_sendPlaylistToAllRoutine( ULONG_PTR )
  *
  * @date         2015-04-09
  *
- * @revision     none
+ * @revision     2026-10-18 - the {StreamEngine} sends the change stream
+ *   message, followed by the last few seconds of the stream, so the client
+ *   can start playing right away.
  *
  * @designer     Eric Tsang, Georgi Hristov
  *
@@ -547,22 +660,9 @@ VOID CALLBACK ServerControlThread::_sendPlaylistToOne( ULONG_PTR data )
         sock->Send( NEW_SONG, &(*songit), sizeof( SongName ) );
     }
 
-	RequestPacket packet;
-	if(thiz->currentsong)
-	{
-		packet.index = thiz->currentsong->id;
-		sock->Send(CHANGE_STREAM, &packet, sizeof(packet));
-	}
+    StreamEngine::getInstance()->join( sock );
 }
 
-DWORD WINAPI ServerControlThread::_multicastRoutine( void * params )
-{
-
-    ServerControlThread * thiz = ServerControlThread::getInstance();
-	thiz->currentsong = (SongName *) params;
-    thiz->udpSocket->sendWave( *((SongName *) params), 60, thiz->_socks );
-    return 0;
-}
 /////////////////////////////////////
 // static function implementations //
 /////////////////////////////////////
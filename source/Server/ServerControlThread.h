@@ -25,6 +25,7 @@ public:
     static ServerControlThread * getInstance();
 
     void addConnection(TCPSocket* connection);
+    void addDataConnection(TCPSocket* connection);
 
     void start();
     void stop();
@@ -44,14 +45,15 @@ protected:
 private:
 
     static DWORD WINAPI _threadRoutine( void * params );
-    static DWORD WINAPI _multicastRoutine( void * params );
 
     static DWORD WINAPI _sendFileToOne( void * params );
 
     void _handleMsgChangeStream( RequestPacket *, TCPSocket * );
-    void _handleMsgRequestDownload( RequestPacket *, TCPSocket* socket);
+    void _handleMsgRequestDownload( DownloadRequestPacket *, TCPSocket* socket);
     void _handleMsgCancelDownload( RequestPacket *, TCPSocket* socket );
     void _handleMsgDisconnect( int clientIndex );
+    void _handleMsgSeekStream( SeekPacket *, TCPSocket * sock );
+    void _handleMsgTuneStation( RequestPacket *, TCPSocket * sock );
 
     static VOID CALLBACK _sendPlaylistToAllRoutine( ULONG_PTR );
     static VOID CALLBACK _sendPlaylistToOne( ULONG_PTR tcpSock );
@@ -81,11 +83,6 @@ private:
      */
     HANDLE _thread;
 
-    /**
-     * handle to the thread used to run {ServerControlThread::_multicastRoutine}.
-     */
-    HANDLE _multicastThread;
-
     /**
      * handle to an event object, used to stop the execution of thread.
      */
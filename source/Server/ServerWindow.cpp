@@ -7,7 +7,10 @@
 -- virtual ~ServerWindow();
 -- virtual void onCreate();
 --
--- REVISIONS:
+-- REVISIONS: October 18, 2026 - Show the rate of every download, and let the upload budget
+--		and the limit of a download be changed while the server runs.
+--		October 18, 2026 - Let the format songs are streamed in be set.
+--		October 18, 2026 - Let the server mix the voice of the clients.
 --
 -- DESIGNER: Calvin Rempel
 --
@@ -32,6 +35,10 @@
 #include "../Buffer/MessageQueue.h"
 #include "ServerControlThread.h"
 #include "../Client/Sockets.h"
+#include "SongStore.h"
+#include "TransferScheduler.h"
+#include "StreamEngine.h"
+#include "ConferenceMixer.h"
 
 /**
  * element that is put into the message queue.
@@ -67,7 +74,7 @@ ServerWindow::ServerWindow(HINSTANCE hInst)
 	: GuiWindow(hInst)
 {
 	setup(windowClass, NULL, windowStyles);
-	setMiniumSize(700, 325);
+	setMiniumSize(700, 450);
 	setExitOnClose(true);
 
 	bottomPanelBrush = CreateSolidBrush(RGB(255, 0, 0));
@@ -101,6 +108,7 @@ ServerWindow::~ServerWindow()
 	DeleteObject(pen);
 
 	delete connectedClients;
+	delete transfersList;
 	delete bottomPanel;
 	delete leftPaddingPanel;
 
@@ -109,21 +117,33 @@ ServerWindow::~ServerWindow()
 	delete tcpInputPanel;
 	delete udpInputPanel;
 	delete playlistInputPanel;
+	delete rateInputPanel;
+	delete formatInputPanel;
+	delete voiceInputPanel;
 
 	delete tcpPortLabel;
     delete udpPortLabel;
     delete playlistLabel;
+	delete rateLabel;
+	delete formatLabel;
+	delete voiceLabel;
 
 	delete tcpPortInput;
 	delete udpPortInput;
 	delete playlistInput;
+	delete rateInput;
+	delete formatInput;
 	delete connectionButton;
+	delete applyRateButton;
+	delete voiceModeButton;
 }
 
 /*-------------------------------------------------------------------------------------------------
 -- FUNCTION: onCreate
 --
--- REVISIONS:
+-- REVISIONS: October 18, 2026 - Add the list of downloads, and the rate input.
+--		October 18, 2026 - Add the stream format input.
+--		October 18, 2026 - Add the voice mixing button.
 --
 -- DESIGNER: Calvin Rempel
 --
@@ -141,10 +161,11 @@ void ServerWindow::onCreate()
 {
 	// Set Window Properties
 	setTitle(L"CommAudio Server");
-	setSize(750, 325);
+	setSize(750, 480);
 
 	// Create Window Components
 	connectedClients = new GuiListBox(hInst, this);
+	transfersList = new GuiListBox(hInst, this);
 	bottomPanel = new GuiPanel(hInst, this);
 	leftPaddingPanel = new GuiPanel(hInst, bottomPanel);
 
@@ -153,16 +174,26 @@ void ServerWindow::onCreate()
 	tcpInputPanel = new GuiPanel(hInst, inputPanel);
 	udpInputPanel = new GuiPanel(hInst, inputPanel);
 	playlistInputPanel = new GuiPanel(hInst, inputPanel);
+	rateInputPanel = new GuiPanel(hInst, inputPanel);
+	formatInputPanel = new GuiPanel(hInst, inputPanel);
+	voiceInputPanel = new GuiPanel(hInst, inputPanel);
 
 	tcpPortLabel = new GuiLabel(hInst, tcpInputPanel);
 	udpPortLabel = new GuiLabel(hInst, udpInputPanel);
 	playlistLabel = new GuiLabel(hInst, playlistInputPanel);
+	rateLabel = new GuiLabel(hInst, rateInputPanel);
+	formatLabel = new GuiLabel(hInst, formatInputPanel);
+	voiceLabel = new GuiLabel(hInst, voiceInputPanel);
 
 	tcpPortInput = new GuiTextBox(hInst, tcpInputPanel, false);
 	udpPortInput = new GuiTextBox(hInst, udpInputPanel, false);
 	playlistInput = new GuiTextBox(hInst, playlistInputPanel, false);
+	rateInput = new GuiTextBox(hInst, rateInputPanel, false);
+	formatInput = new GuiTextBox(hInst, formatInputPanel, false);
 
 	connectionButton = new GuiButton(hInst, bottomPanel, IDB_CONNECTION_TOGGLE);
+	applyRateButton = new GuiButton(hInst, rateInputPanel, IDB_APPLY_RATE);
+	voiceModeButton = new GuiButton(hInst, voiceInputPanel, IDB_VOICE_MODE);
 
 	// Get the windows default vertical linear layout
 	GuiLinearLayout *layout = (GuiLinearLayout*)getLayoutManager();
@@ -176,9 +207,16 @@ void ServerWindow::onCreate()
 	connectedClients->setPreferredSize(0, 0);
 	layout->addComponent(connectedClients, &layoutProps);
 
+	// Add Transfers Listbox to the Window Layout, and refresh it periodically
+	transfersList->init();
+	transfersList->setPreferredSize(0, 0);
+	layout->addComponent(transfersList, &layoutProps);
+	addMessageListener(WM_TIMER, refreshTransfers, this);
+	SetTimer(getHWND(), IDT_REFRESH_TRANSFERS, TRANSFERS_REFRESH_MS, NULL);
+
 	// Add Bottom Panel to the Window Layout
 	bottomPanel->init();
-	bottomPanel->setPreferredSize(0, 100);
+	bottomPanel->setPreferredSize(0, 190);
 	bottomPanel->addCommandListener(BN_CLICKED, toggleConnection, this);
 	layout->addComponent(bottomPanel);
 
@@ -191,7 +229,7 @@ void ServerWindow::onCreate()
 	//layout->addComponent(leftPaddingPanel, &layoutProps);
 
 	inputPanel->init();
-	inputPanel->setPreferredSize(400, 120);
+	inputPanel->setPreferredSize(400, 180);
 	layoutProps.bottomMargin = 5;
 	layoutProps.topMargin = 5;
 	layoutProps.leftMargin = 5;
@@ -284,6 +322,93 @@ void ServerWindow::onCreate()
 	playlistInput->setPreferredSize(256, 0);
 	layout->addComponent(playlistInput, &layoutProps);
 
+
+	layout = (GuiLinearLayout*)inputPanel->getLayoutManager();
+
+	// Add the Rate Input Panel to the Bottom Panel Layout
+	rateInputPanel->init();
+	rateInputPanel->setPreferredSize(400, 30);
+	rateInputPanel->addCommandListener(BN_CLICKED, applyRate, this);
+	layoutProps.bottomMargin = 0;
+	layoutProps.topMargin = 0;
+	layoutProps.leftMargin = 5;
+	layoutProps.rightMargin = 5;
+	layout->addComponent(rateInputPanel, &layoutProps);
+
+	layout = (GuiLinearLayout*)rateInputPanel->getLayoutManager();
+	layout->setHorizontal(true);
+
+	rateLabel->init();
+	rateLabel->setText(L"Rate (KB/s):");
+	layoutProps.leftMargin = 0;
+	layoutProps.rightMargin = 0;
+	layoutProps.topMargin = 0;
+	layout->addComponent(rateLabel, &layoutProps);
+
+	rateInput->init();
+	rateInput->setPreferredSize(180, 0);
+	layout->addComponent(rateInput, &layoutProps);
+
+	applyRateButton->init();
+	applyRateButton->setText(L"Apply");
+	applyRateButton->setPreferredSize(76, 0);
+	layout->addComponent(applyRateButton, &layoutProps);
+
+
+	layout = (GuiLinearLayout*)inputPanel->getLayoutManager();
+
+	// Add the Format Input Panel to the Bottom Panel Layout; blank streams
+	// songs in their own format
+	formatInputPanel->init();
+	formatInputPanel->setPreferredSize(400, 30);
+	layoutProps.bottomMargin = 0;
+	layoutProps.topMargin = 0;
+	layoutProps.leftMargin = 5;
+	layoutProps.rightMargin = 5;
+	layout->addComponent(formatInputPanel, &layoutProps);
+
+	layout = (GuiLinearLayout*)formatInputPanel->getLayoutManager();
+	layout->setHorizontal(true);
+
+	formatLabel->init();
+	formatLabel->setText(L"Format:");
+	layoutProps.leftMargin = 0;
+	layoutProps.rightMargin = 0;
+	layoutProps.topMargin = 0;
+	layout->addComponent(formatLabel, &layoutProps);
+
+	formatInput->init();
+	formatInput->setPreferredSize(256, 0);
+	layout->addComponent(formatInput, &layoutProps);
+
+
+	layout = (GuiLinearLayout*)inputPanel->getLayoutManager();
+
+	// Add the Voice Input Panel to the Bottom Panel Layout
+	voiceInputPanel->init();
+	voiceInputPanel->setPreferredSize(400, 30);
+	voiceInputPanel->addCommandListener(BN_CLICKED, changeVoiceMode, this);
+	layoutProps.bottomMargin = 0;
+	layoutProps.topMargin = 0;
+	layoutProps.leftMargin = 5;
+	layoutProps.rightMargin = 5;
+	layout->addComponent(voiceInputPanel, &layoutProps);
+
+	layout = (GuiLinearLayout*)voiceInputPanel->getLayoutManager();
+	layout->setHorizontal(true);
+
+	voiceLabel->init();
+	voiceLabel->setText(L"Voice:");
+	layoutProps.leftMargin = 0;
+	layoutProps.rightMargin = 0;
+	layoutProps.topMargin = 0;
+	layout->addComponent(voiceLabel, &layoutProps);
+
+	voiceModeButton->init();
+	voiceModeButton->setText(L"Peer to peer");
+	voiceModeButton->setPreferredSize(256, 0);
+	layout->addComponent(voiceModeButton, &layoutProps);
+
     layout = (GuiLinearLayout*)bottomPanel->getLayoutManager();
 
 	connectionButton->init();
@@ -319,6 +444,189 @@ void ServerWindow::createLabelFont()
 	SendMessage(udpPortLabel->getHWND(), WM_SETFONT, (WPARAM)labelFont, TRUE);
 }
 
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: showSongStoreStats
+--
+-- REVISIONS:
+--
+-- INTERFACE: void showSongStoreStats()
+--
+-- RETURNS: void
+--
+-- NOTES:
+-- Lists how many times each song was mapped from disk, how many readers shared an existing
+-- mapping, and how much of what was read was already cached in memory.
+-------------------------------------------------------------------------------------------------*/
+void ServerWindow::showSongStoreStats()
+{
+	std::vector<SongStoreStats> stats;
+	SongStore::getInstance()->getStats(&stats);
+
+	for (std::vector<SongStoreStats>::iterator it = stats.begin(); it != stats.end(); ++it)
+	{
+		wchar_t line[256];
+		double residentRate = it->bytesRead ? 100.0 * it->bytesResident / it->bytesRead : 0;
+		swprintf(line, 256, L"song %d: mapped %lu, shared %lu, read %llu KB, resident %.1f%%",
+			it->songId, it->mapCount, it->shareCount, it->bytesRead / 1024, residentRate);
+		connectedClients->addItem(line, -1);
+	}
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: refreshTransfers
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: bool refreshTransfers(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam,
+--		LPARAM lParam, INT_PTR *retval)
+--		GuiComponent *pThis : the ServerWindow
+--		WPARAM wParam       : id of the timer that went off
+--
+-- RETURNS: true if the timer was the transfers refresh timer
+--
+-- NOTES:
+-- Lists every download the TransferScheduler is sending, with the rate it is being sent at. The
+-- id of each download is kept as the data of its line, and the selected download stays selected.
+-------------------------------------------------------------------------------------------------*/
+bool ServerWindow::refreshTransfers(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval)
+{
+	ServerWindow *serverWindow = (ServerWindow*) pThis;
+	GuiListBox *list = serverWindow->transfersList;
+	TransferScheduler *scheduler = TransferScheduler::getInstance();
+
+	if (wParam != IDT_REFRESH_TRANSFERS)
+	{
+		return false;
+	}
+
+	std::vector<TransferStats> stats;
+	scheduler->getStats(&stats);
+
+	int selected = list->getSelected();
+	int selectedId = selected >= 0 ? (int) list->getItemData(selected) : -1;
+	list->clear();
+
+	wchar_t line[256];
+	swprintf(line, 256, L"budget %lu KB/s, %lu KB/s reserved for the stream, stream at %lu KB/s",
+		scheduler->getBudget() / 1024, scheduler->getStreamReserve() / 1024,
+		scheduler->getStreamRate() / 1024);
+	list->setItemData(list->addItem(line, -1), -1);
+
+	for (std::vector<TransferStats>::iterator it = stats.begin(); it != stats.end(); ++it)
+	{
+		in_addr peer;
+		peer.s_addr = it->peer;
+		swprintf(line, 256, L"%S song %d: %lu KB/s, weight %d, limit %lu KB/s, sent %llu KB",
+			inet_ntoa(peer), it->songId, it->rate / 1024, it->weight, it->limit / 1024,
+			it->bytesSent / 1024);
+
+		int n = list->addItem(line, -1);
+		list->setItemData(n, it->id);
+		if (it->id == selectedId)
+		{
+			list->setSelected(n);
+		}
+	}
+
+	*retval = 0;
+	return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: applyRate
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: bool applyRate(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam,
+--		LPARAM lParam, INT_PTR *retval)
+--		GuiComponent *pThis : the ServerWindow
+--		UINT id             : id of the button that was clicked
+--
+-- RETURNS: true
+--
+-- NOTES:
+-- Limits the selected download to the rate typed in, in KB/s. If no download is selected, the
+-- rate becomes the upload budget of all the downloads and the stream instead. A rate of 0 lifts
+-- the limit.
+-------------------------------------------------------------------------------------------------*/
+bool ServerWindow::applyRate(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval)
+{
+	ServerWindow *serverWindow = (ServerWindow*) pThis;
+	TransferScheduler *scheduler = TransferScheduler::getInstance();
+
+	if (id != IDB_APPLY_RATE)
+	{
+		return true;
+	}
+
+	unsigned long rate = _wtoi(serverWindow->rateInput->getText()) * 1024;
+	int selected = serverWindow->transfersList->getSelected();
+	int transfer = selected >= 0 ? (int) serverWindow->transfersList->getItemData(selected) : -1;
+
+	if (transfer >= 0)
+	{
+		scheduler->setLimit(transfer, rate);
+	}
+	else
+	{
+		scheduler->setBudget(rate);
+	}
+
+	return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: changeVoiceMode
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: bool changeVoiceMode(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam,
+--		LPARAM lParam, INT_PTR *retval)
+--		GuiComponent *pThis : the ServerWindow
+--		UINT id             : id of the button that was clicked
+--
+-- RETURNS: true
+--
+-- NOTES:
+-- Goes on to the next way of handling the voice clients send to the server; thrown away, so
+-- clients talk peer to peer, mixed and sent to each talker without its own voice, or mixed and
+-- multicast on every station.
+-------------------------------------------------------------------------------------------------*/
+bool ServerWindow::changeVoiceMode(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval)
+{
+	ServerWindow *serverWindow = (ServerWindow*) pThis;
+	ConferenceMixer *mixer = ConferenceMixer::getInstance();
+
+	if (id != IDB_VOICE_MODE)
+	{
+		return true;
+	}
+
+	switch (mixer->getMode())
+	{
+	case CONFERENCE_OFF:
+		mixer->setMode(CONFERENCE_UNICAST);
+		serverWindow->voiceModeButton->setText(L"Mixed for each talker");
+		break;
+	case CONFERENCE_UNICAST:
+		mixer->setMode(CONFERENCE_MULTICAST);
+		serverWindow->voiceModeButton->setText(L"Mixed and multicast");
+		break;
+	default:
+		mixer->setMode(CONFERENCE_OFF);
+		serverWindow->voiceModeButton->setText(L"Peer to peer");
+		break;
+	}
+
+	return true;
+}
+
 typedef struct
 {
     WSAOVERLAPPED   overlapped;
@@ -471,6 +779,27 @@ void ServerWindow::newConnHandler( TCPConnection * connection, void * data )
     ServerControlThread::getInstance()->addConnection( new_client );
 }
 
+/*-------------------------------------------------------------------------------------------------
+-- FUNCTION: newDataConnHandler
+--
+-- DATE: October 18, 2026
+--
+-- REVISIONS:
+--
+-- INTERFACE: newDataConnHandler( TCPConnection * connection, void * data )
+--		TCPConnection * connection : the connection accepted on the data port
+--		void * data                : the ServerWindow
+--
+-- NOTES: Hands a connection accepted on the data port over to the file transferer, which
+-- serves download requests over it until it closes.
+-------------------------------------------------------------------------------------------------*/
+void ServerWindow::newDataConnHandler( TCPConnection * connection, void * data )
+{
+	MessageQueue* msgQueue = new MessageQueue(MCAPA, sizeof(TCPPacket));
+	TCPSocket*  new_client = new TCPSocket(connection->sock, msgQueue, true);
+    ServerControlThread::getInstance()->addDataConnection( new_client );
+}
+
 bool ServerWindow::toggleConnection(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval)
 {
 	ServerWindow *serverWindow = (ServerWindow*) pThis;
@@ -482,11 +811,14 @@ bool ServerWindow::toggleConnection(GuiComponent *pThis, UINT command, UINT id,
 	if (serverWindow->connected)
 	{
         serverWindow->connectedClients->addItem(L"Stoping...", -1);
+		serverWindow->showSongStoreStats();
 
 		serverWindow->server->disconnect();
+		serverWindow->dataServer->disconnect();
 		serverWindow->tcpPortInput->setEnabled(true);
 		serverWindow->udpPortInput->setEnabled(true);
 		serverWindow->playlistInput->setEnabled(true);
+		serverWindow->formatInput->setEnabled(true);
 		serverWindow->connectionButton->setText(L"Start Server");
 		serverWindow->connected = false;
 	}
@@ -497,6 +829,19 @@ bool ServerWindow::toggleConnection(GuiComponent *pThis, UINT command, UINT id,
 	{
         serverWindow->connectedClients->addItem(L"Starting...", -1);
 
+        // songs are converted to "<sample rate> <bits per sample> <channels>",
+        // if it is given
+        StreamFormat format;
+        if( swscanf_s( serverWindow->formatInput->getText(), L"%lu %hd %hd", &format.sample_rate, &format.bps, &format.channels ) == 3
+            && format.sample_rate > 0 && ( format.bps == 8 || format.bps == 16 ) && format.channels > 0 )
+        {
+            StreamEngine::getInstance()->setStreamFormat( &format );
+        }
+        else
+        {
+            StreamEngine::getInstance()->setStreamFormat( NULL );
+        }
+
         sct->setPlaylist( new Playlist( serverWindow->playlistInput->getText() ) );
 
         for( std::vector< SongName >::iterator it = sct->getPlaylist()->playlist.begin()
@@ -511,7 +856,8 @@ bool ServerWindow::toggleConnection(GuiComponent *pThis, UINT command, UINT id,
 		unsigned short groupAddress = inet_addr(MULTICAST_ADDR);
 
 		serverWindow->server = new Server(tcpPort, newConnHandler, serverWindow, groupAddress, udpPort);
-		if (serverWindow->server->startTCP())
+		serverWindow->dataServer = new Server(tcpPort + DATA_PORT_OFFSET, newDataConnHandler, serverWindow, groupAddress, udpPort);
+		if (serverWindow->server->startTCP() && serverWindow->dataServer->startTCP())
 		{
             sct->setUDPSocket( new UDPSocket( udpPort, new MessageQueue( MSGQ_CAPACITY, MSGQ_ELEM_SIZE ) ) );
             sct->start();
@@ -519,6 +865,7 @@ bool ServerWindow::toggleConnection(GuiComponent *pThis, UINT command, UINT id,
 		    serverWindow->tcpPortInput->setEnabled(false);
 		    serverWindow->udpPortInput->setEnabled(false);
 		    serverWindow->playlistInput->setEnabled(false);
+		    serverWindow->formatInput->setEnabled(false);
 		    serverWindow->connectionButton->setText(L"Close Server");
 		    serverWindow->connected = true;
 		}
@@ -7,7 +7,8 @@
 -- virtual ~ServerWindow();
 -- virtual void onCreate();
 --
--- REVISIONS:
+-- REVISIONS: October 18, 2026 - Show the rate of every download, and let the upload budget
+--		and the limit of a download be changed while the server runs.
 --
 -- DESIGNER: Calvin Rempel
 --
@@ -25,6 +26,11 @@
 
 #define BUFSIZE 64
 
+/*
+	Milliseconds between refreshes of the list of downloads being sent.
+*/
+#define TRANSFERS_REFRESH_MS 1000
+
 class Server;
 class GuiListBox;
 class GuiPanel;
@@ -51,6 +57,7 @@ public:
 
 private:
 	GuiListBox *connectedClients;
+	GuiListBox *transfersList;
 	GuiPanel *bottomPanel;
 
 	GuiPanel *leftPaddingPanel;
@@ -60,24 +67,36 @@ private:
 	GuiPanel *tcpInputPanel;
 	GuiPanel *udpInputPanel;
 	GuiPanel *playlistInputPanel;
+	GuiPanel *rateInputPanel;
+	GuiPanel *formatInputPanel;
+	GuiPanel *voiceInputPanel;
 
 	GuiLabel *tcpPortLabel;
 	GuiLabel *udpPortLabel;
 	GuiLabel *playlistLabel;
+	GuiLabel *rateLabel;
+	GuiLabel *formatLabel;
+	GuiLabel *voiceLabel;
 
 	GuiTextBox *tcpPortInput;
 	GuiTextBox *udpPortInput;
 	GuiTextBox *playlistInput;
+	GuiTextBox *rateInput;
+	GuiTextBox *formatInput;
 
 	GuiButton *connectionButton;
+	GuiButton *applyRateButton;
+	GuiButton *voiceModeButton;
 
     HFONT labelFont;
 	HBRUSH bottomPanelBrush;
 	HPEN pen;
 
 	void createLabelFont();
+	void showSongStoreStats();
 
     Server * server;
+    Server * dataServer;
 	bool connected;
 
     UDPSocket* udpSock;
@@ -90,7 +109,11 @@ private:
                                 , LPWSAOVERLAPPED lpOverlapped
                                 , DWORD dwFlags );
 	static bool toggleConnection(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
+	static bool applyRate(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
+	static bool changeVoiceMode(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
+	static bool refreshTransfers(GuiComponent *pThis, UINT command, UINT id, WPARAM wParam, LPARAM lParam, INT_PTR *retval);
     static void newConnHandler( TCPConnection * server, void * data );
+    static void newDataConnHandler( TCPConnection * server, void * data );
 };
 
 #endif
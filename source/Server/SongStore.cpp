@@ -0,0 +1,416 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: SongStore.cpp
+--
+-- NOTES:
+-- This file contains the implementation of the {SongStore}
+-- class.
+--------------------------------------------------------------*/
+#include "SongStore.h"
+#include "StreamEngine.h"
+#include "../MemoryHelper.h"
+
+/**
+ * a song file that is mapped into memory, or was mapped into memory earlier.
+ *   the statistics outlive the mapping, so they accumulate over the lifetime
+ *   of the server.
+ *
+ * {file}; handle to the opened song file; INVALID_HANDLE_VALUE if unmapped
+ *
+ * {mapping}; handle to the file mapping object; NULL if unmapped
+ *
+ * {view}; pointer to the start of the mapped view; NULL if unmapped
+ *
+ * {lastUsed}; tick count of when the song was last released
+ *
+ * {stats}; statistics about the song
+ */
+struct SongStore::MappedSong
+{
+    HANDLE file;
+    HANDLE mapping;
+    const char * view;
+    DWORD lastUsed;
+    SongStoreStats stats;
+};
+
+/**
+ * returns the singleton instance of the {SongStore}
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    SongStore * SongStore::getInstance()
+ *
+ * @return       the one and only {SongStore}
+ */
+SongStore * SongStore::getInstance()
+{
+    static SongStore * _instance = new SongStore();
+    return _instance;
+}
+
+/**
+ * creates an empty {SongStore}
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    SongStore::SongStore()
+ */
+SongStore::SongStore()
+    : access( CreateMutex( NULL, FALSE, NULL ) )
+{
+}
+
+/**
+ * unmaps all the mapped songs.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    SongStore::~SongStore()
+ */
+SongStore::~SongStore()
+{
+    for( std::map< int, MappedSong * >::iterator it = songs.begin()
+       ; it != songs.end()
+       ; ++it )
+    {
+        unmap( it->second );
+        delete it->second;
+    }
+    CloseHandle( access );
+}
+
+/**
+ * returns a pointer to the read-only contents of the song file with the given
+ *   id, mapping the file into memory if it isn't already. every call to
+ *   acquire must be matched by a call to {SongStore::release}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         all readers of the same song share the same view, so the
+ *   pages of the file are only read from disk once.
+ *
+ * @signature    const char * SongStore::acquire( int songId, unsigned long * size )
+ *
+ * @param        songId   id of the song to acquire
+ * @param        size   set to the size of the song file in bytes
+ *
+ * @return       pointer to the start of the song file; NULL if the file could
+ *   not be mapped.
+ */
+const char * SongStore::acquire( int songId, unsigned long * size )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    MappedSong * song = map( songId );
+    const char * view = NULL;
+
+    if( song != NULL )
+    {
+        ++song->stats.users;
+        view  = song->view;
+        *size = (unsigned long) song->stats.size;
+    }
+
+    ReleaseMutex( access );
+    return view;
+}
+
+/**
+ * releases a song acquired with {SongStore::acquire}. the song stays mapped
+ *   for a while after the last reader releases it, in case it is requested
+ *   again.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void SongStore::release( int songId )
+ *
+ * @param        songId   id of the song to release
+ */
+void SongStore::release( int songId )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    std::map< int, MappedSong * >::iterator it = songs.find( songId );
+    if( it != songs.end() && it->second->stats.users > 0 )
+    {
+        it->second->lastUsed = GetTickCount();
+        if( --it->second->stats.users == 0 )
+        {
+            trimIdle();
+        }
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * returns the handle of the song file backing the mapping of an acquired
+ *   song, so it can be handed to TransmitFile. the handle is opened for
+ *   overlapped reads, so readers must always pass an explicit offset.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the handle is only valid until the song is released.
+ *
+ * @signature    HANDLE SongStore::getFile( int songId )
+ *
+ * @param        songId   id of an acquired song
+ *
+ * @return       handle to the song file; INVALID_HANDLE_VALUE if the song is
+ *   not mapped.
+ */
+HANDLE SongStore::getFile( int songId )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    std::map< int, MappedSong * >::iterator it = songs.find( songId );
+    if( it != songs.end() )
+    {
+        file = it->second->file;
+    }
+
+    ReleaseMutex( access );
+    return file;
+}
+
+/**
+ * tells the {SongStore} that a reader is about to read the passed region of
+ *   the song. the region is counted towards the statistics of the song, and
+ *   the operating system is asked to read it in ahead of time.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void SongStore::willRead( int songId, unsigned long offset,
+ *   unsigned long len )
+ *
+ * @param        songId   id of the song that will be read from
+ * @param        offset   offset into the song file that will be read from
+ * @param        len   number of bytes that will be read
+ */
+void SongStore::willRead( int songId, unsigned long offset, unsigned long len )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    std::map< int, MappedSong * >::iterator it = songs.find( songId );
+    if( it != songs.end() && it->second->view != NULL && offset < it->second->stats.size )
+    {
+        MappedSong * song = it->second;
+        if( offset + len > song->stats.size )
+        {
+            len = (unsigned long) ( song->stats.size - offset );
+        }
+
+        song->stats.bytesRead   += len;
+        song->stats.bytesResident += min( residentBytes( song->view + offset, len ), len );
+        prefetchRange( song->view + offset, len );
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * copies the statistics of every song that was ever mapped into {stats}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void SongStore::getStats( std::vector< SongStoreStats > * stats )
+ *
+ * @param        stats   vector that the statistics are appended to
+ */
+void SongStore::getStats( std::vector< SongStoreStats > * stats )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    for( std::map< int, MappedSong * >::iterator it = songs.begin()
+       ; it != songs.end()
+       ; ++it )
+    {
+        stats->push_back( it->second->stats );
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * returns the mapped song with the given id, opening and mapping the song
+ *   file if needed. must be called while holding {access}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - looks the path up through the {StreamEngine},
+ *   under the lock of the playlist.
+ *
+ * @note         none
+ *
+ * @signature    SongStore::MappedSong * SongStore::map( int songId )
+ *
+ * @param        songId   id of the song to map
+ *
+ * @return       the mapped song; NULL if it could not be mapped
+ */
+SongStore::MappedSong * SongStore::map( int songId )
+{
+    MappedSong * song = songs[ songId ];
+
+    if( song == NULL )
+    {
+        song = new MappedSong;
+        memset( song, 0, sizeof( *song ) );
+        song->file         = INVALID_HANDLE_VALUE;
+        song->stats.songId = songId;
+        songs[ songId ]    = song;
+    }
+
+    // reuse the existing mapping if there is one
+    if( song->view != NULL )
+    {
+        ++song->stats.shareCount;
+        return song;
+    }
+
+    // the playlist is read under the lock of the {StreamEngine}, like every
+    // other reader of it
+    wchar_t * path = StreamEngine::getInstance()->getSongPath( songId );
+    if( path == NULL )
+    {
+        return NULL;
+    }
+
+    song->file = CreateFile( path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN | FILE_FLAG_OVERLAPPED, NULL );
+    delete [] path;
+
+    if( song->file == INVALID_HANDLE_VALUE )
+    {
+        return NULL;
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx( song->file, &size );
+    song->stats.size = size.QuadPart;
+
+    song->mapping = CreateFileMapping( song->file, NULL, PAGE_READONLY, 0, 0, NULL );
+    if( song->mapping != NULL )
+    {
+        song->view = (const char *) MapViewOfFile( song->mapping, FILE_MAP_READ, 0, 0, 0 );
+    }
+
+    if( song->view == NULL )
+    {
+        wchar_t errorStr[256] = {0};
+        swprintf( errorStr, 256, L"mapping song %d failed: %d", songId, GetLastError() );
+        #ifdef DEBUG
+        MessageBox(NULL, errorStr, L"Error", MB_ICONERROR);
+        #endif
+        unmap( song );
+        return NULL;
+    }
+
+    ++song->stats.mapCount;
+    return song;
+}
+
+/**
+ * unmaps the passed song, and closes its handles. the statistics of the song
+ *   are kept.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void SongStore::unmap( MappedSong * song )
+ *
+ * @param        song   song to unmap
+ */
+void SongStore::unmap( MappedSong * song )
+{
+    if( song->view != NULL )
+    {
+        UnmapViewOfFile( song->view );
+        song->view = NULL;
+    }
+    if( song->mapping != NULL )
+    {
+        CloseHandle( song->mapping );
+        song->mapping = NULL;
+    }
+    if( song->file != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( song->file );
+        song->file = INVALID_HANDLE_VALUE;
+    }
+}
+
+/**
+ * unmaps the least recently used songs that nobody is reading, until only
+ *   {SONG_STORE_IDLE_LIMIT} idle songs are left mapped. must be called while
+ *   holding {access}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void SongStore::trimIdle()
+ */
+void SongStore::trimIdle()
+{
+    while( true )
+    {
+        int idle = 0;
+        MappedSong * oldest = NULL;
+
+        for( std::map< int, MappedSong * >::iterator it = songs.begin()
+           ; it != songs.end()
+           ; ++it )
+        {
+            MappedSong * song = it->second;
+            if( song->view != NULL && song->stats.users == 0 )
+            {
+                ++idle;
+                if( oldest == NULL || song->lastUsed - oldest->lastUsed > 0x7FFFFFFF )
+                {
+                    oldest = song;
+                }
+            }
+        }
+
+        if( idle <= SONG_STORE_IDLE_LIMIT )
+        {
+            break;
+        }
+        unmap( oldest );
+    }
+}
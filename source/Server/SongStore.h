@@ -0,0 +1,92 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: SongStore.h
+--
+-- NOTES:
+-- The {SongStore} maps each song file into memory once, and
+-- shares the read-only view between the multicast sender and
+-- all the clients that are downloading the same song.
+--------------------------------------------------------------*/
+#ifndef SONGSTORE_H
+#define SONGSTORE_H
+
+#include "../common.h"
+#include <map>
+#include <vector>
+
+/**
+ * number of bytes ahead of the current read position that readers should ask
+ *   the {SongStore} to read ahead.
+ */
+#define SONG_STORE_READ_AHEAD (256*1024)
+
+/**
+ * number of mapped songs that are kept mapped even though nobody is using
+ *   them, so the next request for them doesn't need to map them again.
+ */
+#define SONG_STORE_IDLE_LIMIT 4
+
+/**
+ * statistics about a single song in the {SongStore}.
+ *
+ * {songId}; id of the song
+ *
+ * {size}; size of the mapped song file in bytes
+ *
+ * {users}; number of readers that currently have the song acquired
+ *
+ * {mapCount}; number of times the song file had to be opened and mapped
+ *
+ * {shareCount}; number of acquires that reused an existing mapping
+ *
+ * {bytesRead}; number of bytes readers announced they were going to read
+ *
+ * {bytesResident}; number of those bytes that were already in the working
+ *   set of the server when they were announced. pages in the file cache that
+ *   aren't mapped into the working set count as not resident, so this is a
+ *   lower bound on page cache hits, not a count of them.
+ */
+struct SongStoreStats
+{
+    int songId;
+    unsigned long long size;
+    int users;
+    unsigned long mapCount;
+    unsigned long shareCount;
+    unsigned long long bytesRead;
+    unsigned long long bytesResident;
+};
+
+class SongStore
+{
+public:
+    static SongStore * getInstance();
+
+    const char * acquire( int songId, unsigned long * size );
+    void release( int songId );
+    HANDLE getFile( int songId );
+    void willRead( int songId, unsigned long offset, unsigned long len );
+    void getStats( std::vector< SongStoreStats > * stats );
+
+protected:
+    SongStore();
+    ~SongStore();
+
+private:
+    struct MappedSong;
+
+    MappedSong * map( int songId );
+    void unmap( MappedSong * song );
+    void trimIdle();
+
+    /**
+     * mapped songs, indexed by song id.
+     */
+    std::map< int, MappedSong * > songs;
+
+    /**
+     * protects the interface functions of the {SongStore}.
+     */
+    HANDLE access;
+};
+
+#endif
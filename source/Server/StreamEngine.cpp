@@ -0,0 +1,1609 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: StreamEngine.cpp
+--
+-- NOTES:
+-- This file contains the implementation of the
+-- {StreamEngine} class.
+--------------------------------------------------------------*/
+#include "StreamEngine.h"
+#include "SongStore.h"
+#include "TransferScheduler.h"
+#include <algorithm>
+
+/**
+ * flag of CreateWaitableTimerEx for a timer that goes off within a fraction
+ *   of a millisecond; missing from older SDKs.
+ */
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+/**
+ * returns the singleton instance of the {StreamEngine}
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    StreamEngine * StreamEngine::getInstance()
+ *
+ * @return       the one and only {StreamEngine}
+ */
+StreamEngine * StreamEngine::getInstance()
+{
+    static StreamEngine * _instance = new StreamEngine();
+    return _instance;
+}
+
+/**
+ * a station of the {StreamEngine}.
+ *
+ * {number}; number of the station, counted from 0
+ *
+ * {group}; multicast group the station is sent to
+ *
+ * {cursor}; position in the playlist of the song being streamed
+ *
+ * {songId}; id of the song being streamed; -1 before the first song
+ *
+ * {song}; contents of the song being streamed, acquired from the
+ *   {SongStore}; NULL when the station isn't streaming anything
+ *
+ * {size}; offset of the end of the audio of the song being streamed, once
+ *   converted
+ *
+ * {converter}; converts the song to the stream format; NULL if it is sent
+ *   as is
+ *
+ * {offset}; offset of the next byte of the song to send
+ *
+ * {readAhead}; offset of the next region of the song to have read in ahead
+ *
+ * {lastIndex}; index of the last packet read from the song
+ *
+ * {due}; performance counter value of when the next packet is due
+ *
+ * {ticksPerPacket}; performance counter ticks it takes to play a packet of
+ *   the song
+ *
+ * {bytesPerSec}; byte rate of the song
+ *
+ * {prepared}; true once the next song has been opened, or failed to open,
+ *   near the end of the song
+ *
+ * {queuedSong}, {queuedData}, {queuedSize}, {queuedCursor},
+ *   {queuedConverter}; the next song, in the format it is sent in, its
+ *   contents, acquired from the {SongStore}, its size once converted, its
+ *   position in the playlist, and its converter; {queuedData} is NULL if it
+ *   couldn't be opened
+ *
+ * {announceCountdown}; packets left to send before the next song is
+ *   announced again
+ *
+ * {queued}; true if the station is in the deadline heap
+ *
+ * {ring}, {ringStart}, {ringCount}; the last packets read from the song;
+ *   {ringCount} of them, the oldest at {ringStart}
+ *
+ * {ringLead}; bytes at the start of the oldest packet in the ring that are
+ *   the end of the song before
+ *
+ * {timing}, {requested}; true until the first packet of a new song nobody
+ *   was listening to is sent, and when the song was requested
+ *
+ * {listeners}; clients tuned to the station
+ *
+ * {swapPending}, {nextSong}, {nextRequested}; song to swap to at the next
+ *   packet boundary, and when it was requested
+ *
+ * {startPending}; true if the station should start streaming its cursor, if
+ *   it isn't streaming anything
+ *
+ * {joining}, {joinRequested}; clients that tuned in since the last packet
+ *   boundary, and when they did
+ *
+ * {isPending}; true if the station is in the pending list of the engine
+ */
+struct StreamEngine::Station
+{
+    int number;
+    sockaddr_in group;
+    int cursor;
+
+    int songId;
+    const char * song;
+    unsigned long size;
+    FormatConverter * converter;
+    unsigned long offset;
+    unsigned long readAhead;
+    int lastIndex;
+
+    double due;
+    double ticksPerPacket;
+    unsigned long bytesPerSec;
+    bool queued;
+
+    bool prepared;
+    SongName queuedSong;
+    const char * queuedData;
+    unsigned long queuedSize;
+    int queuedCursor;
+    FormatConverter * queuedConverter;
+    int announceCountdown;
+
+    std::vector< DataPacket > ring;
+    int ringStart;
+    int ringCount;
+    int ringLead;
+
+    bool timing;
+    LONGLONG requested;
+
+    std::vector< TCPSocket * > listeners;
+    bool swapPending;
+    SongName nextSong;
+    LONGLONG nextRequested;
+    bool startPending;
+    std::vector< TCPSocket * > joining;
+    std::vector< LONGLONG > joinRequested;
+    bool isPending;
+};
+
+/**
+ * messages waiting to be sent to a client over its control connection.
+ *
+ * {client}; control connection of the client
+ *
+ * {messages}; type and contents of each message, oldest first
+ *
+ * {ready}; auto-reset event set when messages are added, or the client
+ *   leaves
+ *
+ * {closing}; set once the client has left; the messages left are dropped
+ *
+ * {thread}; thread sending the messages
+ */
+struct StreamEngine::Outbox
+{
+    TCPSocket * client;
+    std::deque< std::pair< char, std::vector< char > > > messages;
+    HANDLE ready;
+    volatile bool closing;
+    HANDLE thread;
+};
+
+/**
+ * creates a {StreamEngine} with no stations.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - starts with an empty ring.
+ *               2026-10-18 - starts with no stations.
+ *               2026-10-18 - starts without a stream format.
+ *
+ * @note         the thread is started once the socket is set.
+ *
+ * @signature    StreamEngine::StreamEngine()
+ */
+StreamEngine::StreamEngine()
+    : udpSocket( NULL )
+    , playlist( NULL )
+    , packetsSent( 0 )
+    , packetsLate( 0 )
+    , wake( CreateEvent( NULL, FALSE, FALSE, NULL ) )
+    , thread( NULL )
+    , access( CreateMutex( NULL, FALSE, NULL ) )
+{
+    memset( &switchLatency, 0, sizeof( switchLatency ) );
+    memset( &joinLatency, 0, sizeof( joinLatency ) );
+    memset( &streamFormat, 0, sizeof( streamFormat ) );
+    QueryPerformanceFrequency( &freq );
+    stations.reserve( STREAM_MAX_STATIONS );
+}
+
+/**
+ * closes the handles of the {StreamEngine}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the engine lives as long as the server, so its thread is
+ *   never stopped.
+ *
+ * @signature    StreamEngine::~StreamEngine()
+ */
+StreamEngine::~StreamEngine()
+{
+    CloseHandle( wake );
+    CloseHandle( access );
+}
+
+/**
+ * sets the socket the stations are sent from, and starts the thread of the
+ *   {StreamEngine} if it isn't running yet.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void StreamEngine::setSocket( UDPSocket * sock )
+ *
+ * @param        sock   socket to send the stations from
+ */
+void StreamEngine::setSocket( UDPSocket * sock )
+{
+    WaitForSingleObject( access, INFINITE );
+    udpSocket = sock;
+    if( thread == NULL )
+    {
+        DWORD useless;
+        thread = CreateThread( 0, 0, _streamRoutine, 0, 0, &useless );
+    }
+    ReleaseMutex( access );
+}
+
+/**
+ * sets the songs the stations play. stations that are streaming a song
+ *   carry on with it, and go on to the next song of the new playlist after.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void StreamEngine::setPlaylist( Playlist * playlist )
+ *
+ * @param        playlist   songs to play
+ */
+void StreamEngine::setPlaylist( Playlist * playlist )
+{
+    WaitForSingleObject( access, INFINITE );
+    this->playlist = playlist;
+    ReleaseMutex( access );
+}
+
+/**
+ * returns the full path to the song with the given id, read from the
+ *   playlist under {access}, so it can't race a station moving through it.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the caller deletes the path with delete [].
+ *
+ * @signature    wchar_t * StreamEngine::getSongPath( int songId )
+ *
+ * @param        songId   id of the song
+ *
+ * @return       the path to the song; NULL if it isn't in the playlist
+ */
+wchar_t * StreamEngine::getSongPath( int songId )
+{
+    wchar_t * path = NULL;
+
+    WaitForSingleObject( access, INFINITE );
+    if( playlist != NULL )
+    {
+        path = playlist->getSongPath( songId );
+    }
+    ReleaseMutex( access );
+
+    return path;
+}
+
+/**
+ * adds stations until there are {count} of them. station {n} is sent to the
+ *   {n}th group after {MULTICAST_ADDR}, and starts at the {n}th song of the
+ *   playlist.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         stations are never removed; at most {STREAM_MAX_STATIONS}
+ *   are made.
+ *
+ * @signature    void StreamEngine::setStations( int count )
+ *
+ * @param        count   number of stations to have
+ */
+void StreamEngine::setStations( int count )
+{
+    WaitForSingleObject( access, INFINITE );
+    count = min( count, STREAM_MAX_STATIONS );
+    while( (int) stations.size() < count )
+    {
+        Station * station = new Station;
+        station->number = stations.size();
+        memset( &station->group, 0, sizeof( station->group ) );
+        station->group.sin_family      = AF_INET;
+        station->group.sin_port        = htons( MULTICAST_PORT );
+        station->group.sin_addr.s_addr = htonl( ntohl( inet_addr( MULTICAST_ADDR ) ) + station->number );
+        station->cursor         = station->number - 1;
+        station->songId         = -1;
+        station->song           = NULL;
+        station->size           = 0;
+        station->converter      = NULL;
+        station->offset         = 0;
+        station->readAhead      = 0;
+        station->lastIndex      = 0;
+        station->due            = 0;
+        station->ticksPerPacket = 0;
+        station->bytesPerSec    = 1;
+        station->queued         = false;
+        station->prepared       = false;
+        station->queuedData     = NULL;
+        station->queuedSize     = 0;
+        station->queuedCursor   = 0;
+        station->queuedConverter = NULL;
+        station->announceCountdown = 0;
+        station->ringStart      = 0;
+        station->ringCount      = 0;
+        station->ringLead       = 0;
+        station->timing         = false;
+        station->requested      = 0;
+        station->swapPending    = false;
+        station->nextRequested  = 0;
+        station->startPending   = false;
+        station->isPending      = false;
+        stations.push_back( station );
+    }
+    ReleaseMutex( access );
+}
+
+/**
+ * sets the format songs are converted to before they are sent. songs that
+ *   start after this are sent in the new format.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         set before the server starts, so every client is told the
+ *   same format when it tunes in.
+ *
+ * @signature    void StreamEngine::setStreamFormat( StreamFormat * format )
+ *
+ * @param        format   format to send songs in; NULL to send them in their
+ *   own format
+ */
+void StreamEngine::setStreamFormat( StreamFormat * format )
+{
+    WaitForSingleObject( access, INFINITE );
+    if( format != NULL )
+    {
+        streamFormat = *format;
+    }
+    else
+    {
+        memset( &streamFormat, 0, sizeof( streamFormat ) );
+    }
+    ReleaseMutex( access );
+}
+
+/**
+ * copies the format songs are converted to before they are sent.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void StreamEngine::getStreamFormat( StreamFormat * format )
+ *
+ * @param        format   set to the stream format; its sample rate is 0 if
+ *   songs are sent in their own format
+ */
+void StreamEngine::getStreamFormat( StreamFormat * format )
+{
+    WaitForSingleObject( access, INFINITE );
+    *format = streamFormat;
+    ReleaseMutex( access );
+}
+
+/**
+ * returns the number of stations.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    int StreamEngine::getStations()
+ *
+ * @return       the number of stations
+ */
+int StreamEngine::getStations()
+{
+    WaitForSingleObject( access, INFINITE );
+    int count = stations.size();
+    ReleaseMutex( access );
+    return count;
+}
+
+/**
+ * copies the multicast group a station is sent to.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         used to send other traffic to everybody listening to the
+ *   stations.
+ *
+ * @signature    bool StreamEngine::getGroup( int station, sockaddr_in * group )
+ *
+ * @param        station   number of the station
+ * @param        group   set to the address of the group of the station
+ *
+ * @return       false if there is no such station; true otherwise.
+ */
+bool StreamEngine::getGroup( int station, sockaddr_in * group )
+{
+    WaitForSingleObject( access, INFINITE );
+    bool found = station >= 0 && station < (int) stations.size();
+    if( found )
+    {
+        *group = stations[ station ]->group;
+    }
+    ReleaseMutex( access );
+    return found;
+}
+
+/**
+ * starts a station streaming the song at its cursor, at the next packet
+ *   boundary, if it isn't streaming anything yet. stations start by
+ *   themselves when the first client tunes in.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void StreamEngine::startStation( int station )
+ *
+ * @param        station   number of the station
+ */
+void StreamEngine::startStation( int station )
+{
+    WaitForSingleObject( access, INFINITE );
+    if( station >= 0 && station < (int) stations.size() )
+    {
+        stations[ station ]->startPending = true;
+        _wake( stations[ station ] );
+    }
+    ReleaseMutex( access );
+}
+
+/**
+ * tunes a client to a station. at the next packet boundary, the client is
+ *   told which group the station is sent to, which song it is playing, and
+ *   sent the packets in its ring.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the client stops getting the change stream messages of the
+ *   station it was tuned to before.
+ *
+ * @signature    void StreamEngine::tune( TCPSocket * client, int station )
+ *
+ * @param        client   control connection of the client
+ * @param        station   number of the station
+ */
+void StreamEngine::tune( TCPSocket * client, int station )
+{
+    LONGLONG now = _now();
+
+    WaitForSingleObject( access, INFINITE );
+    if( station < 0 || station >= (int) stations.size() )
+    {
+        ReleaseMutex( access );
+        return;
+    }
+
+    Station * next = stations[ station ];
+    std::map< TCPSocket *, Station * >::iterator it = tuned.find( client );
+    if( it == tuned.end() || it->second != next )
+    {
+        if( it != tuned.end() )
+        {
+            std::vector< TCPSocket * > & listeners = it->second->listeners;
+            listeners.erase( std::remove( listeners.begin(), listeners.end(), client ), listeners.end() );
+        }
+        next->listeners.push_back( client );
+        tuned[ client ] = next;
+    }
+
+    next->joining.push_back( client );
+    next->joinRequested.push_back( now );
+    next->startPending = true;
+    _wake( next );
+    ReleaseMutex( access );
+}
+
+/**
+ * sends a client that has just connected, or been sent the playlist again,
+ *   what it needs to play the station it is tuned to; station 0 if it isn't
+ *   tuned to one yet.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - tunes the client to a station.
+ *
+ * @note         none
+ *
+ * @signature    void StreamEngine::join( TCPSocket * client )
+ *
+ * @param        client   control connection of the client
+ */
+void StreamEngine::join( TCPSocket * client )
+{
+    int station = 0;
+
+    WaitForSingleObject( access, INFINITE );
+    std::map< TCPSocket *, Station * >::iterator it = tuned.find( client );
+    if( it != tuned.end() )
+    {
+        station = it->second->number;
+    }
+    ReleaseMutex( access );
+
+    tune( client, station );
+}
+
+/**
+ * forgets about a client that is disconnecting.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - stops the thread sending to the client, and
+ *   drops the messages it hadn't sent.
+ *
+ * @note         once this returns, the client is never sent anything again,
+ *   so its connection can be closed.
+ *
+ * @signature    void StreamEngine::leave( TCPSocket * client )
+ *
+ * @param        client   control connection of the client
+ */
+void StreamEngine::leave( TCPSocket * client )
+{
+    WaitForSingleObject( access, INFINITE );
+    std::map< TCPSocket *, Station * >::iterator it = tuned.find( client );
+    if( it != tuned.end() )
+    {
+        Station * station = it->second;
+        station->listeners.erase( std::remove( station->listeners.begin(), station->listeners.end(), client ), station->listeners.end() );
+        for( int i = station->joining.size() - 1; i >= 0; --i )
+        {
+            if( station->joining[ i ] == client )
+            {
+                station->joining.erase( station->joining.begin() + i );
+                station->joinRequested.erase( station->joinRequested.begin() + i );
+            }
+        }
+        tuned.erase( it );
+    }
+
+    Outbox * outbox = NULL;
+    std::map< TCPSocket *, Outbox * >::iterator out = outboxes.find( client );
+    if( out != outboxes.end() )
+    {
+        outbox = out->second;
+        outbox->closing = true;
+        SetEvent( outbox->ready );
+        outboxes.erase( out );
+    }
+    ReleaseMutex( access );
+
+    // the thread needs {access} to stop, so it is waited for without it
+    if( outbox != NULL )
+    {
+        WaitForSingleObject( outbox->thread, INFINITE );
+        CloseHandle( outbox->thread );
+        CloseHandle( outbox->ready );
+        delete outbox;
+    }
+}
+
+/**
+ * swaps the song of the station a client is tuned to; the new song starts
+ *   at the next packet boundary. returns without waiting for the swap.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - the clients are sent the start of the new song
+ *   along with the change stream message.
+ *               2026-10-18 - only changes the station the client is tuned
+ *   to, and only tells its listeners.
+ *
+ * @note         if another swap is requested before this one happens, only
+ *   the later one takes effect.
+ *
+ * @signature    void StreamEngine::play( TCPSocket * client, SongName * song,
+ *   LONGLONG requested )
+ *
+ * @param        client   control connection of the client that asked for
+ *   the song
+ * @param        song   the song to stream
+ * @param        requested   performance counter value of when the change
+ *   was requested, used to measure the latency of the swap
+ */
+void StreamEngine::play( TCPSocket * client, SongName * song, LONGLONG requested )
+{
+    WaitForSingleObject( access, INFINITE );
+    std::map< TCPSocket *, Station * >::iterator it = tuned.find( client );
+    Station * station = NULL;
+    if( it != tuned.end() )
+    {
+        station = it->second;
+    }
+    else if( !stations.empty() )
+    {
+        station = stations[ 0 ];
+    }
+
+    if( station != NULL )
+    {
+        station->nextSong      = *song;
+        station->nextRequested = requested;
+        station->swapPending   = true;
+        _wake( station );
+    }
+    ReleaseMutex( access );
+}
+
+/**
+ * copies the latency statistics of the {StreamEngine}.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - also copies the join latencies.
+ *
+ * @note         none
+ *
+ * @signature    void StreamEngine::getStats( StreamLatency * switches,
+ *   StreamLatency * joins )
+ *
+ * @param        switches   set to the latencies from a song change being
+ *   requested until the first packet of the new song was sent
+ * @param        joins   set to the latencies from a client tuning in until
+ *   the prefill was sent to it
+ */
+void StreamEngine::getStats( StreamLatency * switches, StreamLatency * joins )
+{
+    WaitForSingleObject( access, INFINITE );
+    *switches = switchLatency;
+    *joins    = joinLatency;
+    ReleaseMutex( access );
+}
+
+/**
+ * copies the statistics about the thread sending the stations.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the number of stations playing is read while they are being
+ *   sent, so it may be a packet out of date.
+ *
+ * @signature    void StreamEngine::getSenderStats( StreamSenderStats * stats )
+ *
+ * @param        stats   filled with the statistics
+ */
+void StreamEngine::getSenderStats( StreamSenderStats * stats )
+{
+    WaitForSingleObject( access, INFINITE );
+    stats->stations = stations.size();
+    stats->playing  = 0;
+    for( int i = 0; i < (int) stations.size(); ++i )
+    {
+        stats->playing += ( stations[ i ]->song != NULL );
+    }
+    stats->packets = InterlockedCompareExchange64( &packetsSent, 0, 0 );
+    stats->late    = InterlockedCompareExchange64( &packetsLate, 0, 0 );
+    stats->cpuMs   = 0;
+
+    FILETIME created, exited, kernel, user;
+    if( thread != NULL && GetThreadTimes( thread, &created, &exited, &kernel, &user ) )
+    {
+        ULARGE_INTEGER k, u;
+        k.LowPart  = kernel.dwLowDateTime;
+        k.HighPart = kernel.dwHighDateTime;
+        u.LowPart  = user.dwLowDateTime;
+        u.HighPart = user.dwHighDateTime;
+        stats->cpuMs = (double) ( k.QuadPart + u.QuadPart ) / 10000.0;
+    }
+    ReleaseMutex( access );
+}
+
+/**
+ * threaded routine that sends the stations. it always sends the packet that
+ *   is due first, of all the stations, and waits until it is due. between
+ *   packets, it handles pending swaps and clients tuning in; a swap releases
+ *   the old song and reads the first {STREAM_PREFILL_MS} of the new one into
+ *   the ring, which is sent to every listener along with the change stream
+ *   message. the multicast stream then carries on from the packet after the
+ *   ring, at the byte rate of the song.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - sends the ring to clients that switch or join.
+ *               2026-10-18 - sends every station, paced by a deadline heap,
+ *   instead of a single stream in bursts.
+ *               2026-10-18 - carries on into the next song without a gap
+ *   when it has been opened ahead of time.
+ *               2026-10-18 - counts every packet against the stream reserve.
+ *               2026-10-18 - waits on a high resolution waitable timer
+ *   instead of the 15.6 ms resolution of a plain wait.
+ *               2026-10-18 - drops deadlines left stale by a swap, which
+ *   queues a fresh one.
+ *
+ * @note         packets due within a millisecond are sent right away, so the
+ *   thread doesn't spin between packets of busy stations. where high
+ *   resolution timers aren't supported, the system timer is made to tick
+ *   every millisecond for the life of the server instead.
+ *
+ * @signature    DWORD WINAPI StreamEngine::_streamRoutine( void * params )
+ *
+ * @param        params   unused
+ *
+ * @return       exit code
+ */
+DWORD WINAPI StreamEngine::_streamRoutine( void * params )
+{
+    StreamEngine * thiz = StreamEngine::getInstance();
+    LONGLONG slack = thiz->freq.QuadPart / 1000;
+
+    HANDLE timer = CreateWaitableTimerEx( NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS );
+    if( timer == NULL )
+    {
+        timeBeginPeriod( 1 );
+        timer = CreateWaitableTimer( NULL, FALSE, NULL );
+    }
+    HANDLE events[] = { thiz->wake, timer };
+
+    while( true )
+    {
+        // handle swaps and tuning in at the packet boundary
+        std::vector< Station * > pending;
+        WaitForSingleObject( thiz->access, INFINITE );
+        pending.swap( thiz->pending );
+        ReleaseMutex( thiz->access );
+
+        for( int i = 0; i < (int) pending.size(); ++i )
+        {
+            thiz->_service( pending[ i ], false );
+        }
+
+        // nothing to send; wait for a station to start
+        if( thiz->deadlines.empty() )
+        {
+            WaitForSingleObject( thiz->wake, INFINITE );
+            continue;
+        }
+
+        // wait for the earliest packet to be due
+        Deadline next = thiz->deadlines.top();
+        Station * station = next.second;
+        LONGLONG now = thiz->_now();
+        if( next.first - now > slack )
+        {
+            LARGE_INTEGER wait;
+            wait.QuadPart = -( ( next.first - now ) * 10000000 / thiz->freq.QuadPart );
+            SetWaitableTimer( timer, &wait, 0, NULL, NULL, FALSE );
+            WaitForMultipleObjects( 2, events, FALSE, INFINITE );
+            continue;
+        }
+        thiz->deadlines.pop();
+
+        // the station swapped songs since it was queued, and its fresh
+        // deadline is already in the heap
+        if( (LONGLONG) station->due != next.first )
+        {
+            continue;
+        }
+
+        // the song is over, and the next one isn't open; go on to it the
+        // slow way
+        DataPacket packet;
+        if( !thiz->_readPacket( station, &packet ) )
+        {
+            station->queued = false;
+            thiz->_service( station, true );
+            continue;
+        }
+
+        TransferScheduler::getInstance()->sendStream( sizeof( packet ) );
+        thiz->udpSocket->sendtoGroup( MUSICSTREAM, &packet, sizeof( packet ), &station->group );
+        InterlockedIncrement64( &thiz->packetsSent );
+        if( now - next.first > slack )
+        {
+            InterlockedIncrement64( &thiz->packetsLate );
+        }
+
+        if( station->timing )
+        {
+            station->timing = false;
+            thiz->_record( &thiz->switchLatency, station->requested, station, L"stream switch" );
+        }
+
+        thiz->_prepare( station );
+
+        station->due += station->ticksPerPacket;
+        thiz->deadlines.push( Deadline( (LONGLONG) station->due, station ) );
+    }
+
+    return 0;
+}
+
+/**
+ * handles what is pending for a station; a swap, starting it, or clients
+ *   tuning in. when {advance} is set, the station has finished its song, and
+ *   goes on to the next one on the playlist.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - posts the messages to the clients instead of
+ *   sending them.
+ *               2026-10-18 - reads the playlist under {access}.
+ *               2026-10-18 - always queues a fresh deadline after a swap,
+ *   so a station already in the heap isn't left waiting on its old one.
+ *
+ * @note         only called from the thread of the {StreamEngine}.
+ *
+ * @signature    void StreamEngine::_service( Station * station, bool advance )
+ *
+ * @param        station   the station
+ * @param        advance   true if the station has finished its song
+ */
+void StreamEngine::_service( Station * station, bool advance )
+{
+    std::vector< TCPSocket * > listeners;
+    std::vector< TCPSocket * > joining;
+    std::vector< LONGLONG > joinRequested;
+    SongName next;
+    LONGLONG requested = 0;
+    bool swap;
+    bool start;
+    Playlist * playlist;
+    int count;
+
+    WaitForSingleObject( access, INFINITE );
+    swap = station->swapPending;
+    if( swap )
+    {
+        next      = station->nextSong;
+        requested = station->nextRequested;
+    }
+    start = station->startPending;
+    station->swapPending  = false;
+    station->startPending = false;
+    station->isPending    = false;
+    joining.swap( station->joining );
+    joinRequested.swap( station->joinRequested );
+    listeners = station->listeners;
+    playlist  = this->playlist;
+    count     = stations.size();
+
+    // a station that isn't playing anything starts at its cursor, and one that
+    // has finished its song goes on to the next one
+    if( !swap && ( advance || ( start && station->song == NULL ) )
+        && playlist != NULL && !playlist->playlist.empty() )
+    {
+        station->cursor = ( station->cursor + 1 ) % (int) playlist->playlist.size();
+        next      = playlist->playlist[ station->cursor ];
+        requested = _now();
+        swap      = true;
+    }
+    ReleaseMutex( access );
+
+    if( advance && !swap && station->song != NULL )
+    {
+        SongStore::getInstance()->release( station->songId );
+        station->song = NULL;
+        delete station->converter;
+        station->converter = NULL;
+    }
+
+    if( swap )
+    {
+        _swap( station, &next, playlist );
+
+        // clients tuning in are sent the same below
+        int told = 0;
+        RequestPacket change;
+        change.index = station->songId;
+        for( int i = 0; i < (int) listeners.size(); ++i )
+        {
+            if( std::find( joining.begin(), joining.end(), listeners[ i ] ) == joining.end() )
+            {
+                _post( listeners[ i ], CHANGE_STREAM, &change, sizeof( change ) );
+                _sendPrefill( station, listeners[ i ] );
+                ++told;
+            }
+        }
+
+        // without listeners, the first packet out is the multicast one
+        station->requested = requested;
+        station->timing    = ( told == 0 );
+        if( !station->timing )
+        {
+            _record( &switchLatency, requested, station, L"stream switch" );
+        }
+
+        // the listeners are ahead by the ring; carry on in real time from now
+        station->due = (double) _now();
+        if( station->song != NULL )
+        {
+            station->queued = true;
+            deadlines.push( Deadline( (LONGLONG) station->due, station ) );
+        }
+    }
+
+    for( int i = 0; i < (int) joining.size(); ++i )
+    {
+        _sendTuned( station, joining[ i ], count );
+        if( station->songId == -1 )
+        {
+            continue;
+        }
+
+        RequestPacket change;
+        change.index = station->songId;
+        _post( joining[ i ], CHANGE_STREAM, &change, sizeof( change ) );
+        if( station->song != NULL )
+        {
+            _sendPrefill( station, joining[ i ] );
+            _record( &joinLatency, joinRequested[ i ], station, L"stream join" );
+        }
+    }
+}
+
+/**
+ * releases the song a station is streaming, and starts streaming the next
+ *   one. the ring is sized to hold {STREAM_PREFILL_MS} of the new song, and
+ *   filled with its first packets, and the cursor moves to the new song.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - swaps the song of a single station.
+ *               2026-10-18 - drops the next song, if it was opened.
+ *               2026-10-18 - converts the new song to the stream format.
+ *               2026-10-18 - reads the playlist under {access}.
+ *               2026-10-18 - starts after the header of the song.
+ *
+ * @note         only called from the thread of the {StreamEngine}.
+ *
+ * @signature    void StreamEngine::_swap( Station * station, SongName * next,
+ *   Playlist * playlist )
+ *
+ * @param        station   the station
+ * @param        next   the song to stream
+ * @param        playlist   the playlist the cursor is in
+ */
+void StreamEngine::_swap( Station * station, SongName * next, Playlist * playlist )
+{
+    SongStore * store = SongStore::getInstance();
+
+    if( station->song != NULL )
+    {
+        store->release( station->songId );
+    }
+    _unprepare( station );
+    station->songId    = next->id;
+    station->song      = store->acquire( station->songId, &station->size );
+    station->lastIndex = 0;
+
+    // the station goes on from the new song once it's over
+    WaitForSingleObject( access, INFINITE );
+    if( playlist != NULL )
+    {
+        for( int i = 0; i < (int) playlist->playlist.size(); ++i )
+        {
+            if( playlist->playlist[ i ].id == next->id )
+            {
+                station->cursor = i;
+                break;
+            }
+        }
+    }
+    ReleaseMutex( access );
+
+    // the header isn't streamed; the client gets the format with the song
+    SongName streamed = *next;
+    _convert( &streamed, station->song, &station->size, &station->converter );
+    station->size      = min( station->size, streamed.dataOffset + streamed.size );
+    station->offset    = min( streamed.dataOffset, station->size );
+    station->readAhead = 0;
+
+    unsigned long bytesPerSec = max( streamed.sample_rate * max( streamed.channels * streamed.bps / 8, 1 ), 1UL );
+    station->bytesPerSec    = bytesPerSec;
+    station->ticksPerPacket = (double) freq.QuadPart * DATA_LEN / bytesPerSec;
+
+    unsigned long packets = bytesPerSec / 1000 * STREAM_PREFILL_MS / DATA_LEN;
+    station->ring.resize( max( min( packets, (unsigned long) STREAM_PREFILL_MAX_PACKETS ), 1UL ) );
+    station->ringStart = 0;
+    station->ringCount = 0;
+    station->ringLead  = 0;
+
+    DataPacket packet;
+    while( station->ringCount < (int) station->ring.size() && _readPacket( station, &packet ) );
+}
+
+/**
+ * sets up the conversion of a song to the stream format, if it isn't in that
+ *   format already; the converter that was there before is deleted.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         only called from the thread of the {StreamEngine}.
+ *
+ * @signature    void StreamEngine::_convert( SongName * song,
+ *   const char * data, unsigned long * size, FormatConverter ** converter )
+ *
+ * @param        song   the song; changed to the format it is sent in
+ * @param        data   contents of the song, acquired from the {SongStore};
+ *   NULL if it couldn't be opened
+ * @param        size   size of the song file; changed to the size of the
+ *   converted song
+ * @param        converter   set to the converter of the song, or NULL if it
+ *   is sent as is
+ */
+void StreamEngine::_convert( SongName * song, const char * data, unsigned long * size, FormatConverter ** converter )
+{
+    StreamFormat format;
+    getStreamFormat( &format );
+
+    delete *converter;
+    *converter = NULL;
+    if( data != NULL && FormatConverter::isNeeded( song, &format ) )
+    {
+        *converter = new FormatConverter( data, *size, song, &format );
+        *size      = (*converter)->getSize();
+    }
+    FormatConverter::convert( song, &format );
+}
+
+/**
+ * reads the next packet of the song a station is streaming, and keeps it in
+ *   the ring, in place of the oldest one once the ring is full. if the song
+ *   ends part way into the packet and the next song is open, the station
+ *   carries on into it, and the rest of the packet is filled from its start;
+ *   otherwise the rest is zeroed.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - reads from a single station.
+ *               2026-10-18 - reads through the converter of the song.
+ *               2026-10-18 - carries on into the next song within the packet.
+ *
+ * @note         only called from the thread of the {StreamEngine}.
+ *
+ * @signature    bool StreamEngine::_readPacket( Station * station,
+ *   DataPacket * packet )
+ *
+ * @param        station   the station
+ * @param        packet   filled with the next packet
+ *
+ * @return       false if the whole song has been read, and the next song
+ *   isn't open; true otherwise.
+ */
+bool StreamEngine::_readPacket( Station * station, DataPacket * packet )
+{
+    if( station->song == NULL
+        || ( station->offset >= station->size && !_continue( station ) ) )
+    {
+        return false;
+    }
+
+    // announce the next song once more, right where it starts
+    if( station->queuedData != NULL && station->size - station->offset <= DATA_LEN )
+    {
+        _announce( station );
+    }
+
+    unsigned long len = _readData( station, packet->data, DATA_LEN );
+    int lead = 0;
+    if( len < DATA_LEN && _continue( station ) )
+    {
+        lead = (int) len;
+        len += _readData( station, packet->data + len, DATA_LEN - len );
+    }
+    memset( packet->data + len, 0, DATA_LEN - len );
+    packet->index = ++station->lastIndex;
+
+    // the ring started over with this packet if the station carried on
+    int ringSize = station->ring.size();
+    station->ring[ ( station->ringStart + station->ringCount ) % ringSize ] = *packet;
+    if( station->ringCount < ringSize )
+    {
+        ++station->ringCount;
+    }
+    else
+    {
+        station->ringStart = ( station->ringStart + 1 ) % ringSize;
+        station->ringLead  = 0;
+    }
+    if( station->ringCount == 1 )
+    {
+        station->ringLead = lead;
+    }
+
+    return true;
+}
+
+/**
+ * reads the next bytes of the song a station is streaming.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         only called from the thread of the {StreamEngine}.
+ *
+ * @signature    unsigned long StreamEngine::_readData( Station * station,
+ *   char * data, unsigned long len )
+ *
+ * @param        station   the station
+ * @param        data   filled with the bytes
+ * @param        len   most bytes to read
+ *
+ * @return       number of bytes read; less than {len} at the end of the song.
+ */
+unsigned long StreamEngine::_readData( Station * station, char * data, unsigned long len )
+{
+    // ask for the next region to be read in before we get to it
+    if( station->offset >= station->readAhead )
+    {
+        unsigned long from = station->readAhead;
+        if( station->converter != NULL )
+        {
+            from = station->converter->sourceOffset( from );
+        }
+        SongStore::getInstance()->willRead( station->songId, from, SONG_STORE_READ_AHEAD );
+        station->readAhead += SONG_STORE_READ_AHEAD;
+    }
+
+    len = min( station->size - station->offset, len );
+    if( station->converter != NULL )
+    {
+        station->converter->read( station->offset, data, len );
+    }
+    else
+    {
+        memcpy( data, station->song + station->offset, len );
+    }
+    station->offset += len;
+    return len;
+}
+
+/**
+ * opens the next song of a station once the current one is within
+ *   {STREAM_PREOPEN_MS} of its end, and reads its first region in. once it
+ *   is open, it is announced every {STREAM_ANNOUNCE_PACKETS} packets, so
+ *   listeners that miss an announcement catch the next one.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - converts the next song to the stream format.
+ *               2026-10-18 - reads the playlist under {access}.
+ *
+ * @note         only called from the thread of the {StreamEngine}, after
+ *   each packet of the station is sent.
+ *
+ * @signature    void StreamEngine::_prepare( Station * station )
+ *
+ * @param        station   the station
+ */
+void StreamEngine::_prepare( Station * station )
+{
+    if( !station->prepared && station->size - station->offset <= station->bytesPerSec / 1000 * STREAM_PREOPEN_MS )
+    {
+        // a failed open isn't tried again; the station goes on the slow way
+        station->prepared   = true;
+        station->queuedData = NULL;
+
+        WaitForSingleObject( access, INFINITE );
+        Playlist * playlist = this->playlist;
+        bool hasNext = playlist != NULL && !playlist->playlist.empty();
+        if( hasNext )
+        {
+            station->queuedCursor = ( station->cursor + 1 ) % (int) playlist->playlist.size();
+            station->queuedSong   = playlist->playlist[ station->queuedCursor ];
+        }
+        ReleaseMutex( access );
+
+        if( hasNext )
+        {
+            SongStore * store = SongStore::getInstance();
+            station->queuedData   = store->acquire( station->queuedSong.id, &station->queuedSize );
+            if( station->queuedData != NULL )
+            {
+                store->willRead( station->queuedSong.id, 0, SONG_STORE_READ_AHEAD );
+            }
+            _convert( &station->queuedSong, station->queuedData, &station->queuedSize, &station->queuedConverter );
+        }
+        station->announceCountdown = 0;
+    }
+
+    if( station->queuedData != NULL && --station->announceCountdown <= 0 )
+    {
+        _announce( station );
+        station->announceCountdown = STREAM_ANNOUNCE_PACKETS;
+    }
+}
+
+/**
+ * carries a station on into the next song, if it was opened ahead of time.
+ *   the packets of the next song carry on from the indexes of the old one,
+ *   and go out on the same schedule, so listeners don't hear a gap.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - carries on with the converter of the next song.
+ *               2026-10-18 - starts after the header of the next song, and
+ *                            leaves announcing it to the caller.
+ *
+ * @note         only called from the thread of the {StreamEngine}, once the
+ *   whole song has been read. the ring starts over, so clients that tune in
+ *   are only sent packets of the new song, save for the end of the old one
+ *   in the packet they share.
+ *
+ * @signature    bool StreamEngine::_continue( Station * station )
+ *
+ * @param        station   the station
+ *
+ * @return       true if the station carried on into the next song; false if
+ *   it wasn't open.
+ */
+bool StreamEngine::_continue( Station * station )
+{
+    if( station->queuedData == NULL )
+    {
+        _unprepare( station );
+        return false;
+    }
+
+    SongName * next = &station->queuedSong;
+    SongStore::getInstance()->release( station->songId );
+    station->songId     = next->id;
+    station->song       = station->queuedData;
+    station->size       = min( station->queuedSize, next->dataOffset + next->size );
+    station->cursor     = station->queuedCursor;
+    delete station->converter;
+    station->converter       = station->queuedConverter;
+    station->queuedConverter = NULL;
+    station->offset     = min( next->dataOffset, station->size );
+    station->readAhead  = SONG_STORE_READ_AHEAD;
+    station->prepared   = false;
+    station->queuedData = NULL;
+
+    station->bytesPerSec    = max( next->sample_rate * max( next->channels * next->bps / 8, 1 ), 1UL );
+    station->ticksPerPacket = (double) freq.QuadPart * DATA_LEN / station->bytesPerSec;
+
+    unsigned long packets = station->bytesPerSec / 1000 * STREAM_PREFILL_MS / DATA_LEN;
+    station->ring.resize( max( min( packets, (unsigned long) STREAM_PREFILL_MAX_PACKETS ), 1UL ) );
+    station->ringStart = 0;
+    station->ringCount = 0;
+
+    wchar_t out[128];
+    swprintf_s( out, 128, L"station %d carried on to song %d at packet %d\n", station->number, station->songId, station->lastIndex + 1 );
+    OutputDebugString( out );
+    return true;
+}
+
+/**
+ * multicasts the format of the next song of a station, and the index of its
+ *   first packet, to the listeners of the station.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - counts the format against the stream reserve.
+ *               2026-10-18 - tells where in its first packet the song starts,
+ *                            and where in the song the stream starts.
+ *
+ * @note         only called from the thread of the {StreamEngine}, once the
+ *   next song is open.
+ *
+ * @signature    void StreamEngine::_announce( Station * station )
+ *
+ * @param        station   the station
+ */
+void StreamEngine::_announce( Station * station )
+{
+    unsigned long left = station->size - station->offset;
+
+    FormatPacket format;
+    format.firstIndex  = station->lastIndex + left / DATA_LEN + 1;
+    format.lead        = left % DATA_LEN;
+    format.dataOffset  = station->queuedSong.dataOffset;
+    format.songId      = station->queuedSong.id;
+    format.channels    = station->queuedSong.channels;
+    format.bps         = station->queuedSong.bps;
+    format.sample_rate = station->queuedSong.sample_rate;
+    format.size        = station->queuedSong.size;
+    TransferScheduler::getInstance()->sendStream( sizeof( format ) );
+    udpSocket->sendtoGroup( STREAM_FORMAT, &format, sizeof( format ), &station->group );
+}
+
+/**
+ * releases the next song of a station, if it was opened.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - deletes its converter.
+ *
+ * @note         only called from the thread of the {StreamEngine}.
+ *
+ * @signature    void StreamEngine::_unprepare( Station * station )
+ *
+ * @param        station   the station
+ */
+void StreamEngine::_unprepare( Station * station )
+{
+    if( station->queuedData != NULL )
+    {
+        SongStore::getInstance()->release( station->queuedSong.id );
+    }
+    delete station->queuedConverter;
+    station->prepared        = false;
+    station->queuedData      = NULL;
+    station->queuedConverter = NULL;
+}
+
+/**
+ * sends the packets in the ring of a station to a client over its control
+ *   connection, in as many {STREAM_PREFILL} messages as it takes.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - sends the ring of a single station.
+ *               2026-10-18 - counts the ring against the stream reserve.
+ *               2026-10-18 - posts the ring instead of sending it.
+ *               2026-10-18 - tells how much of the oldest packet is the end
+ *                            of the song before.
+ *
+ * @note         only called from the thread of the {StreamEngine}.
+ *
+ * @signature    void StreamEngine::_sendPrefill( Station * station,
+ *   TCPSocket * client )
+ *
+ * @param        station   the station
+ * @param        client   control connection of the client
+ */
+void StreamEngine::_sendPrefill( Station * station, TCPSocket * client )
+{
+    PrefillPacket prefill;
+    prefill.songId = station->songId;
+    prefill.first  = 1;
+    prefill.lead   = station->ringLead;
+
+    int ringSize = station->ring.size();
+    for( int i = 0; i < station->ringCount; )
+    {
+        prefill.count = 0;
+        while( prefill.count < PREFILL_BATCH && i < station->ringCount )
+        {
+            prefill.packets[ prefill.count++ ] = station->ring[ ( station->ringStart + i++ ) % ringSize ];
+        }
+        TransferScheduler::getInstance()->sendStream( offsetof( PrefillPacket, packets ) + prefill.count * sizeof( DataPacket ) );
+        _post( client, STREAM_PREFILL, &prefill, offsetof( PrefillPacket, packets ) + prefill.count * sizeof( DataPacket ) );
+        prefill.first = 0;
+        prefill.lead  = 0;
+    }
+}
+
+/**
+ * tells a client which station it is tuned to, which group to join to
+ *   receive it, and the format songs are sent in.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - tells the client the stream format.
+ *               2026-10-18 - posts the message instead of sending it.
+ *
+ * @note         only called from the thread of the {StreamEngine}.
+ *
+ * @signature    void StreamEngine::_sendTuned( Station * station,
+ *   TCPSocket * client, int count )
+ *
+ * @param        station   the station
+ * @param        client   control connection of the client
+ * @param        count   number of stations
+ */
+void StreamEngine::_sendTuned( Station * station, TCPSocket * client, int count )
+{
+    StationPacket tuned;
+    tuned.station = station->number;
+    tuned.count   = count;
+    tuned.group   = station->group.sin_addr.s_addr;
+    getStreamFormat( &tuned.format );
+    _post( client, TUNE_STATION, &tuned, sizeof( tuned ) );
+}
+
+/**
+ * hands a message to the thread sending to a client over its control
+ *   connection, starting the thread the first time. returns right away, so
+ *   the thread of the {StreamEngine} never waits for a client.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         the message is dropped if the client has left; the messages
+ *   of each client are sent in the order they were posted.
+ *
+ * @signature    void StreamEngine::_post( TCPSocket * client, char type,
+ *   const void * data, int length )
+ *
+ * @param        client   control connection of the client
+ * @param        type   type of the message
+ * @param        data   contents of the message; copied
+ * @param        length   length of the message
+ */
+void StreamEngine::_post( TCPSocket * client, char type, const void * data, int length )
+{
+    WaitForSingleObject( access, INFINITE );
+    if( tuned.find( client ) == tuned.end() )
+    {
+        ReleaseMutex( access );
+        return;
+    }
+
+    Outbox * outbox;
+    std::map< TCPSocket *, Outbox * >::iterator it = outboxes.find( client );
+    if( it != outboxes.end() )
+    {
+        outbox = it->second;
+    }
+    else
+    {
+        DWORD useless;
+        outbox          = new Outbox;
+        outbox->client  = client;
+        outbox->ready   = CreateEvent( NULL, FALSE, FALSE, NULL );
+        outbox->closing = false;
+        outbox->thread  = CreateThread( 0, 0, _sendRoutine, outbox, 0, &useless );
+        outboxes[ client ] = outbox;
+    }
+
+    const char * bytes = (const char *) data;
+    outbox->messages.push_back( std::make_pair( type, std::vector< char >( bytes, bytes + length ) ) );
+    SetEvent( outbox->ready );
+    ReleaseMutex( access );
+}
+
+/**
+ * threaded routine that sends the messages posted to a client, in order,
+ *   until the client leaves.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         one runs for every client that has been sent anything.
+ *
+ * @signature    DWORD WINAPI StreamEngine::_sendRoutine( void * params )
+ *
+ * @param        params   the {Outbox} of the client
+ *
+ * @return       exit code
+ */
+DWORD WINAPI StreamEngine::_sendRoutine( void * params )
+{
+    StreamEngine * thiz = StreamEngine::getInstance();
+    Outbox * outbox = (Outbox *) params;
+    std::deque< std::pair< char, std::vector< char > > > messages;
+
+    while( !outbox->closing )
+    {
+        WaitForSingleObject( outbox->ready, INFINITE );
+
+        WaitForSingleObject( thiz->access, INFINITE );
+        messages.swap( outbox->messages );
+        ReleaseMutex( thiz->access );
+
+        for( ; !messages.empty() && !outbox->closing; messages.pop_front() )
+        {
+            std::vector< char > & message = messages.front().second;
+            outbox->client->Send( messages.front().first, message.empty() ? NULL : &message[ 0 ], (int) message.size() );
+        }
+        messages.clear();
+    }
+
+    return 0;
+}
+
+/**
+ * adds a latency to the statistics of the {StreamEngine}, and logs it.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - logs the station too.
+ *
+ * @note         none
+ *
+ * @signature    void StreamEngine::_record( StreamLatency * latency,
+ *   LONGLONG requested, Station * station, const wchar_t * what )
+ *
+ * @param        latency   statistics to add the latency to
+ * @param        requested   performance counter value of when the latency
+ *   started
+ * @param        station   the station the latency is of
+ * @param        what   what the latency is of, for the log
+ */
+void StreamEngine::_record( StreamLatency * latency, LONGLONG requested, Station * station, const wchar_t * what )
+{
+    double ms = (double) ( _now() - requested ) * 1000.0 / freq.QuadPart;
+
+    WaitForSingleObject( access, INFINITE );
+    ++latency->count;
+    latency->lastMs   = ms;
+    latency->totalMs += ms;
+    latency->maxMs    = max( latency->maxMs, ms );
+    ReleaseMutex( access );
+
+    wchar_t out[128];
+    swprintf_s( out, 128, L"%s on station %d to song %d took %.2f ms\n", what, station->number, station->songId, ms );
+    OutputDebugString( out );
+}
+
+/**
+ * puts a station on the pending list, and wakes the sending thread up to
+ *   handle it. must be called with {access} held.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void StreamEngine::_wake( Station * station )
+ *
+ * @param        station   the station
+ */
+void StreamEngine::_wake( Station * station )
+{
+    if( !station->isPending )
+    {
+        station->isPending = true;
+        pending.push_back( station );
+    }
+    SetEvent( wake );
+}
+
+/**
+ * returns the value of the performance counter.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    LONGLONG StreamEngine::_now()
+ *
+ * @return       the value of the performance counter
+ */
+LONGLONG StreamEngine::_now()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter( &now );
+    return now.QuadPart;
+}
@@ -0,0 +1,255 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: StreamEngine.h
+--
+-- NOTES:
+-- The {StreamEngine} sends the server's stations, each on its
+-- own multicast group. Every station streams the playlist from
+-- its own cursor, at the byte rate of its song. One thread sends
+-- all of them, always the packet that is due first, for the
+-- life of the server; changing the song of a station swaps its
+-- source at the next packet boundary.
+--
+-- A few seconds before a song ends, the next one is opened, and
+-- announced in the stream; its packets carry on from the indexes
+-- of the old one, so clients go on to it without a gap.
+--
+-- Each station keeps the last few seconds of its stream in a
+-- ring, and sends them to clients that tune in, so they can
+-- start playing right away instead of waiting for their
+-- buffers to fill.
+--
+-- When a stream format is set, every song is converted to it
+-- as it is sent, so clients never have to reopen their audio
+-- device when the song changes.
+--
+-- Messages to clients over their control connections are
+-- handed to a sending thread of each client, so a client that is
+-- slow to read them never holds up the stations.
+--------------------------------------------------------------*/
+#ifndef STREAMENGINE_H
+#define STREAMENGINE_H
+
+#include "../common.h"
+#include "../protocol.h"
+#include "Playlist.h"
+#include "FormatConverter.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <queue>
+#include <vector>
+
+/**
+ * number of stations the server sends, unless changed with
+ *   {StreamEngine::setStations}.
+ */
+#define STREAM_DEFAULT_STATIONS 8
+
+/**
+ * most stations the server can send.
+ */
+#define STREAM_MAX_STATIONS 256
+
+/**
+ * milliseconds of the stream kept in the ring, and sent to clients when they
+ *   tune in or the song changes.
+ */
+#define STREAM_PREFILL_MS 2000
+
+/**
+ * most packets kept in the ring, no matter the byte rate of the song.
+ */
+#define STREAM_PREFILL_MAX_PACKETS 2048
+
+/**
+ * milliseconds before the end of a song that the next song of the station is
+ *   opened, and its first region read in.
+ */
+#define STREAM_PREOPEN_MS 5000
+
+/**
+ * packets sent between announcements of the next song, once it is open.
+ */
+#define STREAM_ANNOUNCE_PACKETS 64
+
+/**
+ * latency statistics of the {StreamEngine}.
+ *
+ * {count}; number of latencies measured
+ *
+ * {lastMs}; last latency measured in milliseconds
+ *
+ * {totalMs}; sum of the latencies in milliseconds
+ *
+ * {maxMs}; largest latency in milliseconds
+ */
+struct StreamLatency
+{
+    int count;
+    double lastMs;
+    double totalMs;
+    double maxMs;
+};
+
+/**
+ * statistics about the thread sending the stations.
+ *
+ * {stations}; number of stations
+ *
+ * {playing}; number of stations streaming a song
+ *
+ * {packets}; number of packets multicast so far
+ *
+ * {late}; number of packets sent more than a millisecond after they were due
+ *
+ * {cpuMs}; milliseconds of CPU time the thread has used so far
+ */
+struct StreamSenderStats
+{
+    int stations;
+    int playing;
+    unsigned long long packets;
+    unsigned long long late;
+    double cpuMs;
+};
+
+class StreamEngine
+{
+public:
+    static StreamEngine * getInstance();
+
+    void setSocket( UDPSocket * sock );
+    void setPlaylist( Playlist * playlist );
+    wchar_t * getSongPath( int songId );
+    void setStations( int count );
+    void setStreamFormat( StreamFormat * format );
+    void getStreamFormat( StreamFormat * format );
+    int getStations();
+    bool getGroup( int station, sockaddr_in * group );
+    void startStation( int station );
+    void tune( TCPSocket * client, int station );
+    void join( TCPSocket * client );
+    void leave( TCPSocket * client );
+    void play( TCPSocket * client, SongName * song, LONGLONG requested );
+    void getStats( StreamLatency * switches, StreamLatency * joins );
+    void getSenderStats( StreamSenderStats * stats );
+
+protected:
+    StreamEngine();
+    ~StreamEngine();
+
+private:
+    struct Station;
+    struct Outbox;
+
+    /**
+     * a station in the deadline heap, and when its next packet is due.
+     */
+    typedef std::pair< LONGLONG, Station * > Deadline;
+
+    static DWORD WINAPI _streamRoutine( void * params );
+    static DWORD WINAPI _sendRoutine( void * params );
+
+    void _service( Station * station, bool advance );
+    void _swap( Station * station, SongName * next, Playlist * playlist );
+    void _convert( SongName * song, const char * data, unsigned long * size, FormatConverter ** converter );
+    bool _readPacket( Station * station, DataPacket * packet );
+    unsigned long _readData( Station * station, char * data, unsigned long len );
+    void _prepare( Station * station );
+    bool _continue( Station * station );
+    void _announce( Station * station );
+    void _unprepare( Station * station );
+    void _sendPrefill( Station * station, TCPSocket * client );
+    void _sendTuned( Station * station, TCPSocket * client, int count );
+    void _post( TCPSocket * client, char type, const void * data, int length );
+    void _record( StreamLatency * latency, LONGLONG requested, Station * station, const wchar_t * what );
+    void _wake( Station * station );
+    LONGLONG _now();
+
+    /**
+     * socket the stations are sent to their multicast groups from.
+     */
+    UDPSocket * udpSocket;
+
+    /**
+     * songs the stations play, in order.
+     */
+    Playlist * playlist;
+
+    /**
+     * format songs are converted to before they are sent; a sample rate of 0
+     *   if they are sent in their own format.
+     */
+    StreamFormat streamFormat;
+
+    /**
+     * the stations; never shrinks, and never reallocates, so the sending
+     *   thread can hold on to them.
+     */
+    std::vector< Station * > stations;
+
+    /**
+     * station each client is tuned to, indexed by its control connection.
+     */
+    std::map< TCPSocket *, Station * > tuned;
+
+    /**
+     * messages waiting to be sent to each client tuned to a station, indexed
+     *   by its control connection.
+     */
+    std::map< TCPSocket *, Outbox * > outboxes;
+
+    /**
+     * stations with a swap or clients tuning in to handle at the next packet
+     *   boundary.
+     */
+    std::vector< Station * > pending;
+
+    /**
+     * stations streaming a song, by when their next packet is due; the
+     *   earliest on top. only used by the sending thread.
+     */
+    std::priority_queue< Deadline, std::vector< Deadline >, std::greater< Deadline > > deadlines;
+
+    /**
+     * latencies from a song change being requested until the first packet of
+     *   the new song is sent.
+     */
+    StreamLatency switchLatency;
+
+    /**
+     * latencies from a client tuning in until the prefill is posted to it.
+     */
+    StreamLatency joinLatency;
+
+    /**
+     * packets multicast, and packets multicast late, so far; only changed
+     *   by the sending thread, with interlocked operations.
+     */
+    volatile LONGLONG packetsSent;
+    volatile LONGLONG packetsLate;
+
+    /**
+     * frequency of the performance counter.
+     */
+    LARGE_INTEGER freq;
+
+    /**
+     * auto-reset event that wakes the sending thread up when it is waiting
+     *   for the next packet to be due, so it handles swaps and tuning in
+     *   right away.
+     */
+    HANDLE wake;
+
+    /**
+     * handle to the thread running {StreamEngine::_streamRoutine}.
+     */
+    HANDLE thread;
+
+    /**
+     * protects the interface functions of the {StreamEngine}.
+     */
+    HANDLE access;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "StreamEngine.h"
+#include "../Buffer/MessageQueue.h"
+
+#ifdef TEST_STREAM_ENGINE
+
+/**
+ * loopback benchmark of the stations of the StreamEngine. more and more
+ *   stations are started, all streaming a CD quality song, and a receiver
+ *   that joined every group counts what comes back. reports the CPU time the
+ *   sending thread takes per station, and how many packets went out late.
+ */
+
+#define SENDER_PORT 7793
+#define RUN_MS 3000
+#define TEST_SONG_SIZE (8*1024*1024)
+#define TEST_DIR L"StreamEngineTest"
+#define TEST_SONG L"StreamEngineTest\\song.wav"
+
+static volatile LONG received = 0;
+
+DWORD WINAPI receiver(void* params)
+{
+    SOCKET sd = (SOCKET) params;
+    char datagram[1+sizeof(DataPacket)];
+
+    while(recv(sd,datagram,sizeof(datagram),0) > 0)
+    {
+        InterlockedIncrement(&received);
+    }
+    return 0;
+}
+
+SOCKET listenOnGroups(int count)
+{
+    SOCKET sd = socket(AF_INET,SOCK_DGRAM,IPPROTO_UDP);
+    int size = 4*1024*1024;
+    setsockopt(sd,SOL_SOCKET,SO_RCVBUF,(char*) &size,sizeof(size));
+
+    sockaddr_in addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(MULTICAST_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    bind(sd,(sockaddr*) &addr,sizeof(addr));
+
+    // the same groups the StreamEngine gives its stations
+    for(int i = 0; i < count; ++i)
+    {
+        ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = htonl(ntohl(inet_addr(MULTICAST_ADDR))+i);
+        mreq.imr_interface.s_addr = INADDR_ANY;
+        setsockopt(sd,IPPROTO_IP,IP_ADD_MEMBERSHIP,(char*) &mreq,sizeof(mreq));
+    }
+    return sd;
+}
+
+void writeSong()
+{
+    struct
+    {
+        char riff[4];
+        unsigned long riffSize;
+        char wave[4];
+        char fmt[4];
+        unsigned long fmtSize;
+        short format, channels;
+        unsigned long sampleRate, byteRate;
+        short blockAlign, bitsPerSample;
+        char data[4];
+        unsigned long dataSize;
+    } header = {{'R','I','F','F'},TEST_SONG_SIZE-8,{'W','A','V','E'},
+        {'f','m','t',' '},16,1,2,44100,44100*4,4,16,
+        {'d','a','t','a'},TEST_SONG_SIZE-44};
+
+    CreateDirectory(TEST_DIR,NULL);
+    FILE* fp = _wfopen(TEST_SONG,L"wb");
+    fwrite(&header,sizeof(header),1,fp);
+    for(unsigned long i = sizeof(header); i < TEST_SONG_SIZE; ++i)
+    {
+        fputc((char) i,fp);
+    }
+    fclose(fp);
+}
+
+int main(void)
+{
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2,2),&wsaData);
+
+    writeSong();
+    StreamEngine* engine = StreamEngine::getInstance();
+    engine->setPlaylist(new Playlist(TEST_DIR L"\\*.wav"));
+
+    UDPSocket* sock = new UDPSocket(SENDER_PORT,new MessageQueue(100,sizeof(LocalDataPacket)));
+    sock->setGroup(MULTICAST_ADDR,0);
+    engine->setSocket(sock);
+
+    int counts[] = {1,8,16,32,64};
+    CreateThread(NULL,0,receiver,(void*) listenOnGroups(counts[sizeof(counts)/sizeof(counts[0])-1]),0,NULL);
+
+    printf("%d ms per run, %d byte packets\n",RUN_MS,DATA_LEN);
+    for(int c = 0; c < sizeof(counts)/sizeof(counts[0]); ++c)
+    {
+        int started = engine->getStations();
+        engine->setStations(counts[c]);
+        for(int i = started; i < counts[c]; ++i)
+        {
+            engine->startStation(i);
+        }
+
+        // let the new stations get past their prefill before measuring
+        Sleep(500);
+
+        StreamSenderStats before, after;
+        engine->getSenderStats(&before);
+        LONG receivedBefore = received;
+        Sleep(RUN_MS);
+        engine->getSenderStats(&after);
+        LONG receivedAfter = received;
+
+        double cpuMs = after.cpuMs-before.cpuMs;
+        unsigned long long packets = after.packets-before.packets;
+        printf("%3d stations %8.2f%% cpu %6.3f%% per station %8llu sent %8ld received %6llu late\n",
+            after.playing,cpuMs*100/RUN_MS,cpuMs*100/RUN_MS/max(after.playing,1),
+            packets,receivedAfter-receivedBefore,after.late-before.late);
+    }
+
+    DeleteFile(TEST_SONG);
+    RemoveDirectory(TEST_DIR);
+    WSACleanup();
+    return 0;
+}
+
+#endif
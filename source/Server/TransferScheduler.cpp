@@ -0,0 +1,629 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: TransferScheduler.cpp
+--
+-- NOTES:
+-- This file contains the implementation of the
+-- {TransferScheduler} class.
+--------------------------------------------------------------*/
+#include "TransferScheduler.h"
+
+/**
+ * a download the {TransferScheduler} is sharing the budget with.
+ *
+ * {peer}; IPv4 address the download is sent to
+ *
+ * {songId}; id of the song being downloaded
+ *
+ * {users}; number of threads sending the download; connections of the same
+ *   client downloading the same song share one entry, and so one share.
+ *
+ * {weight}; share of the budget the download gets, relative to the others
+ *
+ * {limit}; most bytes per second the download may be sent at; 0 for none
+ *
+ * {finishTag}; finish tag of the last send of the download
+ *
+ * {limitTokens}; bytes the download may send right now under its {limit}
+ *
+ * {limitRefill}; performance counter value of when {limitTokens} was last
+ *   refilled
+ *
+ * {bytesSent}; number of bytes of the download sent so far
+ *
+ * {windowBytes}; number of bytes sent since {windowStart}
+ *
+ * {windowStart}; performance counter value of when the current rate window
+ *   started
+ *
+ * {rate}; bytes per second measured over the last rate window
+ */
+struct TransferScheduler::Transfer
+{
+    unsigned long peer;
+    int songId;
+    int users;
+    int weight;
+    unsigned long limit;
+    double finishTag;
+    double limitTokens;
+    LONGLONG limitRefill;
+    unsigned long long bytesSent;
+    unsigned long long windowBytes;
+    LONGLONG windowStart;
+    unsigned long rate;
+};
+
+/**
+ * returns the singleton instance of the {TransferScheduler}
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    TransferScheduler * TransferScheduler::getInstance()
+ *
+ * @return       the one and only {TransferScheduler}
+ */
+TransferScheduler * TransferScheduler::getInstance()
+{
+    static TransferScheduler * _instance = new TransferScheduler();
+    return _instance;
+}
+
+/**
+ * creates a {TransferScheduler} with the default budget and stream reserve.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    TransferScheduler::TransferScheduler()
+ */
+TransferScheduler::TransferScheduler()
+    : virtualTime( 0 )
+    , tokens( 0 )
+    , streamTokens( 0 )
+    , streamWindowBytes( 0 )
+    , streamRate( 0 )
+    , budget( TRANSFER_DEFAULT_BUDGET )
+    , streamReserve( TRANSFER_DEFAULT_STREAM_RESERVE )
+    , nextId( 0 )
+    , access( CreateMutex( NULL, FALSE, NULL ) )
+{
+    QueryPerformanceFrequency( &freq );
+    lastRefill = now();
+    streamWindowStart = lastRefill;
+}
+
+/**
+ * forgets about all the downloads.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    TransferScheduler::~TransferScheduler()
+ */
+TransferScheduler::~TransferScheduler()
+{
+    for( std::map< int, Transfer * >::iterator it = transfers.begin()
+       ; it != transfers.end()
+       ; ++it )
+    {
+        delete it->second;
+    }
+    CloseHandle( access );
+}
+
+/**
+ * invoked when a thread starts sending a download. threads sending the same
+ *   song to the same client share one download, so a client opening several
+ *   connections doesn't get a bigger share than the others.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         every call must be matched by a call to
+ *   {TransferScheduler::close}.
+ *
+ * @signature    int TransferScheduler::open( unsigned long peer, int songId )
+ *
+ * @param        peer   IPv4 address the download is sent to
+ * @param        songId   id of the song being downloaded
+ *
+ * @return       id of the download, to pass to {TransferScheduler::send}.
+ */
+int TransferScheduler::open( unsigned long peer, int songId )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    for( std::map< int, Transfer * >::iterator it = transfers.begin()
+       ; it != transfers.end()
+       ; ++it )
+    {
+        if( it->second->peer == peer && it->second->songId == songId )
+        {
+            ++it->second->users;
+            ReleaseMutex( access );
+            return it->first;
+        }
+    }
+
+    Transfer * transfer = new Transfer;
+    transfer->peer        = peer;
+    transfer->songId      = songId;
+    transfer->users       = 1;
+    transfer->weight      = TRANSFER_DEFAULT_WEIGHT;
+    transfer->limit       = 0;
+    transfer->finishTag   = 0;
+    transfer->limitTokens = 0;
+    transfer->limitRefill = now();
+    transfer->bytesSent   = 0;
+    transfer->windowBytes = 0;
+    transfer->windowStart = transfer->limitRefill;
+    transfer->rate        = 0;
+
+    int id = nextId++;
+    transfers[ id ] = transfer;
+
+    ReleaseMutex( access );
+    return id;
+}
+
+/**
+ * invoked when a thread stops sending a download. the download is forgotten
+ *   once no thread is sending it any more.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void TransferScheduler::close( int id )
+ *
+ * @param        id   id of the download
+ */
+void TransferScheduler::close( int id )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    std::map< int, Transfer * >::iterator it = transfers.find( id );
+    if( it != transfers.end() && --it->second->users == 0 )
+    {
+        delete it->second;
+        transfers.erase( it );
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * waits until the download may send the passed number of bytes.
+ *
+ * the download first waits for its own limit, if it has one, so a download
+ *   held back by its limit doesn't hold up the others. it then waits for its
+ *   turn at the budget: every send is tagged with the tag of the download's
+ *   last send plus its size divided by the download's weight, and the send
+ *   with the smallest tag goes as soon as the budget allows. downloads waiting
+ *   for the budget are sent at rates proportional to their weights, and a
+ *   download alone gets all of it.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - the stream's overflow is taken out of the downloads' tokens
+ *
+ * @note         must only be called by a thread that has the download open.
+ *
+ * @signature    void TransferScheduler::send( int id, unsigned long bytes )
+ *
+ * @param        id   id of the download
+ * @param        bytes   number of bytes about to be sent
+ */
+void TransferScheduler::send( int id, unsigned long bytes )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    std::map< int, Transfer * >::iterator it = transfers.find( id );
+    if( it == transfers.end() )
+    {
+        ReleaseMutex( access );
+        return;
+    }
+    Transfer * transfer = it->second;
+
+    // wait for the download's own limit
+    while( transfer->limit > 0 )
+    {
+        LONGLONG time = now();
+        double burst = max( (double) bytes, (double) transfer->limit * TRANSFER_BURST_MS / 1000 );
+        transfer->limitTokens = min( burst, transfer->limitTokens
+            + (double) ( time - transfer->limitRefill ) * transfer->limit / freq.QuadPart );
+        transfer->limitRefill = time;
+
+        if( transfer->limitTokens >= bytes )
+        {
+            transfer->limitTokens -= bytes;
+            break;
+        }
+
+        DWORD wait = (DWORD) ( ( bytes - transfer->limitTokens ) * 1000 / transfer->limit );
+        ReleaseMutex( access );
+        Sleep( max( wait, (DWORD) 1 ) );
+        WaitForSingleObject( access, INFINITE );
+    }
+
+    // wait for the download's turn at the budget
+    double tag = max( transfer->finishTag, virtualTime ) + (double) bytes / transfer->weight;
+    transfer->finishTag = tag;
+    waiting.insert( tag );
+
+    while( downloadRate() > 0 || *waiting.begin() != tag )
+    {
+        LONGLONG time = now();
+        double rate = downloadRate();
+        DWORD wait = 1;
+
+        if( *waiting.begin() == tag )
+        {
+            refill( time, bytes );
+            if( tokens >= bytes )
+            {
+                tokens -= bytes;
+                break;
+            }
+            wait = (DWORD) ( ( bytes - tokens ) * 1000 / rate );
+        }
+
+        ReleaseMutex( access );
+        Sleep( max( wait, (DWORD) 1 ) );
+        WaitForSingleObject( access, INFINITE );
+    }
+    virtualTime = tag - (double) bytes / transfer->weight;
+    waiting.erase( waiting.find( tag ) );
+
+    // measure the download's rate
+    LONGLONG time = now();
+    transfer->bytesSent   += bytes;
+    transfer->windowBytes += bytes;
+    if( time - transfer->windowStart >= freq.QuadPart * TRANSFER_RATE_WINDOW_MS / 1000 )
+    {
+        transfer->rate        = (unsigned long) ( transfer->windowBytes * freq.QuadPart / ( time - transfer->windowStart ) );
+        transfer->windowBytes = 0;
+        transfer->windowStart = time;
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * counts bytes of the live stream that are about to be sent. the stream never
+ *   waits; it is sent out of its reserve, and whatever it sends beyond that is
+ *   taken out of the tokens of the downloads, which then wait until the budget
+ *   has made up for it.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         called by every sender of the stream for every packet, so
+ *   it only holds {access} for as long as it takes to count the bytes.
+ *
+ * @signature    void TransferScheduler::sendStream( unsigned long bytes )
+ *
+ * @param        bytes   number of bytes of the stream about to be sent
+ */
+void TransferScheduler::sendStream( unsigned long bytes )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    LONGLONG time = now();
+    refill( time, 0 );
+    if( budget > 0 )
+    {
+        double reserved = min( max( streamTokens, 0.0 ), (double) bytes );
+        streamTokens -= reserved;
+        tokens       -= bytes - reserved;
+    }
+
+    // measure the stream's rate
+    streamWindowBytes += bytes;
+    if( time - streamWindowStart >= freq.QuadPart * TRANSFER_RATE_WINDOW_MS / 1000 )
+    {
+        streamRate        = (unsigned long) ( streamWindowBytes * freq.QuadPart / ( time - streamWindowStart ) );
+        streamWindowBytes = 0;
+        streamWindowStart = time;
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * sets how many bytes per second all downloads and the stream may be sent at.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         takes effect immediately, for downloads already being sent.
+ *
+ * @signature    void TransferScheduler::setBudget( unsigned long bytesPerSecond )
+ *
+ * @param        bytesPerSecond   the budget; 0 for no limit
+ */
+void TransferScheduler::setBudget( unsigned long bytesPerSecond )
+{
+    WaitForSingleObject( access, INFINITE );
+    budget = bytesPerSecond;
+    ReleaseMutex( access );
+}
+
+/**
+ * returns how many bytes per second all downloads and the stream may be sent
+ *   at.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - read under {access}
+ *
+ * @note         none
+ *
+ * @signature    unsigned long TransferScheduler::getBudget()
+ *
+ * @return       the budget; 0 if there is no limit
+ */
+unsigned long TransferScheduler::getBudget()
+{
+    WaitForSingleObject( access, INFINITE );
+    unsigned long bytesPerSecond = budget;
+    ReleaseMutex( access );
+    return bytesPerSecond;
+}
+
+/**
+ * sets how many bytes per second of the budget are kept back for the live
+ *   stream.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         downloads still get {TRANSFER_MIN_RATE} if the reserve leaves
+ *   less than that.
+ *
+ * @signature    void TransferScheduler::setStreamReserve( unsigned long bytesPerSecond )
+ *
+ * @param        bytesPerSecond   the reserve
+ */
+void TransferScheduler::setStreamReserve( unsigned long bytesPerSecond )
+{
+    WaitForSingleObject( access, INFINITE );
+    streamReserve = bytesPerSecond;
+    ReleaseMutex( access );
+}
+
+/**
+ * returns how many bytes per second of the budget are kept back for the live
+ *   stream.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     2026-10-18 - read under {access}
+ *
+ * @note         none
+ *
+ * @signature    unsigned long TransferScheduler::getStreamReserve()
+ *
+ * @return       the reserve
+ */
+unsigned long TransferScheduler::getStreamReserve()
+{
+    WaitForSingleObject( access, INFINITE );
+    unsigned long bytesPerSecond = streamReserve;
+    ReleaseMutex( access );
+    return bytesPerSecond;
+}
+
+/**
+ * returns how many bytes per second the stream was sent at recently.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    unsigned long TransferScheduler::getStreamRate()
+ *
+ * @return       bytes per second the stream was sent at
+ */
+unsigned long TransferScheduler::getStreamRate()
+{
+    WaitForSingleObject( access, INFINITE );
+    unsigned long bytesPerSecond = streamRate;
+
+    // the stream has stopped if it hasn't been sent for a whole window
+    if( now() - streamWindowStart >= 2 * freq.QuadPart * TRANSFER_RATE_WINDOW_MS / 1000 )
+    {
+        bytesPerSecond = 0;
+    }
+    ReleaseMutex( access );
+    return bytesPerSecond;
+}
+
+/**
+ * sets the share of the budget a download gets, relative to the others.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void TransferScheduler::setWeight( int id, int weight )
+ *
+ * @param        id   id of the download
+ * @param        weight   the weight; at least 1
+ */
+void TransferScheduler::setWeight( int id, int weight )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    std::map< int, Transfer * >::iterator it = transfers.find( id );
+    if( it != transfers.end() )
+    {
+        it->second->weight = max( weight, 1 );
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * sets the most bytes per second a download may be sent at.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    void TransferScheduler::setLimit( int id, unsigned long bytesPerSecond )
+ *
+ * @param        id   id of the download
+ * @param        bytesPerSecond   the limit; 0 to only limit the download by its
+ *   share of the budget
+ */
+void TransferScheduler::setLimit( int id, unsigned long bytesPerSecond )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    std::map< int, Transfer * >::iterator it = transfers.find( id );
+    if( it != transfers.end() )
+    {
+        it->second->limit       = bytesPerSecond;
+        it->second->limitTokens = 0;
+        it->second->limitRefill = now();
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * copies the statistics of every download being sent into the passed vector.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         downloads that have not sent anything for a whole rate window
+ *   are reported with a rate of 0.
+ *
+ * @signature    void TransferScheduler::getStats( std::vector< TransferStats > * stats )
+ *
+ * @param        stats   vector to append the statistics to
+ */
+void TransferScheduler::getStats( std::vector< TransferStats > * stats )
+{
+    WaitForSingleObject( access, INFINITE );
+
+    LONGLONG time = now();
+    for( std::map< int, Transfer * >::iterator it = transfers.begin()
+       ; it != transfers.end()
+       ; ++it )
+    {
+        TransferStats stat;
+        stat.id        = it->first;
+        stat.peer      = it->second->peer;
+        stat.songId    = it->second->songId;
+        stat.weight    = it->second->weight;
+        stat.limit     = it->second->limit;
+        stat.bytesSent = it->second->bytesSent;
+        stat.rate      = it->second->rate;
+        if( time - it->second->windowStart >= 2 * freq.QuadPart * TRANSFER_RATE_WINDOW_MS / 1000 )
+        {
+            stat.rate = 0;
+        }
+        stats->push_back( stat );
+    }
+
+    ReleaseMutex( access );
+}
+
+/**
+ * returns how many bytes per second all downloads together may be sent at;
+ *   the budget less what is kept back for the stream.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         must be called with {access} held.
+ *
+ * @signature    double TransferScheduler::downloadRate()
+ *
+ * @return       bytes per second; 0 if there is no limit
+ */
+double TransferScheduler::downloadRate()
+{
+    if( budget == 0 )
+        return 0;
+
+    return budget > streamReserve + TRANSFER_MIN_RATE ? budget - streamReserve : TRANSFER_MIN_RATE;
+}
+
+/**
+ * adds the bytes the downloads and the stream may send for the time since
+ *   they were last refilled.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         must be called with {access} held. the budget may only be
+ *   saved up for a little while, so neither can burst for long after being
+ *   idle.
+ *
+ * @signature    void TransferScheduler::refill( LONGLONG time, unsigned long bytes )
+ *
+ * @param        time   the performance counter now
+ * @param        bytes   size of the download send waiting for the tokens; 0
+ *   when refilling for the stream
+ */
+void TransferScheduler::refill( LONGLONG time, unsigned long bytes )
+{
+    double elapsed = (double) ( time - lastRefill ) / freq.QuadPart;
+    double rate    = downloadRate();
+    double reserve = budget > 0 ? (double) min( streamReserve, budget ) : 0;
+
+    double burst = max( (double) bytes, rate * TRANSFER_BURST_MS / 1000 );
+    tokens       = min( burst, tokens + elapsed * rate );
+    streamTokens = min( reserve * TRANSFER_BURST_MS / 1000, streamTokens + elapsed * reserve );
+    lastRefill   = time;
+}
+
+/**
+ * returns the current value of the performance counter.
+ *
+ * @date         2026-10-18
+ *
+ * @revision     none
+ *
+ * @note         none
+ *
+ * @signature    LONGLONG TransferScheduler::now()
+ *
+ * @return       the performance counter
+ */
+LONGLONG TransferScheduler::now()
+{
+    LARGE_INTEGER time;
+    QueryPerformanceCounter( &time );
+    return time.QuadPart;
+}
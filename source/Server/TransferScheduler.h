@@ -0,0 +1,181 @@
+/*--------------------------------------------------------------
+-- SOURCE FILE: TransferScheduler.h
+--
+-- NOTES:
+-- The {TransferScheduler} shares the server's upload budget
+-- between all the downloads it is sending, and keeps part of
+-- it back for the live stream. The stream is never made to
+-- wait; whatever it sends beyond its reserve is taken out of
+-- the downloads' share instead.
+--------------------------------------------------------------*/
+#ifndef TRANSFERSCHEDULER_H
+#define TRANSFERSCHEDULER_H
+
+#include "../common.h"
+#include <map>
+#include <set>
+#include <vector>
+
+/**
+ * bytes per second all downloads together may be sent at, unless changed with
+ *   {TransferScheduler::setBudget}.
+ */
+#define TRANSFER_DEFAULT_BUDGET (8*1024*1024)
+
+/**
+ * bytes per second of the budget kept back for the live stream, unless
+ *   changed with {TransferScheduler::setStreamReserve}.
+ */
+#define TRANSFER_DEFAULT_STREAM_RESERVE (256*1024)
+
+/**
+ * downloads always get at least this many bytes per second between them, no
+ *   matter how much is reserved for the stream.
+ */
+#define TRANSFER_MIN_RATE (16*1024)
+
+/**
+ * weight of a new download; a download with twice the weight of another is
+ *   sent twice as fast when both are waiting for the budget.
+ */
+#define TRANSFER_DEFAULT_WEIGHT 1
+
+/**
+ * milliseconds worth of budget that may be saved up while nothing is being
+ *   sent, and then sent in one burst.
+ */
+#define TRANSFER_BURST_MS 50
+
+/**
+ * milliseconds over which the rate of each download is measured.
+ */
+#define TRANSFER_RATE_WINDOW_MS 1000
+
+/**
+ * statistics about a single download in the {TransferScheduler}.
+ *
+ * {id}; id of the download in the scheduler
+ *
+ * {peer}; IPv4 address the download is sent to, in network byte order
+ *
+ * {songId}; id of the song being downloaded
+ *
+ * {weight}; share of the budget the download gets, relative to the others
+ *
+ * {limit}; most bytes per second the download may be sent at; 0 if it is
+ *   only limited by its share of the budget
+ *
+ * {rate}; bytes per second the download was sent at recently
+ *
+ * {bytesSent}; number of bytes of the download sent so far
+ */
+struct TransferStats
+{
+    int id;
+    unsigned long peer;
+    int songId;
+    int weight;
+    unsigned long limit;
+    unsigned long rate;
+    unsigned long long bytesSent;
+};
+
+class TransferScheduler
+{
+public:
+    static TransferScheduler * getInstance();
+
+    int open( unsigned long peer, int songId );
+    void close( int id );
+    void send( int id, unsigned long bytes );
+    void sendStream( unsigned long bytes );
+
+    void setBudget( unsigned long bytesPerSecond );
+    unsigned long getBudget();
+    void setStreamReserve( unsigned long bytesPerSecond );
+    unsigned long getStreamReserve();
+    unsigned long getStreamRate();
+    void setWeight( int id, int weight );
+    void setLimit( int id, unsigned long bytesPerSecond );
+    void getStats( std::vector< TransferStats > * stats );
+
+protected:
+    TransferScheduler();
+    ~TransferScheduler();
+
+private:
+    struct Transfer;
+
+    double downloadRate();
+    void refill( LONGLONG time, unsigned long bytes );
+    LONGLONG now();
+
+    /**
+     * downloads being sent, indexed by id.
+     */
+    std::map< int, Transfer * > transfers;
+
+    /**
+     * finish tags of the sends waiting for their turn at the budget. the send
+     *   with the smallest tag goes next.
+     */
+    std::multiset< double > waiting;
+
+    /**
+     * start tag of the send that went last; sends of downloads that were idle
+     *   are tagged from here, so idling doesn't save up a share.
+     */
+    double virtualTime;
+
+    /**
+     * bytes that may be sent right now; refilled at {downloadRate}.
+     */
+    double tokens;
+
+    /**
+     * performance counter value of when {tokens} was last refilled.
+     */
+    LONGLONG lastRefill;
+
+    /**
+     * bytes the stream may send right now out of its reserve; refilled at
+     *   {streamReserve}, along with {tokens}.
+     */
+    double streamTokens;
+
+    /**
+     * bytes the stream sent since {streamWindowStart}, and the bytes per
+     *   second it was sent at over the last whole window.
+     */
+    unsigned long long streamWindowBytes;
+    LONGLONG streamWindowStart;
+    unsigned long streamRate;
+
+    /**
+     * frequency of the performance counter.
+     */
+    LARGE_INTEGER freq;
+
+    /**
+     * bytes per second all downloads and the stream may be sent at; 0 for no
+     *   limit.
+     */
+    unsigned long budget;
+
+    /**
+     * bytes per second of {budget} kept back for the live stream.
+     */
+    unsigned long streamReserve;
+
+    /**
+     * id given to the next download.
+     */
+    int nextId;
+
+    /**
+     * protects the interface functions of the {TransferScheduler}.
+     */
+    HANDLE access;
+};
+
+#endif
@@ -2,5 +2,8 @@
 #define _RESOURCE_H_
 
 #define IDB_CONNECTION_TOGGLE		110
+#define IDB_APPLY_RATE				111
+#define IDB_VOICE_MODE				112
+#define IDT_REFRESH_TRANSFERS		120
 
 #endif
\ No newline at end of file
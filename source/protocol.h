@@ -25,6 +25,31 @@
 
 #define MULTICAST_PORT 7778
 
+/**
+ * the server accepts data connections, used only to download songs, on the
+ *   port after its control port.
+ */
+#define DATA_PORT_OFFSET 1
+
+/**
+ * songs that several clients are downloading at once are also sent round and
+ *   round on this multicast group, so they all share one stream.
+ */
+#define CAROUSEL_ADDR "239.255.0.242"
+
+#define CAROUSEL_PORT 7779
+
+/**
+ * size of the blocks a song is cut into on the carousel. every block is sent
+ *   in a datagram of its own.
+ */
+#define CAROUSEL_BLOCK_SIZE 1024
+
+/**
+ * number of blocks of the carousel protected by each parity block.
+ */
+#define CAROUSEL_FEC_GROUP 8
+
 #define DATA_BUFSIZE 8196
 
 #define SIZE_INDEX 4
@@ -41,12 +66,33 @@
 
 #define AUDIO_BUFFER_LENGTH DATA_LEN
 
+/**
+ * milliseconds of voice captured into each packet in the low-latency voice
+ *   mode, and the milliseconds a voice's jitter buffer holds on to its first
+ *   packet before playing it, in that mode and otherwise. voice packets carry
+ *   one frame each, and are only as long as the frame; a full packet of
+ *   {DATA_LEN} bytes is the frame of the normal mode.
+ */
+#define VOICE_LOW_LATENCY_FRAME_MS 5
+
+#define VOICE_LOW_LATENCY_JITTER_MS 15
+
+#define VOICE_JITTER_MS 50
+
 #define NUM_AUDIO_CHANNELS 1
 
 #define FILENAME_PACKET_LENGTH 128
 
 #define FILE_PACKET_SIZE 256
 
+#define FILE_CHUNK_SIZE (64*1024)
+
+/**
+ * size of the header of the WAV files songs are read from. the PCM data of a
+ *   song starts right after it.
+ */
+#define WAV_HEADER_SIZE 44
+
 /**
  * audio data packet, that has an {index}, describing in what order the packet is
  *   supposed to be played.
@@ -69,12 +115,16 @@ typedef struct DataPacket DataPacket;
  *
  * {srcAddr}; holds the source address that sent this packet
  *
+ * {len}; number of bytes of {data} that were received; packets of voice may
+ *   be shorter than {DATA_LEN}
+ *
  * {data}; raw PCM data to play
  */
 struct LocalDataPacket
 {
 	int index;
 	unsigned long srcAddr;
+	int len;
 	char data[DATA_LEN];
 };
 
@@ -94,6 +144,182 @@ struct RequestPacket
 
 typedef struct RequestPacket RequestPacket;
 
+/**
+ * packet sent from the client to the server to request a download of a range
+ *   of a song, so a partially downloaded song can be resumed where it left off.
+ *
+ * {index}; integer that identifies which song is being downloaded.
+ *
+ * {offset}; offset of the first byte of the song to send
+ *
+ * {length}; number of bytes to send starting at {offset}; 0 to send the rest
+ *   of the song.
+ *
+ * {flags}; DOWNLOAD_FLAG_BULK if the client wants the song sent as a
+ *   DOWNLOAD_HEADER and DOWNLOAD_CHUNKs; otherwise it is sent the old way, in
+ *   DOWNLOAD packets.
+ *
+ * clients starting a download over a data connection first ask for an
+ *   {offset} of ULONG_MAX, which is answered with just the size of the song.
+ */
+struct DownloadRequestPacket
+{
+	int index;
+	unsigned long offset;
+	unsigned long length;
+	int flags;
+};
+
+typedef struct DownloadRequestPacket DownloadRequestPacket;
+
+/**
+ * set in the {flags} of a {DownloadRequestPacket} by clients that can
+ *   receive a song in bulk.
+ */
+#define DOWNLOAD_FLAG_BULK 1
+
+/**
+ * packet sent from the client to the server to have a song streamed to it
+ *   alone, starting at a sample of its choosing, instead of listening to the
+ *   multicast stream everybody shares.
+ *
+ * the server sends the same packet back to the client over TCP, with an
+ *   {index} of -1 and the same {firstIndex}, when the stream has reached the
+ *   end of the song.
+ *
+ * {index}; integer that identifies which song to stream; -1 to stop streaming
+ *   to the client, and go back to the multicast stream.
+ *
+ * {sample}; number of the first sample frame to stream, counted from the
+ *   start of the song's PCM data.
+ *
+ * {firstIndex}; the first packet of the stream is numbered {firstIndex} + 1,
+ *   so the client can tell it from packets of the streams before it.
+ */
+struct SeekPacket
+{
+	int index;
+	unsigned long sample;
+	int firstIndex;
+};
+
+typedef struct SeekPacket SeekPacket;
+
+/**
+ * most packets carried by a single {PrefillPacket}.
+ */
+#define PREFILL_BATCH 64
+
+/**
+ * packet sent from the server to a client over TCP, right after telling it
+ *   which song the multicast stream is playing. it carries the packets of the
+ *   stream the server sent most recently, or the first packets of a new song,
+ *   so they reach the client faster than real time. a prefill is split over
+ *   as many of these as it takes.
+ *
+ * {songId}; id of the song the packets are from
+ *
+ * {first}; nonzero for the first packet of a prefill; the client starts its
+ *   jitter buffer over just before the first of its {packets}.
+ *
+ * {lead}; bytes at the start of the first of {packets} that are the end of
+ *   the song before; only set on the first packet of a prefill.
+ *
+ * {count}; number of packets in {packets}; only that many are sent.
+ *
+ * {packets}; packets of the stream, in order.
+ */
+struct PrefillPacket
+{
+	int songId;
+	int first;
+	int lead;
+	int count;
+	DataPacket packets[PREFILL_BATCH];
+};
+
+typedef struct PrefillPacket PrefillPacket;
+
+/**
+ * format the server converts every song it streams to, so clients can keep
+ *   their audio device open from one song to the next.
+ *
+ * {sample_rate}; sample frames per second; 0 if songs are streamed in their
+ *   own format
+ *
+ * {bps}; bits per sample; 8 or 16
+ *
+ * {channels}; number of channels
+ */
+struct StreamFormat
+{
+	unsigned long sample_rate;
+	short bps;
+	short channels;
+};
+
+typedef struct StreamFormat StreamFormat;
+
+/**
+ * packet sent from the server to a client over TCP when the client is tuned
+ *   to a station; the client leaves the multicast group it was in, and joins
+ *   the group of the station.
+ *
+ * {station}; number of the station, counted from 0
+ *
+ * {count}; number of stations the server sends
+ *
+ * {group}; multicast group the station is sent to, in network byte order
+ *
+ * {format}; format the server streams songs in
+ */
+struct StationPacket
+{
+	int station;
+	int count;
+	unsigned long group;
+	StreamFormat format;
+};
+
+typedef struct StationPacket StationPacket;
+
+/**
+ * packet multicast by the server to announce the song a station goes on to
+ *   once the current one ends. the packets of the next song carry on from the
+ *   indexes of the current one, so the client's jitter buffer isn't reset;
+ *   the last bytes of the current song share a packet with the first bytes of
+ *   the next one, so there is no silence between them.
+ *
+ * {firstIndex}; index of the first packet with audio of the next song. it
+ *   comes first, so the client's UDP socket hands it over as the index of the
+ *   packet.
+ *
+ * {songId}; id of the next song
+ *
+ * {channels}, {bps}, {sample_rate}; format of the next song
+ *
+ * {size}; size of the audio of the next song
+ *
+ * {lead}; bytes at the start of the packet {firstIndex} that are the end of
+ *   the current song
+ *
+ * {dataOffset}; offset of the audio in the next song; the header of the song
+ *   isn't streamed
+ */
+struct FormatPacket
+{
+	int firstIndex;
+	int songId;
+	short channels;
+	short bps;
+	unsigned long sample_rate;
+	unsigned long size;
+	int lead;
+	unsigned long dataOffset;
+};
+
+typedef struct FormatPacket FormatPacket;
+
 struct MessageHeader
 {
 	uint32_t size;
@@ -121,6 +347,9 @@ typedef struct MessageHeader MessageHeader;
  *
  * {size}; size of the song in bytes
  *
+ * {dataOffset}; offset of the PCM data in the song file; {WAV_HEADER_SIZE}
+ *   unless the header has chunks besides the format and the data.
+ *
  * {filepath}; path to the file on the server side in wide characters
  *
  * {cFilepath}; path to the file on the client side
@@ -134,6 +363,7 @@ struct SongName
 	short bps; //bits per sample
 	unsigned long sample_rate;
 	unsigned long size;
+	unsigned long dataOffset;
 	wchar_t filepath[STR_LEN];
 	char cFilepath[STR_LEN];
 	char cFilename[STR_LEN];
@@ -169,6 +399,107 @@ struct FileTransferData
 
 typedef struct FileTransferData FileTransferData;
 
+/**
+ * sent once at the start of a bulk file transfer, before any of the
+ *   {FileChunkHeader} messages of the file.
+ *
+ * {songId}; id of the song being downloaded
+ *
+ * {size}; size of the whole file in bytes
+ *
+ * {offset}; offset of the first byte of the file that will be sent
+ *
+ * {length}; number of bytes of the file that will be sent
+ *
+ * {filename}; name of the song file being downloaded
+ */
+struct FileTransferHeader
+{
+	int songId;
+	unsigned long size;
+	unsigned long offset;
+	unsigned long length;
+	char filename[FILENAME_PACKET_LENGTH];
+};
+
+typedef struct FileTransferHeader FileTransferHeader;
+
+/**
+ * header of a chunk of a bulk file transfer. the header is immediately
+ *   followed by {dataLen} bytes of the file in the same message.
+ *
+ * a chunk with a {dataLen} of 0 ends the transfer, whether the whole file was
+ *   sent or the transfer was cancelled.
+ *
+ * {songId}; id of the song being downloaded
+ *
+ * {offset}; offset into the file that the data of this chunk belongs at
+ *
+ * {dataLen}; number of bytes of file data following the header
+ */
+struct FileChunkHeader
+{
+	int songId;
+	unsigned long offset;
+	unsigned long dataLen;
+};
+
+typedef struct FileChunkHeader FileChunkHeader;
+
+/**
+ * sent over a data connection ahead of the reply to a client starting a
+ *   download, when the song is also being sent on a carousel. the client may
+ *   collect the song from the carousel, and then fetch whatever it missed over
+ *   the data connection.
+ *
+ * {songId}; id of the song on the carousel
+ *
+ * {size}; size of the whole file in bytes
+ *
+ * {group}; address of the multicast group the carousel is sent to
+ *
+ * {port}; port the carousel is sent to
+ */
+struct CarouselOfferPacket
+{
+	int songId;
+	unsigned long size;
+	char group[16];
+	unsigned short port;
+};
+
+typedef struct CarouselOfferPacket CarouselOfferPacket;
+
+/**
+ * a block of a song sent on a carousel.
+ *
+ * the blocks of a song are numbered from 0, and every {CAROUSEL_FEC_GROUP}
+ *   blocks make up a group that is followed by a parity block, the XOR of the
+ *   blocks of the group. a client missing one block of a group can rebuild it
+ *   from the parity block and the others.
+ *
+ * {songId}; id of the song the block belongs to
+ *
+ * {size}; size of the whole file in bytes
+ *
+ * {block}; number of the block; or the number of the group, for a parity
+ *   block
+ *
+ * {parity}; nonzero if this is a parity block
+ *
+ * {data}; the block. the last block of the song is padded with zeros.
+ */
+struct CarouselPacket
+{
+	int songId;
+	unsigned long size;
+	unsigned long block;
+	int parity;
+	char data[CAROUSEL_BLOCK_SIZE];
+};
+
+typedef struct CarouselPacket CarouselPacket;
+
 /**
  * all the packets that the client and server exchange over the TCP control
  *   connection.
@@ -177,8 +508,11 @@ union TCPPacket
 {
 	SongName songName;
 	RequestPacket requestPacket;
+	DownloadRequestPacket downloadRequestPacket;
+	SeekPacket seekPacket;
 	DataPacket dataPacket;
 	FileTransferData fileTransferData;
+	FileTransferHeader fileTransferHeader;
 };
 
 typedef union TCPPacket TCPPacket;